@@ -1,32 +1,239 @@
-#pragma once
-
+#include <cerrno>
+#include <fstream>
 #include <iostream>
 #include <filesystem>
-#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BytecodeCompiler.h"
+#include "ConstantFolder.h"
+#include "IRFolder.h"
+#include "IRGenerator.h"
+#include "Interpreter.h"
 #include "Lexer.h"
+#include "MappedFile.h"
+#include "NativeCodeGenerator.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+#include "VirtualMachine.h"
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
 
 namespace fs = std::filesystem;
 
-void processFile(const char* filepath)
+// How processFile runs the program
+enum class Mode { RUN, INTERPRET, DISASSEMBLE, ASSEMBLY, NATIVE, IR };
+
+// Runs `arguments[0]`, looked up on the PATH, without a shell in between so
+// nothing in the arguments is interpreted. Returns whether it exited with 0.
+bool runProgram(const std::vector<std::string>& arguments)
+{
+    std::vector<char*> argv;
+    for(const std::string& argument : arguments)
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+#ifdef _WIN32
+    return _spawnvp(_P_WAIT, argv[0], argv.data()) == 0;
+#else
+    pid_t pid{};
+    if(posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        return false;
+    int status{ 0 };
+    while(waitpid(pid, &status, 0) == -1)
+    {
+        if(errno != EINTR)
+            return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+bool isSameFile(const fs::path& first, const fs::path& second)
+{
+    // Fails, and so is false, when either file does not exist
+    std::error_code error;
+    return fs::equivalent(first, second, error);
+}
+
+// Compiles the program to assembly, then either prints it or builds an
+// executable from it with the system's cc. The executable is `output`, by
+// default the source path without its extension, or with ".out" when it has
+// none, and the assembly is written next to it with ".s" appended.
+int compileNative(const std::vector<BBTCompiler::Stmt*>& statements, uint32_t frameSize, const fs::path& path,
+                  const fs::path& output, Mode mode)
+{
+    const std::string filename{ path.filename().string() };
+    BBTCompiler::NativeCodeGenerator generator(filename);
+    if(!generator.generate(statements, frameSize))
+    {
+        generator.getDiagnostics().print(std::cerr, filename);
+        return 65;
+    }
+    if(mode == Mode::ASSEMBLY)
+    {
+        std::cout << generator.getAssembly();
+        return 0;
+    }
+    fs::path executable{ output };
+    if(executable.empty())
+        executable = path.has_extension() ? fs::path(path).replace_extension() : fs::path(path) += ".out";
+    fs::path assembly{ executable };
+    assembly += ".s";
+    if(isSameFile(executable, path) || isSameFile(assembly, path))
+    {
+        std::cerr << "Refusing to overwrite the source file " << path.string() << ", pick another output with -o\n";
+        return 1;
+    }
+    std::ofstream stream(assembly);
+    stream << generator.getAssembly();
+    stream.close();
+    if(!stream)
+    {
+        std::cerr << "Cannot write " << assembly.string() << '\n';
+        return 1;
+    }
+    // Absolute paths, so a name starting with '-' is not taken for an option
+    if(!runProgram({ "cc", fs::absolute(assembly).string(), "-o", fs::absolute(executable).string() }))
+    {
+        std::cerr << "Cannot assemble " << assembly.string() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Runs the program in the file, returns the exit code
+int processFile(const char* filepath, Mode mode, const char* output)
 {
     const auto path = fs::path(filepath);
+    BBTCompiler::MappedFile file;
+    try
+    {
+        file.open(path);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    // Tokens view into the mapping, so the file must outlive the lexer
     BBTCompiler::Lexer lexer;
-    std::ifstream fileStream(filepath);
-    if(fileStream)
-        lexer.scan(fileStream);
-};
+    lexer.scanParallel(file.getView());
+    BBTCompiler::Parser parser(lexer.getTokens());
+    std::vector<BBTCompiler::Stmt*>& statements{ parser.parse() };
+    const std::string filename{ path.filename().string() };
+    if(parser.getDiagnostics().hasErrors())
+    {
+        parser.getDiagnostics().print(std::cerr, filename);
+        return 65;
+    }
+    BBTCompiler::Resolver resolver;
+    resolver.resolve(statements);
+    if(resolver.getDiagnostics().hasErrors())
+    {
+        resolver.getDiagnostics().print(std::cerr, filename);
+        return 65;
+    }
+    // Checked before folding, so code a constant condition removes is checked too
+    BBTCompiler::TypeChecker checker;
+    if(!checker.check(statements))
+    {
+        checker.getDiagnostics().print(std::cerr, filename);
+        return 65;
+    }
+    BBTCompiler::ConstantFolder folder(parser.getContext());
+    folder.fold(statements);
+    if(mode == Mode::INTERPRET)
+    {
+        BBTCompiler::Interpreter interpreter;
+        if(!interpreter.run(statements, resolver.getFrameSize()))
+        {
+            std::cout.flush();
+            interpreter.getDiagnostics().print(std::cerr, filename);
+            return 70;
+        }
+        return 0;
+    }
+    if(mode == Mode::ASSEMBLY || mode == Mode::NATIVE)
+        return compileNative(statements, resolver.getFrameSize(), path, output ? fs::path(output) : fs::path{}, mode);
+    if(mode == Mode::IR)
+    {
+        BBTCompiler::IRGenerator generator;
+        if(!generator.generate(statements, resolver.getFrameSize()))
+        {
+            generator.getDiagnostics().print(std::cerr, filename);
+            return 65;
+        }
+        BBTCompiler::IRFolder irFolder;
+        irFolder.fold(generator.getModule());
+        generator.getModule().print(std::cout);
+        return 0;
+    }
+    BBTCompiler::BytecodeCompiler compiler;
+    if(!compiler.compile(statements, resolver.getFrameSize()))
+    {
+        compiler.getDiagnostics().print(std::cerr, filename);
+        return 65;
+    }
+    if(mode == Mode::DISASSEMBLE)
+    {
+        compiler.getProgram().disassemble(std::cout);
+        return 0;
+    }
+    BBTCompiler::VirtualMachine vm;
+    if(!vm.run(compiler.getProgram()))
+    {
+        std::cout.flush();
+        vm.getDiagnostics().print(std::cerr, filename);
+        return 70;
+    }
+    return 0;
+}
 
 int main(int argc, char* argv[])
 {
-    if(argc != 2)
+    // The bytecode VM runs the program unless an option picks another mode
+    Mode mode{ Mode::RUN };
+    const char* output{ nullptr };
+    const char* filepath{ nullptr };
+    bool valid{ true };
+    for(int i = 1; i < argc && valid; ++i)
     {
-        std::cerr << "Usage: bbtcompiler filename\n";
+        const std::string_view argument{ argv[i] };
+        const bool modeOption{ mode == Mode::RUN };
+        if(argument == "-o" && i + 1 < argc && !output)
+            output = argv[++i];
+        else if(modeOption && argument == "--interpret")
+            mode = Mode::INTERPRET;
+        else if(modeOption && argument == "--disassemble")
+            mode = Mode::DISASSEMBLE;
+        else if(modeOption && argument == "--asm")
+            mode = Mode::ASSEMBLY;
+        else if(modeOption && argument == "--native")
+            mode = Mode::NATIVE;
+        else if(modeOption && argument == "--ir")
+            mode = Mode::IR;
+        else if(!filepath && !argument.empty() && argument[0] != '-')
+            filepath = argv[i];
+        else
+            valid = false;
+    }
+    if(!valid || !filepath || (output && mode != Mode::NATIVE))
+    {
+        std::cerr << "Usage: bbtcompiler [--interpret | --disassemble | --asm | --ir | --native [-o executable]] filename\n";
+        return 1;
     }
 
-    const auto pathType = fs::status(argv[1]);
-    if(pathType.type() == fs::file_type::regular)
+    const auto pathType = fs::status(filepath);
+    if(pathType.type() != fs::file_type::regular)
     {
-        processFile(argv[0]);
+        std::cerr << "Cannot open " << filepath << '\n';
+        return 1;
     }
-    return 0;
-}
\ No newline at end of file
+    return processFile(filepath, mode, output);
+}
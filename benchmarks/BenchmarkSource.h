@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace BBTBenchmarks
+{
+    // Generates a syntactically valid program exercising every statement and
+    // expression form, repeated `functions` times with distinct names.
+    inline std::string generateProgram(size_t functions)
+    {
+        std::string source;
+        source.reserve(functions * 420);
+        for(size_t i = 0; i < functions; ++i)
+        {
+            const std::string n = std::to_string(i);
+            source += "fn function_" + n + "(alpha: int, beta: float, gamma: bool) -> int\n{\n";
+            source += "    let counter_" + n + " : int = alpha * 2 - 3 + " + n + ";\n";
+            source += "    let ratio : float = beta / 1.25 + 0.5;\n";
+            source += "    let message : char = \"iteration \\\"" + n + "\\\" done\";\n";
+            source += "    for (let i : int = 0; i < 100; i = i + 1) {\n";
+            source += "        if (gamma && counter_" + n + " >= i || !gamma) print message;\n";
+            source += "        else counter_" + n + " = counter_" + n + " - (i * 3 + alpha) / 2;\n";
+            source += "    }\n";
+            source += "    while (counter_" + n + " != 0) counter_" + n + " = counter_" + n + " - 1;\n";
+            source += "    return helper(alpha, -beta, \"text\") + counter_" + n + ";\n}\n";
+        }
+        return source;
+    }
+
+    // Runs `work` `iterations` times and prints how many `unit`s per second
+    // it processed. Catch2 reports the timing statistics, this reports rates.
+    template<typename Work>
+    void reportThroughput(const std::string& name, size_t itemsPerRun, const std::string& unit, size_t iterations, Work&& work)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < iterations; ++i)
+            work();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double rate = static_cast<double>(itemsPerRun * iterations) / elapsed.count();
+        std::cout << name << ": " << rate / 1e6 << " M " << unit << "/s\n";
+    }
+}
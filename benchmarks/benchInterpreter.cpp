@@ -0,0 +1,148 @@
+#include "catch.hpp"
+#include "BenchmarkSource.h"
+#include "BytecodeCompiler.h"
+#include "Interpreter.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "VirtualMachine.h"
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using BBTCompiler::BytecodeCompiler;
+using BBTCompiler::Interpreter;
+using BBTCompiler::Lexer;
+using BBTCompiler::Parser;
+using BBTCompiler::Resolver;
+using BBTCompiler::VirtualMachine;
+
+namespace
+{
+    // Recursive calls dominate
+    constexpr std::string_view FibonacciSource{ R"(
+        fn fib(n: int) -> int {
+            if (n < 2) return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+        print fib(22);
+    )" };
+    // fib(22) makes 2 * fib(23) - 1 calls
+    constexpr size_t FibonacciCalls{ 2 * 28657 - 1 };
+
+    // Variable reads and writes and arithmetic in a loop dominate
+    constexpr std::string_view LoopSource{ R"(
+        let sum : int = 0;
+        let ratio : float = 0.0;
+        for (let i : int = 0; i < 200000; i = i + 1) {
+            if (i / 3 * 3 == i) sum = sum + i; else sum = sum - 1;
+            ratio = ratio + 0.5;
+        }
+        print sum;
+        print ratio;
+    )" };
+    constexpr size_t LoopIterations{ 200000 };
+
+    struct Program
+    {
+        Lexer lexer;
+        std::unique_ptr<Parser> parser;
+        std::vector<BBTCompiler::Stmt*>* statements{ nullptr };
+        uint32_t frameSize{ 0 };
+    };
+
+    std::unique_ptr<Program> compile(std::string_view source)
+    {
+        auto program = std::make_unique<Program>();
+        program->lexer.scan(source);
+        program->parser = std::make_unique<Parser>(program->lexer.getTokens());
+        program->statements = &program->parser->parse();
+        REQUIRE_FALSE(program->parser->getDiagnostics().hasErrors());
+        Resolver resolver;
+        resolver.resolve(*program->statements);
+        REQUIRE_FALSE(resolver.getDiagnostics().hasErrors());
+        program->frameSize = resolver.getFrameSize();
+        return program;
+    }
+}
+
+TEST_CASE("TreeWalkingInterpreter", "[benchmark][Interpreter]")
+{
+    const auto fibonacci = compile(FibonacciSource);
+    const auto loop = compile(LoopSource);
+    std::stringstream output;
+    Interpreter interpreter(output);
+    REQUIRE(interpreter.run(*fibonacci->statements, fibonacci->frameSize));
+    REQUIRE(interpreter.run(*loop->statements, loop->frameSize));
+    REQUIRE(output.str() == "17711\n6666500000\n100000\n");
+
+    BBTBenchmarks::reportThroughput("interpreter fib", FibonacciCalls, "calls", 10, [&] {
+        output.str("");
+        interpreter.run(*fibonacci->statements, fibonacci->frameSize);
+    });
+    BBTBenchmarks::reportThroughput("interpreter loop", LoopIterations, "iterations", 10, [&] {
+        output.str("");
+        interpreter.run(*loop->statements, loop->frameSize);
+    });
+
+    BENCHMARK("fib(22)")
+    {
+        output.str("");
+        return interpreter.run(*fibonacci->statements, fibonacci->frameSize);
+    };
+    BENCHMARK("loop of 200000")
+    {
+        output.str("");
+        return interpreter.run(*loop->statements, loop->frameSize);
+    };
+}
+
+TEST_CASE("BytecodeVM", "[benchmark][Interpreter][Bytecode]")
+{
+    const auto fibonacci = compile(FibonacciSource);
+    const auto loop = compile(LoopSource);
+    BytecodeCompiler fibonacciCompiler;
+    REQUIRE(fibonacciCompiler.compile(*fibonacci->statements, fibonacci->frameSize));
+    BytecodeCompiler loopCompiler;
+    REQUIRE(loopCompiler.compile(*loop->statements, loop->frameSize));
+    const BBTCompiler::BytecodeProgram& fibonacciProgram{ fibonacciCompiler.getProgram() };
+    const BBTCompiler::BytecodeProgram& loopProgram{ loopCompiler.getProgram() };
+
+    std::stringstream output;
+    VirtualMachine vm(output);
+    for(const auto dispatch : { VirtualMachine::Dispatch::COMPUTED_GOTO, VirtualMachine::Dispatch::SWITCH })
+    {
+        const std::string name{ dispatch == VirtualMachine::Dispatch::SWITCH ? "switch" : "computed goto" };
+        vm.setDispatch(dispatch);
+        output.str("");
+        REQUIRE(vm.run(fibonacciProgram));
+        REQUIRE(vm.run(loopProgram));
+        REQUIRE(output.str() == "17711\n6666500000\n100000\n");
+
+        BBTBenchmarks::reportThroughput("vm " + name + " fib", FibonacciCalls, "calls", 10, [&] {
+            output.str("");
+            vm.run(fibonacciProgram);
+        });
+        BBTBenchmarks::reportThroughput("vm " + name + " loop", LoopIterations, "iterations", 10, [&] {
+            output.str("");
+            vm.run(loopProgram);
+        });
+    }
+
+    vm.setDispatch(VirtualMachine::Dispatch::COMPUTED_GOTO);
+    BENCHMARK("fib(22)")
+    {
+        output.str("");
+        return vm.run(fibonacciProgram);
+    };
+    BENCHMARK("loop of 200000")
+    {
+        output.str("");
+        return vm.run(loopProgram);
+    };
+    BENCHMARK("compile fib")
+    {
+        BytecodeCompiler compiler;
+        return compiler.compile(*fibonacci->statements, fibonacci->frameSize);
+    };
+}
@@ -0,0 +1,214 @@
+#include "catch.hpp"
+#include "BenchmarkSource.h"
+#include "Lexer.h"
+#include "CharScan.h"
+#include "TokenBuffer.h"
+#include <unordered_map>
+
+using BBTCompiler::Lexer;
+using BBTCompiler::TokenType;
+
+namespace
+{
+    // The unordered_map tables the Lexer used before the constexpr tables,
+    // kept as the baseline for the lookup benchmarks.
+    const std::unordered_map<std::string, TokenType> LegacyKeywords{
+        {"const", TokenType::CONST}, {"int", TokenType::INT}, {"char", TokenType::CHAR},
+        {"bool", TokenType::BOOL}, {"float", TokenType::FLOAT}, {"true", TokenType::TRUE},
+        {"false", TokenType::FALSE}, {"null", TokenType::NIL}, {"return", TokenType::RETURN},
+        {"print", TokenType::PRINT}, {"let", TokenType::LET}, {"if", TokenType::IF},
+        {"else", TokenType::ELSE}, {"while", TokenType::WHILE}, {"for", TokenType::FOR},
+        {"continue", TokenType::CONTINUE}, {"break", TokenType::BREAK}, {"fn", TokenType::FN},
+        {"class", TokenType::CLASS}
+    };
+
+    const std::unordered_map<std::string, TokenType> LegacyPairedOperators{
+        {"==", TokenType::EQ_EQ}, {"!=", TokenType::NOT_EQ}, {"++", TokenType::PLUS_PLUS},
+        {"--", TokenType::MINUS_MINUS}, {"+=", TokenType::PLUS_EQ}, {"-+", TokenType::MINUS_EQ},
+        {">=", TokenType::GREATER_EQ}, {"<=", TokenType::LESS_EQ}, {"||", TokenType::OR},
+        {"&&", TokenType::AND}, {"->", TokenType::RIGHT_ARROW}
+    };
+
+    const std::vector<std::string_view> Words{
+        "counter", "let", "alpha", "return", "while", "message", "int", "float", "print",
+        "helper", "if", "else", "beta", "gamma", "for", "i", "function_42", "true", "fn"
+    };
+}
+
+TEST_CASE("LexerThroughput", "[benchmark][Lexer]")
+{
+    const std::string source = BBTBenchmarks::generateProgram(2000);
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    const size_t tokenCount = lexer.getTokens().size();
+    lexer.reset();
+
+    BBTBenchmarks::reportThroughput("lexer", tokenCount, "tokens", 20, [&] {
+        lexer.reset();
+        lexer.scan(std::string_view(source));
+    });
+
+    BENCHMARK("scan " + std::to_string(source.size() / 1024) + " KiB")
+    {
+        lexer.reset();
+        lexer.scan(std::string_view(source));
+        return lexer.getTokens().size();
+    };
+}
+
+TEST_CASE("LexerLookupTables", "[benchmark][Lexer]")
+{
+    BENCHMARK("keywords: unordered_map (before)")
+    {
+        size_t keywords{ 0 };
+        for(const auto word : Words)
+        {
+            const std::string key{ word };
+            if(LegacyKeywords.find(key) != LegacyKeywords.end())
+                keywords += static_cast<size_t>(LegacyKeywords.find(key)->second);
+        }
+        return keywords;
+    };
+
+    BENCHMARK("keywords: perfect hash (after)")
+    {
+        size_t keywords{ 0 };
+        for(const auto word : Words)
+        {
+            const TokenType type = BBTCompiler::keywordType(word);
+            if(type != TokenType::IDENTIFIER)
+                keywords += static_cast<size_t>(type);
+        }
+        return keywords;
+    };
+
+    const std::string_view operators{ "a==b!=c+=d-->e<=f&&g||h+i*j/k(l)m;" };
+
+    BENCHMARK("paired operators: unordered_map (before)")
+    {
+        size_t pairs{ 0 };
+        for(size_t i = 0; i + 1 < operators.size(); ++i)
+        {
+            const std::string pairString{ operators[i], operators[i + 1] };
+            if(LegacyPairedOperators.find(pairString) != LegacyPairedOperators.cend())
+                pairs += static_cast<size_t>(LegacyPairedOperators.find(pairString)->second);
+        }
+        return pairs;
+    };
+
+    BENCHMARK("paired operators: packed switch (after)")
+    {
+        size_t pairs{ 0 };
+        for(size_t i = 0; i + 1 < operators.size(); ++i)
+        {
+            const TokenType type = BBTCompiler::pairedOperatorType(operators[i], operators[i + 1]);
+            if(type != TokenType::INVALID)
+                pairs += static_cast<size_t>(type);
+        }
+        return pairs;
+    };
+}
+
+TEST_CASE("LexerSimdLevels", "[benchmark][Lexer][CharScan]")
+{
+    namespace CharScan = BBTCompiler::CharScan;
+    // Generated code with deep indentation, long names and long string
+    // literals, where scanning whole vectors at a time pays off
+    std::string source;
+    for(int i = 0; i < 5000; ++i)
+    {
+        source += std::string(48, ' ') + "let generated_identifier_with_a_long_name_" + std::to_string(i) + " : int = 1234567890123456;\n";
+        source += std::string(48, ' ') + "print \"a generated string literal with a fairly long body, number " + std::to_string(i) + "\";\n\n";
+    }
+    const std::string sizeLabel = " " + std::to_string(source.size() / 1024) + " KiB";
+    Lexer lexer;
+
+    const auto benchmarkLevel = [&](CharScan::SimdLevel level, const std::string& name) {
+        if(!CharScan::setLevel(level))
+            return;
+        BENCHMARK(name + sizeLabel)
+        {
+            lexer.reset();
+            lexer.scan(std::string_view(source));
+            return lexer.getTokens().size();
+        };
+    };
+    benchmarkLevel(CharScan::SimdLevel::SCALAR, "long runs scalar");
+    benchmarkLevel(CharScan::SimdLevel::SSE2, "long runs sse2");
+    benchmarkLevel(CharScan::SimdLevel::AVX2, "long runs avx2");
+    CharScan::setLevel(CharScan::bestSupportedLevel());
+}
+
+TEST_CASE("LexerParallelScan", "[benchmark][Lexer][Parallel]")
+{
+    const std::string source = BBTBenchmarks::generateProgram(20000);
+    const std::string sizeLabel = " " + std::to_string(source.size() / (1024 * 1024)) + " MiB";
+
+    // A fresh Lexer per run, as when compiling a file, so neither side reuses
+    // token storage from the previous iteration
+    BENCHMARK("sequential" + sizeLabel)
+    {
+        Lexer lexer;
+        lexer.scan(std::string_view(source));
+        return lexer.getTokens().size();
+    };
+
+    for(const size_t threads : { 2, 4, 8 })
+    {
+        BENCHMARK("parallel " + std::to_string(threads) + " threads" + sizeLabel)
+        {
+            Lexer lexer;
+            lexer.scanParallel(source, threads);
+            return lexer.getTokens().size();
+        };
+    }
+}
+
+TEST_CASE("TokenBufferMemory", "[benchmark][Lexer][TokenBuffer]")
+{
+    const std::string source = BBTBenchmarks::generateProgram(2000);
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    const std::vector<BBTCompiler::Token>& tokens{ lexer.getTokens() };
+    BBTCompiler::TokenBuffer buffer;
+    buffer.scan(source);
+
+    const double vectorBytes = static_cast<double>(tokens.capacity() * sizeof(BBTCompiler::Token));
+    std::cout << "std::vector<Token>: " << vectorBytes / tokens.size() << " bytes/token ("
+              << sizeof(BBTCompiler::Token) << " per element)\n";
+    std::cout << "TokenBuffer: " << static_cast<double>(buffer.memoryUsage()) / buffer.size() << " bytes/token\n";
+
+    BENCHMARK("scan into std::vector<Token>")
+    {
+        lexer.reset();
+        lexer.scan(std::string_view(source));
+        return lexer.getTokens().size();
+    };
+
+    BENCHMARK("scan into TokenBuffer")
+    {
+        buffer.scan(source);
+        return buffer.size();
+    };
+
+    // The access pattern of the Parser: the type of every token, and the
+    // lexeme of identifiers and literals
+    BENCHMARK("walk std::vector<Token>")
+    {
+        size_t checksum{ 0 };
+        for(const auto& token : lexer.getTokens())
+            checksum += static_cast<size_t>(token.type) + (token.type <= TokenType::STRING_LITERAL ? token.value.size() : 0);
+        return checksum;
+    };
+
+    BENCHMARK("walk TokenBuffer")
+    {
+        size_t checksum{ 0 };
+        for(size_t i = 0; i < buffer.size(); ++i)
+        {
+            const TokenType type{ buffer.type(i) };
+            checksum += static_cast<size_t>(type) + (type <= TokenType::STRING_LITERAL ? buffer.lexeme(i).size() : 0);
+        }
+        return checksum;
+    };
+}
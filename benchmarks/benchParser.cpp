@@ -0,0 +1,504 @@
+#include "catch.hpp"
+#include "BenchmarkSource.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "FlatAst.h"
+#include "ASTWalker.h"
+#include "JsonVisitor.h"
+#include "JsonWriter.h"
+#include "Resolver.h"
+#include <cstring>
+#include <sstream>
+
+using BBTCompiler::Lexer;
+using BBTCompiler::Parser;
+
+namespace
+{
+    // Counts the nodes of the pointer tree, the traversal a visitor pass does
+    class NodeCounter : public BBTCompiler::ASTConstVisitor
+    {
+    public:
+        size_t count{ 0 };
+        void add(const BBTCompiler::Expr* expr) { if(expr) expr->accept(*this); }
+        void add(const BBTCompiler::Stmt* stmt) { if(stmt) stmt->accept(*this); }
+
+        void visit(const BBTCompiler::AssignmentExpr& expr) override { ++count; add(expr.m_Value); }
+        void visit(const BBTCompiler::BinaryExpr& expr) override { ++count; add(expr.m_Left); add(expr.m_Right); }
+        void visit(const BBTCompiler::UnaryExpr& expr) override { ++count; add(expr.m_Right); }
+        void visit(const BBTCompiler::LiteralExpr&) override { ++count; }
+        void visit(const BBTCompiler::GroupedExpr& expr) override { ++count; add(expr.m_Expression); }
+        void visit(const BBTCompiler::VariableExpr&) override { ++count; }
+        void visit(const BBTCompiler::CallExpr& expr) override
+        {
+            ++count;
+            add(expr.m_Callee);
+            for(const auto* arg : expr.m_Args)
+                add(arg);
+        }
+        void visit(const BBTCompiler::ExprStmt& stmt) override { ++count; add(stmt.m_Expression); }
+        void visit(const BBTCompiler::PrintStmt& stmt) override { ++count; add(stmt.m_Expression); }
+        void visit(const BBTCompiler::VariableStmt& stmt) override { ++count; add(stmt.m_Initializer); }
+        void visit(const BBTCompiler::BlockStmt& stmt) override
+        {
+            ++count;
+            for(const auto* statement : stmt.m_Statements)
+                add(statement);
+        }
+        void visit(const BBTCompiler::IfStmt& stmt) override
+        {
+            ++count;
+            add(stmt.m_Condition);
+            add(stmt.m_ThenBranch);
+            add(stmt.m_ElseBranch);
+        }
+        void visit(const BBTCompiler::WhileStmt& stmt) override { ++count; add(stmt.m_Condition); add(stmt.m_Body); }
+        void visit(const BBTCompiler::FuncStmt& stmt) override
+        {
+            ++count;
+            for(const auto* statement : stmt.m_Body)
+                add(statement);
+        }
+        void visit(const BBTCompiler::ReturnStmt& stmt) override { ++count; add(stmt.m_Value); }
+        void visit(const BBTCompiler::ErrorExpr&) override { ++count; }
+        void visit(const BBTCompiler::ErrorStmt&) override { ++count; }
+    };
+
+    // The same traversal through visitAst, dispatched on the node kind
+    struct StaticNodeCounter
+    {
+        size_t count{ 0 };
+        void add(const BBTCompiler::Expr* expr) { if(expr) BBTCompiler::visitAst(*expr, *this); }
+        void add(const BBTCompiler::Stmt* stmt) { if(stmt) BBTCompiler::visitAst(*stmt, *this); }
+
+        void operator()(const BBTCompiler::AssignmentExpr& expr) { ++count; add(expr.m_Value); }
+        void operator()(const BBTCompiler::BinaryExpr& expr) { ++count; add(expr.m_Left); add(expr.m_Right); }
+        void operator()(const BBTCompiler::UnaryExpr& expr) { ++count; add(expr.m_Right); }
+        void operator()(const BBTCompiler::LiteralExpr&) { ++count; }
+        void operator()(const BBTCompiler::GroupedExpr& expr) { ++count; add(expr.m_Expression); }
+        void operator()(const BBTCompiler::VariableExpr&) { ++count; }
+        void operator()(const BBTCompiler::CallExpr& expr)
+        {
+            ++count;
+            add(expr.m_Callee);
+            for(const auto* arg : expr.m_Args)
+                add(arg);
+        }
+        void operator()(const BBTCompiler::ExprStmt& stmt) { ++count; add(stmt.m_Expression); }
+        void operator()(const BBTCompiler::PrintStmt& stmt) { ++count; add(stmt.m_Expression); }
+        void operator()(const BBTCompiler::VariableStmt& stmt) { ++count; add(stmt.m_Initializer); }
+        void operator()(const BBTCompiler::BlockStmt& stmt)
+        {
+            ++count;
+            for(const auto* statement : stmt.m_Statements)
+                add(statement);
+        }
+        void operator()(const BBTCompiler::IfStmt& stmt)
+        {
+            ++count;
+            add(stmt.m_Condition);
+            add(stmt.m_ThenBranch);
+            add(stmt.m_ElseBranch);
+        }
+        void operator()(const BBTCompiler::WhileStmt& stmt) { ++count; add(stmt.m_Condition); add(stmt.m_Body); }
+        void operator()(const BBTCompiler::FuncStmt& stmt)
+        {
+            ++count;
+            for(const auto* statement : stmt.m_Body)
+                add(statement);
+        }
+        void operator()(const BBTCompiler::ReturnStmt& stmt) { ++count; add(stmt.m_Value); }
+        void operator()(const BBTCompiler::ErrorExpr&) { ++count; }
+        void operator()(const BBTCompiler::ErrorStmt&) { ++count; }
+    };
+}
+
+TEST_CASE("ParserThroughput", "[benchmark][Parser]")
+{
+    const std::string source = BBTBenchmarks::generateProgram(2000);
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    const size_t tokenCount = lexer.getTokens().size();
+
+    {
+        Parser parser(lexer.getTokens());
+        parser.parse();
+        std::cout << "AST arena: " << parser.getContext().bytesAllocated() / 1024 << " KiB in "
+                  << parser.getContext().chunkCount() << " chunks\n";
+    }
+
+    // Includes destroying the tree, which frees one block per arena chunk
+    BBTBenchmarks::reportThroughput("parser", tokenCount, "tokens", 20, [&] {
+        Parser parser(lexer.getTokens());
+        parser.parse();
+    });
+
+    BENCHMARK("parse and destroy " + std::to_string(source.size() / 1024) + " KiB")
+    {
+        Parser parser(lexer.getTokens());
+        return parser.parse().size();
+    };
+}
+
+TEST_CASE("AstTraversal", "[benchmark][Parser][FlatAst]")
+{
+    const std::string source = BBTBenchmarks::generateProgram(2000);
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    Parser parser(lexer.getTokens());
+    const std::vector<BBTCompiler::Stmt*>& statements{ parser.parse() };
+    const BBTCompiler::FlatAst ast{ BBTCompiler::FlatAst::build(statements) };
+    std::cout << "AST nodes: " << ast.size() << "\n";
+
+    BENCHMARK("pointer tree, visitor")
+    {
+        NodeCounter counter;
+        for(const auto* statement : statements)
+            counter.add(statement);
+        return counter.count;
+    };
+
+    BENCHMARK("flat, pre-order")
+    {
+        size_t count{ 0 };
+        ast.preOrder([&](BBTCompiler::NodeIndex) { ++count; });
+        return count;
+    };
+
+    BENCHMARK("flat, post-order")
+    {
+        size_t count{ 0 };
+        ast.postOrder([&](BBTCompiler::NodeIndex) { ++count; });
+        return count;
+    };
+
+    BENCHMARK("flat, linear scan")
+    {
+        size_t count{ 0 };
+        for(BBTCompiler::NodeIndex node = 0; node < ast.size(); ++node)
+            count += ast.kind(node) != BBTCompiler::FlatNodeKind::LITERAL;
+        return count;
+    };
+
+    BENCHMARK("build flat AST from tree")
+    {
+        return BBTCompiler::FlatAst::build(statements).size();
+    };
+}
+
+TEST_CASE("AstDispatch", "[benchmark][Parser][Walker]")
+{
+    // A tree that stays in cache, where the cost of dispatch dominates, and
+    // one large enough for the traversal to be bound by memory latency
+    for(const size_t functions : { 200, 20000 })
+    {
+        const std::string source = BBTBenchmarks::generateProgram(functions);
+        const std::string sizeLabel = " " + std::to_string(source.size() / 1024) + " KiB";
+        Lexer lexer;
+        lexer.scan(std::string_view(source));
+        Parser parser(lexer.getTokens());
+        const std::vector<BBTCompiler::Stmt*>& statements{ parser.parse() };
+
+        BENCHMARK("virtual accept/visit" + sizeLabel)
+        {
+            NodeCounter counter;
+            for(const auto* statement : statements)
+                counter.add(statement);
+            return counter.count;
+        };
+
+        BENCHMARK("visitAst" + sizeLabel)
+        {
+            StaticNodeCounter counter;
+            for(const auto* statement : statements)
+                counter.add(statement);
+            return counter.count;
+        };
+    }
+}
+
+TEST_CASE("ParserErrorRecovery", "[benchmark][Parser][Diagnostics]")
+{
+    // One missing operand per function, the kind of error a half-edited file has
+    std::string source = BBTBenchmarks::generateProgram(2000);
+    for(size_t at = source.find("+ 0.5;"); at != std::string::npos; at = source.find("+ 0.5;", at))
+        source.replace(at, 6, "+ ;");
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    const size_t tokenCount = lexer.getTokens().size();
+
+    {
+        Parser parser(lexer.getTokens());
+        parser.parse();
+        std::cout << "syntax errors: " << parser.getDiagnostics().size() << "\n";
+    }
+
+    BBTBenchmarks::reportThroughput("parser with errors", tokenCount, "tokens", 20, [&] {
+        Parser parser(lexer.getTokens());
+        parser.parse();
+    });
+
+    BENCHMARK("parse with errors " + std::to_string(source.size() / 1024) + " KiB")
+    {
+        Parser parser(lexer.getTokens());
+        parser.parse();
+        return parser.getDiagnostics().size();
+    };
+
+    BENCHMARK("parse and format diagnostics")
+    {
+        Parser parser(lexer.getTokens());
+        parser.parse();
+        size_t length{ 0 };
+        for(const auto& diagnostic : parser.getDiagnostics().getDiagnostics())
+            length += BBTCompiler::Diagnostics::format(diagnostic).size();
+        return length;
+    };
+}
+
+TEST_CASE("ExpressionParsing", "[benchmark][Parser][Expression]")
+{
+    // Every nesting level and every operand starts a descent from the
+    // loosest precedence level down to the primary expression
+    const auto nested = [](size_t depth) {
+        std::string expression;
+        for(size_t i = 0; i < depth; ++i)
+            expression += i % 2 ? "-(" : "(a + ";
+        expression += "1";
+        expression.append(depth, ')');
+        return expression;
+    };
+    const auto flat = [](size_t operands) {
+        const char* const operators[]{ " + ", " * ", " == ", " - ", " < ", " / ", " || ", " && " };
+        std::string expression{ "x" };
+        for(size_t i = 1; i < operands; ++i)
+            expression += operators[i % 8] + std::to_string(i);
+        return expression;
+    };
+
+    std::string deepSource;
+    for(size_t i = 0; i < 200; ++i)
+        deepSource += "print " + nested(200) + ";\n";
+    const std::vector<std::pair<std::string, std::string>> sources{
+        { "deeply nested", deepSource },
+        { "long flat", "print " + flat(100000) + ";\n" }
+    };
+
+    for(const auto& source : sources)
+    {
+        const std::string& name{ source.first };
+        Lexer lexer;
+        lexer.scan(std::string_view(source.second));
+        const size_t tokenCount = lexer.getTokens().size();
+        BBTBenchmarks::reportThroughput(name + " expressions", tokenCount, "tokens", 20, [&] {
+            Parser parser(lexer.getTokens());
+            parser.parse();
+        });
+
+        BENCHMARK("parse " + name + " expressions")
+        {
+            Parser parser(lexer.getTokens());
+            return parser.parse().size();
+        };
+    }
+}
+
+TEST_CASE("DeclarationParsing", "[benchmark][Parser][TokenSet]")
+{
+    // Typed declarations of literals and unary expressions, which go
+    // through the type, unary operator and literal token sets
+    std::string source;
+    const char* const declarations[]{
+        "let a_{} : int = -{};\n",
+        "let b_{} : float = !{}.5;\n",
+        "let c_{} : bool = true;\n",
+        "let d_{} : char = \"{}\";\n",
+        "let e_{} : int = -(-{});\n",
+    };
+    for(size_t i = 0; i < 100000; ++i)
+    {
+        std::string declaration{ declarations[i % 5] };
+        for(size_t at = declaration.find("{}"); at != std::string::npos; at = declaration.find("{}", at))
+            declaration.replace(at, 2, std::to_string(i));
+        source += declaration;
+    }
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    const size_t tokenCount = lexer.getTokens().size();
+
+    BBTBenchmarks::reportThroughput("declarations", tokenCount, "tokens", 20, [&] {
+        Parser parser(lexer.getTokens());
+        parser.parse();
+    });
+
+    BENCHMARK("parse declarations " + std::to_string(source.size() / 1024) + " KiB")
+    {
+        Parser parser(lexer.getTokens());
+        return parser.parse().size();
+    };
+}
+
+TEST_CASE("NestingDepth", "[benchmark][Parser][Nesting]")
+{
+    // Around a million tokens of nested groups and blocks at each depth. Both
+    // parsers get the same limit, one that accepts the input. The recursive
+    // parser would run out of stack on inputs deeper than the default limit,
+    // so only the iterative one parses those.
+    for(const size_t depth : { size_t{ 10 }, size_t{ 1000 }, size_t{ 100000 } })
+    {
+        const std::string nested{ "print " + std::string(depth, '(') + "1" + std::string(depth, ')') + ";\n" +
+                                  std::string(depth, '{') + "print 1;" + std::string(depth, '}') + "\n" };
+        std::string source;
+        for(size_t i = 0; i == 0 || i < 250000 / depth; ++i)
+            source += nested;
+        Lexer lexer;
+        lexer.scan(std::string_view(source));
+        const size_t tokenCount = lexer.getTokens().size();
+
+        for(const bool iterative : { false, true })
+        {
+            if(!iterative && depth > Parser::DefaultNestingLimit)
+                continue;
+            const std::string name{ std::string(iterative ? "iterative" : "recursive") + " depth " + std::to_string(depth) };
+            const auto parse = [&] {
+                Parser parser(lexer.getTokens());
+                parser.setIterative(iterative);
+                parser.setNestingLimit(depth + 2);
+                return parser.parse().size();
+            };
+            BBTBenchmarks::reportThroughput(name, tokenCount, "tokens", 20, parse);
+
+            BENCHMARK("parse " + name)
+            {
+                return parse();
+            };
+        }
+    }
+}
+
+TEST_CASE("JsonSerialization", "[benchmark][Parser][Json]")
+{
+    const std::string source = BBTBenchmarks::generateProgram(500);
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    Parser parser(lexer.getTokens());
+    const std::vector<BBTCompiler::Stmt*>& statements{ parser.parse() };
+
+    // The DOM visitor builds a json document per statement and then dumps it
+    const auto domJson = [&] {
+        std::string output;
+        for(const BBTCompiler::Stmt* statement : statements)
+        {
+            BBTCompiler::ASTJSonVisitor jsonVisitor;
+            statement->accept(jsonVisitor);
+            output += jsonVisitor.toString();
+            output += '\n';
+        }
+        return output.size();
+    };
+    const auto writerJson = [&] {
+        BBTCompiler::ASTJsonWriter writer;
+        for(const BBTCompiler::Stmt* statement : statements)
+        {
+            statement->accept(writer);
+            writer.writeRaw("\n");
+        }
+        return writer.getString().size();
+    };
+    const size_t outputSize{ writerJson() };
+    REQUIRE(domJson() == outputSize);
+
+    BBTBenchmarks::reportThroughput("json dom", outputSize, "bytes", 10, domJson);
+    BBTBenchmarks::reportThroughput("json writer", outputSize, "bytes", 10, writerJson);
+
+    BENCHMARK("json dom " + std::to_string(outputSize / 1024) + " KiB")
+    {
+        return domJson();
+    };
+    BENCHMARK("json writer " + std::to_string(outputSize / 1024) + " KiB")
+    {
+        return writerJson();
+    };
+}
+
+TEST_CASE("BinaryAstFormat", "[benchmark][Parser][FlatAst]")
+{
+    const std::string source = BBTBenchmarks::generateProgram(500);
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    Parser parser(lexer.getTokens());
+    const std::vector<BBTCompiler::Stmt*>& statements{ parser.parse() };
+    const BBTCompiler::FlatAst ast{ BBTCompiler::FlatAst::build(statements) };
+
+    // What tooling reads today: one JSON document per statement
+    std::string json;
+    {
+        BBTCompiler::ASTJsonWriter writer;
+        writer.writeRaw("[");
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            if(i != 0)
+                writer.writeRaw(",");
+            statements[i]->accept(writer);
+        }
+        writer.writeRaw("]");
+        json = writer.getString();
+    }
+    std::stringstream stream;
+    ast.write(stream);
+    const std::string binary{ stream.str() };
+    std::vector<uint32_t> aligned((binary.size() + 3) / 4);
+    std::memcpy(aligned.data(), binary.data(), binary.size());
+    const std::string_view bytes(reinterpret_cast<const char*>(aligned.data()), binary.size());
+    std::cout << "JSON: " << json.size() / 1024 << " KiB, binary AST: " << binary.size() / 1024 << " KiB\n";
+
+    BENCHMARK("write binary AST")
+    {
+        std::stringstream output;
+        ast.write(output);
+        return output.tellp();
+    };
+
+    BENCHMARK("parse JSON")
+    {
+        return nlohmann::json::parse(json).size();
+    };
+
+    // Loading only checks the header, so this includes touching every node
+    BENCHMARK("load binary AST and scan it")
+    {
+        const BBTCompiler::FlatAst loaded{ BBTCompiler::FlatAst::load(bytes) };
+        size_t count{ 0 };
+        for(BBTCompiler::NodeIndex node = 0; node < loaded.size(); ++node)
+            count += loaded.kind(node) != BBTCompiler::FlatNodeKind::LITERAL;
+        return count;
+    };
+}
+
+TEST_CASE("NameResolution", "[benchmark][Parser][Resolver]")
+{
+    // The generated program calls an undeclared helper, declare it first
+    const std::string source = "fn helper(a: int, b: float, c: char) -> int { return a; }\n" + BBTBenchmarks::generateProgram(2000);
+    Lexer lexer;
+    lexer.scan(std::string_view(source));
+    const size_t tokenCount = lexer.getTokens().size();
+    Parser parser(lexer.getTokens());
+    std::vector<BBTCompiler::Stmt*>& statements{ parser.parse() };
+    {
+        BBTCompiler::Resolver resolver;
+        resolver.resolve(statements);
+        REQUIRE_FALSE(resolver.getDiagnostics().hasErrors());
+    }
+
+    BBTBenchmarks::reportThroughput("resolver", tokenCount, "tokens", 20, [&] {
+        BBTCompiler::Resolver resolver;
+        resolver.resolve(statements);
+    });
+
+    BENCHMARK("resolve " + std::to_string(source.size() / 1024) + " KiB")
+    {
+        BBTCompiler::Resolver resolver;
+        resolver.resolve(statements);
+        return resolver.getFrameSize();
+    };
+}
@@ -0,0 +1,100 @@
+#include "catch.hpp"
+#include "BenchmarkSource.h"
+#include "StringInterner.h"
+#include "SymbolTable.h"
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+using BBTCompiler::SymbolId;
+using BBTCompiler::SymbolTable;
+using BBTCompiler::SymbolType;
+
+namespace
+{
+    // The SymbolTable before interning, a std::map of names per scope, kept
+    // as the baseline
+    class LegacySymbolTable
+    {
+    public:
+        struct Symbol
+        {
+            SymbolType type{ SymbolType::INVALID };
+        };
+        std::map<std::string, Symbol>& pushScope() { return m_symbols.emplace_back(); }
+        void popScope() { m_symbols.pop_back(); }
+        std::optional<Symbol> find(std::string_view symbol)
+        {
+            for(auto it{m_symbols.rbegin()}; it != m_symbols.rend(); ++it)
+            {
+                if(auto search{ it->find(std::string(symbol)) }; search != it->end())
+                    return { search->second };
+            }
+            return std::nullopt;
+        }
+        Symbol& addSymbol(std::string_view name, SymbolType type)
+        {
+            auto result = m_symbols.back().insert_or_assign(std::string(name), Symbol{type}).first;
+            return result->second;
+        }
+    private:
+        std::vector<std::map<std::string, Symbol>> m_symbols;
+    };
+
+    // Opens `depth` nested scopes declaring `perScope` names each, looks up
+    // every name declared so far after each scope, then pops them all
+    template<typename Table, typename Names>
+    size_t nestedScopes(Table& table, const Names& names, size_t depth, size_t perScope)
+    {
+        size_t found{ 0 };
+        for(size_t scope = 0; scope < depth; ++scope)
+        {
+            table.pushScope();
+            for(size_t i = 0; i < perScope; ++i)
+                table.addSymbol(names[scope * perScope + i], SymbolType::VARIABLE);
+            for(size_t i = 0; i < (scope + 1) * perScope; ++i)
+                found += static_cast<bool>(table.find(names[i]));
+        }
+        for(size_t scope = 0; scope < depth; ++scope)
+            table.popScope();
+        return found;
+    }
+}
+
+TEST_CASE("SymbolTableLookup", "[benchmark][SymbolTable]")
+{
+    for(const auto& [depth, perScope] : { std::pair<size_t, size_t>{ 8, 64 }, { 64, 16 }, { 256, 4 } })
+    {
+        BBTCompiler::StringInterner interner;
+        std::vector<std::string> names;
+        std::vector<SymbolId> symbols;
+        for(size_t i = 0; i < depth * perScope; ++i)
+        {
+            names.push_back("variable_" + std::to_string(i));
+            symbols.push_back(interner.intern(names.back()));
+        }
+        const size_t lookups{ perScope * depth * (depth + 1) / 2 };
+        const std::string shape{ std::to_string(depth) + " scopes of " + std::to_string(perScope) };
+
+        const size_t scopeDepth{ depth };
+        const size_t scopeSize{ perScope };
+        LegacySymbolTable legacy;
+        BBTBenchmarks::reportThroughput("map per scope, " + shape, lookups, "lookups", 5, [&] {
+            return nestedScopes(legacy, names, scopeDepth, scopeSize);
+        });
+        SymbolTable table;
+        BBTBenchmarks::reportThroughput("open addressing, " + shape, lookups, "lookups", 5, [&] {
+            return nestedScopes(table, symbols, scopeDepth, scopeSize);
+        });
+
+        BENCHMARK("map per scope, " + shape)
+        {
+            return nestedScopes(legacy, names, scopeDepth, scopeSize);
+        };
+        BENCHMARK("open addressing, " + shape)
+        {
+            return nestedScopes(table, symbols, scopeDepth, scopeSize);
+        };
+    }
+}
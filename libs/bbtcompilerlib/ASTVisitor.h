@@ -9,6 +9,7 @@ namespace BBTCompiler
     class GroupedExpr;
     class VariableExpr;
     class CallExpr;
+    class ErrorExpr;
     class ExprStmt;
     class PrintStmt;
     class VariableStmt;
@@ -17,6 +18,7 @@ namespace BBTCompiler
     class WhileStmt;
     class FuncStmt;
     class ReturnStmt;
+    class ErrorStmt;
 
     class ASTConstVisitor {
     public:
@@ -27,6 +29,7 @@ namespace BBTCompiler
         virtual void visit(const GroupedExpr& expr) = 0;
         virtual void visit(const VariableExpr& expr) = 0;
         virtual void visit(const CallExpr& expr) = 0;
+        virtual void visit(const ErrorExpr& expr) = 0;
         virtual void visit(const ExprStmt& stmt) = 0;
         virtual void visit(const PrintStmt& stmt) = 0;
         virtual void visit(const VariableStmt& stmt) = 0;
@@ -35,5 +38,6 @@ namespace BBTCompiler
         virtual void visit(const WhileStmt& stmt) = 0;
         virtual void visit(const FuncStmt& stmt) = 0;
         virtual void visit(const ReturnStmt& stmt) = 0;
+        virtual void visit(const ErrorStmt& stmt) = 0;
     };
 }
\ No newline at end of file
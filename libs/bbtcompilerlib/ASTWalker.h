@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Expression.h"
+#include "Statement.h"
+
+namespace BBTCompiler
+{
+    // Statically dispatched alternative to accept()/ASTConstVisitor. The node
+    // kind selects the overload of `visitor` to call with the concrete node,
+    // so there is no virtual call and the visitor can be inlined. Every
+    // overload must return the same type. Recursion into children is left to
+    // the visitor, typically by calling visitAst on them again.
+    template<typename Visitor>
+    decltype(auto) visitAst(const Expr& expr, Visitor&& visitor)
+    {
+        switch(expr.getKind())
+        {
+        case ExprKind::ASSIGNMENT: return visitor(static_cast<const AssignmentExpr&>(expr));
+        case ExprKind::BINARY: return visitor(static_cast<const BinaryExpr&>(expr));
+        case ExprKind::UNARY: return visitor(static_cast<const UnaryExpr&>(expr));
+        case ExprKind::GROUPED: return visitor(static_cast<const GroupedExpr&>(expr));
+        case ExprKind::LITERAL: return visitor(static_cast<const LiteralExpr&>(expr));
+        case ExprKind::VARIABLE: return visitor(static_cast<const VariableExpr&>(expr));
+        case ExprKind::CALL: return visitor(static_cast<const CallExpr&>(expr));
+        case ExprKind::ERROR: break;
+        }
+        return visitor(static_cast<const ErrorExpr&>(expr));
+    }
+
+    template<typename Visitor>
+    decltype(auto) visitAst(const Stmt& stmt, Visitor&& visitor)
+    {
+        switch(stmt.getKind())
+        {
+        case StmtKind::PRINT: return visitor(static_cast<const PrintStmt&>(stmt));
+        case StmtKind::EXPRESSION: return visitor(static_cast<const ExprStmt&>(stmt));
+        case StmtKind::VARIABLE: return visitor(static_cast<const VariableStmt&>(stmt));
+        case StmtKind::BLOCK: return visitor(static_cast<const BlockStmt&>(stmt));
+        case StmtKind::IF: return visitor(static_cast<const IfStmt&>(stmt));
+        case StmtKind::WHILE: return visitor(static_cast<const WhileStmt&>(stmt));
+        case StmtKind::FUNCTION: return visitor(static_cast<const FuncStmt&>(stmt));
+        case StmtKind::RETURN: return visitor(static_cast<const ReturnStmt&>(stmt));
+        case StmtKind::ERROR: break;
+        }
+        return visitor(static_cast<const ErrorStmt&>(stmt));
+    }
+
+    // Same for passes that annotate the nodes they visit
+    template<typename Visitor>
+    decltype(auto) visitAst(Expr& expr, Visitor&& visitor)
+    {
+        switch(expr.getKind())
+        {
+        case ExprKind::ASSIGNMENT: return visitor(static_cast<AssignmentExpr&>(expr));
+        case ExprKind::BINARY: return visitor(static_cast<BinaryExpr&>(expr));
+        case ExprKind::UNARY: return visitor(static_cast<UnaryExpr&>(expr));
+        case ExprKind::GROUPED: return visitor(static_cast<GroupedExpr&>(expr));
+        case ExprKind::LITERAL: return visitor(static_cast<LiteralExpr&>(expr));
+        case ExprKind::VARIABLE: return visitor(static_cast<VariableExpr&>(expr));
+        case ExprKind::CALL: return visitor(static_cast<CallExpr&>(expr));
+        case ExprKind::ERROR: break;
+        }
+        return visitor(static_cast<ErrorExpr&>(expr));
+    }
+
+    template<typename Visitor>
+    decltype(auto) visitAst(Stmt& stmt, Visitor&& visitor)
+    {
+        switch(stmt.getKind())
+        {
+        case StmtKind::PRINT: return visitor(static_cast<PrintStmt&>(stmt));
+        case StmtKind::EXPRESSION: return visitor(static_cast<ExprStmt&>(stmt));
+        case StmtKind::VARIABLE: return visitor(static_cast<VariableStmt&>(stmt));
+        case StmtKind::BLOCK: return visitor(static_cast<BlockStmt&>(stmt));
+        case StmtKind::IF: return visitor(static_cast<IfStmt&>(stmt));
+        case StmtKind::WHILE: return visitor(static_cast<WhileStmt&>(stmt));
+        case StmtKind::FUNCTION: return visitor(static_cast<FuncStmt&>(stmt));
+        case StmtKind::RETURN: return visitor(static_cast<ReturnStmt&>(stmt));
+        case StmtKind::ERROR: break;
+        }
+        return visitor(static_cast<ErrorStmt&>(stmt));
+    }
+}
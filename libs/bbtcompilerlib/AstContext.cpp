@@ -0,0 +1,32 @@
+#include "AstContext.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace BBTCompiler
+{
+    void* AstContext::allocate(size_t size, size_t alignment)
+    {
+        auto address{ reinterpret_cast<std::uintptr_t>(m_Cursor) };
+        auto aligned{ (address + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1) };
+        if(!m_Cursor || aligned + size > reinterpret_cast<std::uintptr_t>(m_Limit))
+        {
+            // Oversized requests get a chunk of their own
+            const size_t chunkSize{ std::max(ChunkSize, size + alignment) };
+            m_Cursor = m_Chunks.emplace_back(new std::byte[chunkSize]).get();
+            m_Limit = m_Cursor + chunkSize;
+            address = reinterpret_cast<std::uintptr_t>(m_Cursor);
+            aligned = (address + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+        }
+        m_Cursor = reinterpret_cast<std::byte*>(aligned + size);
+        m_BytesAllocated += size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void AstContext::clear()
+    {
+        m_Chunks.clear();
+        m_Cursor = nullptr;
+        m_Limit = nullptr;
+        m_BytesAllocated = 0;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace BBTCompiler
+{
+    // Fixed size array allocated in an AstContext, used for the child lists
+    // of AST nodes
+    template<typename T>
+    class AstSpan
+    {
+    public:
+        AstSpan() = default;
+        AstSpan(T* data, size_t size) : m_Data{ data }, m_Size{ size } {}
+        T* begin() const { return m_Data; }
+        T* end() const { return m_Data + m_Size; }
+        T& operator[](size_t index) const { return m_Data[index]; }
+        T* data() const { return m_Data; }
+        size_t size() const { return m_Size; }
+        bool empty() const { return m_Size == 0; }
+    private:
+        T* m_Data{ nullptr };
+        size_t m_Size{ 0 };
+    };
+
+    // Bump allocator owning every node of an AST. Nodes are carved out of
+    // large chunks and never freed individually, which is why they must be
+    // trivially destructible: destroying the context releases the whole tree
+    // in one free per chunk.
+    class AstContext
+    {
+    public:
+        AstContext() = default;
+        AstContext(const AstContext&) = delete;
+        AstContext& operator=(const AstContext&) = delete;
+        AstContext(AstContext&&) = default;
+        AstContext& operator=(AstContext&&) = default;
+
+        template<typename T, typename... Args>
+        T* create(Args&&... args)
+        {
+            static_assert(std::is_trivially_destructible_v<T>, "AST nodes are never destroyed");
+            return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template<typename T>
+        AstSpan<T> copyArray(const T* items, size_t count)
+        {
+            static_assert(std::is_trivially_destructible_v<T>, "AST nodes are never destroyed");
+            if(count == 0)
+                return {};
+            T* data{ static_cast<T*>(allocate(sizeof(T) * count, alignof(T))) };
+            for(size_t i = 0; i < count; ++i)
+                new(data + i) T(items[i]);
+            return { data, count };
+        }
+
+        void* allocate(size_t size, size_t alignment);
+        // Releases every node at once
+        void clear();
+        size_t bytesAllocated() const { return m_BytesAllocated; }
+        size_t chunkCount() const { return m_Chunks.size(); }
+
+        static constexpr size_t ChunkSize{ 64 * 1024 };
+    private:
+        std::vector<std::unique_ptr<std::byte[]>> m_Chunks;
+        std::byte* m_Cursor{ nullptr };
+        std::byte* m_Limit{ nullptr };
+        size_t m_BytesAllocated{ 0 };
+    };
+}
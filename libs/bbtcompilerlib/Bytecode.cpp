@@ -0,0 +1,102 @@
+#include "Bytecode.h"
+#include "Statement.h"
+#include <algorithm>
+#include <array>
+#include <iomanip>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        constexpr std::array OpCodeNames{
+#define BBTCOMPILER_OPCODE_NAME(name) std::string_view{ #name },
+            BBTCOMPILER_OPCODES(BBTCOMPILER_OPCODE_NAME)
+#undef BBTCOMPILER_OPCODE_NAME
+        };
+
+        uint32_t readShort(const std::vector<uint8_t>& code, uint32_t offset)
+        {
+            return code[offset] | (code[offset + 1] << 8);
+        }
+    }
+
+    std::string_view opCodeName(OpCode op)
+    {
+        return OpCodeNames[static_cast<size_t>(op)];
+    }
+
+    const Token& BytecodeFunction::tokenAt(uint32_t offset) const
+    {
+        static const Token NoToken{};
+        if(tokens.empty())
+            return NoToken;
+        const auto found = std::lower_bound(tokens.begin(), tokens.end(), offset,
+            [](const std::pair<uint32_t, Token>& entry, uint32_t value) { return entry.first < value; });
+        return found != tokens.end() ? found->second : tokens.back().second;
+    }
+
+    void BytecodeProgram::disassemble(std::ostream& stream) const
+    {
+        for(const BytecodeFunction& function : functions)
+            disassemble(stream, function);
+    }
+
+    void BytecodeProgram::disassemble(std::ostream& stream, const BytecodeFunction& function)
+    {
+        stream << "== " << (function.declaration ? function.name : "<script>") << " ==\n";
+        for(uint32_t offset = 0; offset < function.code.size();)
+            offset = disassembleInstruction(stream, function, offset);
+    }
+
+    uint32_t BytecodeProgram::disassembleInstruction(std::ostream& stream, const BytecodeFunction& function, uint32_t offset)
+    {
+        const std::vector<uint8_t>& code{ function.code };
+        const auto op = static_cast<OpCode>(code[offset]);
+        stream << std::setw(4) << std::setfill('0') << offset << ' ' << opCodeName(op);
+        uint32_t next{ offset + 1 };
+        switch(op)
+        {
+        case OpCode::CONSTANT:
+        {
+            const uint32_t constant{ readShort(code, next) };
+            stream << ' ' << constant << " (" << function.constants[constant] << ')';
+            next += 2;
+            break;
+        }
+        case OpCode::GET_LOCAL:
+        case OpCode::SET_LOCAL:
+        case OpCode::STORE_LOCAL:
+            stream << ' ' << readShort(code, next);
+            next += 2;
+            break;
+        case OpCode::GET_OUTER:
+        case OpCode::SET_OUTER:
+            stream << ' ' << static_cast<uint32_t>(code[next]) << ' ' << readShort(code, next + 1);
+            next += 3;
+            break;
+        case OpCode::FUNCTION:
+            stream << ' ' << readShort(code, next) << ' ' << readShort(code, next + 2);
+            next += 4;
+            break;
+        case OpCode::JUMP:
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_FALSE_OR_POP:
+        case OpCode::JUMP_IF_TRUE_OR_POP:
+            stream << " -> " << std::setw(4) << next + 2 + readShort(code, next);
+            next += 2;
+            break;
+        case OpCode::LOOP:
+            stream << " -> " << std::setw(4) << next + 2 - readShort(code, next);
+            next += 2;
+            break;
+        case OpCode::CALL:
+            stream << ' ' << static_cast<uint32_t>(code[next]);
+            next += 3;
+            break;
+        default:
+            break;
+        }
+        stream << std::setfill(' ') << '\n';
+        return next;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Lexer.h"
+#include "Value.h"
+
+namespace BBTCompiler
+{
+    class FuncStmt;
+
+    // Instructions of the VM and their operands. The VM works on a value
+    // stack: a call frame is the function's slots, numbered by the Resolver,
+    // followed by the temporaries of the expression being evaluated.
+    // Operands follow the opcode byte, 16-bit ones in little endian order.
+    //
+    //   CONSTANT              u16 constant         push constants[constant]
+    //   NIL, TRUE, FALSE                           push the value
+    //   POP                                        drop the top value
+    //   GET_LOCAL             u16 slot             push a slot of the current frame
+    //   SET_LOCAL             u16 slot             store the top value, keep it
+    //   STORE_LOCAL           u16 slot             store the top value, pop it
+    //   GET_OUTER             u8 depth, u16 slot   same for the frame `depth`
+    //   SET_OUTER             u8 depth, u16 slot   static links out
+    //   FUNCTION              u16 function, u16 slot
+    //                                              store a function value in a slot
+    //   ADD ... GREATER_EQUAL                      pop two operands, push the result
+    //   ADD_INT ... GREATER_EQUAL_INT              same for operands the TypeChecker
+    //   ADD_FLOAT ... GREATER_EQUAL_FLOAT          typed as two ints or two floats,
+    //                                              without checking their type
+    //   NEGATE, NOT                                replace the top value
+    //   NEGATE_INT, NEGATE_FLOAT                   same for a typed operand
+    //   TRUTHY                                     replace the top value by a bool
+    //   JUMP                  u16 offset           jump forward
+    //   JUMP_IF_FALSE         u16 offset           pop, jump forward if false
+    //   JUMP_IF_FALSE_OR_POP  u16 offset           jump forward if false, pop otherwise
+    //   JUMP_IF_TRUE_OR_POP   u16 offset           jump forward if true, pop otherwise
+    //   LOOP                  u16 offset           jump backward
+    //   CALL                  u8 arguments, u16 call site
+    //                                              call the function below the arguments
+    //   RETURN                                     leave the frame with the top value
+    //   PRINT                                      pop and print
+    //
+    // Jump offsets count from the end of the jump instruction.
+#define BBTCOMPILER_OPCODES(X) \
+    X(CONSTANT) X(NIL) X(TRUE) X(FALSE) X(POP) \
+    X(GET_LOCAL) X(SET_LOCAL) X(STORE_LOCAL) X(GET_OUTER) X(SET_OUTER) X(FUNCTION) \
+    X(ADD) X(SUBTRACT) X(MULTIPLY) X(DIVIDE) \
+    X(EQUAL) X(NOT_EQUAL) X(LESS) X(LESS_EQUAL) X(GREATER) X(GREATER_EQUAL) \
+    X(ADD_INT) X(SUBTRACT_INT) X(MULTIPLY_INT) X(DIVIDE_INT) \
+    X(EQUAL_INT) X(NOT_EQUAL_INT) X(LESS_INT) X(LESS_EQUAL_INT) X(GREATER_INT) X(GREATER_EQUAL_INT) \
+    X(ADD_FLOAT) X(SUBTRACT_FLOAT) X(MULTIPLY_FLOAT) X(DIVIDE_FLOAT) \
+    X(EQUAL_FLOAT) X(NOT_EQUAL_FLOAT) X(LESS_FLOAT) X(LESS_EQUAL_FLOAT) X(GREATER_FLOAT) X(GREATER_EQUAL_FLOAT) \
+    X(NEGATE) X(NEGATE_INT) X(NEGATE_FLOAT) X(NOT) X(TRUTHY) \
+    X(JUMP) X(JUMP_IF_FALSE) X(JUMP_IF_FALSE_OR_POP) X(JUMP_IF_TRUE_OR_POP) X(LOOP) \
+    X(CALL) X(RETURN) X(PRINT)
+
+    enum class OpCode : uint8_t
+    {
+#define BBTCOMPILER_OPCODE_ENUM(name) name,
+        BBTCOMPILER_OPCODES(BBTCOMPILER_OPCODE_ENUM)
+#undef BBTCOMPILER_OPCODE_ENUM
+    };
+
+    std::string_view opCodeName(OpCode op);
+
+    struct BytecodeFunction
+    {
+        std::string_view name;
+        // Null for the top level of the program
+        const FuncStmt* declaration{ nullptr };
+        uint32_t arity{ 0 };
+        uint32_t frameSize{ 0 };
+        // Stack the function needs, its frame and its deepest temporaries
+        uint32_t maxStack{ 0 };
+        std::vector<uint8_t> code;
+        std::vector<Value> constants;
+        // Token of every instruction that can fail, by offset, for runtime
+        // errors. Appended in code order so it is sorted.
+        std::vector<std::pair<uint32_t, Token>> tokens;
+
+        const Token& tokenAt(uint32_t offset) const;
+    };
+
+    // Made by the BytecodeCompiler. Function values refer to their FuncStmt,
+    // findFunction maps it to the compiled function.
+    class BytecodeProgram
+    {
+    public:
+        // The top level of the program is function 0
+        std::vector<BytecodeFunction> functions;
+        uint32_t callSites{ 0 };
+
+        uint32_t findFunction(const FuncStmt* declaration) const { return m_Index.at(declaration); }
+        void addFunction(const FuncStmt* declaration, uint32_t index) { m_Index.emplace(declaration, index); }
+
+        // One line per instruction: offset, name and operands
+        void disassemble(std::ostream& stream) const;
+        static void disassemble(std::ostream& stream, const BytecodeFunction& function);
+        // Writes the instruction at `offset`, returns the offset of the next one
+        static uint32_t disassembleInstruction(std::ostream& stream, const BytecodeFunction& function, uint32_t offset);
+    private:
+        std::unordered_map<const FuncStmt*, uint32_t> m_Index;
+    };
+}
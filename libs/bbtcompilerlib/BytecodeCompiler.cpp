@@ -0,0 +1,424 @@
+#include "BytecodeCompiler.h"
+#include "ASTWalker.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        constexpr uint32_t MaxShort{ 0xFFFF };
+        constexpr uint32_t MaxByte{ 0xFF };
+        constexpr std::string_view SyntaxErrorMessage{ "Cannot compile code with a syntax error." };
+
+        bool binaryOpCode(TokenType type, OpCode& op)
+        {
+            switch(type)
+            {
+            case TokenType::PLUS: op = OpCode::ADD; return true;
+            case TokenType::MINUS: op = OpCode::SUBTRACT; return true;
+            case TokenType::STAR: op = OpCode::MULTIPLY; return true;
+            case TokenType::SLASH: op = OpCode::DIVIDE; return true;
+            case TokenType::EQ_EQ: op = OpCode::EQUAL; return true;
+            case TokenType::NOT_EQ: op = OpCode::NOT_EQUAL; return true;
+            case TokenType::LESS: op = OpCode::LESS; return true;
+            case TokenType::LESS_EQ: op = OpCode::LESS_EQUAL; return true;
+            case TokenType::GREATER: op = OpCode::GREATER; return true;
+            case TokenType::GREATER_EQ: op = OpCode::GREATER_EQUAL; return true;
+            default: return false;
+            }
+        }
+
+        // The variant of a generic arithmetic or comparison opcode for two
+        // operands of the same number type, they are declared in the same
+        // order after the generic ones
+        OpCode typedOpCode(OpCode op, ExprType left, ExprType right)
+        {
+            if(left != right || (left != ExprType::INT && left != ExprType::FLOAT))
+                return op;
+            const OpCode first{ left == ExprType::INT ? OpCode::ADD_INT : OpCode::ADD_FLOAT };
+            return static_cast<OpCode>(static_cast<uint8_t>(first) + static_cast<uint8_t>(op) - static_cast<uint8_t>(OpCode::ADD));
+        }
+    }
+
+    struct BytecodeCompilerWalk
+    {
+        BytecodeCompiler& compiler;
+
+        void operator()(const AssignmentExpr& expr) const
+        {
+            compiler.compile(*expr.m_Value);
+            compiler.emitVariable(OpCode::SET_LOCAL, OpCode::SET_OUTER, expr.m_Binding, expr.m_Name);
+        }
+        void operator()(const BinaryExpr& expr) const
+        {
+            const Token& op{ expr.m_Operator };
+            if(op.type == TokenType::AND || op.type == TokenType::OR)
+            {
+                compiler.compile(*expr.m_Left);
+                const uint32_t jump{ compiler.emitJump(
+                    op.type == TokenType::AND ? OpCode::JUMP_IF_FALSE_OR_POP : OpCode::JUMP_IF_TRUE_OR_POP, -1) };
+                compiler.compile(*expr.m_Right);
+                compiler.patchJump(jump);
+                compiler.emit(OpCode::TRUTHY, 0);
+                return;
+            }
+            compiler.compile(*expr.m_Left);
+            compiler.compile(*expr.m_Right);
+            OpCode opCode{};
+            if(!binaryOpCode(op.type, opCode))
+            {
+                compiler.error(op, "Unsupported operator '{}'.", op.value);
+                return;
+            }
+            compiler.mark(op);
+            compiler.emit(typedOpCode(opCode, expr.m_Left->getType(), expr.m_Right->getType()), -1);
+        }
+        void operator()(const UnaryExpr& expr) const
+        {
+            compiler.compile(*expr.m_Right);
+            if(expr.m_Operator.type == TokenType::NOT)
+            {
+                compiler.emit(OpCode::NOT, 0);
+                return;
+            }
+            compiler.mark(expr.m_Operator);
+            const ExprType type{ expr.m_Right->getType() };
+            compiler.emit(type == ExprType::INT ? OpCode::NEGATE_INT
+                          : type == ExprType::FLOAT ? OpCode::NEGATE_FLOAT : OpCode::NEGATE, 0);
+        }
+        void operator()(const GroupedExpr& expr) const { compiler.compile(*expr.m_Expression); }
+        void operator()(const LiteralExpr& expr) const
+        {
+            const Token& token{ expr.m_Token };
+            const char* begin{ token.value.data() };
+            const char* end{ begin + token.value.size() };
+            switch(token.type)
+            {
+            case TokenType::TRUE: compiler.emit(OpCode::TRUE, 1); break;
+            case TokenType::FALSE: compiler.emit(OpCode::FALSE, 1); break;
+            case TokenType::STRING_LITERAL: compiler.emitConstant(Value::makeString(token.value), token); break;
+            case TokenType::INT_LITERAL:
+            {
+                int64_t value{ 0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    compiler.error(token, "Integer literal '{}' is too large.", token.value);
+                compiler.emitConstant(Value::makeInt(value), token);
+                break;
+            }
+            case TokenType::FLOAT_LITERAL:
+            {
+                double value{ 0.0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    value = std::numeric_limits<double>::infinity();
+                compiler.emitConstant(Value::makeFloat(value), token);
+                break;
+            }
+            default: compiler.emit(OpCode::NIL, 1); break;
+            }
+        }
+        void operator()(const VariableExpr& expr) const
+        {
+            compiler.emitVariable(OpCode::GET_LOCAL, OpCode::GET_OUTER, expr.m_Binding, expr.m_Name);
+        }
+        void operator()(const CallExpr& expr) const
+        {
+            compiler.compile(*expr.m_Callee);
+            for(const Expr* argument : expr.m_Args)
+                compiler.compile(*argument);
+            if(expr.m_Args.size() > MaxByte)
+                compiler.error(expr.m_Paren, "Too many arguments.");
+            if(compiler.m_Program.callSites > MaxShort)
+                compiler.error(expr.m_Paren, "Too many calls in one program.");
+            compiler.mark(expr.m_Paren);
+            compiler.emit(OpCode::CALL, -static_cast<int32_t>(expr.m_Args.size()));
+            compiler.emitByte(static_cast<uint8_t>(expr.m_Args.size()));
+            compiler.emitShort(compiler.m_Program.callSites++);
+        }
+        void operator()(const ErrorExpr& expr) const { compiler.error(expr.m_Token, SyntaxErrorMessage); }
+
+        void operator()(const PrintStmt& stmt) const
+        {
+            compiler.compile(*stmt.m_Expression);
+            compiler.emit(OpCode::PRINT, -1);
+        }
+        void operator()(const ExprStmt& stmt) const
+        {
+            // An assignment to a local whose value is not used stores and
+            // pops in one instruction
+            const Expr& expression{ *stmt.m_Expression };
+            if(expression.getKind() == ExprKind::ASSIGNMENT)
+            {
+                const auto& assignment = static_cast<const AssignmentExpr&>(expression);
+                if(assignment.m_Binding.isResolved() && assignment.m_Binding.depth == 0)
+                {
+                    compiler.compile(*assignment.m_Value);
+                    compiler.emitSlot(OpCode::STORE_LOCAL, assignment.m_Binding.slot, assignment.m_Name);
+                    return;
+                }
+            }
+            compiler.compile(expression);
+            compiler.emit(OpCode::POP, -1);
+        }
+        void operator()(const VariableStmt& stmt) const
+        {
+            if(stmt.m_Initializer)
+                compiler.compile(*stmt.m_Initializer);
+            else
+                compiler.emitDefault(stmt);
+            if(stmt.m_Slot == Binding::Unresolved)
+            {
+                compiler.error(stmt.m_Name, SyntaxErrorMessage);
+                return;
+            }
+            compiler.emitSlot(OpCode::STORE_LOCAL, stmt.m_Slot, stmt.m_Name);
+        }
+        void operator()(const BlockStmt& stmt) const
+        {
+            compiler.compileBlock(AstSpan<Stmt* const>(stmt.m_Statements.data(), stmt.m_Statements.size()));
+        }
+        void operator()(const IfStmt& stmt) const
+        {
+            compiler.compile(*stmt.m_Condition);
+            const uint32_t elseJump{ compiler.emitJump(OpCode::JUMP_IF_FALSE, -1) };
+            if(stmt.m_ThenBranch)
+                compiler.compile(*stmt.m_ThenBranch);
+            if(!stmt.m_ElseBranch)
+            {
+                compiler.patchJump(elseJump);
+                return;
+            }
+            const uint32_t endJump{ compiler.emitJump(OpCode::JUMP, 0) };
+            compiler.patchJump(elseJump);
+            compiler.compile(*stmt.m_ElseBranch);
+            compiler.patchJump(endJump);
+        }
+        void operator()(const WhileStmt& stmt) const
+        {
+            const uint32_t start{ compiler.offset() };
+            compiler.compile(*stmt.m_Condition);
+            const uint32_t exitJump{ compiler.emitJump(OpCode::JUMP_IF_FALSE, -1) };
+            if(stmt.m_Body)
+                compiler.compile(*stmt.m_Body);
+            compiler.emitLoop(start);
+            compiler.patchJump(exitJump);
+        }
+        // Compiled where the enclosing block starts, see compileBlock
+        void operator()(const FuncStmt&) const {}
+        void operator()(const ReturnStmt& stmt) const
+        {
+            if(stmt.m_Value)
+                compiler.compile(*stmt.m_Value);
+            else
+                compiler.emit(OpCode::NIL, 1);
+            compiler.emit(OpCode::RETURN, -1);
+        }
+        void operator()(const ErrorStmt& stmt) const { compiler.error(stmt.m_Token, SyntaxErrorMessage); }
+    };
+
+    bool BytecodeCompiler::compile(const std::vector<Stmt*>& statements, uint32_t frameSize)
+    {
+        m_Program = BytecodeProgram{};
+        m_Diagnostics.clear();
+        m_Functions.assign(1, FunctionState{ 0 });
+        BytecodeFunction& script = m_Program.functions.emplace_back();
+        script.name = "<script>";
+        script.frameSize = frameSize;
+        compileBlock(AstSpan<Stmt* const>(statements.data(), statements.size()));
+        emit(OpCode::NIL, 1);
+        emit(OpCode::RETURN, -1);
+        current().maxStack = current().frameSize + static_cast<uint32_t>(m_Functions.back().maxDepth);
+        m_Functions.clear();
+        return !m_Diagnostics.hasErrors();
+    }
+
+    uint32_t BytecodeCompiler::compileFunction(const FuncStmt& function)
+    {
+        const auto index = static_cast<uint32_t>(m_Program.functions.size());
+        BytecodeFunction& compiled = m_Program.functions.emplace_back();
+        compiled.name = function.m_Name.value;
+        compiled.declaration = &function;
+        compiled.arity = static_cast<uint32_t>(function.m_Params.size());
+        compiled.frameSize = std::max(function.m_FrameSize, compiled.arity);
+        if(compiled.frameSize > MaxShort + 1)
+            error(function.m_Name, "Too many variables in '{}'.", function.m_Name.value);
+        m_Program.addFunction(&function, index);
+
+        m_Functions.push_back(FunctionState{ index });
+        compileBlock(AstSpan<Stmt* const>(function.m_Body.data(), function.m_Body.size()));
+        emit(OpCode::NIL, 1);
+        emit(OpCode::RETURN, -1);
+        current().maxStack = current().frameSize + static_cast<uint32_t>(m_Functions.back().maxDepth);
+        m_Functions.pop_back();
+        return index;
+    }
+
+    void BytecodeCompiler::compileBlock(AstSpan<Stmt* const> statements)
+    {
+        // Functions of the block are stored before its statements run, like
+        // the Resolver declares them
+        size_t lastFunction{ 0 };
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::FUNCTION)
+                continue;
+            lastFunction = i;
+            const auto& function = static_cast<const FuncStmt&>(*statements[i]);
+            if(function.m_Slot == Binding::Unresolved)
+                continue;
+            const uint32_t index{ compileFunction(function) };
+            if(index > MaxShort)
+                error(function.m_Name, "Too many functions in one program.");
+            emit(OpCode::FUNCTION, 0);
+            emitShort(index);
+            emitShort(function.m_Slot);
+        }
+        // A call to one of them can read a variable declared ahead of the
+        // function before the variable's declaration runs, so the variable
+        // starts with its default value
+        for(size_t i = 0; i < lastFunction; ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::VARIABLE)
+                continue;
+            const auto& variable = static_cast<const VariableStmt&>(*statements[i]);
+            if(variable.m_Slot == Binding::Unresolved)
+                continue;
+            emitDefault(variable);
+            emitSlot(OpCode::STORE_LOCAL, variable.m_Slot, variable.m_Name);
+        }
+        for(const Stmt* statement : statements)
+            compile(*statement);
+    }
+
+    void BytecodeCompiler::compile(const Stmt& stmt)
+    {
+        visitAst(stmt, BytecodeCompilerWalk{ *this });
+    }
+
+    void BytecodeCompiler::compile(const Expr& expr)
+    {
+        visitAst(expr, BytecodeCompilerWalk{ *this });
+    }
+
+    void BytecodeCompiler::emit(OpCode op, int32_t effect)
+    {
+        emitByte(static_cast<uint8_t>(op));
+        FunctionState& state{ m_Functions.back() };
+        state.depth += effect;
+        state.maxDepth = std::max(state.maxDepth, state.depth);
+    }
+
+    void BytecodeCompiler::emitShort(uint32_t value)
+    {
+        emitByte(static_cast<uint8_t>(value & 0xFF));
+        emitByte(static_cast<uint8_t>((value >> 8) & 0xFF));
+    }
+
+    void BytecodeCompiler::mark(const Token& token)
+    {
+        current().tokens.emplace_back(offset(), token);
+    }
+
+    void BytecodeCompiler::emitConstant(Value value, const Token& token)
+    {
+        // Numbers are pooled once per function
+        FunctionState& state{ m_Functions.back() };
+        BytecodeFunction& function{ current() };
+        auto index = static_cast<uint32_t>(function.constants.size());
+        if(value.type == ValueType::INT)
+        {
+            index = state.integers.emplace(value.integer, static_cast<uint16_t>(index)).first->second;
+        }
+        else if(value.type == ValueType::FLOAT)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value.number, sizeof(bits));
+            index = state.floats.emplace(bits, static_cast<uint16_t>(index)).first->second;
+        }
+        if(index == function.constants.size())
+        {
+            if(index > MaxShort)
+                error(token, "Too many constants in one function.");
+            function.constants.push_back(value);
+        }
+        emit(OpCode::CONSTANT, 1);
+        emitShort(index);
+    }
+
+    uint32_t BytecodeCompiler::emitJump(OpCode op, int32_t effect)
+    {
+        emit(op, effect);
+        emitShort(0);
+        return offset() - 2;
+    }
+
+    void BytecodeCompiler::patchJump(uint32_t operand)
+    {
+        const uint32_t distance{ offset() - operand - 2 };
+        if(distance > MaxShort)
+            error(lastToken(), "Too much code to jump over.");
+        current().code[operand] = static_cast<uint8_t>(distance & 0xFF);
+        current().code[operand + 1] = static_cast<uint8_t>((distance >> 8) & 0xFF);
+    }
+
+    void BytecodeCompiler::emitLoop(uint32_t start)
+    {
+        emit(OpCode::LOOP, 0);
+        const uint32_t distance{ offset() + 2 - start };
+        if(distance > MaxShort)
+            error(lastToken(), "Loop body is too large.");
+        emitShort(distance);
+    }
+
+    Token BytecodeCompiler::lastToken()
+    {
+        return current().tokens.empty() ? Token{} : current().tokens.back().second;
+    }
+
+    void BytecodeCompiler::emitVariable(OpCode local, OpCode outer, const Binding& binding, const Token& name)
+    {
+        const int32_t effect{ local == OpCode::GET_LOCAL ? 1 : 0 };
+        if(!binding.isResolved())
+        {
+            error(name, "Undefined name '{}'.", name.value, DiagnosticKind::NAME);
+            return;
+        }
+        if(binding.depth == 0)
+        {
+            emitSlot(local, binding.slot, name);
+            return;
+        }
+        if(binding.depth > MaxByte || binding.slot > MaxShort)
+            error(name, "'{}' is too far away to address.", name.value);
+        emit(outer, effect);
+        emitByte(static_cast<uint8_t>(binding.depth));
+        emitShort(binding.slot);
+    }
+
+    void BytecodeCompiler::emitDefault(const VariableStmt& variable)
+    {
+        if(variable.m_Type.type == TokenType::INT)
+            emitConstant(Value::makeInt(0), variable.m_Name);
+        else if(variable.m_Type.type == TokenType::FLOAT)
+            emitConstant(Value::makeFloat(0.0), variable.m_Name);
+        else
+            emit(variable.m_Type.type == TokenType::BOOL ? OpCode::FALSE : OpCode::NIL, 1);
+    }
+
+    void BytecodeCompiler::emitSlot(OpCode op, uint32_t slot, const Token& name)
+    {
+        if(slot > MaxShort)
+            error(name, "'{}' is too far away to address.", name.value);
+        const int32_t effect{ op == OpCode::GET_LOCAL ? 1 : op == OpCode::STORE_LOCAL ? -1 : 0 };
+        emit(op, effect);
+        emitShort(slot);
+    }
+
+    void BytecodeCompiler::error(const Token& token, std::string_view message, std::string_view argument,
+                                 DiagnosticKind kind)
+    {
+        m_Diagnostics.report(token, message, argument, kind);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Bytecode.h"
+#include "Diagnostics.h"
+#include "Expression.h"
+#include "Statement.h"
+
+namespace BBTCompiler
+{
+    // Lowers a program the Resolver has resolved to bytecode for the
+    // VirtualMachine. The top level and every function become one
+    // BytecodeFunction, variables keep the slots the Resolver assigned.
+    // Loops, including the ones a for statement desugars to, become
+    // backward jumps, && and || jump over their right operand. Arithmetic
+    // and comparisons on expressions the TypeChecker typed as two ints or two
+    // floats use the opcodes that skip the checks of the operand types, so
+    // a tree should only be checked when the checker accepted it.
+    //
+    // Code the Parser could not parse, and limits of the instruction
+    // encoding such as more than 65535 slots or constants in one function,
+    // are reported as diagnostics.
+    class BytecodeCompiler
+    {
+    public:
+        // `frameSize` is the size the Resolver computed for the top level.
+        // Returns false if the program could not be compiled.
+        bool compile(const std::vector<Stmt*>& statements, uint32_t frameSize);
+        BytecodeProgram& getProgram() { return m_Program; }
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+    private:
+        friend struct BytecodeCompilerWalk;
+        // State of the function being compiled
+        struct FunctionState
+        {
+            uint32_t function;
+            // Temporaries on the stack at the current instruction
+            int32_t depth{ 0 };
+            int32_t maxDepth{ 0 };
+            std::unordered_map<int64_t, uint16_t> integers{};
+            std::unordered_map<uint64_t, uint16_t> floats{};
+        };
+
+        uint32_t compileFunction(const FuncStmt& function);
+        void compileBlock(AstSpan<Stmt* const> statements);
+        void compile(const Stmt& stmt);
+        void compile(const Expr& expr);
+        BytecodeFunction& current() { return m_Program.functions[m_Functions.back().function]; }
+        uint32_t offset() { return static_cast<uint32_t>(current().code.size()); }
+        // Appends an instruction that changes the number of temporaries by `effect`
+        void emit(OpCode op, int32_t effect);
+        void emitByte(uint8_t byte) { current().code.push_back(byte); }
+        void emitShort(uint32_t value);
+        // Remembers `token` as the location of the next instruction
+        void mark(const Token& token);
+        void emitConstant(Value value, const Token& token);
+        // Emits a forward jump, patchJump points it at the current offset
+        uint32_t emitJump(OpCode op, int32_t effect);
+        void patchJump(uint32_t operand);
+        void emitLoop(uint32_t start);
+        // Where errors without a token of their own are reported, the last
+        // instruction that has one
+        Token lastToken();
+        void emitVariable(OpCode local, OpCode outer, const Binding& binding, const Token& name);
+        // Pushes the value a variable declared without an initializer starts with
+        void emitDefault(const VariableStmt& variable);
+        void emitSlot(OpCode op, uint32_t slot, const Token& name);
+        void error(const Token& token, std::string_view message, std::string_view argument = {},
+                   DiagnosticKind kind = DiagnosticKind::SYNTAX);
+    private:
+        BytecodeProgram m_Program;
+        Diagnostics m_Diagnostics;
+        std::vector<FunctionState> m_Functions;
+    };
+}
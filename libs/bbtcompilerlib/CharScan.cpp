@@ -0,0 +1,119 @@
+#include "CharScan.h"
+#include "CharScanKernels.h"
+#include <atomic>
+#include <initializer_list>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define BBTCOMPILER_SSE2_KERNELS
+    #include <emmintrin.h>
+#endif
+
+namespace BBTCompiler::CharScan
+{
+#ifdef BBTCOMPILER_AVX2_KERNELS
+    // Defined in CharScanAvx2.cpp, which is the only file built with AVX2 enabled
+    extern const Functions Avx2Functions;
+#endif
+
+    namespace
+    {
+        const Functions ScalarFunctions{
+            &Scalar::skipIdentifierChars,
+            &Scalar::skipDigits,
+            &Scalar::skipWhitespace,
+            &Scalar::findQuoteOrBackslash,
+            &Scalar::countNewlines
+        };
+
+#ifdef BBTCOMPILER_SSE2_KERNELS
+        struct Sse2Ops
+        {
+            using Vector = __m128i;
+            static constexpr size_t Width{ 16 };
+            static Vector loadu(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            static Vector set1(char c) { return _mm_set1_epi8(c); }
+            static Vector cmpeq(Vector a, Vector b) { return _mm_cmpeq_epi8(a, b); }
+            static Vector cmplt(Vector a, Vector b) { return _mm_cmplt_epi8(a, b); }
+            static Vector bitOr(Vector a, Vector b) { return _mm_or_si128(a, b); }
+            static Vector bitXor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+            static Vector sub(Vector a, Vector b) { return _mm_sub_epi8(a, b); }
+            static uint32_t movemask(Vector v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+        };
+
+        const Functions Sse2Functions{ makeFunctions<Kernels<Sse2Ops>>() };
+#endif
+
+        bool cpuSupportsAvx2()
+        {
+#if defined(BBTCOMPILER_AVX2_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+            return __builtin_cpu_supports("avx2");
+#elif defined(BBTCOMPILER_AVX2_KERNELS) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if(info[0] < 7)
+                return false;
+            __cpuid(info, 1);
+            const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            return osSavesYmm && (info[1] & (1 << 5));
+#else
+            return false;
+#endif
+        }
+
+        const Functions* functionsFor(SimdLevel level)
+        {
+            switch(level)
+            {
+#ifdef BBTCOMPILER_AVX2_KERNELS
+            case SimdLevel::AVX2: return cpuSupportsAvx2() ? &Avx2Functions : nullptr;
+#endif
+#ifdef BBTCOMPILER_SSE2_KERNELS
+            case SimdLevel::SSE2: return &Sse2Functions;
+#endif
+            case SimdLevel::SCALAR: return &ScalarFunctions;
+            default: return nullptr;
+            }
+        }
+
+        struct ActiveState
+        {
+            std::atomic<const Functions*> functions;
+            std::atomic<SimdLevel> level;
+        };
+
+        ActiveState& state()
+        {
+            static ActiveState active{ functionsFor(bestSupportedLevel()), bestSupportedLevel() };
+            return active;
+        }
+    }
+
+    const Functions& active()
+    {
+        return *state().functions.load(std::memory_order_relaxed);
+    }
+
+    SimdLevel activeLevel()
+    {
+        return state().level.load(std::memory_order_relaxed);
+    }
+
+    SimdLevel bestSupportedLevel()
+    {
+        for(const SimdLevel level : { SimdLevel::AVX2, SimdLevel::SSE2 })
+            if(functionsFor(level))
+                return level;
+        return SimdLevel::SCALAR;
+    }
+
+    bool setLevel(SimdLevel level)
+    {
+        const Functions* functions = functionsFor(level);
+        if(!functions)
+            return false;
+        state().functions.store(functions, std::memory_order_relaxed);
+        state().level.store(level, std::memory_order_relaxed);
+        return true;
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+
+namespace BBTCompiler
+{
+    // Bulk character scanning used by the Lexer's hot loops. Each function
+    // examines [begin, end) and returns a pointer to the first byte that ends
+    // the run (or `end`). The implementation is chosen once at startup from
+    // the best instruction set the CPU supports: AVX2 (32 bytes per step),
+    // SSE2 (16 bytes per step) or a portable scalar fallback.
+    namespace CharScan
+    {
+        enum class SimdLevel { SCALAR, SSE2, AVX2 };
+
+        struct Functions
+        {
+            const char* (*skipIdentifierChars)(const char* begin, const char* end);
+            const char* (*skipDigits)(const char* begin, const char* end);
+            const char* (*skipWhitespace)(const char* begin, const char* end);
+            const char* (*findQuoteOrBackslash)(const char* begin, const char* end);
+            size_t (*countNewlines)(const char* begin, const char* end);
+        };
+
+        const Functions& active();
+        SimdLevel activeLevel();
+        SimdLevel bestSupportedLevel();
+        // Switches implementation, returns false if the CPU does not support `level`
+        bool setLevel(SimdLevel level);
+
+        // Runs in source code are mostly a few bytes long, so the wrappers test
+        // the first bytes inline and only call the vector implementation for
+        // longer runs, where it pays for the indirect call.
+        constexpr size_t InlineLength{ 16 };
+
+        constexpr bool isIdentifierChar(unsigned char c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        constexpr bool isDigit(unsigned char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        constexpr bool isWhitespace(unsigned char c)
+        {
+            return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+
+        template<typename Predicate, typename Bulk>
+        inline const char* skipRun(const char* begin, const char* end, Predicate predicate, Bulk bulk)
+        {
+            const char* limit{ static_cast<size_t>(end - begin) > InlineLength ? begin + InlineLength : end };
+            while(begin != limit && predicate(*begin))
+                ++begin;
+            return begin != limit || begin == end ? begin : bulk(begin, end);
+        }
+
+        // First byte that is not [A-Za-z0-9_]
+        inline const char* skipIdentifierChars(const char* begin, const char* end)
+        {
+            return skipRun(begin, end, isIdentifierChar,
+                [](const char* from, const char* to) { return active().skipIdentifierChars(from, to); });
+        }
+        // First byte that is not [0-9]
+        inline const char* skipDigits(const char* begin, const char* end)
+        {
+            return skipRun(begin, end, isDigit,
+                [](const char* from, const char* to) { return active().skipDigits(from, to); });
+        }
+        // First byte that is not a space, \t, \n, \v, \f or \r
+        inline const char* skipWhitespace(const char* begin, const char* end)
+        {
+            return skipRun(begin, end, isWhitespace,
+                [](const char* from, const char* to) { return active().skipWhitespace(from, to); });
+        }
+        // First '"' or '\\'
+        inline const char* findQuoteOrBackslash(const char* begin, const char* end)
+        {
+            return skipRun(begin, end, [](unsigned char c) { return c != '"' && c != '\\'; },
+                [](const char* from, const char* to) { return active().findQuoteOrBackslash(from, to); });
+        }
+        // Number of '\n' bytes
+        inline size_t countNewlines(const char* begin, const char* end)
+        {
+            if(static_cast<size_t>(end - begin) > InlineLength)
+                return active().countNewlines(begin, end);
+            size_t count{ 0 };
+            for(; begin != end; ++begin)
+                count += *begin == '\n';
+            return count;
+        }
+    }
+}
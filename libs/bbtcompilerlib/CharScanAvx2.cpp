@@ -0,0 +1,30 @@
+// Built with AVX2 code generation enabled (see CMakeLists.txt). Only reached
+// through CharScan::active() after the CPU has been checked for AVX2 support.
+#include "CharScan.h"
+
+#ifdef BBTCOMPILER_AVX2_KERNELS
+#include "CharScanKernels.h"
+#include <immintrin.h>
+
+namespace BBTCompiler::CharScan
+{
+    namespace
+    {
+        struct Avx2Ops
+        {
+            using Vector = __m256i;
+            static constexpr size_t Width{ 32 };
+            static Vector loadu(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            static Vector set1(char c) { return _mm256_set1_epi8(c); }
+            static Vector cmpeq(Vector a, Vector b) { return _mm256_cmpeq_epi8(a, b); }
+            static Vector cmplt(Vector a, Vector b) { return _mm256_cmpgt_epi8(b, a); }
+            static Vector bitOr(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+            static Vector bitXor(Vector a, Vector b) { return _mm256_xor_si256(a, b); }
+            static Vector sub(Vector a, Vector b) { return _mm256_sub_epi8(a, b); }
+            static uint32_t movemask(Vector v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+        };
+    }
+
+    extern const Functions Avx2Functions{ makeFunctions<Kernels<Avx2Ops>>() };
+}
+#endif
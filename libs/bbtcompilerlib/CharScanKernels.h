@@ -0,0 +1,172 @@
+#pragma once
+
+// Internal to CharScan.cpp and CharScanAvx2.cpp. Everything here has internal
+// linkage so that the copy compiled with AVX2 enabled can never be merged with
+// the baseline copy by the linker.
+
+#include "CharScan.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+namespace BBTCompiler::CharScan
+{
+    namespace
+    {
+        inline unsigned countTrailingZeros(uint32_t mask)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        inline size_t popCount(uint32_t mask)
+        {
+            mask = mask - ((mask >> 1) & 0x55555555u);
+            mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+            return (((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+        }
+
+        // The character classes are the predicates of CharScan.h
+        namespace Scalar
+        {
+            inline const char* skipIdentifierChars(const char* begin, const char* end)
+            {
+                while(begin != end && isIdentifierChar(*begin)) ++begin;
+                return begin;
+            }
+
+            inline const char* skipDigits(const char* begin, const char* end)
+            {
+                while(begin != end && isDigit(*begin)) ++begin;
+                return begin;
+            }
+
+            inline const char* skipWhitespace(const char* begin, const char* end)
+            {
+                while(begin != end && isWhitespace(*begin)) ++begin;
+                return begin;
+            }
+
+            inline const char* findQuoteOrBackslash(const char* begin, const char* end)
+            {
+                while(begin != end && *begin != '"' && *begin != '\\') ++begin;
+                return begin;
+            }
+
+            inline size_t countNewlines(const char* begin, const char* end)
+            {
+                size_t count{ 0 };
+                for(; begin != end; ++begin)
+                    count += *begin == '\n';
+                return count;
+            }
+        }
+
+        // Vector kernels shared by every SIMD width. `Ops` wraps the intrinsics
+        // of one instruction set: a Vector type, its Width in bytes, loadu,
+        // set1, cmpeq, cmplt (signed), bitOr, bitXor, sub and movemask.
+        template<typename Ops>
+        struct Kernels
+        {
+            using Vector = typename Ops::Vector;
+            static constexpr size_t Width{ Ops::Width };
+            static constexpr uint32_t FullMask{ Width == 32 ? 0xFFFFFFFFu : (1u << Width) - 1 };
+
+            // Bytes within [low, high], using the signed compare with a bias
+            static Vector inRange(Vector v, unsigned char low, unsigned char high)
+            {
+                const Vector shifted = Ops::bitXor(Ops::sub(v, Ops::set1(static_cast<char>(low))), Ops::set1(static_cast<char>(0x80)));
+                return Ops::cmplt(shifted, Ops::set1(static_cast<char>(high - low + 1 - 128)));
+            }
+
+            static Vector identifierChars(Vector v)
+            {
+                const Vector letters = inRange(Ops::bitOr(v, Ops::set1(0x20)), 'a', 'z');
+                return Ops::bitOr(Ops::bitOr(letters, inRange(v, '0', '9')), Ops::cmpeq(v, Ops::set1('_')));
+            }
+
+            static Vector whitespace(Vector v)
+            {
+                return Ops::bitOr(inRange(v, '\t', '\r'), Ops::cmpeq(v, Ops::set1(' ')));
+            }
+
+            template<typename Matches>
+            static const char* skipWhile(const char* begin, const char* end, Matches matches)
+            {
+                while(static_cast<size_t>(end - begin) >= Width)
+                {
+                    const uint32_t misses = ~Ops::movemask(matches(Ops::loadu(begin))) & FullMask;
+                    if(misses)
+                        return begin + countTrailingZeros(misses);
+                    begin += Width;
+                }
+                return begin;
+            }
+
+            static const char* skipIdentifierChars(const char* begin, const char* end)
+            {
+                begin = skipWhile(begin, end, identifierChars);
+                return Scalar::skipIdentifierChars(begin, end);
+            }
+
+            static const char* skipDigits(const char* begin, const char* end)
+            {
+                begin = skipWhile(begin, end, [](Vector v) { return inRange(v, '0', '9'); });
+                return Scalar::skipDigits(begin, end);
+            }
+
+            static const char* skipWhitespace(const char* begin, const char* end)
+            {
+                begin = skipWhile(begin, end, whitespace);
+                return Scalar::skipWhitespace(begin, end);
+            }
+
+            static const char* findQuoteOrBackslash(const char* begin, const char* end)
+            {
+                const Vector quote = Ops::set1('"');
+                const Vector backslash = Ops::set1('\\');
+                while(static_cast<size_t>(end - begin) >= Width)
+                {
+                    const Vector v = Ops::loadu(begin);
+                    const uint32_t hits = Ops::movemask(Ops::bitOr(Ops::cmpeq(v, quote), Ops::cmpeq(v, backslash)));
+                    if(hits)
+                        return begin + countTrailingZeros(hits);
+                    begin += Width;
+                }
+                return Scalar::findQuoteOrBackslash(begin, end);
+            }
+
+            static size_t countNewlines(const char* begin, const char* end)
+            {
+                const Vector newline = Ops::set1('\n');
+                size_t count{ 0 };
+                while(static_cast<size_t>(end - begin) >= Width)
+                {
+                    count += popCount(Ops::movemask(Ops::cmpeq(Ops::loadu(begin), newline)));
+                    begin += Width;
+                }
+                return count + Scalar::countNewlines(begin, end);
+            }
+        };
+
+        template<typename Kernel>
+        constexpr Functions makeFunctions()
+        {
+            return Functions{
+                &Kernel::skipIdentifierChars,
+                &Kernel::skipDigits,
+                &Kernel::skipWhitespace,
+                &Kernel::findQuoteOrBackslash,
+                &Kernel::countNewlines
+            };
+        }
+    }
+}
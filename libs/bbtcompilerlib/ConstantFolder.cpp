@@ -0,0 +1,469 @@
+#include "ConstantFolder.h"
+#include "ASTWalker.h"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        // Integer arithmetic wraps around instead of overflowing
+        int64_t wrap(uint64_t value) { return static_cast<int64_t>(value); }
+
+        // The value of a literal, false for other expressions and for
+        // literals that fail at runtime
+        bool literalValue(const Expr& expr, Value& value)
+        {
+            if(expr.getKind() != ExprKind::LITERAL)
+                return false;
+            const Token& token{ static_cast<const LiteralExpr&>(expr).m_Token };
+            const char* begin{ token.value.data() };
+            const char* end{ begin + token.value.size() };
+            switch(token.type)
+            {
+            case TokenType::TRUE: value = Value::makeBool(true); return true;
+            case TokenType::FALSE: value = Value::makeBool(false); return true;
+            case TokenType::NIL: value = Value{}; return true;
+            case TokenType::STRING_LITERAL: value = Value::makeString(token.value); return true;
+            case TokenType::INT_LITERAL:
+            {
+                int64_t integer{ 0 };
+                if(std::from_chars(begin, end, integer).ec != std::errc{})
+                    return false;
+                value = Value::makeInt(integer);
+                return true;
+            }
+            case TokenType::FLOAT_LITERAL:
+            {
+                double number{ 0.0 };
+                if(std::from_chars(begin, end, number).ec != std::errc{})
+                    number = std::numeric_limits<double>::infinity();
+                value = Value::makeFloat(number);
+                return true;
+            }
+            default: return false;
+            }
+        }
+
+        // What an expression evaluates to when it does not fail, as far as
+        // its shape tells: NUMBER is an int or a float
+        enum class NumberKind : uint8_t { NONE, INT, FLOAT, NUMBER };
+
+        NumberKind numberKind(const Expr& expr)
+        {
+            switch(expr.getKind())
+            {
+            case ExprKind::LITERAL:
+            {
+                const TokenType type{ static_cast<const LiteralExpr&>(expr).m_Token.type };
+                return type == TokenType::INT_LITERAL ? NumberKind::INT
+                     : type == TokenType::FLOAT_LITERAL ? NumberKind::FLOAT : NumberKind::NONE;
+            }
+            case ExprKind::GROUPED:
+                return numberKind(*static_cast<const GroupedExpr&>(expr).m_Expression);
+            case ExprKind::UNARY:
+            {
+                const auto& unary = static_cast<const UnaryExpr&>(expr);
+                if(unary.m_Operator.type != TokenType::MINUS)
+                    return NumberKind::NONE;
+                const NumberKind operand{ numberKind(*unary.m_Right) };
+                return operand == NumberKind::NONE ? NumberKind::NUMBER : operand;
+            }
+            case ExprKind::BINARY:
+            {
+                const auto& binary = static_cast<const BinaryExpr&>(expr);
+                const TokenType op{ binary.m_Operator.type };
+                if(op != TokenType::PLUS && op != TokenType::MINUS && op != TokenType::STAR && op != TokenType::SLASH)
+                    return NumberKind::NONE;
+                const NumberKind left{ numberKind(*binary.m_Left) };
+                const NumberKind right{ numberKind(*binary.m_Right) };
+                // + of two strings is a string
+                if(op == TokenType::PLUS && (left == NumberKind::NONE || right == NumberKind::NONE))
+                    return NumberKind::NONE;
+                if(left == NumberKind::INT && right == NumberKind::INT)
+                    return NumberKind::INT;
+                if(left == NumberKind::FLOAT || right == NumberKind::FLOAT)
+                    return NumberKind::FLOAT;
+                return NumberKind::NUMBER;
+            }
+            default:
+                return NumberKind::NONE;
+            }
+        }
+
+        // Whether `x op constant`, or `constant op x` when the constant is on
+        // the left, is always x
+        bool isIdentity(TokenType op, const Value& constant, bool constantOnRight, NumberKind x)
+        {
+            if(x == NumberKind::NONE || !constant.isNumber())
+                return false;
+            // A float constant would turn an int into a float
+            if(constant.type == ValueType::FLOAT && x != NumberKind::FLOAT)
+                return false;
+            const bool one{ constant.asFloat() == 1.0 };
+            const bool zero{ constant.asFloat() == 0.0 && !std::signbit(constant.asFloat()) };
+            switch(op)
+            {
+            case TokenType::STAR: return one;
+            case TokenType::SLASH: return one && constantOnRight;
+            case TokenType::MINUS: return zero && constantOnRight;
+            case TokenType::PLUS: return zero && x == NumberKind::INT;
+            default: return false;
+            }
+        }
+
+        struct CountWalk
+        {
+            size_t count(const Expr* expr) const { return expr ? visitAst(*expr, *this) : 0; }
+            size_t count(const Stmt* stmt) const { return stmt ? visitAst(*stmt, *this) : 0; }
+
+            size_t operator()(const AssignmentExpr& expr) const { return 1 + count(expr.m_Value); }
+            size_t operator()(const BinaryExpr& expr) const { return 1 + count(expr.m_Left) + count(expr.m_Right); }
+            size_t operator()(const UnaryExpr& expr) const { return 1 + count(expr.m_Right); }
+            size_t operator()(const GroupedExpr& expr) const { return 1 + count(expr.m_Expression); }
+            size_t operator()(const LiteralExpr&) const { return 1; }
+            size_t operator()(const VariableExpr&) const { return 1; }
+            size_t operator()(const CallExpr& expr) const
+            {
+                size_t total{ 1 + count(expr.m_Callee) };
+                for(const Expr* argument : expr.m_Args)
+                    total += count(argument);
+                return total;
+            }
+            size_t operator()(const ErrorExpr&) const { return 1; }
+
+            size_t operator()(const PrintStmt& stmt) const { return 1 + count(stmt.m_Expression); }
+            size_t operator()(const ExprStmt& stmt) const { return 1 + count(stmt.m_Expression); }
+            size_t operator()(const VariableStmt& stmt) const { return 1 + count(stmt.m_Initializer); }
+            size_t operator()(const BlockStmt& stmt) const
+            {
+                size_t total{ 1 };
+                for(const Stmt* statement : stmt.m_Statements)
+                    total += count(statement);
+                return total;
+            }
+            size_t operator()(const IfStmt& stmt) const
+            {
+                return 1 + count(stmt.m_Condition) + count(stmt.m_ThenBranch) + count(stmt.m_ElseBranch);
+            }
+            size_t operator()(const WhileStmt& stmt) const { return 1 + count(stmt.m_Condition) + count(stmt.m_Body); }
+            size_t operator()(const FuncStmt& stmt) const
+            {
+                size_t total{ 1 };
+                for(const Stmt* statement : stmt.m_Body)
+                    total += count(statement);
+                return total;
+            }
+            size_t operator()(const ReturnStmt& stmt) const { return 1 + count(stmt.m_Value); }
+            size_t operator()(const ErrorStmt&) const { return 1; }
+        };
+    }
+
+    struct ConstantFolderWalk
+    {
+        ConstantFolder& folder;
+
+        Expr* operator()(AssignmentExpr& expr) const
+        {
+            expr.m_Value = folder.fold(expr.m_Value);
+            return &expr;
+        }
+        Expr* operator()(BinaryExpr& expr) const { return folder.foldBinary(expr); }
+        Expr* operator()(UnaryExpr& expr) const
+        {
+            expr.m_Right = folder.fold(expr.m_Right);
+            Value operand;
+            if(!literalValue(*expr.m_Right, operand))
+                return &expr;
+            Value result;
+            if(expr.m_Operator.type == TokenType::NOT)
+                result = Value::makeBool(!operand.isTruthy());
+            else if(operand.type == ValueType::INT)
+                result = Value::makeInt(wrap(0 - static_cast<uint64_t>(operand.integer)));
+            else if(operand.type == ValueType::FLOAT)
+                result = Value::makeFloat(-operand.number);
+            else
+                return &expr;
+            folder.m_RemovedNodes += 1;
+            return folder.makeLiteral(result, expr.m_Operator);
+        }
+        Expr* operator()(GroupedExpr& expr) const
+        {
+            expr.m_Expression = folder.fold(expr.m_Expression);
+            if(expr.m_Expression->getKind() != ExprKind::LITERAL)
+                return &expr;
+            folder.m_RemovedNodes += 1;
+            return expr.m_Expression;
+        }
+        Expr* operator()(LiteralExpr& expr) const { return &expr; }
+        Expr* operator()(VariableExpr& expr) const { return &expr; }
+        Expr* operator()(CallExpr& expr) const
+        {
+            expr.m_Callee = folder.fold(expr.m_Callee);
+            for(Expr*& argument : expr.m_Args)
+                argument = folder.fold(argument);
+            return &expr;
+        }
+        Expr* operator()(ErrorExpr& expr) const { return &expr; }
+
+        Stmt* operator()(PrintStmt& stmt) const
+        {
+            stmt.m_Expression = folder.fold(stmt.m_Expression);
+            return &stmt;
+        }
+        Stmt* operator()(ExprStmt& stmt) const
+        {
+            stmt.m_Expression = folder.fold(stmt.m_Expression);
+            return &stmt;
+        }
+        Stmt* operator()(VariableStmt& stmt) const
+        {
+            if(stmt.m_Initializer)
+                stmt.m_Initializer = folder.fold(stmt.m_Initializer);
+            return &stmt;
+        }
+        Stmt* operator()(BlockStmt& stmt) const
+        {
+            stmt.m_Statements = folder.foldBlock(stmt.m_Statements);
+            return &stmt;
+        }
+        Stmt* operator()(IfStmt& stmt) const
+        {
+            stmt.m_Condition = folder.fold(stmt.m_Condition);
+            Value condition;
+            if(!literalValue(*stmt.m_Condition, condition))
+            {
+                if(stmt.m_ThenBranch && !(stmt.m_ThenBranch = folder.fold(stmt.m_ThenBranch)))
+                    stmt.m_ThenBranch = folder.emptyBlock();
+                if(stmt.m_ElseBranch)
+                    stmt.m_ElseBranch = folder.fold(stmt.m_ElseBranch);
+                return &stmt;
+            }
+            // Only the branch that runs is left, or nothing
+            Stmt* const taken{ condition.isTruthy() ? stmt.m_ThenBranch : stmt.m_ElseBranch };
+            folder.m_RemovedNodes += 1;
+            folder.removed(stmt.m_Condition);
+            folder.removed(condition.isTruthy() ? stmt.m_ElseBranch : stmt.m_ThenBranch);
+            return taken ? folder.fold(taken) : nullptr;
+        }
+        Stmt* operator()(WhileStmt& stmt) const
+        {
+            stmt.m_Condition = folder.fold(stmt.m_Condition);
+            if(Value condition; literalValue(*stmt.m_Condition, condition) && !condition.isTruthy())
+            {
+                folder.removed(&stmt);
+                return nullptr;
+            }
+            if(stmt.m_Body && !(stmt.m_Body = folder.fold(stmt.m_Body)))
+                stmt.m_Body = folder.emptyBlock();
+            return &stmt;
+        }
+        Stmt* operator()(FuncStmt& stmt) const
+        {
+            stmt.m_Body = folder.foldBlock(stmt.m_Body);
+            return &stmt;
+        }
+        Stmt* operator()(ReturnStmt& stmt) const
+        {
+            if(stmt.m_Value)
+                stmt.m_Value = folder.fold(stmt.m_Value);
+            return &stmt;
+        }
+        Stmt* operator()(ErrorStmt& stmt) const { return &stmt; }
+    };
+
+    void ConstantFolder::fold(std::vector<Stmt*>& statements)
+    {
+        size_t kept{ 0 };
+        for(Stmt* statement : statements)
+        {
+            if(Stmt* folded{ fold(statement) })
+                statements[kept++] = folded;
+        }
+        statements.resize(kept);
+    }
+
+    Expr* ConstantFolder::fold(Expr* expr)
+    {
+        return visitAst(*expr, ConstantFolderWalk{ *this });
+    }
+
+    Stmt* ConstantFolder::fold(Stmt* stmt)
+    {
+        return visitAst(*stmt, ConstantFolderWalk{ *this });
+    }
+
+    AstSpan<Stmt*> ConstantFolder::foldBlock(AstSpan<Stmt*> statements)
+    {
+        size_t kept{ 0 };
+        for(Stmt* statement : statements)
+        {
+            if(Stmt* folded{ fold(statement) })
+                statements[kept++] = folded;
+        }
+        return AstSpan<Stmt*>(statements.data(), kept);
+    }
+
+    Expr* ConstantFolder::foldBinary(BinaryExpr& expr)
+    {
+        expr.m_Left = fold(expr.m_Left);
+        expr.m_Right = fold(expr.m_Right);
+        const Token& op{ expr.m_Operator };
+        Value left;
+        Value right;
+        const bool leftConstant{ literalValue(*expr.m_Left, left) };
+        const bool rightConstant{ literalValue(*expr.m_Right, right) };
+
+        if(op.type == TokenType::AND || op.type == TokenType::OR)
+        {
+            // The right operand only matters if the left one does not decide
+            if(!leftConstant)
+                return &expr;
+            Value result;
+            if(left.isTruthy() == (op.type == TokenType::OR))
+                result = Value::makeBool(left.isTruthy());
+            else if(rightConstant)
+                result = Value::makeBool(right.isTruthy());
+            else
+                return &expr;
+            m_RemovedNodes += countNodes(&expr) - 1;
+            return makeLiteral(result, op);
+        }
+
+        if(leftConstant && rightConstant)
+        {
+            Value result;
+            bool folded{ true };
+            if(op.type == TokenType::EQ_EQ)
+                result = Value::makeBool(left == right);
+            else if(op.type == TokenType::NOT_EQ)
+                result = Value::makeBool(left != right);
+            else if(op.type == TokenType::PLUS && left.type == ValueType::STRING && right.type == ValueType::STRING)
+                result = Value::makeString({});
+            else
+                folded = evaluate(op.type, left, right, result);
+            if(!folded)
+                return &expr;
+            m_RemovedNodes += 2;
+            if(result.type != ValueType::STRING)
+                return makeLiteral(result, op);
+            // The text lives in the context like the rest of the tree
+            std::string text{ left.asString() };
+            text += right.asString();
+            const AstSpan<char> copy{ m_Context.copyArray(text.data(), text.size()) };
+            return makeLiteral(Value::makeString(std::string_view(copy.data(), copy.size())), op);
+        }
+
+        if(leftConstant && isIdentity(op.type, left, false, numberKind(*expr.m_Right)))
+        {
+            m_RemovedNodes += 2;
+            return expr.m_Right;
+        }
+        if(rightConstant && isIdentity(op.type, right, true, numberKind(*expr.m_Left)))
+        {
+            m_RemovedNodes += 2;
+            return expr.m_Left;
+        }
+        return &expr;
+    }
+
+    bool ConstantFolder::evaluate(TokenType op, const Value& left, const Value& right, Value& result)
+    {
+        if(!left.isNumber() || !right.isNumber())
+            return false;
+        if(left.type == ValueType::INT && right.type == ValueType::INT)
+        {
+            const int64_t a{ left.integer };
+            const int64_t b{ right.integer };
+            switch(op)
+            {
+            case TokenType::PLUS: result = Value::makeInt(wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b))); return true;
+            case TokenType::MINUS: result = Value::makeInt(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b))); return true;
+            case TokenType::STAR: result = Value::makeInt(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b))); return true;
+            case TokenType::SLASH:
+                if(b == 0)
+                    return false;
+                result = Value::makeInt(b == -1 ? wrap(0 - static_cast<uint64_t>(a)) : a / b);
+                return true;
+            case TokenType::LESS: result = Value::makeBool(a < b); return true;
+            case TokenType::LESS_EQ: result = Value::makeBool(a <= b); return true;
+            case TokenType::GREATER: result = Value::makeBool(a > b); return true;
+            case TokenType::GREATER_EQ: result = Value::makeBool(a >= b); return true;
+            default: return false;
+            }
+        }
+        const double a{ left.asFloat() };
+        const double b{ right.asFloat() };
+        switch(op)
+        {
+        case TokenType::PLUS: result = Value::makeFloat(a + b); return true;
+        case TokenType::MINUS: result = Value::makeFloat(a - b); return true;
+        case TokenType::STAR: result = Value::makeFloat(a * b); return true;
+        case TokenType::SLASH: result = Value::makeFloat(a / b); return true;
+        case TokenType::LESS: result = Value::makeBool(a < b); return true;
+        case TokenType::LESS_EQ: result = Value::makeBool(a <= b); return true;
+        case TokenType::GREATER: result = Value::makeBool(a > b); return true;
+        case TokenType::GREATER_EQ: result = Value::makeBool(a >= b); return true;
+        default: return false;
+        }
+    }
+
+    Stmt* ConstantFolder::emptyBlock()
+    {
+        // Counted as removed when the branch it stands in for was
+        --m_RemovedNodes;
+        return m_Context.create<BlockStmt>(AstSpan<Stmt*>{});
+    }
+
+    Expr* ConstantFolder::makeLiteral(const Value& value, const Token& at)
+    {
+        Token token{ TokenType::NIL, NoSymbol, at.position, "null" };
+        // The type the TypeChecker gives the literal, so a checked tree stays checked
+        ExprType type{ ExprType::NIL };
+        switch(value.type)
+        {
+        case ValueType::BOOL:
+            token.type = value.boolean ? TokenType::TRUE : TokenType::FALSE;
+            token.value = value.boolean ? "true" : "false";
+            type = ExprType::BOOL;
+            break;
+        case ValueType::INT:
+        case ValueType::FLOAT:
+        {
+            // 17 significant digits read back as the same double
+            char buffer[32];
+            const int length{ value.type == ValueType::INT
+                ? std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value.integer))
+                : std::snprintf(buffer, sizeof(buffer), "%.17g", value.number) };
+            const AstSpan<char> text{ m_Context.copyArray(buffer, static_cast<size_t>(length)) };
+            token.type = value.type == ValueType::INT ? TokenType::INT_LITERAL : TokenType::FLOAT_LITERAL;
+            token.value = std::string_view(text.data(), text.size());
+            type = value.type == ValueType::INT ? ExprType::INT : ExprType::FLOAT;
+            break;
+        }
+        case ValueType::STRING:
+            token.type = TokenType::STRING_LITERAL;
+            token.value = value.asString();
+            type = ExprType::CHAR;
+            break;
+        default:
+            break;
+        }
+        Expr* literal{ m_Context.create<LiteralExpr>(token) };
+        literal->setType(type);
+        return literal;
+    }
+
+    size_t ConstantFolder::countNodes(const Expr* expr)
+    {
+        return CountWalk{}.count(expr);
+    }
+
+    size_t ConstantFolder::countNodes(const Stmt* stmt)
+    {
+        return CountWalk{}.count(stmt);
+    }
+}
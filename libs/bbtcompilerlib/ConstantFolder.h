@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "AstContext.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Value.h"
+
+namespace BBTCompiler
+{
+    // Folds constant expressions of a resolved AST in place, with the
+    // Interpreter's semantics: int arithmetic wraps, mixed int and float
+    // operands compute in float and strings concatenate. Operations that
+    // would fail at runtime, like a division by zero, are kept so they still
+    // fail where they did.
+    //
+    // Besides literals the pass removes parentheses around literals and
+    // identity operations on operands that are numbers by construction,
+    // such as `(a - b) * 1` or `-x / 1`; `x + 0` only for ints, as it turns
+    // a float -0 into 0. If statements with a constant condition are
+    // replaced by the branch that runs, and while statements with a false
+    // one are removed.
+    //
+    // New literals are allocated in `context`, the one that owns the tree.
+    class ConstantFolder
+    {
+    public:
+        explicit ConstantFolder(AstContext& context) : m_Context{ context } {}
+
+        void fold(std::vector<Stmt*>& statements);
+        // AST nodes the folds removed from the tree so far, net of the
+        // literals that replaced them
+        size_t getRemovedNodes() const { return m_RemovedNodes; }
+        // Numeric operators of the Interpreter, false where it reports an
+        // error. `result` is the value of `left op right`.
+        static bool evaluate(TokenType op, const Value& left, const Value& right, Value& result);
+    private:
+        friend struct ConstantFolderWalk;
+        // Return the node that replaces the folded one, null for a removed
+        // statement
+        Expr* fold(Expr* expr);
+        Stmt* fold(Stmt* stmt);
+        // Folds the statements of a block, dropping removed ones
+        AstSpan<Stmt*> foldBlock(AstSpan<Stmt*> statements);
+        Expr* foldBinary(BinaryExpr& expr);
+        // An empty block for an if or while whose branch was removed
+        Stmt* emptyBlock();
+        Expr* makeLiteral(const Value& value, const Token& at);
+        void removed(const Expr* expr) { m_RemovedNodes += countNodes(expr); }
+        void removed(const Stmt* stmt) { m_RemovedNodes += countNodes(stmt); }
+        static size_t countNodes(const Expr* expr);
+        static size_t countNodes(const Stmt* stmt);
+    private:
+        AstContext& m_Context;
+        size_t m_RemovedNodes{ 0 };
+    };
+}
@@ -0,0 +1,21 @@
+#include "Diagnostics.h"
+
+namespace BBTCompiler
+{
+    std::string Diagnostics::format(const Diagnostic& diagnostic, std::string_view filename)
+    {
+        static constexpr std::string_view KindNames[]{ "syntax error", "name error", "runtime error", "type error" };
+        std::string message{ diagnostic.message };
+        if(const size_t placeholder{ message.find("{}") }; placeholder != std::string::npos)
+            message.replace(placeholder, 2, diagnostic.argument);
+        return "<" + std::string(filename) + ">:" +
+                std::to_string(diagnostic.token.position.line) + ":" + std::to_string(diagnostic.token.position.column) +
+                ": " + std::string(KindNames[static_cast<size_t>(diagnostic.kind)]) + ": " + message;
+    }
+
+    void Diagnostics::print(std::ostream& stream, std::string_view filename) const
+    {
+        for(const Diagnostic& diagnostic : m_Diagnostics)
+            stream << format(diagnostic, filename) << '\n';
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Lexer.h"
+
+namespace BBTCompiler
+{
+    enum class DiagnosticKind : uint8_t { SYNTAX, NAME, RUNTIME, TYPE };
+
+    // An error as recorded by the Parser or a later pass. Nothing is formatted
+    // when it is reported: `message` is a string literal, optionally with one
+    // "{}" placeholder that is replaced by `argument` when the text is needed.
+    struct Diagnostic
+    {
+        Token token;
+        std::string_view message;
+        std::string_view argument{};
+        DiagnosticKind kind{ DiagnosticKind::SYNTAX };
+    };
+
+    class Diagnostics
+    {
+    public:
+        void report(const Token& token, std::string_view message, std::string_view argument = {},
+                    DiagnosticKind kind = DiagnosticKind::SYNTAX)
+        {
+            m_Diagnostics.push_back(Diagnostic{ token, message, argument, kind });
+        }
+        bool hasErrors() const { return !m_Diagnostics.empty(); }
+        size_t size() const { return m_Diagnostics.size(); }
+        const Diagnostic& operator[](size_t index) const { return m_Diagnostics[index]; }
+        const std::vector<Diagnostic>& getDiagnostics() const { return m_Diagnostics; }
+        void clear() { m_Diagnostics.clear(); }
+
+        // "<filename>:line:column: syntax error: message", or "name error",
+        // "runtime error" or "type error"
+        static std::string format(const Diagnostic& diagnostic, std::string_view filename = "file");
+        void print(std::ostream& stream, std::string_view filename = "file") const;
+    private:
+        std::vector<Diagnostic> m_Diagnostics;
+    };
+}
@@ -3,43 +3,79 @@
 #include <nlohmann/json.hpp>
 #include <iostream>
 #include "ASTVisitor.h"
+#include "AstContext.h"
 #include "Lexer.h"
 
 namespace BBTCompiler
 {
+    enum class ExprKind : uint8_t
+    {
+        ASSIGNMENT, BINARY, UNARY, GROUPED, LITERAL, VARIABLE, CALL, ERROR
+    };
+
+    // Static type of an expression, see TypeChecker.h. VOID is the result of
+    // a call to a function without a return type, NIL the type of `null`.
+    enum class ExprType : uint8_t
+    {
+        UNCHECKED, VOID, NIL, INT, FLOAT, BOOL, CHAR, FUNCTION
+    };
+
+    // Expressions are allocated in an AstContext and never destroyed one by
+    // one, so neither they nor their members may have a non-trivial destructor
     class Expr
     {
     public:
-        virtual ~Expr() = default;
         virtual void accept(ASTConstVisitor& visitor) const = 0;
+        // Identifies the concrete class, see visitAst in ASTWalker.h
+        ExprKind getKind() const { return m_Kind; }
+        // Filled in by the TypeChecker, UNCHECKED before it or after an error
+        ExprType getType() const { return m_ResolvedType; }
+        void setType(ExprType type) { m_ResolvedType = type; }
+    protected:
+        explicit Expr(ExprKind kind) : m_Kind{ kind } {}
+        ~Expr() = default;
     private:
+        ExprKind m_Kind;
+        ExprType m_ResolvedType{ ExprType::UNCHECKED };
+    };
+
+    // Where the value of a name lives, filled in by the Resolver: slot `slot`
+    // of the frame of the function `depth` levels out from the one using it
+    struct Binding
+    {
+        static constexpr uint32_t Unresolved{ UINT32_MAX };
+        uint32_t depth{ Unresolved };
+        uint32_t slot{ Unresolved };
+        bool isResolved() const { return slot != Unresolved; }
     };
 
     class AssignmentExpr : public Expr
     {
     public:
         AssignmentExpr(Token name, Expr* value)
-            : m_Name{ name }, m_Value{ value }
+            : Expr{ ExprKind::ASSIGNMENT }, m_Name{ name }, m_Value{ value }
         {}
         virtual void accept(ASTConstVisitor& visitor) const override
         {
             visitor.visit(*this);
         }
         Token m_Name;
-        std::unique_ptr<Expr> m_Value;
+        Expr* m_Value;
+        Binding m_Binding;
     };
 
     class BinaryExpr : public Expr
     {
     public:
         BinaryExpr(Expr* left, Token op, Expr* right)
-            : m_Left{ left }, m_Operator{ op }, m_Right{ right }
+            : Expr{ ExprKind::BINARY }, m_Left{ left }, m_Right{ right }, m_Operator{ op }
         {}
         virtual void accept(ASTConstVisitor& visitor) const override
         {
             visitor.visit(*this);
         }
-        std::unique_ptr<Expr> m_Left, m_Right;
+        Expr* m_Left;
+        Expr* m_Right;
         Token m_Operator;
     };
 
@@ -47,13 +83,13 @@ namespace BBTCompiler
     {
     public:
         UnaryExpr(Token op, Expr* right)
-            : m_Operator{ op }, m_Right{ right }
+            : Expr{ ExprKind::UNARY }, m_Right{ right }, m_Operator{ op }
         {}
         virtual void accept(ASTConstVisitor& visitor) const override
         {
             visitor.visit(*this);
         }
-        std::unique_ptr<Expr> m_Right;
+        Expr* m_Right;
         Token m_Operator;
     };
 
@@ -61,20 +97,20 @@ namespace BBTCompiler
     {
     public:
         GroupedExpr(Expr* expr)
-            : m_Expression{ expr }
+            : Expr{ ExprKind::GROUPED }, m_Expression{ expr }
         {}
         virtual void accept(ASTConstVisitor& visitor) const override
         {
             visitor.visit(*this);
         }
-        std::unique_ptr<Expr> m_Expression;
+        Expr* m_Expression;
     };
 
     class LiteralExpr : public Expr
     {
     public:
         LiteralExpr(Token token)
-            : m_Token{token}
+            : Expr{ ExprKind::LITERAL }, m_Token{token}
         {}
         virtual void accept(ASTConstVisitor& visitor) const override
         {
@@ -87,7 +123,7 @@ namespace BBTCompiler
     {
     public:
         VariableExpr(Token name)
-            : m_Name{name}
+            : Expr{ ExprKind::VARIABLE }, m_Name{name}
         {}
         virtual void accept(ASTConstVisitor& visitor) const override
         {
@@ -95,20 +131,37 @@ namespace BBTCompiler
         }
         Token m_Name;
         Token m_Type;
+        Binding m_Binding;
     };
 
     class CallExpr : public Expr
     {
     public:
-        CallExpr(std::unique_ptr<Expr> callee, Token paren, std::vector<std::unique_ptr<Expr>> arguements)
-            : m_Callee{ std::move(callee) }, m_Paren{ paren }, m_Args{ std::move(arguements) }
+        CallExpr(Expr* callee, Token paren, AstSpan<Expr*> arguements)
+            : Expr{ ExprKind::CALL }, m_Paren{ paren }, m_Args{ arguements }, m_Callee{ callee }
         {}
         virtual void accept(ASTConstVisitor& visitor) const override
         {
             visitor.visit(*this);
         }
         Token m_Paren;
-        std::vector<std::unique_ptr<Expr>> m_Args;
-        std::unique_ptr<Expr> m_Callee;
+        AstSpan<Expr*> m_Args;
+        Expr* m_Callee;
+    };
+
+    // Stands in for an expression with a syntax error, `m_Token` is where the
+    // error was reported
+    class ErrorExpr : public Expr
+    {
+    public:
+        ErrorExpr(Token token)
+            : Expr{ ExprKind::ERROR }, m_Token{ token }
+        {}
+        virtual void accept(ASTConstVisitor& visitor) const override
+        {
+            visitor.visit(*this);
+        }
+        Token m_Token;
     };
+
 }
\ No newline at end of file
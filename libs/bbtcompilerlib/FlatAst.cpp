@@ -0,0 +1,455 @@
+#include "FlatAst.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "Expression.h"
+
+namespace BBTCompiler
+{
+    class FlatAstBuilder : public ASTConstVisitor
+    {
+    public:
+        explicit FlatAstBuilder(FlatAst::Storage& storage) : m_Storage{ storage } {}
+
+        NodeIndex add(const Stmt* stmt)
+        {
+            if(!stmt)
+                return NoNode;
+            stmt->accept(*this);
+            return m_Last;
+        }
+
+        NodeIndex add(const Expr* expr)
+        {
+            if(!expr)
+                return NoNode;
+            expr->accept(*this);
+            return m_Last;
+        }
+
+        void visit(const AssignmentExpr& expr) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::ASSIGNMENT, addToken(expr.m_Name)) };
+            setData(node, add(expr.m_Value));
+        }
+
+        void visit(const BinaryExpr& expr) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::BINARY, addToken(expr.m_Operator)) };
+            const NodeIndex left{ add(expr.m_Left) };
+            setData(node, left, add(expr.m_Right));
+        }
+
+        void visit(const UnaryExpr& expr) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::UNARY, addToken(expr.m_Operator)) };
+            setData(node, add(expr.m_Right));
+        }
+
+        void visit(const LiteralExpr& expr) override
+        {
+            setData(newNode(FlatNodeKind::LITERAL, addToken(expr.m_Token)));
+        }
+
+        void visit(const GroupedExpr& expr) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::GROUPED) };
+            setData(node, add(expr.m_Expression));
+        }
+
+        void visit(const VariableExpr& expr) override
+        {
+            setData(newNode(FlatNodeKind::VARIABLE, addToken(expr.m_Name)));
+        }
+
+        void visit(const CallExpr& expr) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::CALL, addToken(expr.m_Paren)) };
+            const NodeIndex callee{ add(expr.m_Callee) };
+            const uint32_t args{ reserveExtra(expr.m_Args.size() + 1) };
+            m_Storage.extra[args] = static_cast<uint32_t>(expr.m_Args.size());
+            for(size_t i = 0; i < expr.m_Args.size(); ++i)
+                m_Storage.extra[args + 1 + i] = add(expr.m_Args[i]);
+            setData(node, callee, args);
+        }
+
+        void visit(const ErrorExpr& expr) override
+        {
+            setData(newNode(FlatNodeKind::ERROR_EXPR, addToken(expr.m_Token)));
+        }
+
+        void visit(const ExprStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::EXPR_STMT) };
+            setData(node, add(stmt.m_Expression));
+        }
+
+        void visit(const PrintStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::PRINT) };
+            setData(node, add(stmt.m_Expression));
+        }
+
+        void visit(const VariableStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::VARIABLE_DECL, addToken(stmt.m_Name)) };
+            const uint32_t type{ addToken(stmt.m_Type) };
+            setData(node, add(stmt.m_Initializer), type);
+        }
+
+        void visit(const BlockStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::BLOCK) };
+            const uint32_t statements{ reserveExtra(stmt.m_Statements.size()) };
+            for(size_t i = 0; i < stmt.m_Statements.size(); ++i)
+                m_Storage.extra[statements + i] = add(stmt.m_Statements[i]);
+            setData(node, statements, static_cast<uint32_t>(stmt.m_Statements.size()));
+        }
+
+        void visit(const IfStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::IF) };
+            const NodeIndex condition{ add(stmt.m_Condition) };
+            const uint32_t branches{ reserveExtra(2) };
+            m_Storage.extra[branches] = add(stmt.m_ThenBranch);
+            m_Storage.extra[branches + 1] = add(stmt.m_ElseBranch);
+            setData(node, condition, branches);
+        }
+
+        void visit(const WhileStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::WHILE) };
+            const NodeIndex condition{ add(stmt.m_Condition) };
+            setData(node, condition, add(stmt.m_Body));
+        }
+
+        void visit(const FuncStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::FUNCTION, addToken(stmt.m_Name)) };
+            const size_t params{ stmt.m_Params.size() };
+            const uint32_t signature{ reserveExtra(2 + 2 * params + 1 + stmt.m_Body.size()) };
+            m_Storage.extra[signature] = addToken(stmt.m_ReturnType);
+            m_Storage.extra[signature + 1] = static_cast<uint32_t>(params);
+            for(size_t i = 0; i < params; ++i)
+            {
+                m_Storage.extra[signature + 2 + 2 * i] = addToken(stmt.m_Params[i].first);
+                m_Storage.extra[signature + 3 + 2 * i] = addToken(stmt.m_Params[i].second);
+            }
+            const uint32_t body{ static_cast<uint32_t>(signature + 2 + 2 * params) };
+            m_Storage.extra[body] = static_cast<uint32_t>(stmt.m_Body.size());
+            for(size_t i = 0; i < stmt.m_Body.size(); ++i)
+                m_Storage.extra[body + 1 + i] = add(stmt.m_Body[i]);
+            setData(node, signature);
+        }
+
+        void visit(const ReturnStmt& stmt) override
+        {
+            const NodeIndex node{ newNode(FlatNodeKind::RETURN, addToken(stmt.m_ReturnToken)) };
+            setData(node, add(stmt.m_Value));
+        }
+        void visit(const ErrorStmt& stmt) override
+        {
+            setData(newNode(FlatNodeKind::ERROR_STMT, addToken(stmt.m_Token)));
+        }
+    private:
+        NodeIndex newNode(FlatNodeKind kind, uint32_t token = NoNode)
+        {
+            m_Storage.kinds.push_back(kind);
+            m_Storage.mainTokens.push_back(token);
+            m_Storage.data.emplace_back();
+            return static_cast<NodeIndex>(m_Storage.kinds.size() - 1);
+        }
+
+        void setData(NodeIndex node, uint32_t lhs = NoNode, uint32_t rhs = NoNode)
+        {
+            m_Storage.data[node] = FlatAst::Data{ lhs, rhs };
+            m_Last = node;
+        }
+
+        uint32_t addToken(const Token& token)
+        {
+            m_Storage.tokens.push_back(FlatToken{ static_cast<uint32_t>(m_Storage.strings.size()),
+                static_cast<uint32_t>(token.value.size()), static_cast<uint32_t>(token.position.line),
+                static_cast<uint32_t>(token.position.column), static_cast<uint32_t>(token.type) });
+            m_Storage.strings.insert(m_Storage.strings.end(), token.value.begin(), token.value.end());
+            return static_cast<uint32_t>(m_Storage.tokens.size() - 1);
+        }
+
+        uint32_t reserveExtra(size_t count)
+        {
+            const size_t offset{ m_Storage.extra.size() };
+            m_Storage.extra.resize(offset + count, NoNode);
+            return static_cast<uint32_t>(offset);
+        }
+    private:
+        FlatAst::Storage& m_Storage;
+        NodeIndex m_Last{ NoNode };
+    };
+
+    namespace
+    {
+        constexpr char FileMagic[4]{ 'B', 'B', 'T', 'A' };
+        constexpr uint32_t ByteOrderMark{ 0x01020304 };
+
+        struct FileHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t byteOrder;
+            uint32_t nodeCount;
+            uint32_t extraCount;
+            uint32_t tokenCount;
+            uint32_t rootCount;
+            uint32_t stringsSize;
+        };
+
+        // Size of the file described by `header`, computed in 64 bits so
+        // counts from a corrupt header cannot overflow
+        uint64_t fileSize(const FileHeader& header)
+        {
+            return sizeof(FileHeader)
+                + uint64_t{ header.nodeCount } * (sizeof(uint32_t) + sizeof(FlatAst::Data) + sizeof(FlatNodeKind))
+                + uint64_t{ header.extraCount } * sizeof(uint32_t)
+                + uint64_t{ header.rootCount } * sizeof(NodeIndex)
+                + uint64_t{ header.tokenCount } * sizeof(FlatToken)
+                + header.stringsSize;
+        }
+
+        template<typename T>
+        AstSpan<const T> readArray(const char*& cursor, size_t count)
+        {
+            const AstSpan<const T> array{ reinterpret_cast<const T*>(cursor), count };
+            cursor += count * sizeof(T);
+            return array;
+        }
+
+        template<typename T>
+        void writeArray(std::ostream& stream, const AstSpan<const T>& array)
+        {
+            stream.write(reinterpret_cast<const char*>(array.data()), static_cast<std::streamsize>(array.size() * sizeof(T)));
+        }
+
+        template<typename T>
+        AstSpan<const T> viewOf(const std::vector<T>& items)
+        {
+            return { items.data(), items.size() };
+        }
+    }
+
+    FlatAst FlatAst::build(const std::vector<Stmt*>& statements)
+    {
+        FlatAst ast;
+        ast.m_Storage = std::make_unique<Storage>();
+        Storage& storage{ *ast.m_Storage };
+        FlatAstBuilder builder{ storage };
+        storage.roots.reserve(statements.size());
+        for(const Stmt* statement : statements)
+            storage.roots.push_back(builder.add(statement));
+
+        ast.m_Kinds = viewOf(storage.kinds);
+        ast.m_MainTokens = viewOf(storage.mainTokens);
+        ast.m_Data = viewOf(storage.data);
+        ast.m_Extra = viewOf(storage.extra);
+        ast.m_Tokens = viewOf(storage.tokens);
+        ast.m_Roots = viewOf(storage.roots);
+        ast.m_Strings = std::string_view(storage.strings.data(), storage.strings.size());
+        return ast;
+    }
+
+    FlatAst FlatAst::load(std::string_view bytes)
+    {
+        static_assert(sizeof(FlatToken) == 5 * sizeof(uint32_t) && sizeof(Data) == 2 * sizeof(uint32_t));
+        static_assert(sizeof(FlatNodeKind) == 1 && sizeof(FileHeader) % alignof(FlatToken) == 0);
+        FileHeader header;
+        if(bytes.size() < sizeof(FileHeader))
+            throw std::runtime_error("not a binary AST: too short");
+        std::memcpy(&header, bytes.data(), sizeof(FileHeader));
+        if(std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0)
+            throw std::runtime_error("not a binary AST");
+        if(header.byteOrder != ByteOrderMark)
+            throw std::runtime_error("binary AST written with another byte order");
+        if(header.version != FileVersion)
+            throw std::runtime_error("unsupported binary AST version " + std::to_string(header.version));
+        if(fileSize(header) != bytes.size())
+            throw std::runtime_error("binary AST size does not match its header");
+        if(reinterpret_cast<uintptr_t>(bytes.data()) % alignof(uint32_t) != 0)
+            throw std::runtime_error("binary AST is not aligned");
+
+        // Only the layout is checked, indices in the arrays are trusted
+        FlatAst ast;
+        const char* cursor{ bytes.data() + sizeof(FileHeader) };
+        ast.m_MainTokens = readArray<uint32_t>(cursor, header.nodeCount);
+        ast.m_Data = readArray<Data>(cursor, header.nodeCount);
+        ast.m_Extra = readArray<uint32_t>(cursor, header.extraCount);
+        ast.m_Roots = readArray<NodeIndex>(cursor, header.rootCount);
+        ast.m_Tokens = readArray<FlatToken>(cursor, header.tokenCount);
+        ast.m_Kinds = readArray<FlatNodeKind>(cursor, header.nodeCount);
+        ast.m_Strings = std::string_view(cursor, header.stringsSize);
+        return ast;
+    }
+
+    FlatAst FlatAst::open(const std::filesystem::path& path)
+    {
+        MappedFile file{ path };
+        FlatAst ast{ load(file.getView()) };
+        ast.m_File = std::move(file);
+        return ast;
+    }
+
+    void FlatAst::write(std::ostream& stream) const
+    {
+        FileHeader header{};
+        std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+        header.version = FileVersion;
+        header.byteOrder = ByteOrderMark;
+        header.nodeCount = static_cast<uint32_t>(m_Kinds.size());
+        header.extraCount = static_cast<uint32_t>(m_Extra.size());
+        header.tokenCount = static_cast<uint32_t>(m_Tokens.size());
+        header.rootCount = static_cast<uint32_t>(m_Roots.size());
+        header.stringsSize = static_cast<uint32_t>(m_Strings.size());
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+        writeArray(stream, m_MainTokens);
+        writeArray(stream, m_Data);
+        writeArray(stream, m_Extra);
+        writeArray(stream, m_Roots);
+        writeArray(stream, m_Tokens);
+        writeArray(stream, m_Kinds);
+        stream.write(m_Strings.data(), static_cast<std::streamsize>(m_Strings.size()));
+    }
+
+    nlohmann::json FlatAst::toJson(NodeIndex root) const
+    {
+        using Json = nlohmann::json;
+        if(root == NoNode)
+            return Json({});
+        // Children are converted first, their JSON is on top of the stack in
+        // source order when the parent is visited
+        std::vector<Json> stack;
+        const auto popChildren = [&](size_t count) {
+            std::vector<Json> children(std::make_move_iterator(stack.end() - count), std::make_move_iterator(stack.end()));
+            stack.resize(stack.size() - count);
+            return children;
+        };
+        const auto listJson = [&](uint32_t count) {
+            Json list = Json::array();
+            for(auto& child : popChildren(count))
+                list.push_back(std::move(child));
+            return list;
+        };
+
+        postOrder(root, [&](NodeIndex node) {
+            const Data data{ m_Data[node] };
+            Json json({});
+            switch(m_Kinds[node])
+            {
+            case FlatNodeKind::ASSIGNMENT:
+                json["type"] = "AssignmentExpression";
+                json["name"] = token(node).value;
+                json["value"] = std::move(popChildren(1).front());
+                break;
+            case FlatNodeKind::BINARY:
+            {
+                std::vector<Json> operands = popChildren(2);
+                json["type"] = "BinaryExpression";
+                json["operator"] = token(node).value;
+                json["lhs"] = std::move(operands[0]);
+                json["rhs"] = std::move(operands[1]);
+                break;
+            }
+            case FlatNodeKind::UNARY:
+                json["type"] = "UnaryExpression";
+                json["operator"] = token(node).value;
+                json["rhs"] = std::move(popChildren(1).front());
+                break;
+            case FlatNodeKind::LITERAL:
+                json["type"] = "PrimaryExpression";
+                json["value"] = token(node).value;
+                break;
+            case FlatNodeKind::GROUPED:
+                json["type"] = "GroupedExpression";
+                json["expression"] = std::move(popChildren(1).front());
+                break;
+            case FlatNodeKind::VARIABLE:
+                json["type"] = "Variable";
+                json["value"] = token(node).value;
+                break;
+            case FlatNodeKind::CALL:
+            {
+                Json args = listJson(m_Extra[data.rhs]);
+                json["type"] = "CallExpression";
+                json["callee"] = std::move(popChildren(1).front());
+                json["arguements"] = std::move(args);
+                break;
+            }
+            case FlatNodeKind::EXPR_STMT:
+                json["type"] = "ExpressionStatement";
+                json["expression"] = std::move(popChildren(1).front());
+                break;
+            case FlatNodeKind::PRINT:
+                json["type"] = "PrintStatement";
+                json["expression"] = std::move(popChildren(1).front());
+                break;
+            case FlatNodeKind::VARIABLE_DECL:
+                json["type"] = "VariableStatement";
+                json["name"] = token(node).value;
+                json["initializer"] = data.lhs != NoNode ? std::move(popChildren(1).front()) : Json({});
+                break;
+            case FlatNodeKind::BLOCK:
+                json["type"] = "BlockStatement";
+                json["statements"] = listJson(data.rhs);
+                break;
+            case FlatNodeKind::IF:
+            {
+                const uint32_t elseBranch{ m_Extra[data.rhs + 1] };
+                Json elseJson = elseBranch != NoNode ? std::move(popChildren(1).front()) : Json({});
+                Json thenJson = m_Extra[data.rhs] != NoNode ? std::move(popChildren(1).front()) : Json({});
+                json["type"] = "IfStatement";
+                json["condition"] = std::move(popChildren(1).front());
+                json["then"] = std::move(thenJson);
+                json["else"] = std::move(elseJson);
+                break;
+            }
+            case FlatNodeKind::WHILE:
+            {
+                Json body = std::move(popChildren(1).front());
+                json["type"] = "WhileStatement";
+                json["condition"] = std::move(popChildren(1).front());
+                json["body"] = std::move(body);
+                break;
+            }
+            case FlatNodeKind::FUNCTION:
+            {
+                const uint32_t params{ m_Extra[data.lhs + 1] };
+                const uint32_t body{ data.lhs + 2 + 2 * params };
+                const std::string_view returnType{ tokenAt(m_Extra[data.lhs]).value };
+                json["type"] = "FunctionStatement";
+                json["name"] = token(node).value;
+                json["returnType"] = returnType.empty() ? "void" : returnType;
+                json["parameters"] = Json::array();
+                for(uint32_t i = 0; i < params; ++i)
+                {
+                    auto& element = json["parameters"].emplace_back(Json({}));
+                    element["name"] = tokenAt(m_Extra[data.lhs + 2 + 2 * i]).value;
+                    element["type"] = tokenAt(m_Extra[data.lhs + 3 + 2 * i]).value;
+                }
+                json["statements"] = listJson(m_Extra[body]);
+                break;
+            }
+            case FlatNodeKind::RETURN:
+                json["type"] = "ReturnStatement";
+                json["body"] = data.lhs != NoNode ? std::move(popChildren(1).front()) : Json({});
+                break;
+            case FlatNodeKind::ERROR_EXPR:
+                json["type"] = "ErrorExpression";
+                json["token"] = token(node).value;
+                break;
+            case FlatNodeKind::ERROR_STMT:
+                json["type"] = "ErrorStatement";
+                json["token"] = token(node).value;
+                break;
+            }
+            stack.push_back(std::move(json));
+        });
+        return stack.empty() ? Json({}) : std::move(stack.back());
+    }
+}
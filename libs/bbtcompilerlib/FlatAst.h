@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Lexer.h"
+#include "MappedFile.h"
+#include "Statement.h"
+
+namespace BBTCompiler
+{
+    enum class FlatNodeKind : uint8_t
+    {
+        ASSIGNMENT, BINARY, UNARY, LITERAL, GROUPED, VARIABLE, CALL,
+        EXPR_STMT, PRINT, VARIABLE_DECL, BLOCK, IF, WHILE, FUNCTION, RETURN,
+        ERROR_EXPR, ERROR_STMT
+    };
+
+    using NodeIndex = uint32_t;
+    constexpr NodeIndex NoNode{ std::numeric_limits<NodeIndex>::max() };
+
+    // A token as stored in a FlatAst, its text is a slice of the string table.
+    // Symbols are not stored, tokens read from a FlatAst have NoSymbol.
+    struct FlatToken
+    {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t line;
+        uint32_t column;
+        uint32_t type;
+    };
+
+    // Index based encoding of the AST. Node kinds, main tokens and two data
+    // words live in parallel arrays, so a pass over the tree is a walk over
+    // a few contiguous arrays instead of a pointer chase. Nodes are numbered
+    // in pre-order, children always follow their parent. Nodes with more than
+    // two children keep them in the extra table, the data words then hold an
+    // offset into it:
+    //
+    //   ASSIGNMENT     token name,     lhs value
+    //   BINARY         token operator, lhs left,  rhs right
+    //   UNARY          token operator, lhs operand
+    //   LITERAL        token value
+    //   GROUPED                        lhs expression
+    //   VARIABLE       token name
+    //   CALL           token paren,    lhs callee, rhs extra: count, arguments...
+    //   EXPR_STMT                      lhs expression
+    //   PRINT                          lhs expression
+    //   VARIABLE_DECL  token name,     lhs initializer, rhs type token
+    //   BLOCK                          lhs extra offset, rhs count
+    //   IF                             lhs condition, rhs extra: then, else
+    //   WHILE                          lhs condition, rhs body
+    //   FUNCTION       token name,     lhs extra: return type token, parameter
+    //                                  count, (name, type) token pairs, body
+    //                                  count, body statements...
+    //   RETURN         token keyword,  lhs value
+    //   ERROR_EXPR     token where the syntax error was reported
+    //   ERROR_STMT     token where the syntax error was reported
+    //
+    // Optional children are NoNode.
+    //
+    // The arrays are views, either into storage filled by build() or into a
+    // binary AST file, so a file written by write() is used in place without
+    // deserializing it. The file is a header followed by the arrays, 32-bit
+    // ones first so every array is aligned:
+    //
+    //   header         magic "BBTA", version, byte order mark 0x01020304,
+    //                  node, extra, token and root counts, string table size
+    //   main tokens    uint32 per node
+    //   data           two uint32 per node
+    //   extra          uint32 words
+    //   roots          uint32 per top-level statement
+    //   tokens         FlatToken records
+    //   kinds          one byte per node
+    //   strings        token text, referenced by the token records
+    //
+    // Numbers are in the byte order of the machine that wrote the file,
+    // loading a file with another byte order or version fails.
+    class FlatAst
+    {
+    public:
+        struct Data
+        {
+            uint32_t lhs{ NoNode };
+            uint32_t rhs{ NoNode };
+        };
+        static constexpr uint32_t FileVersion{ 1 };
+
+        // Encodes the tree produced by the Parser. This is a second pass over
+        // the pointer tree, not a replacement for it: parsing still allocates
+        // every node, and the flat form only speeds up the passes that walk
+        // it afterwards, or that load it from a binary AST file.
+        static FlatAst build(const std::vector<Stmt*>& statements);
+        // Uses a binary AST in place. `bytes` must stay alive as long as the
+        // FlatAst and be aligned to 4 bytes. Throws std::runtime_error if it
+        // is not a binary AST this version can read.
+        static FlatAst load(std::string_view bytes);
+        // Maps the file and loads it, the FlatAst keeps the mapping open
+        static FlatAst open(const std::filesystem::path& path);
+        void write(std::ostream& stream) const;
+
+        size_t size() const { return m_Kinds.size(); }
+        const AstSpan<const NodeIndex>& getRoots() const { return m_Roots; }
+        FlatNodeKind kind(NodeIndex node) const { return m_Kinds[node]; }
+        Token token(NodeIndex node) const { return tokenAt(m_MainTokens[node]); }
+        Token tokenAt(uint32_t index) const
+        {
+            const FlatToken& token{ m_Tokens[index] };
+            return Token{ static_cast<TokenType>(token.type), NoSymbol, TokenPosition{ token.line, token.column },
+                          m_Strings.substr(token.offset, token.length) };
+        }
+        Data data(NodeIndex node) const { return m_Data[node]; }
+        uint32_t extra(uint32_t index) const { return m_Extra[index]; }
+
+        // Calls visit(child) for every present child of `node`, in source order
+        template<typename Visit>
+        void forEachChild(NodeIndex node, Visit&& visit) const;
+
+        // Walk the subtree below `root`, or every root in order, with an
+        // explicit stack so arbitrarily deep trees do not need a deep call
+        // stack. Visiting nodes 0 to size() - 1 in a plain loop is also a
+        // pre-order walk, and the fastest one when the depth is not needed.
+        template<typename Visit>
+        void preOrder(NodeIndex root, Visit&& visit) const;
+        template<typename Visit>
+        void preOrder(Visit&& visit) const;
+        template<typename Visit>
+        void postOrder(NodeIndex root, Visit&& visit) const;
+        template<typename Visit>
+        void postOrder(Visit&& visit) const;
+
+        // Same layout as the output of ASTJSonVisitor for the node
+        nlohmann::json toJson(NodeIndex root) const;
+    private:
+        template<typename Visit>
+        void preOrder(std::vector<NodeIndex>& stack, NodeIndex root, Visit& visit) const;
+        template<typename Visit>
+        void postOrder(std::vector<std::pair<NodeIndex, bool>>& stack, NodeIndex root, Visit& visit) const;
+    private:
+        friend class FlatAstBuilder;
+        // Arrays of a tree made by build(), on the heap so moving the FlatAst
+        // does not move the arrays the views point into
+        struct Storage
+        {
+            std::vector<FlatNodeKind> kinds;
+            std::vector<uint32_t> mainTokens;
+            std::vector<Data> data;
+            std::vector<uint32_t> extra;
+            std::vector<FlatToken> tokens;
+            std::vector<NodeIndex> roots;
+            std::vector<char> strings;
+        };
+        AstSpan<const FlatNodeKind> m_Kinds;
+        AstSpan<const uint32_t> m_MainTokens;
+        AstSpan<const Data> m_Data;
+        AstSpan<const uint32_t> m_Extra;
+        AstSpan<const FlatToken> m_Tokens;
+        AstSpan<const NodeIndex> m_Roots;
+        std::string_view m_Strings;
+        std::unique_ptr<Storage> m_Storage;
+        MappedFile m_File;
+    };
+
+    template<typename Visit>
+    void FlatAst::forEachChild(NodeIndex node, Visit&& visit) const
+    {
+        const auto visitIfPresent = [&](uint32_t child) {
+            if(child != NoNode)
+                visit(child);
+        };
+        const Data data{ m_Data[node] };
+        switch(m_Kinds[node])
+        {
+        case FlatNodeKind::LITERAL:
+        case FlatNodeKind::VARIABLE:
+        case FlatNodeKind::ERROR_EXPR:
+        case FlatNodeKind::ERROR_STMT:
+            break;
+        case FlatNodeKind::ASSIGNMENT:
+        case FlatNodeKind::UNARY:
+        case FlatNodeKind::GROUPED:
+        case FlatNodeKind::EXPR_STMT:
+        case FlatNodeKind::PRINT:
+        case FlatNodeKind::VARIABLE_DECL:
+        case FlatNodeKind::RETURN:
+            visitIfPresent(data.lhs);
+            break;
+        case FlatNodeKind::BINARY:
+        case FlatNodeKind::WHILE:
+            visitIfPresent(data.lhs);
+            visitIfPresent(data.rhs);
+            break;
+        case FlatNodeKind::CALL:
+            visitIfPresent(data.lhs);
+            for(uint32_t i = 0; i < m_Extra[data.rhs]; ++i)
+                visitIfPresent(m_Extra[data.rhs + 1 + i]);
+            break;
+        case FlatNodeKind::BLOCK:
+            for(uint32_t i = 0; i < data.rhs; ++i)
+                visitIfPresent(m_Extra[data.lhs + i]);
+            break;
+        case FlatNodeKind::IF:
+            visitIfPresent(data.lhs);
+            visitIfPresent(m_Extra[data.rhs]);
+            visitIfPresent(m_Extra[data.rhs + 1]);
+            break;
+        case FlatNodeKind::FUNCTION:
+        {
+            const uint32_t bodyStart{ data.lhs + 2 + 2 * m_Extra[data.lhs + 1] };
+            for(uint32_t i = 0; i < m_Extra[bodyStart]; ++i)
+                visitIfPresent(m_Extra[bodyStart + 1 + i]);
+            break;
+        }
+        }
+    }
+
+    template<typename Visit>
+    void FlatAst::preOrder(std::vector<NodeIndex>& stack, NodeIndex root, Visit& visit) const
+    {
+        if(root == NoNode)
+            return;
+        stack.push_back(root);
+        while(!stack.empty())
+        {
+            const NodeIndex node{ stack.back() };
+            stack.pop_back();
+            visit(node);
+            // Pushed in reverse so the first child is visited next
+            const size_t mark{ stack.size() };
+            forEachChild(node, [&](NodeIndex child) { stack.push_back(child); });
+            std::reverse(stack.begin() + mark, stack.end());
+        }
+    }
+
+    template<typename Visit>
+    void FlatAst::preOrder(NodeIndex root, Visit&& visit) const
+    {
+        std::vector<NodeIndex> stack;
+        preOrder(stack, root, visit);
+    }
+
+    template<typename Visit>
+    void FlatAst::preOrder(Visit&& visit) const
+    {
+        std::vector<NodeIndex> stack;
+        for(const NodeIndex root : m_Roots)
+            preOrder(stack, root, visit);
+    }
+
+    template<typename Visit>
+    void FlatAst::postOrder(std::vector<std::pair<NodeIndex, bool>>& stack, NodeIndex root, Visit& visit) const
+    {
+        if(root == NoNode)
+            return;
+        // The flag is set once the node's children have been pushed
+        stack.emplace_back(root, false);
+        while(!stack.empty())
+        {
+            const auto [node, expanded] = stack.back();
+            if(expanded)
+            {
+                stack.pop_back();
+                visit(node);
+                continue;
+            }
+            stack.back().second = true;
+            const size_t mark{ stack.size() };
+            forEachChild(node, [&](NodeIndex child) { stack.emplace_back(child, false); });
+            std::reverse(stack.begin() + mark, stack.end());
+        }
+    }
+
+    template<typename Visit>
+    void FlatAst::postOrder(NodeIndex root, Visit&& visit) const
+    {
+        std::vector<std::pair<NodeIndex, bool>> stack;
+        postOrder(stack, root, visit);
+    }
+
+    template<typename Visit>
+    void FlatAst::postOrder(Visit&& visit) const
+    {
+        std::vector<std::pair<NodeIndex, bool>> stack;
+        for(const NodeIndex root : m_Roots)
+            postOrder(stack, root, visit);
+    }
+}
@@ -0,0 +1,203 @@
+#include "IR.h"
+#include <array>
+#include <cctype>
+#include <cstdio>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        constexpr std::array IROpNames{
+#define BBTCOMPILER_IR_OPCODE_NAME(name) std::string_view{ #name },
+            BBTCOMPILER_IR_OPCODES(BBTCOMPILER_IR_OPCODE_NAME)
+#undef BBTCOMPILER_IR_OPCODE_NAME
+        };
+        constexpr std::string_view IRTypeNames[]{ "void", "int", "float", "bool", "char" };
+
+        void printBlockName(std::ostream& stream, BlockId block)
+        {
+            stream << "block" << block;
+        }
+
+        void printOperands(std::ostream& stream, const IRInstruction& instruction)
+        {
+            for(size_t i = 0; i < instruction.operands.size(); ++i)
+                stream << (i == 0 ? "" : ", ") << '%' << instruction.operands[i];
+        }
+
+        void printConstant(std::ostream& stream, const IRInstruction& instruction)
+        {
+            switch(instruction.type)
+            {
+            case IRType::INT: stream << instruction.constant.integer; break;
+            case IRType::BOOL: stream << (instruction.constant.boolean ? "true" : "false"); break;
+            case IRType::FLOAT:
+            {
+                char buffer[32];
+                const int length{ std::snprintf(buffer, sizeof(buffer), "%.17g", instruction.constant.number) };
+                stream.write(buffer, length);
+                break;
+            }
+            case IRType::CHAR:
+                if(instruction.text.data())
+                    stream << '"' << instruction.text << '"';
+                else
+                    stream << "null";
+                break;
+            case IRType::VOID: break;
+            }
+        }
+
+        void printSlot(std::ostream& stream, const IRInstruction& instruction)
+        {
+            stream << "slot " << instruction.immediate[1];
+            if(instruction.immediate[0] != 0)
+                stream << " depth " << instruction.immediate[0];
+        }
+    }
+
+    std::string_view irOpName(IROp op)
+    {
+        return IROpNames[static_cast<size_t>(op)];
+    }
+
+    std::string_view irTypeName(IRType type)
+    {
+        return IRTypeNames[static_cast<size_t>(type)];
+    }
+
+    std::vector<BlockId> IRFunction::successors(BlockId block) const
+    {
+        const std::vector<ValueId>& code{ blocks[block].instructions };
+        if(code.empty())
+            return {};
+        const IRInstruction& last{ instruction(code.back()) };
+        switch(last.op)
+        {
+        case IROp::JUMP: return { last.immediate[0] };
+        case IROp::BRANCH: return { last.immediate[0], last.immediate[1] };
+        default: return {};
+        }
+    }
+
+    void IRFunction::renumber(const std::vector<ValueId>& replacement)
+    {
+        std::vector<ValueId> renumbered(instructions.size(), NoId);
+        std::vector<IRInstruction*> kept;
+        kept.reserve(instructions.size());
+        for(IRBlock& block : blocks)
+        {
+            std::vector<ValueId> code;
+            for(const ValueId id : block.instructions)
+            {
+                if(replacement[id] != id)
+                    continue;
+                renumbered[id] = static_cast<ValueId>(kept.size());
+                code.push_back(renumbered[id]);
+                kept.push_back(instructions[id]);
+            }
+            block.instructions = std::move(code);
+        }
+        for(IRInstruction* instruction : kept)
+        {
+            instruction->id = renumbered[instruction->id];
+            for(ValueId& operand : instruction->operands)
+                operand = renumbered[replacement[operand]];
+        }
+        instructions = std::move(kept);
+    }
+
+    void IRModule::print(std::ostream& stream) const
+    {
+        for(const IRFunction& function : functions)
+            print(stream, function);
+    }
+
+    void IRModule::print(std::ostream& stream, const IRFunction& function) const
+    {
+        stream << "fn " << (function.declaration ? function.name : "<script>") << '(';
+        for(size_t i = 0; i < function.parameters.size(); ++i)
+            stream << (i == 0 ? "" : ", ") << irTypeName(function.parameters[i]);
+        stream << ')';
+        if(function.returnType != IRType::VOID)
+            stream << " -> " << irTypeName(function.returnType);
+        stream << " {\n";
+        for(BlockId block = 0; block < function.blocks.size(); ++block)
+        {
+            printBlockName(stream, block);
+            stream << ':';
+            const std::vector<BlockId>& predecessors{ function.blocks[block].predecessors };
+            for(size_t i = 0; i < predecessors.size(); ++i)
+            {
+                stream << (i == 0 ? " ; preds " : ", ");
+                printBlockName(stream, predecessors[i]);
+            }
+            stream << '\n';
+            for(const ValueId id : function.blocks[block].instructions)
+            {
+                const IRInstruction& instruction{ function.instruction(id) };
+                stream << "    ";
+                if(instruction.type != IRType::VOID)
+                    stream << '%' << id << " = ";
+                for(const char c : irOpName(instruction.op))
+                    stream << static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                if(instruction.type != IRType::VOID)
+                    stream << ' ' << irTypeName(instruction.type);
+                switch(instruction.op)
+                {
+                case IROp::CONSTANT:
+                    stream << ' ';
+                    printConstant(stream, instruction);
+                    break;
+                case IROp::PARAMETER:
+                    stream << ' ' << instruction.immediate[0];
+                    break;
+                case IROp::PHI:
+                    for(size_t i = 0; i < instruction.operands.size(); ++i)
+                    {
+                        stream << (i == 0 ? " [%" : ", [%") << instruction.operands[i] << ", ";
+                        printBlockName(stream, predecessors[i]);
+                        stream << ']';
+                    }
+                    break;
+                case IROp::LOAD:
+                    stream << ' ';
+                    printSlot(stream, instruction);
+                    break;
+                case IROp::STORE:
+                    stream << ' ';
+                    printSlot(stream, instruction);
+                    stream << ", ";
+                    printOperands(stream, instruction);
+                    break;
+                case IROp::CALL:
+                    stream << ' ' << functions[instruction.immediate[0]].name << '(';
+                    printOperands(stream, instruction);
+                    stream << ')';
+                    break;
+                case IROp::JUMP:
+                    stream << ' ';
+                    printBlockName(stream, instruction.immediate[0]);
+                    break;
+                case IROp::BRANCH:
+                    stream << ' ';
+                    printOperands(stream, instruction);
+                    stream << ", ";
+                    printBlockName(stream, instruction.immediate[0]);
+                    stream << ", ";
+                    printBlockName(stream, instruction.immediate[1]);
+                    break;
+                default:
+                    if(!instruction.operands.empty())
+                    {
+                        stream << ' ';
+                        printOperands(stream, instruction);
+                    }
+                    break;
+                }
+                stream << '\n';
+            }
+        }
+        stream << "}\n";
+    }
+}
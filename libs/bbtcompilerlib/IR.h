@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "AstContext.h"
+#include "Lexer.h"
+
+namespace BBTCompiler
+{
+    class FuncStmt;
+
+    // Typed intermediate representation in SSA form, made by the IRGenerator.
+    // A function is a list of basic blocks, block 0 is the entry. Every
+    // instruction has a dense id, its index in IRFunction::instructions, and
+    // instructions with a type other than VOID define the value of that id.
+    // Values are defined once; where control flow merges, a PHI picks the
+    // value that flows in from each predecessor.
+    //
+    //   CONSTANT                     constant, CHAR ones have text
+    //   PARAMETER     index          argument `index` of the function
+    //   UNDEFINED                    value of a variable read before any
+    //                                definition, only on impossible paths
+    //   PHI           values...      one operand per predecessor, in the
+    //                                order of IRBlock::predecessors
+    //   ADD ... DIV   left, right    INT or FLOAT arithmetic, DIV of INTs
+    //                                fails at runtime for a zero divisor
+    //   NEG           operand
+    //   NOT           operand        BOOL
+    //   EQ ... GE     left, right    comparisons, operands of one type
+    //   TO_FLOAT      operand        INT to FLOAT
+    //   LOAD          depth, slot    read a variable of the frame `depth`
+    //   STORE         depth, slot    static links out, see below
+    //                 value
+    //   CALL          function       call a function of the module
+    //                 arguments...
+    //   PRINT         value
+    //   JUMP          target
+    //   BRANCH        then, else     two-way branch on a BOOL
+    //                 condition
+    //   RETURN        value?
+    //
+    // The last instruction of a block, and only that one, is a JUMP, BRANCH
+    // or RETURN. Variables live in SSA values, except the ones nested
+    // functions use: those stay in the frame slot the Resolver assigned and
+    // are accessed with LOAD and STORE, so calls see each other's changes.
+#define BBTCOMPILER_IR_OPCODES(X) \
+    X(CONSTANT) X(PARAMETER) X(UNDEFINED) X(PHI) \
+    X(ADD) X(SUB) X(MUL) X(DIV) X(NEG) X(NOT) \
+    X(EQ) X(NE) X(LT) X(LE) X(GT) X(GE) X(TO_FLOAT) \
+    X(LOAD) X(STORE) X(CALL) X(PRINT) \
+    X(JUMP) X(BRANCH) X(RETURN)
+
+    enum class IROp : uint8_t
+    {
+#define BBTCOMPILER_IR_OPCODE_ENUM(name) name,
+        BBTCOMPILER_IR_OPCODES(BBTCOMPILER_IR_OPCODE_ENUM)
+#undef BBTCOMPILER_IR_OPCODE_ENUM
+    };
+
+    // CHAR values are strings, the text of a string literal
+    enum class IRType : uint8_t { VOID, INT, FLOAT, BOOL, CHAR };
+
+    using ValueId = uint32_t;
+    using BlockId = uint32_t;
+    constexpr uint32_t NoId{ std::numeric_limits<uint32_t>::max() };
+
+    std::string_view irOpName(IROp op);
+    std::string_view irTypeName(IRType type);
+
+    // Allocated in the IRModule's arena, like AST nodes in an AstContext
+    struct IRInstruction
+    {
+        IROp op;
+        IRType type;
+        ValueId id;
+        BlockId block;
+        AstSpan<ValueId> operands;
+        // Meaning depends on `op`, see the table above
+        uint32_t immediate[2]{ NoId, NoId };
+        union
+        {
+            int64_t integer;
+            double number;
+            bool boolean;
+        } constant{};
+        // Text of a CHAR constant, null for the value of an uninitialized
+        // char variable
+        std::string_view text;
+        // Where the instruction comes from, for errors
+        Token token;
+
+        bool isTerminator() const { return op == IROp::JUMP || op == IROp::BRANCH || op == IROp::RETURN; }
+    };
+
+    struct IRBlock
+    {
+        // Phis first, the terminator last
+        std::vector<ValueId> instructions;
+        std::vector<BlockId> predecessors;
+    };
+
+    struct IRFunction
+    {
+        std::string_view name;
+        // Null for the top level of the program
+        const FuncStmt* declaration{ nullptr };
+        IRType returnType{ IRType::VOID };
+        std::vector<IRType> parameters;
+        // Slots of the frame the Resolver assigned, LOAD and STORE use some
+        uint32_t frameSize{ 0 };
+        std::vector<IRBlock> blocks;
+        std::vector<IRInstruction*> instructions;
+
+        IRInstruction& instruction(ValueId id) const { return *instructions[id]; }
+        // Targets of the block's terminator
+        std::vector<BlockId> successors(BlockId block) const;
+        // Drops instructions and renumbers the rest in block order, so ids
+        // are dense and a value's id is smaller than its uses' outside of
+        // phis. `replacement[id]` is `id` for an instruction that is kept,
+        // otherwise the kept value its uses get instead, or NoId for an
+        // instruction without uses.
+        void renumber(const std::vector<ValueId>& replacement);
+    };
+
+    class IRModule
+    {
+    public:
+        // The top level of the program is function 0
+        std::vector<IRFunction> functions;
+
+        uint32_t findFunction(const FuncStmt* declaration) const { return m_Index.at(declaration); }
+        void addFunction(const FuncStmt* declaration, uint32_t index) { m_Index.emplace(declaration, index); }
+        AstContext& getArena() { return m_Arena; }
+
+        // Text form, one line per instruction
+        void print(std::ostream& stream) const;
+        void print(std::ostream& stream, const IRFunction& function) const;
+    private:
+        AstContext m_Arena;
+        std::unordered_map<const FuncStmt*, uint32_t> m_Index;
+    };
+}
@@ -0,0 +1,341 @@
+#include "IRFolder.h"
+#include "ConstantFolder.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        // Null chars have no value the ConstantFolder computes with
+        bool hasValue(const IRInstruction& instruction)
+        {
+            return instruction.op == IROp::CONSTANT && (instruction.type != IRType::CHAR || instruction.text.data());
+        }
+
+        Value constantValue(const IRInstruction& constant)
+        {
+            switch(constant.type)
+            {
+            case IRType::INT: return Value::makeInt(constant.constant.integer);
+            case IRType::FLOAT: return Value::makeFloat(constant.constant.number);
+            case IRType::BOOL: return Value::makeBool(constant.constant.boolean);
+            default: return Value::makeString(constant.text);
+            }
+        }
+
+        bool sameConstant(const IRInstruction& left, const IRInstruction& right)
+        {
+            if(left.op != IROp::CONSTANT || right.op != IROp::CONSTANT || left.type != right.type)
+                return false;
+            switch(left.type)
+            {
+            case IRType::INT: return left.constant.integer == right.constant.integer;
+            // 0 and -0 are different constants
+            case IRType::FLOAT: return std::memcmp(&left.constant.number, &right.constant.number, sizeof(double)) == 0;
+            case IRType::BOOL: return left.constant.boolean == right.constant.boolean;
+            case IRType::CHAR: return !left.text.data() == !right.text.data() && left.text == right.text;
+            default: return false;
+            }
+        }
+
+        // Turns `instruction` into the constant `value` of its type
+        void makeConstant(IRInstruction& instruction, const Value& value)
+        {
+            instruction.op = IROp::CONSTANT;
+            instruction.operands = {};
+            switch(value.type)
+            {
+            case ValueType::INT: instruction.constant.integer = value.integer; break;
+            case ValueType::FLOAT: instruction.constant.number = value.number; break;
+            case ValueType::BOOL: instruction.constant.boolean = value.boolean; break;
+            default: break;
+            }
+        }
+
+        TokenType binaryOperator(IROp op)
+        {
+            switch(op)
+            {
+            case IROp::ADD: return TokenType::PLUS;
+            case IROp::SUB: return TokenType::MINUS;
+            case IROp::MUL: return TokenType::STAR;
+            case IROp::DIV: return TokenType::SLASH;
+            case IROp::LT: return TokenType::LESS;
+            case IROp::LE: return TokenType::LESS_EQ;
+            case IROp::GT: return TokenType::GREATER;
+            case IROp::GE: return TokenType::GREATER_EQ;
+            default: return TokenType::INVALID;
+            }
+        }
+
+        // Whether an unused instruction can go, DIV of INTs fails for zero
+        bool isRemovable(const IRInstruction& instruction)
+        {
+            switch(instruction.op)
+            {
+            case IROp::CONSTANT: case IROp::UNDEFINED: case IROp::PHI:
+            case IROp::ADD: case IROp::SUB: case IROp::MUL: case IROp::NEG: case IROp::NOT:
+            case IROp::EQ: case IROp::NE: case IROp::LT: case IROp::LE: case IROp::GT: case IROp::GE:
+            case IROp::TO_FLOAT: case IROp::LOAD:
+                return true;
+            case IROp::DIV:
+                return instruction.type == IRType::FLOAT;
+            default:
+                return false;
+            }
+        }
+    }
+
+    void IRFolder::fold(IRModule& module)
+    {
+        for(IRFunction& function : module.functions)
+            fold(function);
+    }
+
+    void IRFolder::fold(IRFunction& function)
+    {
+        m_Replacement.resize(function.instructions.size());
+        std::iota(m_Replacement.begin(), m_Replacement.end(), 0);
+        for(bool changed = true; changed;)
+        {
+            changed = false;
+            for(const IRBlock& block : function.blocks)
+            {
+                for(const ValueId id : block.instructions)
+                {
+                    if(m_Replacement[id] == id && foldValue(function, function.instruction(id)))
+                        changed = true;
+                }
+            }
+            for(BlockId block = 0; block < function.blocks.size(); ++block)
+            {
+                if(foldBranch(function, block))
+                    changed = true;
+            }
+            if(removeUnreachable(function))
+                changed = true;
+        }
+        removeUnused(function);
+    }
+
+    bool IRFolder::foldValue(IRFunction& function, IRInstruction& instruction)
+    {
+        switch(instruction.op)
+        {
+        case IROp::PHI:
+            return foldPhi(function, instruction);
+        case IROp::ADD: case IROp::SUB: case IROp::MUL: case IROp::DIV: case IROp::NEG: case IROp::NOT:
+        case IROp::EQ: case IROp::NE: case IROp::LT: case IROp::LE: case IROp::GT: case IROp::GE:
+        case IROp::TO_FLOAT:
+            break;
+        default:
+            return false;
+        }
+        Value operands[2];
+        for(size_t i = 0; i < instruction.operands.size(); ++i)
+        {
+            const IRInstruction& operand{ function.instruction(find(instruction.operands[i])) };
+            if(!hasValue(operand))
+                return false;
+            operands[i] = constantValue(operand);
+        }
+
+        Value result;
+        switch(instruction.op)
+        {
+        case IROp::NEG:
+            result = operands[0].type == ValueType::INT
+                ? Value::makeInt(static_cast<int64_t>(0 - static_cast<uint64_t>(operands[0].integer)))
+                : Value::makeFloat(-operands[0].number);
+            break;
+        case IROp::NOT: result = Value::makeBool(!operands[0].boolean); break;
+        case IROp::TO_FLOAT: result = Value::makeFloat(operands[0].asFloat()); break;
+        case IROp::EQ: result = Value::makeBool(operands[0] == operands[1]); break;
+        case IROp::NE: result = Value::makeBool(operands[0] != operands[1]); break;
+        default:
+            if(!ConstantFolder::evaluate(binaryOperator(instruction.op), operands[0], operands[1], result))
+                return false;
+            break;
+        }
+        makeConstant(instruction, result);
+        return true;
+    }
+
+    bool IRFolder::foldPhi(IRFunction& function, IRInstruction& phi)
+    {
+        // A phi merging one value besides itself is that value, one merging
+        // equal constants is that constant
+        ValueId same{ NoId };
+        bool single{ true };
+        bool constants{ true };
+        for(const ValueId operand : phi.operands)
+        {
+            const ValueId value{ find(operand) };
+            if(value == phi.id)
+                continue;
+            if(same == NoId)
+                same = value;
+            else if(value != same)
+                single = false;
+            if(!sameConstant(function.instruction(same), function.instruction(value)))
+                constants = false;
+        }
+        if(same == NoId)
+            return false;
+        if(single)
+        {
+            m_Replacement[phi.id] = same;
+            return true;
+        }
+        if(!constants)
+            return false;
+        const IRInstruction& constant{ function.instruction(same) };
+        phi.op = IROp::CONSTANT;
+        phi.operands = {};
+        phi.constant = constant.constant;
+        phi.text = constant.text;
+        return true;
+    }
+
+    bool IRFolder::foldBranch(IRFunction& function, BlockId block)
+    {
+        IRInstruction& branch{ function.instruction(function.blocks[block].instructions.back()) };
+        if(branch.op != IROp::BRANCH)
+            return false;
+        const IRInstruction& condition{ function.instruction(find(branch.operands[0])) };
+        if(condition.op != IROp::CONSTANT)
+            return false;
+        const BlockId taken{ condition.constant.boolean ? branch.immediate[0] : branch.immediate[1] };
+        const BlockId dropped{ condition.constant.boolean ? branch.immediate[1] : branch.immediate[0] };
+        branch.op = IROp::JUMP;
+        branch.operands = {};
+        branch.immediate[0] = taken;
+        branch.immediate[1] = NoId;
+        removeEdge(function, block, dropped);
+        return true;
+    }
+
+    bool IRFolder::removeUnreachable(IRFunction& function)
+    {
+        std::vector<bool> reachable(function.blocks.size());
+        std::vector<BlockId> work{ 0 };
+        reachable[0] = true;
+        while(!work.empty())
+        {
+            const BlockId block{ work.back() };
+            work.pop_back();
+            for(const BlockId successor : function.successors(block))
+            {
+                if(!reachable[successor])
+                {
+                    reachable[successor] = true;
+                    work.push_back(successor);
+                }
+            }
+        }
+        if(std::find(reachable.begin(), reachable.end(), false) == reachable.end())
+            return false;
+
+        for(BlockId block = 0; block < function.blocks.size(); ++block)
+        {
+            if(reachable[block])
+                continue;
+            for(const BlockId successor : function.successors(block))
+            {
+                if(reachable[successor])
+                    removeEdge(function, block, successor);
+            }
+        }
+        // Renumber the blocks that are left, in their order
+        std::vector<BlockId> renumbered(function.blocks.size(), NoId);
+        std::vector<IRBlock> blocks;
+        for(BlockId block = 0; block < function.blocks.size(); ++block)
+        {
+            if(!reachable[block])
+                continue;
+            renumbered[block] = static_cast<BlockId>(blocks.size());
+            blocks.push_back(std::move(function.blocks[block]));
+        }
+        for(IRBlock& block : blocks)
+        {
+            for(BlockId& predecessor : block.predecessors)
+                predecessor = renumbered[predecessor];
+            for(const ValueId id : block.instructions)
+            {
+                IRInstruction& instruction{ function.instruction(id) };
+                instruction.block = renumbered[instruction.block];
+                if(instruction.op == IROp::JUMP || instruction.op == IROp::BRANCH)
+                    instruction.immediate[0] = renumbered[instruction.immediate[0]];
+                if(instruction.op == IROp::BRANCH)
+                    instruction.immediate[1] = renumbered[instruction.immediate[1]];
+            }
+        }
+        function.blocks = std::move(blocks);
+        return true;
+    }
+
+    void IRFolder::removeEdge(IRFunction& function, BlockId from, BlockId to)
+    {
+        IRBlock& target{ function.blocks[to] };
+        const auto position = std::find(target.predecessors.begin(), target.predecessors.end(), from);
+        const auto index = static_cast<size_t>(position - target.predecessors.begin());
+        target.predecessors.erase(position);
+        for(const ValueId id : target.instructions)
+        {
+            IRInstruction& phi{ function.instruction(id) };
+            if(phi.op != IROp::PHI)
+                break;
+            std::copy(phi.operands.begin() + index + 1, phi.operands.end(), phi.operands.begin() + index);
+            phi.operands = AstSpan<ValueId>(phi.operands.data(), phi.operands.size() - 1);
+        }
+    }
+
+    void IRFolder::removeUnused(IRFunction& function)
+    {
+        std::vector<ValueId> replacement(function.instructions.size(), NoId);
+        std::vector<uint32_t> uses(function.instructions.size());
+        for(const IRBlock& block : function.blocks)
+        {
+            for(const ValueId id : block.instructions)
+            {
+                replacement[id] = find(id);
+                if(replacement[id] != id)
+                    continue;
+                for(const ValueId operand : function.instruction(id).operands)
+                {
+                    if(find(operand) != id)
+                        ++uses[find(operand)];
+                }
+            }
+        }
+        // Removing a value can leave its operands without uses
+        std::vector<ValueId> work;
+        for(ValueId id = 0; id < function.instructions.size(); ++id)
+        {
+            if(replacement[id] == id && uses[id] == 0 && isRemovable(function.instruction(id)))
+                work.push_back(id);
+        }
+        while(!work.empty())
+        {
+            const ValueId id{ work.back() };
+            work.pop_back();
+            replacement[id] = NoId;
+            for(const ValueId operand : function.instruction(id).operands)
+            {
+                const ValueId value{ find(operand) };
+                if(value != id && --uses[value] == 0 && isRemovable(function.instruction(value)))
+                    work.push_back(value);
+            }
+        }
+        function.renumber(replacement);
+    }
+
+    ValueId IRFolder::find(ValueId value) const
+    {
+        while(m_Replacement[value] != value)
+            value = m_Replacement[value];
+        return value;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include "IR.h"
+
+namespace BBTCompiler
+{
+    // Folds the constants of an IRModule the IRGenerator made. SSA values
+    // carry constants from their definitions to every use, so unlike the
+    // ConstantFolder on the AST this also folds through variables, as in
+    // `let n : int = 4; print n * 2;`. Arithmetic and comparisons of
+    // constants become constants, with the ConstantFolder's semantics, and
+    // so do phis merging one constant; operations that fail at runtime are
+    // kept. Branches on a constant become jumps, and blocks no longer
+    // reached are removed with their edges and phi operands. Last, values
+    // without uses are removed and the ids renumbered.
+    class IRFolder
+    {
+    public:
+        void fold(IRModule& module);
+    private:
+        void fold(IRFunction& function);
+        // Return whether anything changed
+        bool foldValue(IRFunction& function, IRInstruction& instruction);
+        bool foldPhi(IRFunction& function, IRInstruction& phi);
+        bool foldBranch(IRFunction& function, BlockId block);
+        bool removeUnreachable(IRFunction& function);
+        // Removes the edge and the operands phis of `to` have for it
+        void removeEdge(IRFunction& function, BlockId from, BlockId to);
+        void removeUnused(IRFunction& function);
+        // The value that replaces `value`, itself if it was not replaced
+        ValueId find(ValueId value) const;
+    private:
+        std::vector<ValueId> m_Replacement;
+    };
+}
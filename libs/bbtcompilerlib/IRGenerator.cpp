@@ -0,0 +1,787 @@
+#include "IRGenerator.h"
+#include "ASTWalker.h"
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <numeric>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        constexpr std::string_view SyntaxErrorMessage{ "Cannot compile code with a syntax error." };
+
+        // Marks the slots of a function that its nested functions use. `level`
+        // counts the functions entered, a binding refers to the function's
+        // frame when its depth equals that count.
+        struct CaptureWalk
+        {
+            std::vector<bool>& captured;
+            uint32_t level;
+
+            void use(const Binding& binding) const
+            {
+                if(level > 0 && binding.depth == level && binding.slot < captured.size())
+                    captured[binding.slot] = true;
+            }
+            void walk(const Expr* expr) const
+            {
+                if(expr)
+                    visitAst(*expr, *this);
+            }
+            void walk(const Stmt* stmt) const
+            {
+                if(stmt)
+                    visitAst(*stmt, *this);
+            }
+
+            void operator()(const AssignmentExpr& expr) const { use(expr.m_Binding); walk(expr.m_Value); }
+            void operator()(const BinaryExpr& expr) const { walk(expr.m_Left); walk(expr.m_Right); }
+            void operator()(const UnaryExpr& expr) const { walk(expr.m_Right); }
+            void operator()(const GroupedExpr& expr) const { walk(expr.m_Expression); }
+            void operator()(const LiteralExpr&) const {}
+            void operator()(const VariableExpr& expr) const { use(expr.m_Binding); }
+            void operator()(const CallExpr& expr) const
+            {
+                walk(expr.m_Callee);
+                for(const Expr* argument : expr.m_Args)
+                    walk(argument);
+            }
+            void operator()(const ErrorExpr&) const {}
+
+            void operator()(const PrintStmt& stmt) const { walk(stmt.m_Expression); }
+            void operator()(const ExprStmt& stmt) const { walk(stmt.m_Expression); }
+            void operator()(const VariableStmt& stmt) const { walk(stmt.m_Initializer); }
+            void operator()(const BlockStmt& stmt) const
+            {
+                for(const Stmt* statement : stmt.m_Statements)
+                    walk(statement);
+            }
+            void operator()(const IfStmt& stmt) const
+            {
+                walk(stmt.m_Condition);
+                walk(stmt.m_ThenBranch);
+                walk(stmt.m_ElseBranch);
+            }
+            void operator()(const WhileStmt& stmt) const { walk(stmt.m_Condition); walk(stmt.m_Body); }
+            void operator()(const FuncStmt& stmt) const
+            {
+                const CaptureWalk nested{ captured, level + 1 };
+                for(const Stmt* statement : stmt.m_Body)
+                    nested.walk(statement);
+            }
+            void operator()(const ReturnStmt& stmt) const { walk(stmt.m_Value); }
+            void operator()(const ErrorStmt&) const {}
+        };
+
+        bool arithmeticOp(TokenType type, IROp& op)
+        {
+            switch(type)
+            {
+            case TokenType::PLUS: op = IROp::ADD; return true;
+            case TokenType::MINUS: op = IROp::SUB; return true;
+            case TokenType::STAR: op = IROp::MUL; return true;
+            case TokenType::SLASH: op = IROp::DIV; return true;
+            default: return false;
+            }
+        }
+
+        bool comparisonOp(TokenType type, IROp& op)
+        {
+            switch(type)
+            {
+            case TokenType::EQ_EQ: op = IROp::EQ; return true;
+            case TokenType::NOT_EQ: op = IROp::NE; return true;
+            case TokenType::LESS: op = IROp::LT; return true;
+            case TokenType::LESS_EQ: op = IROp::LE; return true;
+            case TokenType::GREATER: op = IROp::GT; return true;
+            case TokenType::GREATER_EQ: op = IROp::GE; return true;
+            default: return false;
+            }
+        }
+
+        bool isNumber(ExprType type)
+        {
+            return type == ExprType::INT || type == ExprType::FLOAT;
+        }
+    }
+
+    struct IRGeneratorWalk
+    {
+        IRGenerator& generator;
+
+        ValueId operator()(const AssignmentExpr& expr) const
+        {
+            const ValueId value{ generator.lower(*expr.m_Value) };
+            const IRGenerator::Slot* slot{ generator.slot(expr.m_Binding, expr.m_Name) };
+            if(!slot || value == NoId)
+                return NoId;
+            if(expr.m_Binding.depth > 0 || slot->captured)
+            {
+                IRInstruction& store{ generator.current().instruction(
+                    generator.emit(IROp::STORE, IRType::VOID, { value }, expr.m_Name)) };
+                store.immediate[0] = expr.m_Binding.depth;
+                store.immediate[1] = expr.m_Binding.slot;
+            }
+            else
+            {
+                generator.writeVariable(expr.m_Binding.slot, generator.state().current, value);
+            }
+            return value;
+        }
+        ValueId operator()(const BinaryExpr& expr) const { return generator.lowerBinary(expr); }
+        ValueId operator()(const UnaryExpr& expr) const
+        {
+            const ValueId operand{ generator.lower(*expr.m_Right) };
+            if(operand == NoId)
+                return NoId;
+            if(expr.m_Operator.type == TokenType::NOT)
+                return generator.emit(IROp::NOT, IRType::BOOL, { generator.truth(operand) }, expr.m_Operator);
+            return generator.emit(IROp::NEG, IRGenerator::irType(expr.getType()), { operand }, expr.m_Operator);
+        }
+        ValueId operator()(const GroupedExpr& expr) const { return generator.lower(*expr.m_Expression); }
+        ValueId operator()(const LiteralExpr& expr) const
+        {
+            const Token& token{ expr.m_Token };
+            const char* begin{ token.value.data() };
+            const char* end{ begin + token.value.size() };
+            switch(token.type)
+            {
+            case TokenType::TRUE:
+            case TokenType::FALSE:
+            {
+                IRInstruction& constant{ generator.constant(IRType::BOOL, token) };
+                constant.constant.boolean = token.type == TokenType::TRUE;
+                return constant.id;
+            }
+            case TokenType::INT_LITERAL:
+            {
+                int64_t value{ 0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    return generator.error(token, "Integer literal '{}' is too large.", token.value, DiagnosticKind::SYNTAX);
+                IRInstruction& constant{ generator.constant(IRType::INT, token) };
+                constant.constant.integer = value;
+                return constant.id;
+            }
+            case TokenType::FLOAT_LITERAL:
+            {
+                double value{ 0.0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    value = std::numeric_limits<double>::infinity();
+                IRInstruction& constant{ generator.constant(IRType::FLOAT, token) };
+                constant.constant.number = value;
+                return constant.id;
+            }
+            case TokenType::STRING_LITERAL:
+            {
+                IRInstruction& constant{ generator.constant(IRType::CHAR, token) };
+                // Never null, even for an empty literal
+                constant.text = token.value.data() ? token.value : std::string_view{ "" };
+                return constant.id;
+            }
+            default:
+                return generator.error(token, "'{}' is not supported in the IR.", token.value);
+            }
+        }
+        ValueId operator()(const VariableExpr& expr) const
+        {
+            const IRGenerator::Slot* slot{ generator.slot(expr.m_Binding, expr.m_Name) };
+            if(!slot)
+                return NoId;
+            if(expr.m_Binding.depth == 0 && !slot->captured)
+                return generator.readVariable(expr.m_Binding.slot, generator.state().current);
+            IRInstruction& load{ generator.current().instruction(
+                generator.emit(IROp::LOAD, IRGenerator::irType(expr.getType()), {}, expr.m_Name)) };
+            load.immediate[0] = expr.m_Binding.depth;
+            load.immediate[1] = expr.m_Binding.slot;
+            return load.id;
+        }
+        ValueId operator()(const CallExpr& expr) const { return generator.lowerCall(expr); }
+        ValueId operator()(const ErrorExpr& expr) const
+        {
+            return generator.error(expr.m_Token, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+        }
+
+        void operator()(const PrintStmt& stmt) const
+        {
+            const ValueId value{ generator.lower(*stmt.m_Expression) };
+            if(value != NoId)
+                generator.emit(IROp::PRINT, IRType::VOID, { value });
+        }
+        void operator()(const ExprStmt& stmt) const { generator.lower(*stmt.m_Expression); }
+        void operator()(const VariableStmt& stmt) const
+        {
+            const IRType type{ IRGenerator::declaredType(stmt.m_Type) };
+            ValueId value{ NoId };
+            if(stmt.m_Initializer)
+            {
+                value = generator.lower(*stmt.m_Initializer);
+                if(value == NoId)
+                    return;
+            }
+            else
+            {
+                // Zero, or null text for char
+                value = generator.constant(type, stmt.m_Name).id;
+            }
+            if(stmt.m_Slot == Binding::Unresolved)
+            {
+                generator.error(stmt.m_Name, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+                return;
+            }
+            IRGenerator::Slot& slot{ generator.state().slots[stmt.m_Slot] };
+            slot.type = type;
+            slot.declared = true;
+            if(slot.captured)
+            {
+                IRInstruction& store{ generator.current().instruction(
+                    generator.emit(IROp::STORE, IRType::VOID, { value }, stmt.m_Name)) };
+                store.immediate[0] = 0;
+                store.immediate[1] = stmt.m_Slot;
+            }
+            else
+            {
+                generator.writeVariable(stmt.m_Slot, generator.state().current, value);
+            }
+        }
+        void operator()(const BlockStmt& stmt) const
+        {
+            generator.lowerBlock(AstSpan<Stmt* const>(stmt.m_Statements.data(), stmt.m_Statements.size()));
+        }
+        void operator()(const IfStmt& stmt) const
+        {
+            const ValueId condition{ generator.lower(*stmt.m_Condition) };
+            if(condition == NoId)
+                return;
+            const BlockId thenBlock{ generator.newBlock() };
+            const BlockId elseBlock{ generator.newBlock() };
+            generator.branch(generator.truth(condition), thenBlock, elseBlock);
+            generator.sealBlock(thenBlock);
+            generator.state().current = thenBlock;
+            if(stmt.m_ThenBranch)
+                generator.lower(*stmt.m_ThenBranch);
+            if(!stmt.m_ElseBranch)
+            {
+                // The else block is where both paths meet
+                if(generator.state().current != NoId)
+                    generator.jump(elseBlock);
+                generator.sealBlock(elseBlock);
+                generator.state().current = elseBlock;
+                return;
+            }
+            const BlockId thenEnd{ generator.state().current };
+            generator.sealBlock(elseBlock);
+            generator.state().current = elseBlock;
+            generator.lower(*stmt.m_ElseBranch);
+            const BlockId elseEnd{ generator.state().current };
+            if(thenEnd == NoId && elseEnd == NoId)
+                return;
+            const BlockId join{ generator.newBlock() };
+            for(const BlockId end : { thenEnd, elseEnd })
+            {
+                if(end == NoId)
+                    continue;
+                generator.state().current = end;
+                generator.jump(join);
+            }
+            generator.sealBlock(join);
+            generator.state().current = join;
+        }
+        void operator()(const WhileStmt& stmt) const
+        {
+            // The header is sealed after the body, when the back edge is known
+            const BlockId header{ generator.newBlock() };
+            generator.jump(header);
+            generator.state().current = header;
+            const ValueId condition{ generator.lower(*stmt.m_Condition) };
+            const BlockId body{ generator.newBlock() };
+            const BlockId exit{ generator.newBlock() };
+            if(condition == NoId)
+            {
+                // Keeps the blocks well formed while errors are collected
+                generator.jump(exit);
+                generator.sealBlock(header);
+                generator.sealBlock(body);
+                generator.sealBlock(exit);
+                generator.state().current = exit;
+                return;
+            }
+            generator.branch(generator.truth(condition), body, exit);
+            generator.sealBlock(body);
+            generator.state().current = body;
+            if(stmt.m_Body)
+                generator.lower(*stmt.m_Body);
+            if(generator.state().current != NoId)
+                generator.jump(header);
+            generator.sealBlock(header);
+            generator.sealBlock(exit);
+            generator.state().current = exit;
+        }
+        // Lowered after the enclosing block, see lowerBlock
+        void operator()(const FuncStmt&) const {}
+        void operator()(const ReturnStmt& stmt) const
+        {
+            ValueId value{ NoId };
+            if(stmt.m_Value)
+            {
+                value = generator.lower(*stmt.m_Value);
+                if(value == NoId)
+                    return;
+            }
+            // The top level may return anything, its value is dropped
+            if(generator.current().declaration == nullptr || value == NoId)
+                generator.emit(IROp::RETURN, IRType::VOID, {}, stmt.m_ReturnToken);
+            else
+                generator.emit(IROp::RETURN, IRType::VOID, { value }, stmt.m_ReturnToken);
+            generator.state().current = NoId;
+        }
+        void operator()(const ErrorStmt& stmt) const
+        {
+            generator.error(stmt.m_Token, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+        }
+    };
+
+    bool IRGenerator::generate(const std::vector<Stmt*>& statements, uint32_t frameSize)
+    {
+        m_Diagnostics.clear();
+        m_Module = IRModule{};
+        m_Functions.clear();
+        IRFunction script;
+        script.name = "<script>";
+        script.frameSize = frameSize;
+        m_Module.functions.push_back(std::move(script));
+        lowerFunction(nullptr, AstSpan<Stmt* const>(statements.data(), statements.size()), 0, frameSize);
+        return !m_Diagnostics.hasErrors();
+    }
+
+    uint32_t IRGenerator::declareFunction(const FuncStmt& declaration)
+    {
+        IRFunction function;
+        function.name = declaration.m_Name.value;
+        function.declaration = &declaration;
+        if(declaration.m_ReturnType.type != TokenType::INVALID)
+            function.returnType = declaredType(declaration.m_ReturnType);
+        for(const auto& [name, type] : declaration.m_Params)
+            function.parameters.push_back(declaredType(type));
+        function.frameSize = std::max(declaration.m_FrameSize, static_cast<uint32_t>(declaration.m_Params.size()));
+        const auto index = static_cast<uint32_t>(m_Module.functions.size());
+        m_Module.functions.push_back(std::move(function));
+        m_Module.addFunction(&declaration, index);
+        return index;
+    }
+
+    void IRGenerator::lowerFunction(const FuncStmt* declaration, AstSpan<Stmt* const> body, uint32_t function, uint32_t frameSize)
+    {
+        m_Functions.push_back(FunctionState{ function });
+        state().slots.resize(frameSize);
+        std::vector<bool> captured(frameSize);
+        const CaptureWalk walk{ captured, 0 };
+        for(const Stmt* statement : body)
+            walk.walk(statement);
+        for(uint32_t slot = 0; slot < frameSize; ++slot)
+            state().slots[slot].captured = captured[slot];
+
+        const BlockId entry{ newBlock() };
+        sealBlock(entry);
+        state().current = entry;
+        for(uint32_t i = 0; declaration && i < declaration->m_Params.size(); ++i)
+        {
+            const IRType type{ current().parameters[i] };
+            const Token& name{ declaration->m_Params[i].first };
+            IRInstruction& parameter{ current().instruction(emit(IROp::PARAMETER, type, {}, name)) };
+            parameter.immediate[0] = i;
+            const ValueId value{ parameter.id };
+            Slot& slot{ state().slots[i] };
+            slot.type = type;
+            slot.declared = true;
+            if(slot.captured)
+            {
+                IRInstruction& store{ current().instruction(emit(IROp::STORE, IRType::VOID, { value }, name)) };
+                store.immediate[0] = 0;
+                store.immediate[1] = i;
+            }
+            else
+            {
+                writeVariable(i, entry, value);
+            }
+        }
+
+        lowerBlock(body);
+        if(state().current != NoId)
+        {
+            if(current().returnType == IRType::VOID)
+                emit(IROp::RETURN, IRType::VOID);
+            else
+                emit(IROp::RETURN, IRType::VOID, { constant(current().returnType).id });
+        }
+        simplify(current());
+        m_Functions.pop_back();
+    }
+
+    void IRGenerator::lowerBlock(AstSpan<Stmt* const> statements)
+    {
+        // Functions of the block can be called before their declaration,
+        // like the Resolver declares them. Their bodies are lowered after
+        // the block, when the variables they can see have their types.
+        std::vector<std::pair<const FuncStmt*, uint32_t>> functions;
+        size_t lastFunction{ 0 };
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::FUNCTION)
+                continue;
+            lastFunction = i;
+            const auto& function = static_cast<const FuncStmt&>(*statements[i]);
+            if(function.m_Slot == Binding::Unresolved)
+                continue;
+            const uint32_t index{ declareFunction(function) };
+            Slot& slot{ state().slots[function.m_Slot] };
+            slot.function = index;
+            slot.declared = true;
+            functions.emplace_back(&function, index);
+        }
+        // A call to one of them can load a variable declared ahead of the
+        // function before the variable's declaration runs, so the variable
+        // starts with its default value. Only captured variables are read
+        // by other functions.
+        for(size_t i = 0; i < lastFunction; ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::VARIABLE)
+                continue;
+            const auto& variable = static_cast<const VariableStmt&>(*statements[i]);
+            const IRType type{ declaredType(variable.m_Type) };
+            if(variable.m_Slot == Binding::Unresolved || type == IRType::VOID || !state().slots[variable.m_Slot].captured)
+                continue;
+            IRInstruction& store{ current().instruction(
+                emit(IROp::STORE, IRType::VOID, { constant(type, variable.m_Name).id }, variable.m_Name)) };
+            store.immediate[0] = 0;
+            store.immediate[1] = variable.m_Slot;
+        }
+        for(const Stmt* statement : statements)
+        {
+            // The rest of the block follows a return and is never run
+            if(state().current == NoId)
+                break;
+            lower(*statement);
+        }
+        for(const auto& [function, index] : functions)
+        {
+            lowerFunction(function, AstSpan<Stmt* const>(function->m_Body.data(), function->m_Body.size()), index,
+                          m_Module.functions[index].frameSize);
+        }
+    }
+
+    void IRGenerator::lower(const Stmt& stmt)
+    {
+        visitAst(stmt, IRGeneratorWalk{ *this });
+    }
+
+    ValueId IRGenerator::lower(const Expr& expr)
+    {
+        return visitAst(expr, IRGeneratorWalk{ *this });
+    }
+
+    ValueId IRGenerator::lowerBinary(const BinaryExpr& expr)
+    {
+        const Token& op{ expr.m_Operator };
+        if(op.type == TokenType::AND || op.type == TokenType::OR)
+            return lowerLogical(expr);
+
+        ValueId left{ lower(*expr.m_Left) };
+        ValueId right{ lower(*expr.m_Right) };
+        if(left == NoId || right == NoId)
+            return NoId;
+        IROp irOp{};
+        if(!arithmeticOp(op.type, irOp) && !comparisonOp(op.type, irOp))
+            return error(op, "Unsupported operator '{}'.", op.value);
+        const ExprType leftType{ expr.m_Left->getType() };
+        const ExprType rightType{ expr.m_Right->getType() };
+        // The TypeChecker lets two chars concatenate
+        if(expr.getType() == ExprType::CHAR)
+            return error(op, "'{}' on strings is not supported in the IR.", op.value);
+        if(isNumber(leftType) && isNumber(rightType) && leftType != rightType)
+        {
+            left = toFloat(left);
+            right = toFloat(right);
+        }
+        return emit(irOp, irType(expr.getType()), { left, right }, op);
+    }
+
+    ValueId IRGenerator::lowerLogical(const BinaryExpr& expr)
+    {
+        // The result is a phi of the left operand, when it decides, and the
+        // right one
+        const Token& op{ expr.m_Operator };
+        const ValueId leftValue{ lower(*expr.m_Left) };
+        if(leftValue == NoId)
+            return NoId;
+        const ValueId left{ truth(leftValue) };
+        const BlockId rightBlock{ newBlock() };
+        const BlockId join{ newBlock() };
+        if(op.type == TokenType::AND)
+            branch(left, rightBlock, join);
+        else
+            branch(left, join, rightBlock);
+        sealBlock(rightBlock);
+        state().current = rightBlock;
+        const ValueId rightValue{ lower(*expr.m_Right) };
+        const ValueId right{ rightValue == NoId ? NoId : truth(rightValue) };
+        jump(join);
+        sealBlock(join);
+        state().current = join;
+        if(right == NoId)
+            return NoId;
+        const ValueId phi{ insertPhi(join, IRType::BOOL) };
+        IRInstruction& instruction{ current().instruction(phi) };
+        const ValueId incoming[]{ left, right };
+        instruction.operands = m_Module.getArena().copyArray(incoming, 2);
+        return phi;
+    }
+
+    ValueId IRGenerator::lowerCall(const CallExpr& expr)
+    {
+        if(expr.m_Callee->getKind() != ExprKind::VARIABLE)
+            return error(expr.m_Paren, "Only functions can be called, by their name.");
+        const auto& callee = static_cast<const VariableExpr&>(*expr.m_Callee);
+        const Slot* slot{ this->slot(callee.m_Binding, callee.m_Name) };
+        if(!slot || slot->function == NoId)
+            return NoId;
+        const uint32_t function{ slot->function };
+        std::vector<ValueId> arguments;
+        for(const Expr* argument : expr.m_Args)
+        {
+            arguments.push_back(lower(*argument));
+            if(arguments.back() == NoId)
+                return NoId;
+        }
+        IRInstruction& call{ current().instruction(
+            emit(IROp::CALL, irType(expr.getType()), arguments, expr.m_Paren)) };
+        call.immediate[0] = function;
+        return call.id;
+    }
+
+    ValueId IRGenerator::truth(ValueId value)
+    {
+        if(typeOf(value) == IRType::BOOL)
+            return value;
+        IRInstruction& constant{ this->constant(IRType::BOOL) };
+        constant.constant.boolean = true;
+        return constant.id;
+    }
+
+    ValueId IRGenerator::toFloat(ValueId value)
+    {
+        if(typeOf(value) == IRType::FLOAT)
+            return value;
+        return emit(IROp::TO_FLOAT, IRType::FLOAT, { value }, current().instruction(value).token);
+    }
+
+    IRGenerator::Slot* IRGenerator::slot(const Binding& binding, const Token& name)
+    {
+        if(!binding.isResolved() || binding.depth >= m_Functions.size())
+        {
+            error(name, "Undefined name '{}'.", name.value, DiagnosticKind::NAME);
+            return nullptr;
+        }
+        Slot& slot{ m_Functions[m_Functions.size() - 1 - binding.depth].slots[binding.slot] };
+        // Only possible for a name whose declaration had an error
+        if(!slot.declared)
+            return nullptr;
+        return &slot;
+    }
+
+    void IRGenerator::writeVariable(uint32_t slot, BlockId block, ValueId value)
+    {
+        std::vector<ValueId>& definitions{ state().definitions[block] };
+        if(definitions.empty())
+            definitions.assign(state().slots.size(), NoId);
+        definitions[slot] = value;
+    }
+
+    ValueId IRGenerator::readVariable(uint32_t slot, BlockId block)
+    {
+        const std::vector<ValueId>& definitions{ state().definitions[block] };
+        if(!definitions.empty() && definitions[slot] != NoId)
+            return definitions[slot];
+        return readVariableRecursive(slot, block);
+    }
+
+    ValueId IRGenerator::readVariableRecursive(uint32_t slot, BlockId block)
+    {
+        const IRType type{ state().slots[slot].type };
+        ValueId value{ NoId };
+        if(!state().sealed[block])
+        {
+            value = insertPhi(block, type);
+            state().incompletePhis[block].emplace_back(slot, value);
+        }
+        else if(current().blocks[block].predecessors.empty())
+        {
+            IRInstruction& undefined{ create(IROp::UNDEFINED, type, nullptr, 0, {}) };
+            undefined.block = block;
+            std::vector<ValueId>& code{ current().blocks[block].instructions };
+            code.insert(code.begin(), undefined.id);
+            value = undefined.id;
+        }
+        else if(current().blocks[block].predecessors.size() == 1)
+        {
+            value = readVariable(slot, current().blocks[block].predecessors[0]);
+        }
+        else
+        {
+            // Defined before the operands are read, so loops end at the phi
+            value = insertPhi(block, type);
+            writeVariable(slot, block, value);
+            addPhiOperands(slot, value);
+        }
+        writeVariable(slot, block, value);
+        return value;
+    }
+
+    void IRGenerator::addPhiOperands(uint32_t slot, ValueId phi)
+    {
+        const BlockId block{ current().instruction(phi).block };
+        const std::vector<BlockId> predecessors{ current().blocks[block].predecessors };
+        std::vector<ValueId> operands;
+        for(const BlockId predecessor : predecessors)
+            operands.push_back(readVariable(slot, predecessor));
+        current().instruction(phi).operands = m_Module.getArena().copyArray(operands.data(), operands.size());
+    }
+
+    void IRGenerator::sealBlock(BlockId block)
+    {
+        const auto phis{ std::move(state().incompletePhis[block]) };
+        state().incompletePhis[block].clear();
+        for(const auto& [slot, phi] : phis)
+            addPhiOperands(slot, phi);
+        state().sealed[block] = true;
+    }
+
+    void IRGenerator::simplify(IRFunction& function)
+    {
+        // A phi whose operands are one value besides itself is that value.
+        // Replacing it can make phis that use it trivial, so repeat until
+        // nothing changes.
+        const size_t count{ function.instructions.size() };
+        std::vector<ValueId> replacement(count);
+        std::iota(replacement.begin(), replacement.end(), 0);
+        const auto find = [&](ValueId value) {
+            while(replacement[value] != value)
+                value = replacement[value];
+            return value;
+        };
+        for(bool changed = true; changed;)
+        {
+            changed = false;
+            for(IRInstruction* instruction : function.instructions)
+            {
+                if(instruction->op != IROp::PHI || replacement[instruction->id] != instruction->id)
+                    continue;
+                ValueId same{ NoId };
+                bool trivial{ true };
+                for(const ValueId operand : instruction->operands)
+                {
+                    const ValueId value{ find(operand) };
+                    if(value == same || value == instruction->id)
+                        continue;
+                    if(same != NoId)
+                    {
+                        trivial = false;
+                        break;
+                    }
+                    same = value;
+                }
+                if(trivial && same != NoId)
+                {
+                    replacement[instruction->id] = same;
+                    changed = true;
+                }
+            }
+        }
+
+        for(ValueId& value : replacement)
+            value = find(value);
+        function.renumber(replacement);
+    }
+
+    BlockId IRGenerator::newBlock()
+    {
+        FunctionState& function{ state() };
+        function.definitions.emplace_back();
+        function.sealed.push_back(false);
+        function.incompletePhis.emplace_back();
+        current().blocks.emplace_back();
+        return static_cast<BlockId>(current().blocks.size() - 1);
+    }
+
+    IRInstruction& IRGenerator::create(IROp op, IRType type, const ValueId* operands, size_t count, const Token& token)
+    {
+        IRInstruction* instruction{ m_Module.getArena().create<IRInstruction>() };
+        instruction->op = op;
+        instruction->type = type;
+        instruction->id = static_cast<ValueId>(current().instructions.size());
+        instruction->operands = m_Module.getArena().copyArray(operands, count);
+        instruction->token = token;
+        current().instructions.push_back(instruction);
+        return *instruction;
+    }
+
+    ValueId IRGenerator::emit(IROp op, IRType type, const std::vector<ValueId>& operands, const Token& token)
+    {
+        IRInstruction& instruction{ create(op, type, operands.data(), operands.size(), token) };
+        instruction.block = state().current;
+        current().blocks[state().current].instructions.push_back(instruction.id);
+        return instruction.id;
+    }
+
+    IRInstruction& IRGenerator::constant(IRType type, const Token& token)
+    {
+        return current().instruction(emit(IROp::CONSTANT, type, {}, token));
+    }
+
+    ValueId IRGenerator::insertPhi(BlockId block, IRType type)
+    {
+        IRInstruction& phi{ create(IROp::PHI, type, nullptr, 0, {}) };
+        phi.block = block;
+        std::vector<ValueId>& code{ current().blocks[block].instructions };
+        const auto position = std::find_if(code.begin(), code.end(),
+            [&](ValueId id) { return current().instruction(id).op != IROp::PHI; });
+        code.insert(position, phi.id);
+        return phi.id;
+    }
+
+    void IRGenerator::jump(BlockId target)
+    {
+        IRInstruction& instruction{ current().instruction(emit(IROp::JUMP, IRType::VOID)) };
+        instruction.immediate[0] = target;
+        current().blocks[target].predecessors.push_back(state().current);
+        state().current = NoId;
+    }
+
+    void IRGenerator::branch(ValueId condition, BlockId thenBlock, BlockId elseBlock)
+    {
+        IRInstruction& instruction{ current().instruction(emit(IROp::BRANCH, IRType::VOID, { condition })) };
+        instruction.immediate[0] = thenBlock;
+        instruction.immediate[1] = elseBlock;
+        current().blocks[thenBlock].predecessors.push_back(state().current);
+        current().blocks[elseBlock].predecessors.push_back(state().current);
+        state().current = NoId;
+    }
+
+    IRType IRGenerator::irType(ExprType type)
+    {
+        switch(type)
+        {
+        case ExprType::INT: return IRType::INT;
+        case ExprType::FLOAT: return IRType::FLOAT;
+        case ExprType::BOOL: return IRType::BOOL;
+        case ExprType::CHAR: return IRType::CHAR;
+        default: return IRType::VOID;
+        }
+    }
+
+    ValueId IRGenerator::error(const Token& token, std::string_view message, std::string_view argument, DiagnosticKind kind)
+    {
+        m_Diagnostics.report(token, message, argument, kind);
+        return NoId;
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Diagnostics.h"
+#include "Expression.h"
+#include "IR.h"
+#include "Statement.h"
+#include "TypeChecker.h"
+
+namespace BBTCompiler
+{
+    // Lowers a program the TypeChecker has checked to the typed SSA form of
+    // IR.h. Instructions get the types the checker stored in the
+    // expressions, see Expr::getType, mixed int and float operands are
+    // converted with TO_FLOAT, and what the checker accepts but the IR has
+    // no values for, null and string concatenation, is reported as a type
+    // error. A function with a return type whose end is reachable in the
+    // IR, like after `while(true)`, returns zero there.
+    //
+    // SSA values are built on the fly while lowering, following Braun et
+    // al., "Simple and Efficient Construction of Static Single Assignment
+    // Form": a variable read looks for the definition in the current block
+    // and then in its predecessors, placing phis where they merge. Loop
+    // headers are sealed once their back edge is known; until then reads in
+    // them get phis whose operands are filled in when sealing. Phis that
+    // turn out to merge a single value are removed afterwards and the ids
+    // renumbered so they are dense again.
+    //
+    // The IRFolder optimizes the IR before `bbtcompiler --ir` prints it. No
+    // backend lowers from it yet, the BytecodeCompiler and the
+    // NativeCodeGenerator still work on the AST.
+    class IRGenerator
+    {
+    public:
+        // `frameSize` is the size the Resolver computed for the top level.
+        // Returns false if the program could not be lowered.
+        bool generate(const std::vector<Stmt*>& statements, uint32_t frameSize);
+        IRModule& getModule() { return m_Module; }
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+    private:
+        struct Slot
+        {
+            IRType type{ IRType::VOID };
+            // Set for function slots, the function in the module
+            uint32_t function{ NoId };
+            // Used by a nested function, so kept in the frame
+            bool captured{ false };
+            bool declared{ false };
+        };
+        // State of the function being lowered
+        struct FunctionState
+        {
+            uint32_t function;
+            // Block new instructions go to, NoId after a return
+            BlockId current{ 0 };
+            std::vector<Slot> slots{};
+            // Current SSA value of each slot, per block
+            std::vector<std::vector<ValueId>> definitions{};
+            std::vector<bool> sealed{};
+            // Phis of unsealed blocks waiting for their operands, and their slots
+            std::vector<std::vector<std::pair<uint32_t, ValueId>>> incompletePhis{};
+        };
+
+        friend struct IRGeneratorWalk;
+        uint32_t declareFunction(const FuncStmt& function);
+        void lowerFunction(const FuncStmt* declaration, AstSpan<Stmt* const> body, uint32_t function, uint32_t frameSize);
+        void lowerBlock(AstSpan<Stmt* const> statements);
+        void lower(const Stmt& stmt);
+        ValueId lower(const Expr& expr);
+        ValueId lowerBinary(const BinaryExpr& expr);
+        ValueId lowerCall(const CallExpr& expr);
+        ValueId lowerLogical(const BinaryExpr& expr);
+        // Condition for a branch: BOOL values as they are, others are true
+        ValueId truth(ValueId value);
+        // Converts an INT operand to FLOAT
+        ValueId toFloat(ValueId value);
+
+        FunctionState& state() { return m_Functions.back(); }
+        IRFunction& current() { return m_Module.functions[state().function]; }
+        IRType typeOf(ValueId value) { return value == NoId ? IRType::VOID : current().instruction(value).type; }
+        // The slot a binding refers to, null after reporting an error
+        Slot* slot(const Binding& binding, const Token& name);
+        void writeVariable(uint32_t slot, BlockId block, ValueId value);
+        ValueId readVariable(uint32_t slot, BlockId block);
+        ValueId readVariableRecursive(uint32_t slot, BlockId block);
+        void addPhiOperands(uint32_t slot, ValueId phi);
+        void sealBlock(BlockId block);
+        // Removes phis that merge one value, then renumbers the instructions
+        void simplify(IRFunction& function);
+
+        BlockId newBlock();
+        IRInstruction& create(IROp op, IRType type, const ValueId* operands, size_t count, const Token& token);
+        // Appends an instruction to the current block
+        ValueId emit(IROp op, IRType type, const std::vector<ValueId>& operands = {}, const Token& token = {});
+        // Appends a constant, zero until the caller sets its value
+        IRInstruction& constant(IRType type, const Token& token = {});
+        ValueId insertPhi(BlockId block, IRType type);
+        void jump(BlockId target);
+        void branch(ValueId condition, BlockId thenBlock, BlockId elseBlock);
+        // The value type of an expression's type, VOID for those without values
+        static IRType irType(ExprType type);
+        static IRType declaredType(const Token& type) { return irType(TypeChecker::declaredType(type)); }
+        ValueId error(const Token& token, std::string_view message, std::string_view argument = {},
+                      DiagnosticKind kind = DiagnosticKind::TYPE);
+    private:
+        IRModule m_Module;
+        Diagnostics m_Diagnostics;
+        std::vector<FunctionState> m_Functions;
+    };
+}
@@ -0,0 +1,361 @@
+#include "Interpreter.h"
+#include "ASTWalker.h"
+#include <algorithm>
+#include <charconv>
+#include <limits>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        // Integer arithmetic wraps around instead of overflowing
+        int64_t wrap(uint64_t value) { return static_cast<int64_t>(value); }
+
+        Value defaultValue(const Token& type)
+        {
+            switch(type.type)
+            {
+            case TokenType::INT: return Value::makeInt(0);
+            case TokenType::FLOAT: return Value::makeFloat(0.0);
+            case TokenType::BOOL: return Value::makeBool(false);
+            default: return Value{};
+            }
+        }
+    }
+
+    struct InterpreterWalk
+    {
+        using Flow = Interpreter::Flow;
+        Interpreter& interpreter;
+
+        Value operator()(const AssignmentExpr& expr) const
+        {
+            const Value value{ interpreter.evaluate(*expr.m_Value) };
+            if(interpreter.failed())
+                return {};
+            Value* slot{ interpreter.slot(expr.m_Binding) };
+            if(!slot)
+                return interpreter.error(expr.m_Name, "Undefined name '{}'.", expr.m_Name.value);
+            *slot = value;
+            return value;
+        }
+        Value operator()(const BinaryExpr& expr) const
+        {
+            const Token& op{ expr.m_Operator };
+            if(op.type == TokenType::AND || op.type == TokenType::OR)
+            {
+                const Value left{ interpreter.evaluate(*expr.m_Left) };
+                if(interpreter.failed() || left.isTruthy() == (op.type == TokenType::OR))
+                    return Value::makeBool(left.isTruthy());
+                return Value::makeBool(interpreter.evaluate(*expr.m_Right).isTruthy());
+            }
+            const Value left{ interpreter.evaluate(*expr.m_Left) };
+            if(interpreter.failed())
+                return {};
+            const Value right{ interpreter.evaluate(*expr.m_Right) };
+            if(interpreter.failed())
+                return {};
+
+            switch(op.type)
+            {
+            case TokenType::EQ_EQ: return Value::makeBool(left == right);
+            case TokenType::NOT_EQ: return Value::makeBool(left != right);
+            case TokenType::PLUS:
+                if(left.type == ValueType::STRING && right.type == ValueType::STRING)
+                    return interpreter.concatenate(left.asString(), right.asString());
+                break;
+            default:
+                break;
+            }
+            if(!left.isNumber() || !right.isNumber())
+            {
+                if(op.type == TokenType::PLUS)
+                    return interpreter.error(op, "Operands of '{}' must be two numbers or two strings.", op.value);
+                return interpreter.error(op, "Operands of '{}' must be numbers.", op.value);
+            }
+
+            if(left.type == ValueType::INT && right.type == ValueType::INT)
+            {
+                const int64_t a{ left.integer };
+                const int64_t b{ right.integer };
+                switch(op.type)
+                {
+                case TokenType::PLUS: return Value::makeInt(wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)));
+                case TokenType::MINUS: return Value::makeInt(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)));
+                case TokenType::STAR: return Value::makeInt(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)));
+                case TokenType::SLASH:
+                    if(b == 0)
+                        return interpreter.error(op, "Division by zero.");
+                    if(b == -1)
+                        return Value::makeInt(wrap(0 - static_cast<uint64_t>(a)));
+                    return Value::makeInt(a / b);
+                case TokenType::LESS: return Value::makeBool(a < b);
+                case TokenType::LESS_EQ: return Value::makeBool(a <= b);
+                case TokenType::GREATER: return Value::makeBool(a > b);
+                case TokenType::GREATER_EQ: return Value::makeBool(a >= b);
+                default: break;
+                }
+            }
+            else
+            {
+                const double a{ left.asFloat() };
+                const double b{ right.asFloat() };
+                switch(op.type)
+                {
+                case TokenType::PLUS: return Value::makeFloat(a + b);
+                case TokenType::MINUS: return Value::makeFloat(a - b);
+                case TokenType::STAR: return Value::makeFloat(a * b);
+                case TokenType::SLASH: return Value::makeFloat(a / b);
+                case TokenType::LESS: return Value::makeBool(a < b);
+                case TokenType::LESS_EQ: return Value::makeBool(a <= b);
+                case TokenType::GREATER: return Value::makeBool(a > b);
+                case TokenType::GREATER_EQ: return Value::makeBool(a >= b);
+                default: break;
+                }
+            }
+            return interpreter.error(op, "Unsupported operator '{}'.", op.value);
+        }
+        Value operator()(const UnaryExpr& expr) const
+        {
+            const Value operand{ interpreter.evaluate(*expr.m_Right) };
+            if(interpreter.failed())
+                return {};
+            if(expr.m_Operator.type == TokenType::NOT)
+                return Value::makeBool(!operand.isTruthy());
+            if(operand.type == ValueType::INT)
+                return Value::makeInt(wrap(0 - static_cast<uint64_t>(operand.integer)));
+            if(operand.type == ValueType::FLOAT)
+                return Value::makeFloat(-operand.number);
+            return interpreter.error(expr.m_Operator, "Operand of '{}' must be a number.", expr.m_Operator.value);
+        }
+        Value operator()(const GroupedExpr& expr) const { return interpreter.evaluate(*expr.m_Expression); }
+        Value operator()(const LiteralExpr& expr) const
+        {
+            const Token& token{ expr.m_Token };
+            const char* begin{ token.value.data() };
+            const char* end{ begin + token.value.size() };
+            switch(token.type)
+            {
+            case TokenType::TRUE: return Value::makeBool(true);
+            case TokenType::FALSE: return Value::makeBool(false);
+            case TokenType::STRING_LITERAL: return Value::makeString(token.value);
+            case TokenType::INT_LITERAL:
+            {
+                int64_t value{ 0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    return interpreter.error(token, "Integer literal '{}' is too large.", token.value);
+                return Value::makeInt(value);
+            }
+            case TokenType::FLOAT_LITERAL:
+            {
+                double value{ 0.0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    value = std::numeric_limits<double>::infinity();
+                return Value::makeFloat(value);
+            }
+            default: return Value{};
+            }
+        }
+        Value operator()(const VariableExpr& expr) const
+        {
+            const Value* slot{ interpreter.slot(expr.m_Binding) };
+            if(!slot)
+                return interpreter.error(expr.m_Name, "Undefined name '{}'.", expr.m_Name.value);
+            return *slot;
+        }
+        Value operator()(const CallExpr& expr) const { return interpreter.call(expr); }
+        Value operator()(const ErrorExpr& expr) const
+        {
+            return interpreter.error(expr.m_Token, "Cannot run code with a syntax error.");
+        }
+
+        Flow operator()(const PrintStmt& stmt) const
+        {
+            const Value value{ interpreter.evaluate(*stmt.m_Expression) };
+            if(interpreter.failed())
+                return Flow::ERROR;
+            interpreter.m_Output << value << '\n';
+            return Flow::NEXT;
+        }
+        Flow operator()(const ExprStmt& stmt) const
+        {
+            interpreter.evaluate(*stmt.m_Expression);
+            return interpreter.failed() ? Flow::ERROR : Flow::NEXT;
+        }
+        Flow operator()(const VariableStmt& stmt) const
+        {
+            const Value value{ stmt.m_Initializer ? interpreter.evaluate(*stmt.m_Initializer) : defaultValue(stmt.m_Type) };
+            if(interpreter.failed())
+                return Flow::ERROR;
+            if(stmt.m_Slot == Binding::Unresolved)
+            {
+                interpreter.error(stmt.m_Name, "Cannot run code with a syntax error.");
+                return Flow::ERROR;
+            }
+            interpreter.m_Stack[interpreter.m_Frames.back().base + stmt.m_Slot] = value;
+            return Flow::NEXT;
+        }
+        Flow operator()(const BlockStmt& stmt) const
+        {
+            return interpreter.executeBlock(AstSpan<Stmt* const>(stmt.m_Statements.data(), stmt.m_Statements.size()));
+        }
+        Flow operator()(const IfStmt& stmt) const
+        {
+            const Value condition{ interpreter.evaluate(*stmt.m_Condition) };
+            if(interpreter.failed())
+                return Flow::ERROR;
+            const Stmt* branch{ condition.isTruthy() ? stmt.m_ThenBranch : stmt.m_ElseBranch };
+            return branch ? interpreter.execute(*branch) : Flow::NEXT;
+        }
+        Flow operator()(const WhileStmt& stmt) const
+        {
+            while(true)
+            {
+                const Value condition{ interpreter.evaluate(*stmt.m_Condition) };
+                if(interpreter.failed())
+                    return Flow::ERROR;
+                if(!condition.isTruthy())
+                    return Flow::NEXT;
+                if(stmt.m_Body)
+                {
+                    if(const Flow flow{ interpreter.execute(*stmt.m_Body) }; flow != Flow::NEXT)
+                        return flow;
+                }
+            }
+        }
+        // The function value was stored when its block was entered
+        Flow operator()(const FuncStmt&) const { return Flow::NEXT; }
+        Flow operator()(const ReturnStmt& stmt) const
+        {
+            interpreter.m_ReturnValue = stmt.m_Value ? interpreter.evaluate(*stmt.m_Value) : Value{};
+            return interpreter.failed() ? Flow::ERROR : Flow::RETURN;
+        }
+        Flow operator()(const ErrorStmt& stmt) const
+        {
+            interpreter.error(stmt.m_Token, "Cannot run code with a syntax error.");
+            return Flow::ERROR;
+        }
+    };
+
+    bool Interpreter::run(const std::vector<Stmt*>& statements, uint32_t frameSize)
+    {
+        m_Diagnostics.clear();
+        m_Failed = false;
+        m_Stack.assign(frameSize, Value{});
+        m_Frames.assign(1, Frame{ 0, 0, ++m_Generation });
+        const Flow flow{ executeBlock(AstSpan<Stmt* const>(statements.data(), statements.size())) };
+        m_Frames.clear();
+        m_Stack.clear();
+        return flow != Flow::ERROR;
+    }
+
+    Interpreter::Flow Interpreter::execute(const Stmt& stmt)
+    {
+        return visitAst(stmt, InterpreterWalk{ *this });
+    }
+
+    Interpreter::Flow Interpreter::executeBlock(AstSpan<Stmt* const> statements)
+    {
+        // Functions of the block can be called before their declaration,
+        // like the Resolver declares them
+        const uint32_t frame{ static_cast<uint32_t>(m_Frames.size() - 1) };
+        size_t lastFunction{ 0 };
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::FUNCTION)
+                continue;
+            lastFunction = i;
+            const auto& function = static_cast<const FuncStmt&>(*statements[i]);
+            if(function.m_Slot != Binding::Unresolved)
+                m_Stack[m_Frames[frame].base + function.m_Slot] = Value::makeFunction(
+                    FunctionRef{ &function, frame, m_Frames[frame].generation });
+        }
+        // A call to one of them can read a variable declared ahead of the
+        // function before the variable's declaration runs, so the variable
+        // starts with its default value
+        for(size_t i = 0; i < lastFunction; ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::VARIABLE)
+                continue;
+            const auto& variable = static_cast<const VariableStmt&>(*statements[i]);
+            if(variable.m_Slot != Binding::Unresolved)
+                m_Stack[m_Frames[frame].base + variable.m_Slot] = defaultValue(variable.m_Type);
+        }
+        for(const Stmt* statement : statements)
+        {
+            if(const Flow flow{ execute(*statement) }; flow != Flow::NEXT)
+                return flow;
+        }
+        return Flow::NEXT;
+    }
+
+    Value Interpreter::evaluate(const Expr& expr)
+    {
+        return visitAst(expr, InterpreterWalk{ *this });
+    }
+
+    Value Interpreter::call(const CallExpr& expr)
+    {
+        const Value callee{ evaluate(*expr.m_Callee) };
+        if(failed())
+            return {};
+        if(callee.type != ValueType::FUNCTION)
+            return error(expr.m_Paren, "Can only call functions.");
+        const FunctionRef reference{ callee.function };
+        const FuncStmt& function{ *reference.declaration };
+        if(expr.m_Args.size() != function.m_Params.size())
+            return error(expr.m_Paren, "Wrong number of arguments to '{}'.", function.m_Name.value);
+        if(reference.frame >= m_Frames.size() || m_Frames[reference.frame].generation != reference.generation)
+            return error(expr.m_Paren, "'{}' is called after the scope it was declared in ended.", function.m_Name.value);
+        if(m_Frames.size() > MaxCallDepth)
+            return error(expr.m_Paren, "Stack overflow.");
+
+        // The new frame is reserved first and the arguments, evaluated in the
+        // caller's frame, go straight into its parameter slots. Calls made by
+        // the arguments use the stack above it.
+        const uint32_t base{ static_cast<uint32_t>(m_Stack.size()) };
+        m_Stack.resize(base + std::max<size_t>(function.m_FrameSize, function.m_Params.size()));
+        for(size_t i = 0; i < expr.m_Args.size(); ++i)
+        {
+            const Value argument{ evaluate(*expr.m_Args[i]) };
+            if(failed())
+            {
+                m_Stack.resize(base);
+                return {};
+            }
+            m_Stack[base + i] = argument;
+        }
+        m_Frames.push_back(Frame{ base, reference.frame, ++m_Generation });
+        const Flow flow{ executeBlock(AstSpan<Stmt* const>(function.m_Body.data(), function.m_Body.size())) };
+        m_Frames.pop_back();
+        m_Stack.resize(base);
+        return flow == Flow::RETURN ? m_ReturnValue : Value{};
+    }
+
+    Value* Interpreter::slot(const Binding& binding)
+    {
+        if(!binding.isResolved())
+            return nullptr;
+        uint32_t frame{ static_cast<uint32_t>(m_Frames.size() - 1) };
+        for(uint32_t depth = binding.depth; depth > 0; --depth)
+            frame = m_Frames[frame].enclosing;
+        return &m_Stack[m_Frames[frame].base + binding.slot];
+    }
+
+    Value Interpreter::concatenate(std::string_view left, std::string_view right)
+    {
+        std::string& text = m_Strings.emplace_back();
+        text.reserve(left.size() + right.size());
+        text.append(left).append(right);
+        return Value::makeString(text);
+    }
+
+    Value Interpreter::error(const Token& token, std::string_view message, std::string_view argument)
+    {
+        // Only the first error is reported, the walk unwinds after it
+        if(!m_Failed)
+            m_Diagnostics.report(token, message, argument, DiagnosticKind::RUNTIME);
+        m_Failed = true;
+        return {};
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Diagnostics.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Value.h"
+
+namespace BBTCompiler
+{
+    // Runs a program by walking its AST. The program must have been through
+    // the Resolver: variables live in flat frames on one value stack and are
+    // addressed by the slots it assigned, a call pushes a frame of the
+    // callee's frame size and follows static links for names of enclosing
+    // functions. Nothing is thrown, a return and a runtime error unwind the
+    // walk through the result of each statement.
+    //
+    // A function value can only be called while the frame it was declared
+    // in is alive, calling it after that is a runtime error. The first
+    // runtime error stops the program.
+    class Interpreter
+    {
+    public:
+        // Calls nested deeper than this are a stack overflow
+        static constexpr size_t MaxCallDepth{ 1000 };
+
+        explicit Interpreter(std::ostream& output = std::cout) : m_Output{ output } {}
+
+        // `frameSize` is the size the Resolver computed for the top level.
+        // Returns false if the program stopped with a runtime error.
+        bool run(const std::vector<Stmt*>& statements, uint32_t frameSize);
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+    private:
+        enum class Flow : uint8_t { NEXT, RETURN, ERROR };
+        struct Frame
+        {
+            uint32_t base;
+            uint32_t enclosing;
+            uint32_t generation;
+        };
+
+        friend struct InterpreterWalk;
+        Flow execute(const Stmt& stmt);
+        Flow executeBlock(AstSpan<Stmt* const> statements);
+        Value evaluate(const Expr& expr);
+        Value call(const CallExpr& expr);
+        Value* slot(const Binding& binding);
+        Value concatenate(std::string_view left, std::string_view right);
+        Value error(const Token& token, std::string_view message, std::string_view argument = {});
+        bool failed() const { return m_Failed; }
+    private:
+        std::ostream& m_Output;
+        Diagnostics m_Diagnostics;
+        std::vector<Value> m_Stack;
+        std::vector<Frame> m_Frames;
+        uint32_t m_Generation{ 0 };
+        // Set by a return statement for the call it leaves
+        Value m_ReturnValue;
+        bool m_Failed{ false };
+        // Text of strings made at runtime, kept until the interpreter is destroyed
+        std::list<std::string> m_Strings;
+    };
+}
@@ -1,17 +1,32 @@
 #include "JsonVisitor.h"
+#include <type_traits>
 #include "Expression.h"
 #include "Statement.h"
 
 namespace BBTCompiler
 {
+    template<typename Node>
+    void ASTJSonVisitor::visitChild(const Node& node, Json& json)
+    {
+        if(m_Deferred)
+        {
+            if constexpr(std::is_base_of_v<Expr, Node>)
+                m_Pending.push_back(PendingNode{ &node, nullptr, &json });
+            else
+                m_Pending.push_back(PendingNode{ nullptr, &node, &json });
+            return;
+        }
+        setCurrentJson(json);
+        node.accept(*this);
+    }
+
     void ASTJSonVisitor::visit(const AssignmentExpr& expr)
     {
         auto& exprJson = getCurrentJson();
         exprJson["type"] = "AssignmentExpression";
         exprJson["name"] = expr.m_Name.value;
         auto& valueExprJson = addNestedJson("value");
-        setCurrentJson(valueExprJson);
-        expr.m_Value->accept(*this);
+        visitChild(*expr.m_Value, valueExprJson);
 
     }
 
@@ -22,10 +37,8 @@ namespace BBTCompiler
         exprJson["operator"] = expr.m_Operator.value;
         auto& leftExprJson = addNestedJson("lhs");
         auto& rightExprJson = addNestedJson("rhs");
-        setCurrentJson(leftExprJson);
-        expr.m_Left->accept(*this);
-        setCurrentJson(rightExprJson);
-        expr.m_Right->accept(*this);
+        visitChild(*expr.m_Left, leftExprJson);
+        visitChild(*expr.m_Right, rightExprJson);
     }
     void ASTJSonVisitor::visit(const UnaryExpr& expr)
     {
@@ -33,8 +46,7 @@ namespace BBTCompiler
         exprJson["type"] = "UnaryExpression";
         exprJson["operator"] = expr.m_Operator.value;
         auto& rightExprJson = addNestedJson("rhs");
-        setCurrentJson(rightExprJson);
-        expr.m_Right->accept(*this);
+        visitChild(*expr.m_Right, rightExprJson);
     }
 
 
@@ -50,8 +62,7 @@ namespace BBTCompiler
         auto& exprJson = getCurrentJson();
         exprJson["type"] = "GroupedExpression";
         auto& groupJson = addNestedJson("expression");
-        setCurrentJson(groupJson);
-        expr.m_Expression->accept(*this);
+        visitChild(*expr.m_Expression, groupJson);
     }
 
     void ASTJSonVisitor::visit(const VariableExpr& expr)
@@ -67,14 +78,20 @@ namespace BBTCompiler
         exprJson["type"] = "CallExpression";
         auto& callee = addNestedJson("callee");
         auto& argsJsonArray = addNestedJsonArray("arguements");
-        setCurrentJson(callee);
-        expr.m_Callee->accept(*this);
-        for (const auto& arguement : expr.m_Args)
-        {
-            auto& element = argsJsonArray.emplace_back(Json({}));
-            setCurrentJson(element);
-            arguement->accept(*this);
-        }
+        visitChild(*expr.m_Callee, callee);
+        // Elements are added first, their addresses must not change while
+        // their nodes are pending
+        for (size_t i = 0; i < expr.m_Args.size(); ++i)
+            argsJsonArray.emplace_back(Json({}));
+        for (size_t i = 0; i < expr.m_Args.size(); ++i)
+            visitChild(*expr.m_Args[i], argsJsonArray[i]);
+    }
+
+    void ASTJSonVisitor::visit(const ErrorExpr& expr)
+    {
+        auto& exprJson = getCurrentJson();
+        exprJson["type"] = "ErrorExpression";
+        exprJson["token"] = expr.m_Token.value;
     }
 
     void ASTJSonVisitor::visit(const PrintStmt& stmt)
@@ -82,8 +99,7 @@ namespace BBTCompiler
         auto& exprJson = getCurrentJson();
         auto& expresson = addNestedJson("expression");
         exprJson["type"] = "PrintStatement";
-        setCurrentJson(expresson);
-        stmt.m_Expression->accept(*this);
+        visitChild(*stmt.m_Expression, expresson);
     }
 
     void ASTJSonVisitor::visit(const ExprStmt& stmt)
@@ -91,8 +107,7 @@ namespace BBTCompiler
         auto& exprJson = getCurrentJson();
         exprJson["type"] = "ExpressionStatement";
         auto& expresson = addNestedJson("expression");
-        setCurrentJson(expresson);
-        stmt.m_Expression->accept(*this);
+        visitChild(*stmt.m_Expression, expresson);
     }
 
     void ASTJSonVisitor::visit(const VariableStmt& stmt)
@@ -101,9 +116,8 @@ namespace BBTCompiler
         exprJson["type"] = "VariableStatement";
         exprJson["name"] = stmt.m_Name.value;
         auto& expresson = addNestedJson("initializer");
-        setCurrentJson(expresson);
-        if(stmt.m_Initializer.get())
-            stmt.m_Initializer->accept(*this);
+        if(stmt.m_Initializer)
+            visitChild(*stmt.m_Initializer, expresson);
     }
 
     void ASTJSonVisitor::visit(const BlockStmt& stmt)
@@ -111,12 +125,10 @@ namespace BBTCompiler
         auto& stmtJson = getCurrentJson();
         stmtJson["type"] = "BlockStatement";
         auto& stmtJsonArray = addNestedJsonArray("statements");
-        for (const auto& statement : stmt.m_Statements)
-        {
-            auto& element = stmtJsonArray.emplace_back(Json({}));
-            setCurrentJson(element);
-            statement->accept(*this);
-        }
+        for (size_t i = 0; i < stmt.m_Statements.size(); ++i)
+            stmtJsonArray.emplace_back(Json({}));
+        for (size_t i = 0; i < stmt.m_Statements.size(); ++i)
+            visitChild(*stmt.m_Statements[i], stmtJsonArray[i]);
     }
 
     void ASTJSonVisitor::visit(const IfStmt& stmt)
@@ -126,13 +138,10 @@ namespace BBTCompiler
         auto& conditionExpr = addNestedJson("condition");
         auto& thenStmt = addNestedJson("then");
         auto& elseStmt = addNestedJson("else");
-        setCurrentJson(conditionExpr);
-        stmt.m_Condition->accept(*this);
-        setCurrentJson(thenStmt);
-        stmt.m_ThenBranch->accept(*this);
-        setCurrentJson(elseStmt);
+        visitChild(*stmt.m_Condition, conditionExpr);
+        visitChild(*stmt.m_ThenBranch, thenStmt);
         if(stmt.m_ElseBranch)
-            stmt.m_ElseBranch->accept(*this);
+            visitChild(*stmt.m_ElseBranch, elseStmt);
     }
 
     void ASTJSonVisitor::visit(const WhileStmt& stmt)
@@ -141,10 +150,8 @@ namespace BBTCompiler
         stmtJson["type"] = "WhileStatement";
         auto& conditionExpr = addNestedJson("condition");
         auto& bodyStmt = addNestedJson("body");
-        setCurrentJson(conditionExpr);
-        stmt.m_Condition->accept(*this);
-        setCurrentJson(bodyStmt);
-        stmt.m_Body->accept(*this);
+        visitChild(*stmt.m_Condition, conditionExpr);
+        visitChild(*stmt.m_Body, bodyStmt);
     }
 
     void ASTJSonVisitor::visit(const FuncStmt& stmt)
@@ -161,12 +168,10 @@ namespace BBTCompiler
             element["name"] = parameter.first.value;
             element["type"] = parameter.second.value;
         }
-        for(const auto& statement : stmt.m_Body)
-        {
-            auto& element = stmtJsonArray.emplace_back(Json({}));
-            setCurrentJson(element);
-            statement->accept(*this);
-        }
+        for (size_t i = 0; i < stmt.m_Body.size(); ++i)
+            stmtJsonArray.emplace_back(Json({}));
+        for (size_t i = 0; i < stmt.m_Body.size(); ++i)
+            visitChild(*stmt.m_Body[i], stmtJsonArray[i]);
     }
 
     void ASTJSonVisitor::visit(const ReturnStmt& stmt)
@@ -176,9 +181,34 @@ namespace BBTCompiler
         auto& returnExpr{ addNestedJson("body") };
         if(stmt.m_Value)
         {
-            setCurrentJson(returnExpr);
-            stmt.m_Value->accept(*this);
+            visitChild(*stmt.m_Value, returnExpr);
+        }
+    }
+
+    void ASTJSonVisitor::visit(const ErrorStmt& stmt)
+    {
+        auto& stmtJson{ getCurrentJson() };
+        stmtJson["type"] = "ErrorStatement";
+        stmtJson["token"] = stmt.m_Token.value;
+    }
+
+    void ASTJSonVisitor::visitIteratively(const Stmt& stmt)
+    {
+        // Each visit fills in its node and queues the children, the order
+        // they are taken in does not matter as each has its own Json
+        m_Deferred = true;
+        stmt.accept(*this);
+        while(!m_Pending.empty())
+        {
+            const PendingNode pending{ m_Pending.back() };
+            m_Pending.pop_back();
+            setCurrentJson(*pending.json);
+            if(pending.expr)
+                pending.expr->accept(*this);
+            else
+                pending.stmt->accept(*this);
         }
+        m_Deferred = false;
     }
 
     const Json& ASTJSonVisitor::getJson() const { return m_Json; }
@@ -1,10 +1,14 @@
 #pragma once
 #include "ASTVisitor.h"
+#include <vector>
 #include "nlohmann/json.hpp"
 
 namespace BBTCompiler
 {
     using Json = nlohmann::json;
+    class Expr;
+    class Stmt;
+
     class ASTJSonVisitor : public ASTConstVisitor {
     public:
         void visit(const AssignmentExpr& expr) override;
@@ -21,6 +25,8 @@ namespace BBTCompiler
 
         void visit(const CallExpr& expr) override;
 
+        void visit(const ErrorExpr& expr) override;
+
         void visit(const PrintStmt& stmt) override;
 
         void visit(const ExprStmt& stmt) override;
@@ -37,6 +43,13 @@ namespace BBTCompiler
 
         void visit(const ReturnStmt& stmt) override;
 
+        void visit(const ErrorStmt& stmt) override;
+
+        // Same result as stmt.accept(*this), but nested nodes are visited
+        // from an explicit work list instead of recursively, so trees nested
+        // deeper than the call stack allows can be converted
+        void visitIteratively(const Stmt& stmt);
+
         const Json& getJson() const;
 
         void print();
@@ -46,8 +59,18 @@ namespace BBTCompiler
         Json& addNestedJson(const std::string& name);
         Json& addNestedJsonArray(const std::string& name);
         void setCurrentJson(Json& data) { m_CurrentJson = &data; }
+        template<typename Node>
+        void visitChild(const Node& node, Json& json);
     private:
+        struct PendingNode
+        {
+            const Expr* expr;
+            const Stmt* stmt;
+            Json* json;
+        };
         Json m_Json{};
         Json* m_CurrentJson{ &m_Json };
+        bool m_Deferred{ false };
+        std::vector<PendingNode> m_Pending;
     };
 }
\ No newline at end of file
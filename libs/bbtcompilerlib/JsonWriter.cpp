@@ -0,0 +1,283 @@
+#include "JsonWriter.h"
+#include "Expression.h"
+#include "Statement.h"
+
+namespace BBTCompiler
+{
+    void ASTJsonWriter::visit(const AssignmentExpr& expr)
+    {
+        beginObject();
+        stringMember("name", expr.m_Name.value);
+        stringMember("type", "AssignmentExpression");
+        nodeMember("value", expr.m_Value);
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const BinaryExpr& expr)
+    {
+        beginObject();
+        nodeMember("lhs", expr.m_Left);
+        stringMember("operator", expr.m_Operator.value);
+        nodeMember("rhs", expr.m_Right);
+        stringMember("type", "BinaryExpression");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const UnaryExpr& expr)
+    {
+        beginObject();
+        stringMember("operator", expr.m_Operator.value);
+        nodeMember("rhs", expr.m_Right);
+        stringMember("type", "UnaryExpression");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const LiteralExpr& expr)
+    {
+        beginObject();
+        stringMember("type", "PrimaryExpression");
+        stringMember("value", expr.m_Token.value);
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const GroupedExpr& expr)
+    {
+        beginObject();
+        nodeMember("expression", expr.m_Expression);
+        stringMember("type", "GroupedExpression");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const VariableExpr& expr)
+    {
+        beginObject();
+        stringMember("type", "Variable");
+        stringMember("value", expr.m_Name.value);
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const CallExpr& expr)
+    {
+        beginObject();
+        nodeArrayMember("arguements", expr.m_Args);
+        nodeMember("callee", expr.m_Callee);
+        stringMember("type", "CallExpression");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const ErrorExpr& expr)
+    {
+        beginObject();
+        stringMember("token", expr.m_Token.value);
+        stringMember("type", "ErrorExpression");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const PrintStmt& stmt)
+    {
+        beginObject();
+        nodeMember("expression", stmt.m_Expression);
+        stringMember("type", "PrintStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const ExprStmt& stmt)
+    {
+        beginObject();
+        nodeMember("expression", stmt.m_Expression);
+        stringMember("type", "ExpressionStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const VariableStmt& stmt)
+    {
+        beginObject();
+        nodeMember("initializer", stmt.m_Initializer);
+        stringMember("name", stmt.m_Name.value);
+        stringMember("type", "VariableStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const BlockStmt& stmt)
+    {
+        beginObject();
+        nodeArrayMember("statements", stmt.m_Statements);
+        stringMember("type", "BlockStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const IfStmt& stmt)
+    {
+        beginObject();
+        nodeMember("condition", stmt.m_Condition);
+        nodeMember("else", stmt.m_ElseBranch);
+        nodeMember("then", stmt.m_ThenBranch);
+        stringMember("type", "IfStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const WhileStmt& stmt)
+    {
+        beginObject();
+        nodeMember("body", stmt.m_Body);
+        nodeMember("condition", stmt.m_Condition);
+        stringMember("type", "WhileStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const FuncStmt& stmt)
+    {
+        beginObject();
+        stringMember("name", stmt.m_Name.value);
+        key("parameters");
+        beginArray();
+        for(const auto& parameter : stmt.m_Params)
+        {
+            element();
+            beginObject();
+            stringMember("name", parameter.first.value);
+            stringMember("type", parameter.second.value);
+            endObject();
+        }
+        endArray();
+        stringMember("returnType", stmt.m_ReturnType.value.empty() ? "void" : stmt.m_ReturnType.value);
+        nodeArrayMember("statements", stmt.m_Body);
+        stringMember("type", "FunctionStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const ReturnStmt& stmt)
+    {
+        beginObject();
+        nodeMember("body", stmt.m_Value);
+        stringMember("type", "ReturnStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::visit(const ErrorStmt& stmt)
+    {
+        beginObject();
+        stringMember("token", stmt.m_Token.value);
+        stringMember("type", "ErrorStatement");
+        endObject();
+    }
+
+    void ASTJsonWriter::flush()
+    {
+        if(!m_Stream || m_Buffer.empty())
+            return;
+        m_Stream->write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+        m_Buffer.clear();
+    }
+
+    void ASTJsonWriter::begin(char bracket)
+    {
+        m_Buffer += bracket;
+        ++m_Depth;
+        m_First = true;
+    }
+
+    void ASTJsonWriter::end(char bracket)
+    {
+        --m_Depth;
+        // Empty objects and arrays stay on one line, as json::dump writes them
+        if(!m_First)
+            newLine(m_Depth);
+        m_Buffer += bracket;
+        m_First = false;
+        if(m_Depth == 0 && m_Buffer.size() >= FlushSize)
+            flush();
+    }
+
+    void ASTJsonWriter::key(std::string_view name)
+    {
+        element();
+        string(name);
+        m_Buffer += m_Indent < 0 ? ":" : ": ";
+    }
+
+    void ASTJsonWriter::element()
+    {
+        if(!m_First)
+            m_Buffer += ',';
+        m_First = false;
+        newLine(m_Depth);
+    }
+
+    void ASTJsonWriter::newLine(int depth)
+    {
+        if(m_Indent < 0)
+            return;
+        m_Buffer += '\n';
+        m_Buffer.append(static_cast<size_t>(depth * m_Indent), ' ');
+    }
+
+    void ASTJsonWriter::string(std::string_view value)
+    {
+        // Same escapes as json::dump: quotes, backslashes and control characters
+        static constexpr char Hex[]{ "0123456789abcdef" };
+        m_Buffer += '"';
+        size_t runStart{ 0 };
+        for(size_t i = 0; i < value.size(); ++i)
+        {
+            const unsigned char c{ static_cast<unsigned char>(value[i]) };
+            if(c >= 0x20 && c != '"' && c != '\\')
+                continue;
+            m_Buffer.append(value.data() + runStart, i - runStart);
+            runStart = i + 1;
+            m_Buffer += '\\';
+            switch(c)
+            {
+            case '"': m_Buffer += '"'; break;
+            case '\\': m_Buffer += '\\'; break;
+            case '\b': m_Buffer += 'b'; break;
+            case '\f': m_Buffer += 'f'; break;
+            case '\n': m_Buffer += 'n'; break;
+            case '\r': m_Buffer += 'r'; break;
+            case '\t': m_Buffer += 't'; break;
+            default:
+                m_Buffer += "u00";
+                m_Buffer += Hex[c >> 4];
+                m_Buffer += Hex[c & 0xF];
+                break;
+            }
+        }
+        m_Buffer.append(value.data() + runStart, value.size() - runStart);
+        m_Buffer += '"';
+    }
+
+    void ASTJsonWriter::stringMember(std::string_view name, std::string_view value)
+    {
+        key(name);
+        string(value);
+    }
+
+    template<typename Node>
+    void ASTJsonWriter::nodeMember(std::string_view name, const Node* node)
+    {
+        key(name);
+        // A missing child is an empty object, as in ASTJSonVisitor
+        if(node)
+        {
+            node->accept(*this);
+        }
+        else
+        {
+            beginObject();
+            endObject();
+        }
+    }
+
+    template<typename Nodes>
+    void ASTJsonWriter::nodeArrayMember(std::string_view name, const Nodes& nodes)
+    {
+        key(name);
+        beginArray();
+        for(const auto* node : nodes)
+        {
+            element();
+            node->accept(*this);
+        }
+        endArray();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "ASTVisitor.h"
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace BBTCompiler
+{
+    // Writes the same JSON as ASTJSonVisitor, but straight into a text buffer
+    // while the tree is walked instead of building a nlohmann::json document
+    // first. Keys are written in the order json::dump uses, so the text is
+    // identical to getJson().dump(indent). An indent below zero writes
+    // compact output. Every accept() appends one JSON object.
+    class ASTJsonWriter : public ASTConstVisitor {
+    public:
+        static constexpr size_t FlushSize{ 64 * 1024 };
+
+        // Output is kept in the writer, see getString()
+        explicit ASTJsonWriter(int indent = 4) : m_Indent{ indent } {}
+        // Output is written to `stream` whenever FlushSize bytes are buffered,
+        // and on flush() or destruction
+        explicit ASTJsonWriter(std::ostream& stream, int indent = 4) : m_Stream{ &stream }, m_Indent{ indent } {}
+        ~ASTJsonWriter() { flush(); }
+        ASTJsonWriter(const ASTJsonWriter&) = delete;
+        ASTJsonWriter& operator=(const ASTJsonWriter&) = delete;
+
+        void visit(const AssignmentExpr& expr) override;
+
+        void visit(const BinaryExpr& expr) override;
+
+        void visit(const UnaryExpr& expr) override;
+
+        void visit(const LiteralExpr& expr) override;
+
+        void visit(const GroupedExpr& expr) override;
+
+        void visit(const VariableExpr& expr) override;
+
+        void visit(const CallExpr& expr) override;
+
+        void visit(const ErrorExpr& expr) override;
+
+        void visit(const PrintStmt& stmt) override;
+
+        void visit(const ExprStmt& stmt) override;
+
+        void visit(const VariableStmt& stmt) override;
+
+        void visit(const BlockStmt& stmt) override;
+
+        void visit(const IfStmt& stmt) override;
+
+        void visit(const WhileStmt& stmt) override;
+
+        void visit(const FuncStmt& stmt) override;
+
+        void visit(const ReturnStmt& stmt) override;
+
+        void visit(const ErrorStmt& stmt) override;
+
+        // Text between two objects, e.g. a newline between statements
+        void writeRaw(std::string_view text) { m_Buffer += text; }
+        void flush();
+        const std::string& getString() const { return m_Buffer; }
+        void clear() { m_Buffer.clear(); }
+    private:
+        void beginObject() { begin('{'); }
+        void endObject() { end('}'); }
+        void beginArray() { begin('['); }
+        void endArray() { end(']'); }
+        void begin(char bracket);
+        void end(char bracket);
+        // Starts the next member of the enclosing object or array
+        void key(std::string_view name);
+        void element();
+        void newLine(int depth);
+        void string(std::string_view value);
+        void stringMember(std::string_view name, std::string_view value);
+        template<typename Node>
+        void nodeMember(std::string_view name, const Node* node);
+        template<typename Nodes>
+        void nodeArrayMember(std::string_view name, const Nodes& nodes);
+    private:
+        std::ostream* m_Stream{ nullptr };
+        std::string m_Buffer;
+        int m_Indent;
+        int m_Depth{ 0 };
+        // Set right after a '{' or '[', when the next member needs no comma
+        bool m_First{ false };
+    };
+}
@@ -1,148 +1,363 @@
 ﻿#include "Lexer.h"
+#include "CharScan.h"
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <thread>
 
 
 namespace BBTCompiler
 {
+    namespace
+    {
+        // String literal state at a chunk boundary. Boundaries directly follow
+        // a '\n', which always consumes a pending escape, so only two states occur.
+        enum class StringState : uint8_t { OUTSIDE, INSIDE };
+
+        // Runs the string literal rules of Lexer::processStringLiteral over [begin, end)
+        StringState advanceStringState(StringState state, const char* begin, const char* end)
+        {
+            while(begin != end)
+            {
+                if(state == StringState::OUTSIDE)
+                {
+                    begin = static_cast<const char*>(std::memchr(begin, '"', end - begin));
+                    if(!begin)
+                        return StringState::OUTSIDE;
+                    ++begin;
+                    state = StringState::INSIDE;
+                    continue;
+                }
+                begin = CharScan::findQuoteOrBackslash(begin, end);
+                if(begin == end)
+                    break;
+                if(*begin == '"')
+                {
+                    ++begin;
+                    state = StringState::OUTSIDE;
+                    continue;
+                }
+                while(begin != end && *begin == '\\')
+                    ++begin;
+                if(begin != end)
+                    ++begin;
+            }
+            return state;
+        }
+
+        // First position after a newline that is not inside a string literal
+        const char* nextSafeBoundary(StringState state, const char* begin, const char* end)
+        {
+            bool escape{false};
+            for(; begin != end; ++begin)
+            {
+                if(state == StringState::OUTSIDE)
+                {
+                    if(*begin == '\n')
+                        return begin + 1;
+                    if(*begin == '"')
+                        state = StringState::INSIDE;
+                }
+                else if(*begin == '\\')
+                {
+                    escape = true;
+                }
+                else if(escape || *begin != '"')
+                {
+                    escape = false;
+                }
+                else
+                {
+                    state = StringState::OUTSIDE;
+                }
+            }
+            return end;
+        }
+
+        // Calls work(i) for every i in [0, count) on up to threadCount threads,
+        // the calling thread included. Each thread pulls the next index when it
+        // finishes one, so uneven chunks still balance.
+        template<typename Work>
+        void parallelFor(size_t count, size_t threadCount, Work work)
+        {
+            std::atomic<size_t> next{ 0 };
+            const auto worker = [&]() {
+                for(size_t i = next++; i < count; i = next++)
+                    work(i);
+            };
+            std::vector<std::thread> threads;
+            for(size_t i = 1; i < std::min(threadCount, count); ++i)
+                threads.emplace_back(worker);
+            worker();
+            for(auto& thread : threads)
+                thread.join();
+        }
+    }
+
     void Lexer::reset()
     {
         m_Tokens.clear();
+        m_Storage.clear();
         m_CurrentToken = Token{}; 
         m_Position = TokenPosition{ 1, 1 };
     }
 
     void Lexer::scan(std::istream& stream)
     {
-        while(stream >> std::noskipws >> m_CurrentChar)
-        {
-            if(m_CurrentChar == '\n')
-                incrementLine();
-            else if(std::isdigit(m_CurrentChar))
-                processNumLiteral(stream);
-            else if(m_CurrentChar == '"')
-                processStringLiteral(stream);
-            else if(isOperator(m_CurrentChar))
-                processOperator(stream);
-            else if(std::isalpha(m_CurrentChar) || m_CurrentChar == '_')
-                processIdentifier(stream);
+        // The tokens view into the source so the Lexer keeps the stream contents alive
+        const std::string& source = m_Storage.emplace_back(
+            std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        scan(source);
+    }
 
-            incrementColumn();
-        }
-        m_Tokens.emplace_back(Token{TokenType::END, m_Position, ""});
+    void Lexer::scan(std::string_view source)
+    {
+        open(source);
+        do
+        {
+            m_Tokens.push_back(next());
+        } while(m_Tokens.back().type != TokenType::END);
     }
 
-    Token& Lexer::newToken(TokenType type, TokenPosition position)
+    void Lexer::open(std::string_view source)
     {
-        return m_Tokens.emplace_back(Token{type, position, ""});
+        m_Begin = source.data();
+        m_TokenStart = m_Begin;
+        m_Cursor = source.data();
+        m_End = source.data() + source.size();
     }
 
-    void Lexer::processNumLiteral(std::istream& stream)
+    Token Lexer::next()
     {
-        Token& token = newToken(TokenType::INT_LITERAL, m_Position);
-        token.value += m_CurrentChar;
-        bool hasDot{false};
-        while(stream >> std::noskipws >> m_CurrentChar)
+        while(true)
         {
-            if(std::isdigit(m_CurrentChar))
-            {
-                token.value += m_CurrentChar;
-            }
-            else if(m_CurrentChar == '.' && !hasDot)
-            {
-                token.value += m_CurrentChar;
-                token.type = TokenType::FLOAT_LITERAL;
-                hasDot = true;
-            }
-            else
+            skipWhitespace();
+            m_TokenStart = m_Cursor;
+            m_TokenEscaped = false;
+            if(!nextChar())
+                return Token{TokenType::END, NoSymbol, m_Position, ""};
+
+            bool isToken{ true };
+            switch(CharClasses[m_CurrentChar])
             {
-                stream.putback(m_CurrentChar);
-                break;
+            case CharClass::NEWLINE: incrementLine(); isToken = false; break;
+            case CharClass::DIGIT: processNumLiteral(); break;
+            case CharClass::QUOTE: processStringLiteral(); break;
+            case CharClass::OPERATOR: processOperator(); break;
+            case CharClass::IDENTIFIER: processIdentifier(); break;
+            case CharClass::OTHER: isToken = false; break;
             }
+
+            incrementColumn();
+            if(isToken)
+                return m_CurrentToken;
         }
-        incrementColumn(token.value.size() - 1);
     }
 
-    void Lexer::processStringLiteral(std::istream& stream)
+    void Lexer::scanParallel(std::string_view source, size_t threadCount, size_t minChunkSize)
     {
-        Token& token = newToken(TokenType::STRING_LITERAL, m_Position);
-        bool escape{false};
-        incrementColumn();
-        while(stream >> std::noskipws >> m_CurrentChar)
+        if(threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        const size_t chunkTarget{ std::min(source.size() / std::max<size_t>(minChunkSize, 1), threadCount * 4) };
+        if(threadCount < 2 || chunkTarget < 2)
         {
-            if(m_CurrentChar == '\\')
-            {
-                escape = true;
-            }
-            else if(escape || m_CurrentChar != '"')
-            {
-                token.value += m_CurrentChar;
-                escape = false;
-            } 
-            else
-            {
+            scan(source);
+            return;
+        }
+
+        // Evenly spaced boundaries moved to just after the following newline
+        const char* begin{ source.data() };
+        const char* end{ source.data() + source.size() };
+        std::vector<const char*> boundaries{ begin };
+        for(size_t i = 1; i < chunkTarget; ++i)
+        {
+            const char* candidate{ std::max(begin + source.size() * i / chunkTarget, boundaries.back()) };
+            const void* newline{ std::memchr(candidate, '\n', end - candidate) };
+            if(!newline)
                 break;
+            const char* boundary{ static_cast<const char*>(newline) + 1 };
+            if(boundary != end && boundary != boundaries.back())
+                boundaries.push_back(boundary);
+        }
+        boundaries.push_back(end);
+
+        // Speculative pass: a chunk does not know whether it starts inside a
+        // string literal, so compute its exit state for both entry states
+        std::vector<std::array<StringState, 2>> exits(boundaries.size() - 1);
+        parallelFor(exits.size(), threadCount, [&](size_t i) {
+            exits[i][0] = advanceStringState(StringState::OUTSIDE, boundaries[i], boundaries[i + 1]);
+            exits[i][1] = advanceStringState(StringState::INSIDE, boundaries[i], boundaries[i + 1]);
+        });
+
+        // Fix-up pass: chain the real entry states from the start of the source
+        // and move boundaries that fall inside a string literal past its end
+        std::vector<const char*> chunks{ begin };
+        StringState state{ StringState::OUTSIDE };
+        for(size_t i = 1; i < boundaries.size(); ++i)
+        {
+            state = exits[i - 1][static_cast<size_t>(state)];
+            const char* boundary{ boundaries[i] };
+            if(state == StringState::INSIDE && boundary != end)
+                boundary = nextSafeBoundary(state, boundary, end);
+            if(boundary > chunks.back() && (boundary == end || i + 1 == boundaries.size() || boundary < boundaries[i + 1]))
+                chunks.push_back(boundary);
+        }
+        if(chunks.back() != end)
+            chunks.push_back(end);
+
+        std::vector<Lexer> lexers(chunks.size() - 1);
+        lexers.front().m_Position = m_Position;
+        parallelFor(lexers.size(), threadCount, [&](size_t i) {
+            lexers[i].scan(std::string_view(chunks[i], chunks[i + 1] - chunks[i]));
+        });
+
+        // Every chunk after the first starts at column 1 of a line its lexer
+        // counted as line 1, and only the last chunk keeps its END token.
+        // Symbols are renumbered from each chunk's interner into this one,
+        // chunk by chunk, which gives the ids a sequential scan would.
+        size_t tokenCount{ m_Tokens.size() + 1 };
+        for(const auto& lexer : lexers)
+            tokenCount += lexer.m_Tokens.size() - 1;
+        m_Tokens.reserve(tokenCount);
+        size_t lineOffset{ 0 };
+        for(size_t i = 0; i < lexers.size(); ++i)
+        {
+            auto& lexer = lexers[i];
+            const StringInterner& chunkInterner{ lexer.getInterner() };
+            std::vector<SymbolId> symbols(chunkInterner.size() + 1, NoSymbol);
+            for(SymbolId symbol = 1; symbol < symbols.size(); ++symbol)
+                symbols[symbol] = m_Interner->intern(chunkInterner.view(symbol));
+            const size_t count{ i + 1 == lexers.size() ? lexer.m_Tokens.size() : lexer.m_Tokens.size() - 1 };
+            for(size_t t = 0; t < count; ++t)
+            {
+                Token& token = m_Tokens.emplace_back(lexer.m_Tokens[t]);
+                token.position.line += lineOffset;
+                token.symbol = symbols[token.symbol];
             }
-            incrementColumn();
+            m_Storage.splice(m_Storage.end(), lexer.m_Storage);
+            m_Position = lexer.m_Position;
+            m_Position.line += lineOffset;
+            lineOffset = m_Position.line - 1;
         }
     }
 
-    void Lexer::processOperator(std::istream& stream)
+    void Lexer::skipWhitespace()
     {
-        TokenType type = isOperator(m_CurrentChar) ? Operators.find(m_CurrentChar)->second: TokenType::INVALID;
-        Token& token = newToken(type, m_Position);
-        const unsigned char nextChar = stream.peek();
-        std::string pairString;
-        pairString.push_back(m_CurrentChar);
-        token.value = m_CurrentChar;
-        pairString.push_back(nextChar);
-        if(isPairedOperator(pairString))
+        const char* end{ CharScan::skipWhitespace(m_Cursor, m_End) };
+        if(end == m_Cursor)
+            return;
+        if(const size_t newlines{ CharScan::countNewlines(m_Cursor, end) })
         {
-            stream >> std::noskipws >> m_CurrentChar;
-            token.type = PairedOperators.find(pairString)->second;
-            incrementColumn();
-            token.value = pairString;
+            const char* lastNewline{ end - 1 };
+            while(*lastNewline != '\n')
+                --lastNewline;
+            incrementLine(static_cast<int>(newlines));
+            incrementColumn(static_cast<int>(end - lastNewline));
         }
+        else
+        {
+            incrementColumn(static_cast<int>(end - m_Cursor));
+        }
+        m_Cursor = end;
+    }
+
+    bool Lexer::nextChar()
+    {
+        if(m_Cursor == m_End)
+            return false;
+        m_CurrentChar = static_cast<unsigned char>(*m_Cursor++);
+        return true;
+    }
+
+    unsigned char Lexer::peekChar() const
+    {
+        return m_Cursor != m_End ? static_cast<unsigned char>(*m_Cursor) : '\0';
     }
 
-    void Lexer::processIdentifier(std::istream& stream)
+    Token& Lexer::newToken(TokenType type, TokenPosition position)
     {
-        Token& token = newToken(TokenType::IDENTIFIER, m_Position);
-        token.value += m_CurrentChar;
-        while(stream >> std::noskipws >> m_CurrentChar)
+        m_CurrentToken = Token{type, NoSymbol, position, ""};
+        return m_CurrentToken;
+    }
+
+    void Lexer::processNumLiteral()
+    {
+        Token& token = newToken(TokenType::INT_LITERAL, m_Position);
+        const char* start{ m_Cursor - 1 };
+        m_Cursor = CharScan::skipDigits(m_Cursor, m_End);
+        if(m_Cursor != m_End && *m_Cursor == '.')
         {
-            if(isalnum(m_CurrentChar) || m_CurrentChar == '_')
-            {
-                token.value += m_CurrentChar;
-                incrementColumn();
-            }
-            else
-            {
-                stream.putback(m_CurrentChar);
-                break;
-            }
+            token.type = TokenType::FLOAT_LITERAL;
+            m_Cursor = CharScan::skipDigits(m_Cursor + 1, m_End);
         }
-        if (isKeyword(token.value))
+        token.value = std::string_view(start, m_Cursor - start);
+        incrementColumn(token.value.size() - 1);
+    }
+
+    void Lexer::processStringLiteral()
+    {
+        Token& token = newToken(TokenType::STRING_LITERAL, m_Position);
+        const char* start{ m_Cursor };
+        const char* current{ CharScan::findQuoteOrBackslash(m_Cursor, m_End) };
+        bool hasEscape{false};
+        while(current != m_End && *current == '\\')
         {
-            token.type = Keywords.find(token.value)->second;
+            // A run of backslashes escapes the first character following it
+            hasEscape = true;
+            while(current != m_End && *current == '\\')
+                ++current;
+            if(current != m_End)
+                ++current;
+            current = CharScan::findQuoteOrBackslash(current, m_End);
         }
+        // Only literals containing escapes need their own storage
+        token.value = hasEscape ? unescapeString(start, current) : std::string_view(start, current - start);
+        m_TokenEscaped = hasEscape;
+        incrementColumn(static_cast<int>(current - start) + 1);
+        m_Cursor = current != m_End ? current + 1 : current;
     }
 
-    bool Lexer::isOperator(unsigned char c)
+    std::string_view Lexer::unescapeString(const char* begin, const char* end)
     {
-        return Operators.find(c) != Operators.end();
+        std::string& value = m_Storage.emplace_back();
+        value.reserve(end - begin);
+        // An escape drops the backslash and keeps the character following it
+        for(const char* current = begin; current != end; ++current)
+        {
+            if(*current != '\\')
+                value += *current;
+        }
+        return value;
     }
 
-    bool Lexer::isPairedOperator(const std::string& pairString)
+    void Lexer::processOperator()
     {
-        const auto search = PairedOperators.find(pairString);
-        return search != PairedOperators.cend();
+        Token& token = newToken(Operators[m_CurrentChar], m_Position);
+        token.value = std::string_view(m_Cursor - 1, 1);
+        const TokenType pairedType = pairedOperatorType(m_CurrentChar, peekChar());
+        if(pairedType != TokenType::INVALID)
+        {
+            ++m_Cursor;
+            token.type = pairedType;
+            incrementColumn();
+            token.value = std::string_view(m_Cursor - 2, 2);
+        }
     }
 
-    bool Lexer::isKeyword(const std::string& word)
+    void Lexer::processIdentifier()
     {
-         return Keywords.find(word) != Keywords.end();
+        const char* start{ m_Cursor - 1 };
+        m_Cursor = CharScan::skipIdentifierChars(m_Cursor, m_End);
+        const std::string_view word(start, m_Cursor - start);
+        Token& token = newToken(keywordType(word), m_Position);
+        token.value = word;
+        if(token.type == TokenType::IDENTIFIER)
+            token.symbol = m_Interner->intern(word);
+        incrementColumn(word.size() - 1);
     }
 
     void Lexer::incrementLine(int count)
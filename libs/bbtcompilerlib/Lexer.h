@@ -1,8 +1,13 @@
 ﻿#pragma once
+#include <array>
+#include <cstdint>
 #include <istream>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_set>
-#include <unordered_map>
+#include "StringInterner.h"
 
 namespace BBTCompiler
 {
@@ -39,13 +44,21 @@ namespace BBTCompiler
         INVALID
     };
 
-    const std::unordered_map<std::string, TokenType> Keywords{
+    constexpr size_t TokenTypeCount{ static_cast<size_t>(TokenType::INVALID) + 1 };
+
+    struct KeywordEntry
+    {
+        std::string_view word{};
+        TokenType type{ TokenType::IDENTIFIER };
+    };
+
+    constexpr std::array<KeywordEntry, 19> Keywords{{
         // Type Qualifiers
         {"const",       TokenType::CONST},
         // types
         {"int",         TokenType::INT},
         {"char",        TokenType::CHAR},
-        {"bool",     TokenType::BOOL},
+        {"bool",        TokenType::BOOL},
         {"float",       TokenType::FLOAT},
         // bool literals
         {"true",        TokenType::TRUE},
@@ -63,54 +76,143 @@ namespace BBTCompiler
         {"break",       TokenType::BREAK},
         // Declarations
         {"fn",          TokenType::FN},
-        {"class",          TokenType::CLASS}
-    };
+        {"class",       TokenType::CLASS}
+    }};
 
-    const std::unordered_map<unsigned char, TokenType> Operators{
-        {'{', TokenType::LEFT_BRACE},
-        {'}', TokenType::RIGHT_BRACE},
-        {'(', TokenType::LEFT_PAREN},
-        {')', TokenType::RIGHT_PAREN},
-        {'[', TokenType::LEFT_BRACKET},
-        {']', TokenType::RIGHT_BRACKET},
-        {'.', TokenType::DOT},
-        {',', TokenType::COMMA},
-        {';', TokenType::SEMICOLON},
-        {':', TokenType::COLON},
-        {'+', TokenType::PLUS},
-        {'-', TokenType::MINUS},
-        {'*', TokenType::STAR},
-        {'/', TokenType::SLASH},
-        {'&', TokenType::AMPERSAND},
-        {'>', TokenType::GREATER},
-        {'<', TokenType::LESS},
-        {'=', TokenType::EQ},
-        {'!', TokenType::NOT},
-        {'|', TokenType::PIPE}
-    };
+    // Perfect hash over the keyword set: the first and last characters plus the
+    // length select a unique slot, so a lookup is one hash and one compare.
+    constexpr size_t KeywordTableSize{ 32 };
+    constexpr size_t keywordHash(std::string_view word)
+    {
+        return (static_cast<unsigned char>(word.front()) * 2
+              + static_cast<unsigned char>(word.back()) * 8
+              + word.size() * 7) & (KeywordTableSize - 1);
+    }
 
-    const std::unordered_map<std::string, TokenType> PairedOperators{
-        {"==", TokenType::EQ_EQ},
-        {"!=", TokenType::NOT_EQ},
-        {"++", TokenType::PLUS_PLUS},
-        {"--", TokenType::MINUS_MINUS},
-        {"+=", TokenType::PLUS_EQ},
-        {"-+", TokenType::MINUS_EQ},
-        {">=", TokenType::GREATER_EQ},
-        {"<=", TokenType::LESS_EQ},
-        {"||", TokenType::OR},
-        {"&&", TokenType::AND},
-        {"->", TokenType::RIGHT_ARROW},
-    };
+    constexpr std::array<KeywordEntry, KeywordTableSize> makeKeywordTable()
+    {
+        std::array<KeywordEntry, KeywordTableSize> table{};
+        for(const auto& keyword : Keywords)
+            table[keywordHash(keyword.word)] = keyword;
+        return table;
+    }
+
+    constexpr std::array<KeywordEntry, KeywordTableSize> KeywordTable{ makeKeywordTable() };
+
+    constexpr bool isKeywordTablePerfect()
+    {
+        for(const auto& keyword : Keywords)
+            if(KeywordTable[keywordHash(keyword.word)].word != keyword.word)
+                return false;
+        return true;
+    }
+    static_assert(isKeywordTablePerfect(), "keywordHash has collisions, adjust its multipliers");
+
+    // Returns the keyword type of `word`, or IDENTIFIER if it is not a keyword
+    constexpr TokenType keywordType(std::string_view word)
+    {
+        if(word.empty())
+            return TokenType::IDENTIFIER;
+        const KeywordEntry& entry = KeywordTable[keywordHash(word)];
+        return entry.word == word ? entry.type : TokenType::IDENTIFIER;
+    }
+
+    constexpr std::array<TokenType, 256> makeOperatorTable()
+    {
+        std::array<TokenType, 256> table{};
+        for(auto& type : table)
+            type = TokenType::INVALID;
+        table['{'] = TokenType::LEFT_BRACE;
+        table['}'] = TokenType::RIGHT_BRACE;
+        table['('] = TokenType::LEFT_PAREN;
+        table[')'] = TokenType::RIGHT_PAREN;
+        table['['] = TokenType::LEFT_BRACKET;
+        table[']'] = TokenType::RIGHT_BRACKET;
+        table['.'] = TokenType::DOT;
+        table[','] = TokenType::COMMA;
+        table[';'] = TokenType::SEMICOLON;
+        table[':'] = TokenType::COLON;
+        table['+'] = TokenType::PLUS;
+        table['-'] = TokenType::MINUS;
+        table['*'] = TokenType::STAR;
+        table['/'] = TokenType::SLASH;
+        table['&'] = TokenType::AMPERSAND;
+        table['>'] = TokenType::GREATER;
+        table['<'] = TokenType::LESS;
+        table['='] = TokenType::EQ;
+        table['!'] = TokenType::NOT;
+        table['|'] = TokenType::PIPE;
+        return table;
+    }
+
+    // Single character operators indexed by character, INVALID for anything else
+    constexpr std::array<TokenType, 256> Operators{ makeOperatorTable() };
+
+    constexpr uint16_t packOperatorPair(unsigned char first, unsigned char second)
+    {
+        return static_cast<uint16_t>(first << 8 | second);
+    }
+
+    // Returns the type of the two character operator `first``second`, or INVALID
+    constexpr TokenType pairedOperatorType(unsigned char first, unsigned char second)
+    {
+        switch(packOperatorPair(first, second))
+        {
+        case packOperatorPair('=', '='): return TokenType::EQ_EQ;
+        case packOperatorPair('!', '='): return TokenType::NOT_EQ;
+        case packOperatorPair('+', '+'): return TokenType::PLUS_PLUS;
+        case packOperatorPair('-', '-'): return TokenType::MINUS_MINUS;
+        case packOperatorPair('+', '='): return TokenType::PLUS_EQ;
+        case packOperatorPair('-', '+'): return TokenType::MINUS_EQ;
+        case packOperatorPair('>', '='): return TokenType::GREATER_EQ;
+        case packOperatorPair('<', '='): return TokenType::LESS_EQ;
+        case packOperatorPair('|', '|'): return TokenType::OR;
+        case packOperatorPair('&', '&'): return TokenType::AND;
+        case packOperatorPair('-', '>'): return TokenType::RIGHT_ARROW;
+        default: return TokenType::INVALID;
+        }
+    }
 
+    enum class CharClass : uint8_t { OTHER, NEWLINE, DIGIT, QUOTE, OPERATOR, IDENTIFIER };
+
+    constexpr std::array<CharClass, 256> makeCharClassTable()
+    {
+        std::array<CharClass, 256> table{};
+        for(size_t c = 0; c < table.size(); ++c)
+        {
+            if(c == '\n')
+                table[c] = CharClass::NEWLINE;
+            else if(c >= '0' && c <= '9')
+                table[c] = CharClass::DIGIT;
+            else if(c == '"')
+                table[c] = CharClass::QUOTE;
+            else if(Operators[c] != TokenType::INVALID)
+                table[c] = CharClass::OPERATOR;
+            else if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+                table[c] = CharClass::IDENTIFIER;
+            else
+                table[c] = CharClass::OTHER;
+        }
+        return table;
+    }
+
+    // Dispatch class of each character at the start of a token
+    constexpr std::array<CharClass, 256> CharClasses{ makeCharClassTable() };
+
+    // The value of a token is a view into the scanned source, or into storage
+    // owned by the Lexer for string literals containing escapes. Tokens, and
+    // any AST built from them, must not outlive the source buffer and the Lexer.
+    // Identifiers also carry their interned symbol, every other token NoSymbol.
     struct Token
     {
         TokenType type{ TokenType::INVALID };
+        SymbolId symbol{ NoSymbol };
         TokenPosition position{};
-        std::string value{};
+        std::string_view value{};
         friend bool operator==(const Token& l, const Token& r)
         {
             return l.type == r.type
+                && l.symbol == r.symbol
                 && l.position.column == r.position.column
                 && l.position.line == r.position.line
                 && l.value == r.value;
@@ -120,25 +222,55 @@ namespace BBTCompiler
     class Lexer
     {
     public:
+        void scan(std::string_view source);
         void scan(std::istream& stream);
+        void scan(std::istream&& stream) { scan(stream); }
+        // Splits `source` at newlines outside of string literals and lexes the
+        // pieces on `threadCount` threads, or one per hardware thread when 0.
+        // Produces exactly the tokens scan(source) would.
+        void scanParallel(std::string_view source, size_t threadCount = 0, size_t minChunkSize = DefaultChunkSize);
+        static constexpr size_t DefaultChunkSize{ 256 * 1024 };
+        // Pull interface: open() starts lexing `source` and every next() call
+        // returns the following token, END once the source is exhausted.
+        // Nothing is added to getTokens().
+        void open(std::string_view source);
+        Token next();
+        // Offset in the opened source of the token last returned by next()
+        size_t tokenOffset() const { return static_cast<size_t>(m_TokenStart - m_Begin); }
+        // Whether that token is a string literal with escapes, whose value is
+        // in the Lexer's storage instead of the source
+        bool tokenEscaped() const { return m_TokenEscaped; }
         std::vector<Token>& getTokens() { return m_Tokens; }
+        // Identifiers are interned into a StringInterner owned by the Lexer,
+        // or one shared with other Lexers of the same compilation. It is kept
+        // by reset().
+        StringInterner& getInterner() const { return *m_Interner; }
+        void setInterner(std::shared_ptr<StringInterner> interner) { m_Interner = std::move(interner); }
         const std::vector<Token>& getTokens() const { return m_Tokens; }
         void reset();
     private:
         Token m_CurrentToken;
         unsigned char m_CurrentChar;
+        const char* m_Begin{ nullptr };
+        const char* m_TokenStart{ nullptr };
+        const char* m_Cursor{ nullptr };
+        const char* m_End{ nullptr };
+        bool m_TokenEscaped{ false };
         std::vector<Token> m_Tokens;
+        std::list<std::string> m_Storage;
+        std::shared_ptr<StringInterner> m_Interner{ std::make_shared<StringInterner>() };
         TokenPosition m_Position{};
 
+        void skipWhitespace();
+        bool nextChar();
+        unsigned char peekChar() const;
         Token& newToken(TokenType type, TokenPosition position);
-        void processNumLiteral(std::istream& stream);
-        void processStringLiteral(std::istream& stream);
-        void processOperator(std::istream& stream);
-        void processIdentifier(std::istream& stream);
-
-        bool isOperator(unsigned char c);
-        bool isPairedOperator(const std::string& pairString);
-        bool isKeyword(const std::string& word);
+        void processNumLiteral();
+        void processStringLiteral();
+        void processOperator();
+        void processIdentifier();
+        std::string_view unescapeString(const char* begin, const char* end);
+
         void incrementLine(int count = 1);
         void incrementColumn(int count = 1);
     };
@@ -0,0 +1,153 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace BBTCompiler
+{
+    MappedFile::MappedFile(const std::filesystem::path& path)
+    {
+        open(path);
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        swap(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if(this != &other)
+        {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    void MappedFile::swap(MappedFile& other) noexcept
+    {
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_IsOpen, other.m_IsOpen);
+#ifdef _WIN32
+        std::swap(m_File, other.m_File);
+        std::swap(m_Mapping, other.m_Mapping);
+#endif
+    }
+
+#ifdef _WIN32
+    void MappedFile::open(const std::filesystem::path& path)
+    {
+        close();
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("unable to open '" + path.string() + "'");
+
+        LARGE_INTEGER fileSize{};
+        if(!GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            throw std::runtime_error("unable to read the size of '" + path.string() + "'");
+        }
+
+        m_File = file;
+        m_Size = static_cast<size_t>(fileSize.QuadPart);
+        m_IsOpen = true;
+        // Zero length files cannot be mapped, they are exposed as an empty view
+        if(m_Size == 0)
+            return;
+
+        m_Mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!m_Mapping)
+        {
+            close();
+            throw std::runtime_error("unable to map '" + path.string() + "'");
+        }
+        m_Data = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+        if(!m_Data)
+        {
+            close();
+            throw std::runtime_error("unable to map '" + path.string() + "'");
+        }
+    }
+
+    void MappedFile::close()
+    {
+        if(m_Data)
+            UnmapViewOfFile(m_Data);
+        if(m_Mapping)
+            CloseHandle(m_Mapping);
+        if(m_File)
+            CloseHandle(m_File);
+        m_Data = nullptr;
+        m_Mapping = nullptr;
+        m_File = nullptr;
+        m_Size = 0;
+        m_IsOpen = false;
+    }
+#else
+    void MappedFile::open(const std::filesystem::path& path)
+    {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            throw std::runtime_error("unable to open '" + path.string() + "'");
+
+        struct stat fileStat{};
+        if(fstat(fd, &fileStat) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("unable to read the size of '" + path.string() + "'");
+        }
+
+        m_Size = static_cast<size_t>(fileStat.st_size);
+        m_IsOpen = true;
+        // Zero length files cannot be mapped, they are exposed as an empty view
+        if(m_Size == 0)
+        {
+            ::close(fd);
+            return;
+        }
+
+        void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping keeps its own reference to the file
+        ::close(fd);
+        if(data == MAP_FAILED)
+        {
+            m_Size = 0;
+            m_IsOpen = false;
+            throw std::runtime_error("unable to map '" + path.string() + "'");
+        }
+        madvise(data, m_Size, MADV_SEQUENTIAL);
+        m_Data = static_cast<const char*>(data);
+    }
+
+    void MappedFile::close()
+    {
+        if(m_Data)
+            munmap(const_cast<char*>(m_Data), m_Size);
+        m_Data = nullptr;
+        m_Size = 0;
+        m_IsOpen = false;
+    }
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace BBTCompiler
+{
+    // Read-only memory mapping of a whole file. The mapped bytes stay valid
+    // for the lifetime of the object, so views handed out by getView() can be
+    // lexed in place without copying the file into a stream buffer.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::filesystem::path& path);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        ~MappedFile();
+
+        void open(const std::filesystem::path& path);
+        void close();
+        bool isOpen() const { return m_IsOpen; }
+        std::string_view getView() const { return { m_Data, m_Size }; }
+        const char* data() const { return m_Data; }
+        size_t size() const { return m_Size; }
+    private:
+        void swap(MappedFile& other) noexcept;
+    private:
+        const char* m_Data{ nullptr };
+        size_t m_Size{ 0 };
+        bool m_IsOpen{ false };
+#ifdef _WIN32
+        void* m_File{ nullptr };
+        void* m_Mapping{ nullptr };
+#endif
+    };
+}
@@ -0,0 +1,742 @@
+#include "NativeCodeGenerator.h"
+#include "ASTWalker.h"
+#include "Interpreter.h"
+#include "TypeChecker.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        constexpr size_t IntegerRegisterCount{ 6 };
+        constexpr size_t FloatRegisterCount{ 8 };
+        constexpr std::string_view IntegerRegisters[]{ "rdi", "rsi", "rdx", "rcx", "r8", "r9" };
+        constexpr std::string_view SyntaxErrorMessage{ "Cannot compile code with a syntax error." };
+
+        // Text for a .ascii directive
+        std::string escape(std::string_view text)
+        {
+            std::string escaped;
+            escaped.reserve(text.size());
+            for(const char c : text)
+            {
+                const auto byte = static_cast<unsigned char>(c);
+                if(c == '"' || c == '\\')
+                {
+                    escaped += '\\';
+                    escaped += c;
+                }
+                else if(byte < 0x20 || byte >= 0x7F)
+                {
+                    char octal[5];
+                    std::snprintf(octal, sizeof(octal), "\\%03o", byte);
+                    escaped += octal;
+                }
+                else
+                {
+                    escaped += c;
+                }
+            }
+            return escaped;
+        }
+    }
+
+    struct NativeWalk
+    {
+        NativeCodeGenerator& generator;
+
+        void operator()(const AssignmentExpr& expr) const
+        {
+            generator.generate(*expr.m_Value);
+            if(!generator.slot(expr.m_Binding, expr.m_Name))
+                return;
+            generator.store(expr.getType(), generator.address(expr.m_Binding));
+        }
+        void operator()(const BinaryExpr& expr) const { generator.generateBinary(expr); }
+        void operator()(const UnaryExpr& expr) const
+        {
+            generator.generate(*expr.m_Right);
+            if(expr.m_Operator.type == TokenType::NOT)
+            {
+                generator.truth(expr.m_Right->getType());
+                generator.emit("xor eax, 1");
+            }
+            else if(expr.getType() == ExprType::FLOAT)
+            {
+                generator.emit("movq rax, xmm0");
+                generator.emit("btc rax, 63");
+                generator.emit("movq xmm0, rax");
+            }
+            else
+            {
+                generator.emit("neg rax");
+            }
+        }
+        void operator()(const GroupedExpr& expr) const { generator.generate(*expr.m_Expression); }
+        void operator()(const LiteralExpr& expr) const
+        {
+            const Token& token{ expr.m_Token };
+            const char* begin{ token.value.data() };
+            const char* end{ begin + token.value.size() };
+            switch(token.type)
+            {
+            case TokenType::TRUE:
+                generator.emit("mov eax, 1");
+                break;
+            case TokenType::FALSE:
+                generator.emit("xor eax, eax");
+                break;
+            case TokenType::STRING_LITERAL:
+                generator.emit("lea rax, [rip + " + generator.stringConstant(token.value) + "]");
+                break;
+            case TokenType::INT_LITERAL:
+            {
+                int64_t value{ 0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    generator.error(token, "Integer literal '{}' is too large.", token.value, DiagnosticKind::SYNTAX);
+                generator.emit("mov rax, " + std::to_string(value));
+                break;
+            }
+            case TokenType::FLOAT_LITERAL:
+            {
+                double value{ 0.0 };
+                if(std::from_chars(begin, end, value).ec != std::errc{})
+                    value = std::numeric_limits<double>::infinity();
+                generator.emit("movsd xmm0, qword ptr [rip + " + generator.floatConstant(value) + "]");
+                break;
+            }
+            default:
+                generator.error(token, "'{}' is not supported in native code.", token.value);
+                break;
+            }
+        }
+        void operator()(const VariableExpr& expr) const
+        {
+            if(generator.slot(expr.m_Binding, expr.m_Name))
+                generator.load(expr.getType(), generator.address(expr.m_Binding));
+        }
+        void operator()(const CallExpr& expr) const { generator.generateCall(expr); }
+        void operator()(const ErrorExpr& expr) const
+        {
+            generator.error(expr.m_Token, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+        }
+
+        void operator()(const PrintStmt& stmt) const
+        {
+            generator.generate(*stmt.m_Expression);
+            switch(stmt.m_Expression->getType())
+            {
+            case ExprType::INT:
+                generator.emit("mov rsi, rax");
+                generator.emit("lea rdi, [rip + .Lformat_int]");
+                generator.emit("xor eax, eax");
+                break;
+            case ExprType::FLOAT:
+                generator.emit("lea rdi, [rip + .Lformat_float]");
+                generator.emit("mov eax, 1");
+                break;
+            case ExprType::BOOL:
+                generator.emit("lea rsi, [rip + .Ltrue]");
+                generator.emit("lea rdx, [rip + .Lfalse]");
+                generator.emit("test rax, rax");
+                generator.emit("cmovz rsi, rdx");
+                generator.emit("lea rdi, [rip + .Lformat_string]");
+                generator.emit("xor eax, eax");
+                break;
+            case ExprType::CHAR:
+                generator.emit("mov rsi, rax");
+                generator.emit("lea rdi, [rip + .Lformat_string]");
+                generator.emit("xor eax, eax");
+                break;
+            default:
+                return;
+            }
+            generator.call("printf@PLT");
+        }
+        void operator()(const ExprStmt& stmt) const { generator.generate(*stmt.m_Expression); }
+        void operator()(const VariableStmt& stmt) const
+        {
+            const ExprType type{ TypeChecker::declaredType(stmt.m_Type) };
+            if(stmt.m_Initializer)
+                generator.generate(*stmt.m_Initializer);
+            else
+                generator.generateDefault(type);
+            if(stmt.m_Slot == Binding::Unresolved)
+            {
+                generator.error(stmt.m_Name, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+                return;
+            }
+            generator.store(type, NativeCodeGenerator::slotAddress("rbp", stmt.m_Slot));
+        }
+        void operator()(const BlockStmt& stmt) const
+        {
+            generator.generateBlock(AstSpan<Stmt* const>(stmt.m_Statements.data(), stmt.m_Statements.size()));
+        }
+        void operator()(const IfStmt& stmt) const
+        {
+            const std::string elseLabel{ generator.newLabel() };
+            generator.generate(*stmt.m_Condition);
+            generator.truth(stmt.m_Condition->getType());
+            generator.emit("test rax, rax");
+            generator.emit("jz " + elseLabel);
+            if(stmt.m_ThenBranch)
+                generator.generate(*stmt.m_ThenBranch);
+            if(!stmt.m_ElseBranch)
+            {
+                generator.label(elseLabel);
+                return;
+            }
+            const std::string endLabel{ generator.newLabel() };
+            generator.emit("jmp " + endLabel);
+            generator.label(elseLabel);
+            generator.generate(*stmt.m_ElseBranch);
+            generator.label(endLabel);
+        }
+        void operator()(const WhileStmt& stmt) const
+        {
+            // The condition is at the bottom, so an iteration takes one jump
+            const std::string conditionLabel{ generator.newLabel() };
+            const std::string bodyLabel{ generator.newLabel() };
+            generator.emit("jmp " + conditionLabel);
+            generator.label(bodyLabel);
+            if(stmt.m_Body)
+                generator.generate(*stmt.m_Body);
+            generator.label(conditionLabel);
+            generator.generate(*stmt.m_Condition);
+            generator.truth(stmt.m_Condition->getType());
+            generator.emit("test rax, rax");
+            generator.emit("jnz " + bodyLabel);
+        }
+        // Generated after the enclosing block, see generateBlock
+        void operator()(const FuncStmt&) const {}
+        void operator()(const ReturnStmt& stmt) const
+        {
+            if(stmt.m_Value)
+                generator.generate(*stmt.m_Value);
+            // The top level may return anything, main returns 0
+            if(!generator.context().function)
+                generator.emit("xor eax, eax");
+            generator.emit("jmp " + generator.context().returnLabel);
+        }
+        void operator()(const ErrorStmt& stmt) const
+        {
+            generator.error(stmt.m_Token, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+        }
+    };
+
+    bool NativeCodeGenerator::generate(const std::vector<Stmt*>& statements, uint32_t frameSize)
+    {
+        m_Diagnostics.clear();
+        m_Text.clear();
+        m_Data.clear();
+        m_Floats.clear();
+        m_Strings.clear();
+        m_Labels = 0;
+        m_Functions = 0;
+
+        m_Contexts.clear();
+        m_Contexts.push_back(FunctionContext{ nullptr, "main", newLabel(), std::vector<Slot>(frameSize), {} });
+        label("main");
+        prologue(frameSize);
+        emit("mov qword ptr [rbp - 8], 0");
+        generateBlock(AstSpan<Stmt* const>(statements.data(), statements.size()));
+        emit("xor eax, eax");
+        label(context().returnLabel);
+        emit("leave");
+        emit("ret");
+        m_Text += context().code;
+        m_Contexts.clear();
+
+        m_Assembly =
+            "    .intel_syntax noprefix\n"
+            "    .text\n"
+            "    .globl main\n" + m_Text +
+            // Prints a runtime error, rdi the message and esi its length,
+            // after what the program printed so far, and exits
+            "bbt_fail:\n"
+            "    push rbp\n"
+            "    mov rbp, rsp\n"
+            "    and rsp, -16\n"
+            "    mov rbx, rdi\n"
+            "    mov r12d, esi\n"
+            "    xor edi, edi\n"
+            "    call fflush@PLT\n"
+            "    mov edi, 2\n"
+            "    mov rsi, rbx\n"
+            "    mov edx, r12d\n"
+            "    call write@PLT\n"
+            "    mov edi, 70\n"
+            "    call exit@PLT\n"
+            "    .section .rodata\n"
+            ".Lformat_int:\n    .asciz \"%ld\\n\"\n"
+            ".Lformat_float:\n    .asciz \"%g\\n\"\n"
+            ".Lformat_string:\n    .asciz \"%s\\n\"\n"
+            ".Ltrue:\n    .asciz \"true\"\n"
+            ".Lfalse:\n    .asciz \"false\"\n"
+            ".Lnull:\n    .asciz \"null\"\n"
+            "    .p2align 3\n" + m_Data +
+            // Calls of the program's functions in progress
+            "    .bss\n"
+            "    .p2align 3\n"
+            "bbt_depth:\n    .zero 8\n" +
+            "    .section .note.GNU-stack,\"\",@progbits\n";
+        return !m_Diagnostics.hasErrors();
+    }
+
+    void NativeCodeGenerator::generateFunction(const FuncStmt& function, const std::string& name)
+    {
+        const uint32_t frameSize{ std::max(function.m_FrameSize, static_cast<uint32_t>(function.m_Params.size())) };
+        m_Contexts.push_back(FunctionContext{ &function, name, newLabel(), std::vector<Slot>(frameSize), {} });
+        label(name);
+        prologue(frameSize);
+        emit("mov qword ptr [rbp - 8], r10");
+        emit("inc qword ptr [rip + bbt_depth]");
+
+        size_t integers{ 0 };
+        size_t floats{ 0 };
+        for(uint32_t i = 0; i < function.m_Params.size(); ++i)
+        {
+            const bool isFloat{ TypeChecker::declaredType(function.m_Params[i].second) == ExprType::FLOAT };
+            if(isFloat ? floats == FloatRegisterCount : integers == IntegerRegisterCount)
+            {
+                error(function.m_Name, "'{}' has more parameters than native code can pass in registers.", function.m_Name.value);
+                break;
+            }
+            const std::string destination{ slotAddress("rbp", i) };
+            if(isFloat)
+                emit("movsd " + destination + ", xmm" + std::to_string(floats++));
+            else
+                emit("mov " + destination + ", " + std::string(IntegerRegisters[integers++]));
+        }
+
+        generateBlock(AstSpan<Stmt* const>(function.m_Body.data(), function.m_Body.size()));
+        // Falling off the end returns zero
+        emit("xor eax, eax");
+        emit("xorpd xmm0, xmm0");
+        label(context().returnLabel);
+        emit("dec qword ptr [rip + bbt_depth]");
+        emit("leave");
+        emit("ret");
+        m_Text += context().code;
+        m_Contexts.pop_back();
+    }
+
+    void NativeCodeGenerator::prologue(uint32_t frameSize)
+    {
+        // The static link and the slots, rounded up to keep rsp aligned
+        const uint32_t bytes{ (8 + 8 * frameSize + 15) & ~15u };
+        emit("push rbp");
+        emit("mov rbp, rsp");
+        emit("sub rsp, " + std::to_string(bytes));
+    }
+
+    void NativeCodeGenerator::generateBlock(AstSpan<Stmt* const> statements)
+    {
+        // Functions of the block can be called before their declaration,
+        // like the Resolver declares them. They are called directly, so
+        // their slots only hold what a call needs to know. Their code is
+        // generated after the block's, when the types of the variables they
+        // can see are known.
+        std::vector<const FuncStmt*> functions;
+        size_t lastFunction{ 0 };
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::FUNCTION)
+                continue;
+            lastFunction = i;
+            const auto& function = static_cast<const FuncStmt&>(*statements[i]);
+            if(function.m_Slot == Binding::Unresolved)
+                continue;
+            Slot& slot{ context().slots[function.m_Slot] };
+            slot.function = &function;
+            slot.label = "bbt_" + std::string(function.m_Name.value) + "_" + std::to_string(++m_Functions);
+            functions.push_back(&function);
+        }
+        // A call to one of them can read a variable declared ahead of the
+        // function before the variable's declaration runs, so the variable
+        // starts with its default value instead of what was on the stack
+        for(size_t i = 0; i < lastFunction; ++i)
+        {
+            if(statements[i]->getKind() != StmtKind::VARIABLE)
+                continue;
+            const auto& variable = static_cast<const VariableStmt&>(*statements[i]);
+            const ExprType type{ TypeChecker::declaredType(variable.m_Type) };
+            if(variable.m_Slot == Binding::Unresolved)
+                continue;
+            generateDefault(type);
+            store(type, slotAddress("rbp", variable.m_Slot));
+        }
+        for(const Stmt* statement : statements)
+            generate(*statement);
+        for(const FuncStmt* function : functions)
+        {
+            const std::string name{ context().slots[function->m_Slot].label };
+            // The enclosing function's code continues after the nested one
+            std::string code{ std::move(context().code) };
+            context().code.clear();
+            generateFunction(*function, name);
+            context().code = std::move(code);
+        }
+    }
+
+    void NativeCodeGenerator::generateDefault(ExprType type)
+    {
+        if(type == ExprType::FLOAT)
+            emit("xorpd xmm0, xmm0");
+        // Like the Interpreter, which prints the null a char starts with
+        else if(type == ExprType::CHAR)
+            emit("lea rax, [rip + .Lnull]");
+        else
+            emit("xor eax, eax");
+    }
+
+    void NativeCodeGenerator::generate(const Stmt& stmt)
+    {
+        visitAst(stmt, NativeWalk{ *this });
+    }
+
+    void NativeCodeGenerator::generate(const Expr& expr)
+    {
+        visitAst(expr, NativeWalk{ *this });
+    }
+
+    void NativeCodeGenerator::generateCall(const CallExpr& expr)
+    {
+        if(expr.m_Callee->getKind() != ExprKind::VARIABLE)
+        {
+            error(expr.m_Paren, "Native code can only call functions by name.");
+            return;
+        }
+        const auto& callee = static_cast<const VariableExpr&>(*expr.m_Callee);
+        const Slot* slot{ this->slot(callee.m_Binding, callee.m_Name) };
+        if(!slot || !slot->function)
+            return;
+        const std::string target{ slot->label };
+        // Calls nested deeper than in the Interpreter are its stack overflow
+        const std::string callLabel{ newLabel() };
+        emit("cmp qword ptr [rip + bbt_depth], " + std::to_string(Interpreter::MaxCallDepth));
+        emit("jb " + callLabel);
+        fail(expr.m_Paren, "Stack overflow.");
+        label(callLabel);
+        for(const Expr* argument : expr.m_Args)
+        {
+            generate(*argument);
+            push(argument->getType());
+        }
+
+        // The callee's static link is the frame it was declared in
+        if(callee.m_Binding.depth == 0)
+        {
+            emit("mov r10, rbp");
+        }
+        else
+        {
+            emit("mov r10, qword ptr [rbp - 8]");
+            for(uint32_t depth = 1; depth < callee.m_Binding.depth; ++depth)
+                emit("mov r10, qword ptr [r10 - 8]");
+        }
+        size_t integers{ 0 };
+        size_t floats{ 0 };
+        for(const Expr* argument : expr.m_Args)
+            ++(argument->getType() == ExprType::FLOAT ? floats : integers);
+        // Arguments beyond the registers are reported for the callee
+        if(integers > IntegerRegisterCount || floats > FloatRegisterCount)
+            return;
+        for(size_t i = expr.m_Args.size(); i-- > 0;)
+        {
+            if(expr.m_Args[i]->getType() == ExprType::FLOAT)
+            {
+                emit("movsd xmm" + std::to_string(--floats) + ", qword ptr [rsp]");
+                emit("add rsp, 8");
+            }
+            else
+            {
+                emit("pop " + std::string(IntegerRegisters[--integers]));
+            }
+            --context().pushed;
+        }
+        call(target);
+    }
+
+    void NativeCodeGenerator::generateBinary(const BinaryExpr& expr)
+    {
+        const Token& op{ expr.m_Operator };
+        if(op.type == TokenType::AND || op.type == TokenType::OR)
+        {
+            const std::string endLabel{ newLabel() };
+            generate(*expr.m_Left);
+            truth(expr.m_Left->getType());
+            emit("test rax, rax");
+            emit((op.type == TokenType::AND ? "jz " : "jnz ") + endLabel);
+            generate(*expr.m_Right);
+            truth(expr.m_Right->getType());
+            label(endLabel);
+            return;
+        }
+
+        const ExprType left{ expr.m_Left->getType() };
+        const ExprType right{ expr.m_Right->getType() };
+        generate(*expr.m_Left);
+        push(left);
+        generate(*expr.m_Right);
+        pop(left);
+
+        const bool numbers{ (left == ExprType::INT || left == ExprType::FLOAT) && (right == ExprType::INT || right == ExprType::FLOAT) };
+        if((op.type == TokenType::EQ_EQ || op.type == TokenType::NOT_EQ) && !numbers)
+        {
+            if(left == ExprType::CHAR)
+            {
+                // Strings compare by their text, like in the Interpreter
+                emit("mov rdi, rcx");
+                emit("mov rsi, rax");
+                call("strcmp@PLT");
+                emit("test eax, eax");
+            }
+            else
+            {
+                emit("cmp rcx, rax");
+            }
+            emit(op.type == TokenType::EQ_EQ ? "sete al" : "setne al");
+            emit("movzx eax, al");
+            return;
+        }
+        // The TypeChecker lets two chars concatenate
+        if(!numbers)
+        {
+            error(op, "'{}' on strings is not supported in native code.", op.value);
+            return;
+        }
+
+        if(left == ExprType::INT && right == ExprType::INT)
+        {
+            switch(op.type)
+            {
+            case TokenType::PLUS: emit("add rax, rcx"); return;
+            case TokenType::MINUS:
+                emit("sub rcx, rax");
+                emit("mov rax, rcx");
+                return;
+            case TokenType::STAR: emit("imul rax, rcx"); return;
+            case TokenType::SLASH: generateDivision(op); return;
+            default: break;
+            }
+            emit("cmp rcx, rax");
+            switch(op.type)
+            {
+            case TokenType::EQ_EQ: emit("sete al"); break;
+            case TokenType::NOT_EQ: emit("setne al"); break;
+            case TokenType::LESS: emit("setl al"); break;
+            case TokenType::LESS_EQ: emit("setle al"); break;
+            case TokenType::GREATER: emit("setg al"); break;
+            case TokenType::GREATER_EQ: emit("setge al"); break;
+            default:
+                error(op, "Unsupported operator '{}'.", op.value);
+                return;
+            }
+            emit("movzx eax, al");
+            return;
+        }
+
+        // Mixed operands are compared and computed as floats, left in xmm1
+        if(left == ExprType::INT)
+            emit("cvtsi2sd xmm1, rcx");
+        if(right == ExprType::INT)
+            emit("cvtsi2sd xmm0, rax");
+        switch(op.type)
+        {
+        case TokenType::PLUS: emit("addsd xmm1, xmm0"); break;
+        case TokenType::MINUS: emit("subsd xmm1, xmm0"); break;
+        case TokenType::STAR: emit("mulsd xmm1, xmm0"); break;
+        case TokenType::SLASH: emit("divsd xmm1, xmm0"); break;
+        // Comparisons are ordered so that NaN operands give false
+        case TokenType::LESS: emit("ucomisd xmm0, xmm1"); emit("seta al"); break;
+        case TokenType::LESS_EQ: emit("ucomisd xmm0, xmm1"); emit("setae al"); break;
+        case TokenType::GREATER: emit("ucomisd xmm1, xmm0"); emit("seta al"); break;
+        case TokenType::GREATER_EQ: emit("ucomisd xmm1, xmm0"); emit("setae al"); break;
+        case TokenType::EQ_EQ:
+            emit("ucomisd xmm1, xmm0");
+            emit("sete al");
+            emit("setnp cl");
+            emit("and al, cl");
+            break;
+        case TokenType::NOT_EQ:
+            emit("ucomisd xmm1, xmm0");
+            emit("setne al");
+            emit("setp cl");
+            emit("or al, cl");
+            break;
+        default:
+            error(op, "Unsupported operator '{}'.", op.value);
+            return;
+        }
+        if(expr.getType() == ExprType::FLOAT)
+            emit("movapd xmm0, xmm1");
+        else
+            emit("movzx eax, al");
+    }
+
+    void NativeCodeGenerator::generateDivision(const Token& op)
+    {
+        // rcx / rax. Division by zero is the Interpreter's runtime error, and
+        // dividing by -1 negates so the minimum integer wraps instead of
+        // trapping.
+        const std::string divideLabel{ newLabel() };
+        const std::string negateLabel{ newLabel() };
+        const std::string endLabel{ newLabel() };
+        emit("test rax, rax");
+        emit("jnz " + divideLabel);
+        fail(op, "Division by zero.");
+        label(divideLabel);
+        emit("cmp rax, -1");
+        emit("je " + negateLabel);
+        emit("mov r8, rax");
+        emit("mov rax, rcx");
+        emit("cqo");
+        emit("idiv r8");
+        emit("jmp " + endLabel);
+        label(negateLabel);
+        emit("mov rax, rcx");
+        emit("neg rax");
+        label(endLabel);
+    }
+
+    void NativeCodeGenerator::fail(const Token& token, std::string_view message)
+    {
+        const std::string text{ Diagnostics::format(Diagnostic{ token, message, {}, DiagnosticKind::RUNTIME }, m_Filename) + "\n" };
+        emit("lea rdi, [rip + " + stringConstant(text) + "]");
+        emit("mov esi, " + std::to_string(text.size()));
+        emit("call bbt_fail");
+    }
+
+    NativeCodeGenerator::Slot* NativeCodeGenerator::slot(const Binding& binding, const Token& name)
+    {
+        if(!binding.isResolved() || binding.depth >= m_Contexts.size())
+        {
+            error(name, "Undefined name '{}'.", name.value, DiagnosticKind::NAME);
+            return nullptr;
+        }
+        return &m_Contexts[m_Contexts.size() - 1 - binding.depth].slots[binding.slot];
+    }
+
+    std::string NativeCodeGenerator::address(const Binding& binding)
+    {
+        if(binding.depth == 0)
+            return slotAddress("rbp", binding.slot);
+        emit("mov r11, qword ptr [rbp - 8]");
+        for(uint32_t depth = 1; depth < binding.depth; ++depth)
+            emit("mov r11, qword ptr [r11 - 8]");
+        return slotAddress("r11", binding.slot);
+    }
+
+    std::string NativeCodeGenerator::slotAddress(std::string_view base, uint32_t slot)
+    {
+        return "qword ptr [" + std::string(base) + " - " + std::to_string(16 + 8 * static_cast<uint64_t>(slot)) + "]";
+    }
+
+    void NativeCodeGenerator::load(ExprType type, const std::string& address)
+    {
+        emit(type == ExprType::FLOAT ? "movsd xmm0, " + address : "mov rax, " + address);
+    }
+
+    void NativeCodeGenerator::store(ExprType type, const std::string& address)
+    {
+        emit(type == ExprType::FLOAT ? "movsd " + address + ", xmm0" : "mov " + address + ", rax");
+    }
+
+    void NativeCodeGenerator::push(ExprType type)
+    {
+        if(type == ExprType::FLOAT)
+        {
+            emit("sub rsp, 8");
+            emit("movsd qword ptr [rsp], xmm0");
+        }
+        else
+        {
+            emit("push rax");
+        }
+        ++context().pushed;
+    }
+
+    void NativeCodeGenerator::pop(ExprType type)
+    {
+        if(type == ExprType::FLOAT)
+        {
+            emit("movsd xmm1, qword ptr [rsp]");
+            emit("add rsp, 8");
+        }
+        else
+        {
+            emit("pop rcx");
+        }
+        --context().pushed;
+    }
+
+    void NativeCodeGenerator::call(std::string_view function)
+    {
+        const bool pad{ context().pushed % 2 != 0 };
+        if(pad)
+            emit("sub rsp, 8");
+        emit("call " + std::string(function));
+        if(pad)
+            emit("add rsp, 8");
+    }
+
+    void NativeCodeGenerator::truth(ExprType type)
+    {
+        if(type != ExprType::BOOL)
+            emit("mov eax, 1");
+    }
+
+    void NativeCodeGenerator::emit(std::string_view instruction)
+    {
+        std::string& code{ context().code };
+        code += "    ";
+        code += instruction;
+        code += '\n';
+    }
+
+    void NativeCodeGenerator::label(std::string_view name)
+    {
+        std::string& code{ context().code };
+        code += name;
+        code += ":\n";
+    }
+
+    std::string NativeCodeGenerator::newLabel()
+    {
+        return ".L" + std::to_string(m_Labels++);
+    }
+
+    std::string NativeCodeGenerator::floatConstant(double value)
+    {
+        // Written as its bits so the value is exact
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto [entry, inserted] = m_Floats.emplace(bits, std::string{});
+        if(inserted)
+        {
+            entry->second = ".LF" + std::to_string(m_Floats.size() - 1);
+            m_Data += entry->second + ":\n    .quad " + std::to_string(bits) + "\n";
+        }
+        return entry->second;
+    }
+
+    std::string NativeCodeGenerator::stringConstant(std::string_view value)
+    {
+        if(const auto found{ m_Strings.find(value) }; found != m_Strings.end())
+            return found->second;
+        std::string name{ ".LS" + std::to_string(m_Strings.size()) };
+        m_Data += name + ":\n    .asciz \"" + escape(value) + "\"\n";
+        m_Strings.emplace(std::string(value), name);
+        return name;
+    }
+
+    void NativeCodeGenerator::error(const Token& token, std::string_view message, std::string_view argument,
+                                    DiagnosticKind kind)
+    {
+        m_Diagnostics.report(token, message, argument, kind);
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Diagnostics.h"
+#include "Expression.h"
+#include "Statement.h"
+
+namespace BBTCompiler
+{
+    // Compiles a program the TypeChecker has checked to x86-64 assembly for
+    // the GNU assembler (Intel syntax) and the System V ABI. The top level
+    // becomes main, every function a function of its own, and print calls
+    // printf, so the output is linked with the C library, e.g. with
+    // `cc program.s -o program`.
+    //
+    // Native code handles the statically typed part of the language: int,
+    // bool and float values, char values holding string literals, if and
+    // while, and calls of functions by name. The code for an expression
+    // follows the type the TypeChecker stored in it, see Expr::getType, and
+    // what the checker accepts but native code does not support, null and
+    // string operations other than == and !=, is reported as a type error.
+    // Otherwise the program behaves like it does in the Interpreter,
+    // including the division by zero and stack overflow runtime errors.
+    //
+    // Frames are addressed from rbp: the static link, the frame of the
+    // enclosing function, is at rbp - 8 and slot i at rbp - 16 - 8 * i.
+    // Functions take their arguments in the System V argument registers,
+    // at most 6 integer and 8 float ones, and the static link in r10.
+    // Expression results are in rax, or xmm0 for floats, temporaries are
+    // pushed on the machine stack.
+    class NativeCodeGenerator
+    {
+    public:
+        // `filename` appears in the runtime error messages of the program
+        explicit NativeCodeGenerator(std::string_view filename = "file") : m_Filename{ filename } {}
+
+        // `frameSize` is the size the Resolver computed for the top level.
+        // Returns false if the program could not be compiled.
+        bool generate(const std::vector<Stmt*>& statements, uint32_t frameSize);
+        const std::string& getAssembly() const { return m_Assembly; }
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+    private:
+        // Variables need no more than their address, functions are called
+        // directly by their label
+        struct Slot
+        {
+            const FuncStmt* function{ nullptr };
+            std::string label;
+        };
+        struct FunctionContext
+        {
+            const FuncStmt* function;
+            std::string label;
+            std::string returnLabel;
+            std::vector<Slot> slots;
+            std::string code;
+            // 8-byte temporaries pushed at the current instruction
+            uint32_t pushed{ 0 };
+        };
+
+        friend struct NativeWalk;
+        void generateFunction(const FuncStmt& function, const std::string& label);
+        void prologue(uint32_t frameSize);
+        void generateBlock(AstSpan<Stmt* const> statements);
+        // Puts the value a variable declared without an initializer starts
+        // with in rax, or xmm0 for floats
+        void generateDefault(ExprType type);
+        void generate(const Stmt& stmt);
+        void generate(const Expr& expr);
+        void generateCall(const CallExpr& expr);
+        void generateBinary(const BinaryExpr& expr);
+        void generateDivision(const Token& op);
+        // Exits the program with the runtime error `message` at `token`
+        void fail(const Token& token, std::string_view message);
+
+        FunctionContext& context() { return m_Contexts.back(); }
+        // The slot a binding refers to, null after reporting an error
+        Slot* slot(const Binding& binding, const Token& name);
+        // Address of a binding's slot, loads the frame into r11 if needed
+        std::string address(const Binding& binding);
+        static std::string slotAddress(std::string_view base, uint32_t slot);
+        void load(ExprType type, const std::string& address);
+        void store(ExprType type, const std::string& address);
+        void push(ExprType type);
+        // Pops a temporary into rcx, or xmm1 for floats
+        void pop(ExprType type);
+        // Calls `function` with rsp aligned to 16 bytes
+        void call(std::string_view function);
+        // Turns the value in rax into 0 or 1 as a condition, values of
+        // other types than bool are always true
+        void truth(ExprType type);
+
+        void emit(std::string_view instruction);
+        void label(std::string_view name);
+        std::string newLabel();
+        std::string floatConstant(double value);
+        std::string stringConstant(std::string_view value);
+        void error(const Token& token, std::string_view message, std::string_view argument = {},
+                   DiagnosticKind kind = DiagnosticKind::TYPE);
+    private:
+        std::string m_Filename;
+        Diagnostics m_Diagnostics;
+        std::vector<FunctionContext> m_Contexts;
+        std::string m_Text;
+        std::string m_Data;
+        std::string m_Assembly;
+        uint32_t m_Labels{ 0 };
+        uint32_t m_Functions{ 0 };
+        std::map<uint64_t, std::string> m_Floats;
+        std::map<std::string, std::string, std::less<>> m_Strings;
+    };
+}
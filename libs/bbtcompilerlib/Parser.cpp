@@ -1,41 +1,100 @@
 #include "Parser.h"
-#include <iterator>
-#include <iostream>
 
 namespace BBTCompiler
 {
+    namespace
+    {
+        constexpr TokenSet TypeNames{ TokenType::INT, TokenType::CHAR, TokenType::BOOL, TokenType::FLOAT };
+        constexpr TokenSet UnaryOperators{ TokenType::NOT, TokenType::MINUS };
+        constexpr TokenSet Literals{
+            TokenType::TRUE, TokenType::FALSE, TokenType::NIL, TokenType::INT_LITERAL,
+            TokenType::FLOAT_LITERAL, TokenType::STRING_LITERAL
+        };
+        // Tokens error recovery stops before, as they start a new statement
+        constexpr TokenSet StatementStarts{
+            TokenType::FN, TokenType::LET, TokenType::PRINT, TokenType::IF,
+            TokenType::WHILE, TokenType::FOR, TokenType::RETURN
+        };
+
+        // Child lists are collected on a stack shared by the whole parse and
+        // copied into the AstContext once complete. A scope pops its entries
+        // on exit.
+        template<typename T>
+        class ScratchScope
+        {
+        public:
+            explicit ScratchScope(std::vector<T>& scratch)
+                : m_Scratch{ scratch }, m_Base{ scratch.size() }
+            {}
+            ~ScratchScope() { m_Scratch.erase(m_Scratch.begin() + m_Base, m_Scratch.end()); }
+            void push(const T& item) { m_Scratch.push_back(item); }
+            AstSpan<T> copyTo(AstContext& context) const
+            {
+                return context.copyArray(m_Scratch.data() + m_Base, m_Scratch.size() - m_Base);
+            }
+        private:
+            std::vector<T>& m_Scratch;
+            size_t m_Base;
+        };
+    }
+
     Parser::Parser(std::vector<Token>& tokens)
-        : m_Tokens{ tokens }, m_Current{ tokens.begin() }
+        : m_Tokens{ tokens }
     {
     }
 
-    Token& Parser::advance()
+    Parser::Parser(Lexer& lexer)
+        : m_Tokens{ lexer }
     {
-        if(!isAtEnd())
-            std::advance(m_Current, 1);
-        return previous();
     }
 
-    Token& Parser::previous()
+    Parser::Parser(const TokenBuffer& tokens)
+        : m_Tokens{ tokens }
     {
-        return m_Current != m_Tokens.begin() ? *std::prev(m_Current) : *m_Current;
     }
 
-    Token& Parser::peek()
+    const Token& Parser::advance()
     {
-        return *m_Current;
+        m_Tokens.advance();
+        const Token& token{ previous() };
+        m_OpenBraces += (token.type == TokenType::LEFT_BRACE) - (token.type == TokenType::RIGHT_BRACE);
+        return token;
     }
 
-    Token& Parser::consume(TokenType type, const std::string& errorMsg)
+    const Token& Parser::previous()
+    {
+        return m_Tokens.previous();
+    }
+
+    const Token& Parser::peek()
+    {
+        return m_Tokens.peek();
+    }
+
+    const Token& Parser::consume(TokenType type, std::string_view errorMsg, std::string_view argument)
     {
         if(check(type))
             return advance();
-        throw std::runtime_error(syntaxErrorMsg("file", peek(), errorMsg));
+        error(peek(), errorMsg, argument);
+        return peek();
+    }
+
+    void Parser::error(const Token& token, std::string_view message, std::string_view argument)
+    {
+        // Only the first error of a declaration is reported, the rest are
+        // usually caused by it
+        if(m_Panic)
+            return;
+        m_Diagnostics.report(token, message, argument);
+        m_Panic = true;
     }
 
     bool Parser::isAtEnd()
     {
-        return m_Current->type == TokenType::END;
+        // After an error nothing matches and every loop stops, so the parse
+        // functions return straight up to parseDeclaration like an exception
+        // would, without consuming tokens
+        return m_Panic || m_Tokens.isAtEnd();
     }
 
     bool Parser::check(TokenType type)
@@ -43,14 +102,12 @@ namespace BBTCompiler
         return isAtEnd() ? false : peek().type == type;
     }
 
-    bool Parser::check(const std::vector<TokenType>& types)
+    bool Parser::check(TokenSet types)
     {
-        for(const auto& type : types)
-            if(peek().type == type) return true;
-        return false;
+        return isAtEnd() ? false : types.contains(peek().type);
     }
 
-    bool Parser::match(const TokenType& type)
+    bool Parser::match(TokenType type)
     {
         if (check(type)) {
             advance();
@@ -59,50 +116,71 @@ namespace BBTCompiler
         return false;
     }
 
-    bool Parser::match(const std::vector<TokenType>& types)
+    bool Parser::match(TokenSet types)
     {
-        for (TokenType type : types)
-        {
-            if (match(type))
-                return true;
+        if (check(types)) {
+            advance();
+            return true;
         }
         return false;
     }
 
-    std::vector<std::unique_ptr<Stmt>>& Parser::parse()
+    std::vector<Stmt*>& Parser::parse()
     {
-        while(!isAtEnd())
+        if(m_Iterative)
         {
-            if(std::unique_ptr<Stmt> statement{ parseDeclaration() })
-                m_Statements.push_back(std::move(statement));
+            parseIteratively();
+            return m_Statements;
         }
+        while(!isAtEnd())
+            m_Statements.push_back(parseDeclaration());
         return m_Statements;
     }
 
-    std::vector<std::unique_ptr<Stmt>> Parser::parseBlock()
+    bool Parser::checkNesting(size_t depth)
+    {
+        if(depth <= m_NestingLimit)
+            return true;
+        error(peek(), "Too deeply nested.");
+        return false;
+    }
+
+    // Every recursive cycle of the parser passes through a function that
+    // enters a nesting level: parseBlock, parseNestedStatement or parsePrecedence
+    bool Parser::enterNesting()
     {
-        std::vector<std::unique_ptr<Stmt>> statements;
+        if(!checkNesting(m_Depth + 1))
+            return false;
+        ++m_Depth;
+        return true;
+    }
+
+    AstSpan<Stmt*> Parser::parseBlock()
+    {
+        if(!enterNesting())
+            return {};
+        ScratchScope<Stmt*> statements{ m_StmtScratch };
         while(!check(TokenType::RIGHT_BRACE) && !isAtEnd())
-            statements.push_back(std::move(parseDeclaration()));
+            statements.push(parseDeclaration());
         
         consume(TokenType::RIGHT_BRACE, "Expect '}' after block.");
-        return statements;
+        leaveNesting();
+        return statements.copyTo(m_Context);
     }
 
-    std::unique_ptr<Stmt> Parser::parseDeclaration()
+    Stmt* Parser::parseDeclaration()
     {
-        try
-        {
-            if(match(TokenType::FN)) return parseFunctionStatement("function");
-            if(match(TokenType::LET)) return parseVariableDeclaration();
-            return parseStatement();
-        }
-        catch (const std::exception& e)
-        {
-            synchronize();
-            std::cerr << e.what();
-        }
-        return nullptr;
+        const DeclarationStart start{ declarationStart() };
+        Stmt* statement{};
+        if(match(TokenType::FN)) statement = parseFunctionStatement("function");
+        else if(match(TokenType::LET)) statement = parseVariableDeclaration();
+        else statement = parseStatement();
+        if(!m_Panic)
+            return statement;
+
+        m_Panic = false;
+        synchronize(start);
+        return m_Context.create<ErrorStmt>(m_Diagnostics.getDiagnostics().back().token);
     }
 
     std::pair<Token, Token> Parser::parseNewVariable()
@@ -116,50 +194,71 @@ namespace BBTCompiler
 
     Token Parser::parseType()
     {
-        if (check({ TokenType::INT, TokenType::CHAR, TokenType::BOOL, TokenType::FLOAT }))
+        if (check(TypeNames))
             return advance();
         else if (check(TokenType::IDENTIFIER))
             return advance();
         else
-            throw std::runtime_error(syntaxErrorMsg("file", peek(), "Expect '<variable type>'."));
+        {
+            error(peek(), "Expect '<variable type>'.");
+            return peek();
+        }
     }
     
-    std::unique_ptr<Stmt> Parser::parseVariableDeclaration()
+    Stmt* Parser::parseVariableDeclaration()
     {
         const auto [name, type] = parseNewVariable();
-        std::unique_ptr<Expr> initializer{ match(TokenType::EQ) ? parseExpression() : nullptr };
+        Expr* initializer{ match(TokenType::EQ) ? parseExpression() : nullptr };
 
         consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.");
-        return std::make_unique<VariableStmt>(VariableStmt{ name, type, std::move(initializer) });
+        return m_Context.create<VariableStmt>(name, type, initializer);
     }
 
-    std::unique_ptr<Stmt> Parser::parseStatement()
+    Stmt* Parser::parseStatement()
     {
         if(match(TokenType::FOR)) return parseForStatement();
         if(match(TokenType::IF)) return parseIfStatement();
         if(match(TokenType::PRINT)) return parsePrintStatement();
         if(match(TokenType::RETURN)) return parseReturnStatement();
         if(match(TokenType::WHILE)) return parseWhileStatement();
-        if(match(TokenType::LEFT_BRACE)) return std::make_unique<BlockStmt>(BlockStmt{parseBlock()});
+        if(match(TokenType::LEFT_BRACE)) return m_Context.create<BlockStmt>(parseBlock());
         return parseExpressionStatement();
     }
 
-    std::unique_ptr<Stmt> Parser::parseExpressionStatement()
+    // The body of an if, while or for statement
+    Stmt* Parser::parseNestedStatement()
+    {
+        if(!enterNesting())
+            return m_Context.create<ErrorStmt>(peek());
+        Stmt* statement{ parseStatement() };
+        leaveNesting();
+        return statement;
+    }
+
+    Stmt* Parser::parseExpressionStatement()
     {
         auto expression = parseExpression();
         consume(TokenType::SEMICOLON, "Expect ';' after expression.");
-        return std::make_unique<ExprStmt>(expression.release());
+        return m_Context.create<ExprStmt>(expression);
+    }
+
+    Stmt* Parser::parseFunctionStatement(std::string_view kind)
+    {
+        const FunctionHeader header{ parseFunctionHeader(kind) };
+        auto body{ parseBlock() };
+        return m_Context.create<FuncStmt>(header.name, header.returnType, header.params, body);
     }
 
-    std::unique_ptr<Stmt> Parser::parseFunctionStatement(const std::string& kind)
+    // Everything up to and including the '{' starting the body
+    Parser::FunctionHeader Parser::parseFunctionHeader(std::string_view kind)
     {
-        Token name{ consume(TokenType::IDENTIFIER, "Expect " + kind + "name.") };
-        consume(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.");
-        std::vector<std::pair<Token,Token>> parameters;
+        Token name{ consume(TokenType::IDENTIFIER, "Expect {} name.", kind) };
+        consume(TokenType::LEFT_PAREN, "Expect '(' after {} name.", kind);
+        ScratchScope<std::pair<Token,Token>> parameters{ m_ParamScratch };
         if(!check(TokenType::RIGHT_PAREN))
         {
             do {
-                parameters.emplace_back(parseNewVariable());
+                parameters.push(parseNewVariable());
             } while (match(TokenType::COMMA));
         }
         consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
@@ -169,280 +268,544 @@ namespace BBTCompiler
             advance();
             returnType = parseType();
         }
-        consume(TokenType::LEFT_BRACE, "Expect '{' before " + kind + "body.");
-        auto body{ parseBlock() };
-        return std::make_unique<FuncStmt>(name, returnType, std::move(parameters), std::move(body));
+        consume(TokenType::LEFT_BRACE, "Expect '{' before {} body.", kind);
+        return FunctionHeader{ name, returnType, parameters.copyTo(m_Context) };
     }
 
-    std::unique_ptr<Stmt> Parser::parseReturnStatement()
+    Stmt* Parser::parseReturnStatement()
     {
         Token returnKeyword = previous();
-        std::unique_ptr<Expr> value{};
+        Expr* value{};
         if(!check(TokenType::SEMICOLON))
             value = parseExpression();
 
         consume(TokenType::SEMICOLON, "Expect ';' after return value.");
-        return std::make_unique<ReturnStmt>(returnKeyword, std::move(value));
+        return m_Context.create<ReturnStmt>(returnKeyword, value);
     }
 
-    std::unique_ptr<Stmt> Parser::parsePrintStatement()
+    Stmt* Parser::parsePrintStatement()
     {
-        std::unique_ptr<Expr> expression{ parseExpression() };
+        Expr* expression{ parseExpression() };
         consume(TokenType::SEMICOLON, "Expect ';' after value.");
-        return std::make_unique<PrintStmt>(PrintStmt{ std::move(expression) });
+        return m_Context.create<PrintStmt>(expression);
     }
 
-    std::unique_ptr<Stmt> Parser::parseForStatement()
+    Stmt* Parser::parseForStatement()
+    {
+        const ForClauses clauses{ parseForClauses() };
+        Stmt* body{ parseNestedStatement() };
+        return finishFor(clauses, body);
+    }
+
+    Parser::ForClauses Parser::parseForClauses()
     {
         consume(TokenType::LEFT_PAREN, "Expect '(' after 'for'.");
 
-        std::unique_ptr<Stmt> initializer{};
+        Stmt* initializer{};
         if(match(TokenType::SEMICOLON))
-            initializer.reset();
+            initializer = nullptr;
         if(match(TokenType::LET))
             initializer = parseVariableDeclaration();
         else
             initializer = parseExpressionStatement();
 
-        std::unique_ptr<Expr> condition{};
+        Expr* condition{};
         if(!check(TokenType::SEMICOLON))
             condition = parseExpression();
 
         consume(TokenType::SEMICOLON, "Expect ';' after loop condition.");
 
-        std::unique_ptr<Expr> increment{};
+        Expr* increment{};
         if(!check(TokenType::RIGHT_PAREN))
             increment = parseExpression();
         consume(TokenType::RIGHT_PAREN, "Expect ')' after for clauses.");
+        return ForClauses{ initializer, condition, increment };
+    }
 
-        std::unique_ptr<Stmt> body = parseStatement();
+    // Lowers the loop to a while statement
+    Stmt* Parser::finishFor(const ForClauses& clauses, Stmt* body)
+    {
+        auto [initializer, condition, increment] = clauses;
         if(increment)
         {
-            std::vector<std::unique_ptr<Stmt>> innerBlock;
-            innerBlock.push_back(std::move(body));
-            innerBlock.push_back(std::make_unique<ExprStmt>(ExprStmt{ increment.release() }));
-            body = std::make_unique<BlockStmt>(std::move(innerBlock));
+            Stmt* const innerBlock[]{ body, m_Context.create<ExprStmt>(increment) };
+            body = m_Context.create<BlockStmt>(m_Context.copyArray(innerBlock, 2));
         }
 
-        if(!condition) condition = std::make_unique<LiteralExpr>(LiteralExpr{ Token{TokenType::TRUE,{},"true"} });
-        body = std::make_unique<WhileStmt>(WhileStmt{ std::move(condition), std::move(body) });
+        if(!condition) condition = m_Context.create<LiteralExpr>(Token{TokenType::TRUE,NoSymbol,{},"true"});
+        body = m_Context.create<WhileStmt>(condition, body);
 
         if(initializer)
         {
-            std::vector<std::unique_ptr<Stmt>> innerBlock;
-            innerBlock.push_back(std::move(initializer));
-            innerBlock.push_back(std::move(body));
-            body = std::make_unique<BlockStmt>(std::move(innerBlock));
+            Stmt* const innerBlock[]{ initializer, body };
+            body = m_Context.create<BlockStmt>(m_Context.copyArray(innerBlock, 2));
         }
         return body;
     }
 
-    std::unique_ptr<Stmt> Parser::parseWhileStatement()
+    Stmt* Parser::parseWhileStatement()
     {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'while'.");
-        auto condition{ parseExpression() };
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after condition.");
-        auto body{parseStatement()};
-        return std::make_unique<WhileStmt>(WhileStmt{ std::move(condition), std::move(body) });
+        auto condition{ parseCondition("Expect '(' after 'while'.", "Expect ')' after condition.") };
+        auto body{ parseNestedStatement() };
+        return m_Context.create<WhileStmt>(condition, body);
     }
 
-    std::unique_ptr<Stmt> Parser::parseIfStatement()
+    Stmt* Parser::parseIfStatement()
     {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'if'.");
-        auto condition = parseExpression();
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after if condition.");
+        auto condition = parseCondition("Expect '(' after 'if'.", "Expect ')' after if condition.");
 
-        auto thenBranch = parseStatement();
-        std::unique_ptr<Stmt> elseBranch{ match(TokenType::ELSE) ? parseStatement() : nullptr };
-        return std::make_unique<IfStmt>(IfStmt{ std::move(condition), std::move(thenBranch), std::move(elseBranch) });
+        auto thenBranch = parseNestedStatement();
+        Stmt* elseBranch{ match(TokenType::ELSE) ? parseNestedStatement() : nullptr };
+        return m_Context.create<IfStmt>(condition, thenBranch, elseBranch);
     }
 
-    std::unique_ptr<Expr> Parser::parseExpression()
+    Expr* Parser::parseCondition(std::string_view openMsg, std::string_view closeMsg)
     {
-        return parseAssignmentExpr();
+        consume(TokenType::LEFT_PAREN, openMsg);
+        Expr* condition{ parseExpression() };
+        consume(TokenType::RIGHT_PAREN, closeMsg);
+        return condition;
     }
 
-    std::unique_ptr<Expr> Parser::parseAssignmentExpr()
+    Expr* Parser::parseExpression()
     {
-        auto expr = parseOrExpr();
-        if(match(TokenType::EQ))
-        {
-            Token equals = previous();
-            auto value = parseAssignmentExpr();
+        return m_Iterative ? parseExpressionIteratively() : parsePrecedence(Precedence::ASSIGNMENT);
+    }
 
-            if(auto varExpr = dynamic_cast<VariableExpr*>(expr.get()))
+    Expr* Parser::parsePrecedence(Precedence minPrecedence)
+    {
+        if(!enterNesting())
+            return m_Context.create<ErrorExpr>(peek());
+        Expr* expr{ parseUnaryExpr() };
+        while(!isAtEnd())
+        {
+            // NONE is below every valid minimum, so it ends the loop as well
+            const Precedence precedence{ infixPrecedence(peek().type) };
+            if(precedence < minPrecedence)
+                break;
+            const Token op{ advance() };
+            if(op.type == TokenType::LEFT_PAREN)
             {
-                Token name = varExpr->m_Name;
-                return std::make_unique<AssignmentExpr>(AssignmentExpr(name, value.release()));
+                expr = finishCall(expr);
+            }
+            else if(op.type == TokenType::EQ)
+            {
+                // Right associative, the value may itself be an assignment
+                Expr* value{ parsePrecedence(Precedence::ASSIGNMENT) };
+                expr = makeAssignment(expr, op, value);
+            }
+            else
+            {
+                // Binary operators are left associative, the right operand
+                // only takes operators binding tighter than `op`
+                Expr* right{ parsePrecedence(static_cast<Precedence>(static_cast<uint8_t>(precedence) + 1)) };
+                expr = m_Context.create<BinaryExpr>(expr, op, right);
             }
-
-            throw std::runtime_error(syntaxErrorMsg("file", equals, "Invalid assignment target."));
         }
-        return std::move(expr);
+        leaveNesting();
+        return expr;
     }
 
-    std::unique_ptr<Expr> Parser::parseOrExpr()
+    Expr* Parser::makeAssignment(Expr* target, const Token& equals, Expr* value)
     {
-        auto expr = parseAndExpr();
-        while(match(TokenType::OR))
+        if(target->getKind() == ExprKind::VARIABLE)
         {
-            Token op = previous();
-            auto right = parseAndExpr();
-            expr = std::make_unique<BinaryExpr>(BinaryExpr{expr.release(), op, right.release()});
+            Token name = static_cast<VariableExpr*>(target)->m_Name;
+            return m_Context.create<AssignmentExpr>(name, value);
         }
-        return expr;
+
+        error(equals, "Invalid assignment target.");
+        return m_Context.create<ErrorExpr>(equals);
     }
 
-    std::unique_ptr<Expr> Parser::parseAndExpr()
+    Expr* Parser::parseUnaryExpr()
     {
-        auto expr = parseEqualityExpr();
-        while(match(TokenType::AND))
+        if(match(UnaryOperators))
         {
-            Token op = previous();
-            auto right = parseEqualityExpr();
-            expr = std::make_unique<BinaryExpr>(BinaryExpr{expr.release(), op, right.release()});
+            Token op{ previous() };
+            Expr* right{ parsePrecedence(Precedence::UNARY) };
+            return m_Context.create<UnaryExpr>(op, right);
         }
-        return expr;
+
+        return parsePrimaryExpr();
     }
 
-    std::unique_ptr<Expr> Parser::parseEqualityExpr()
+    Expr* Parser::parsePrimaryExpr()
     {
-        std::unique_ptr<Expr> expression{parseComparisonExpr()};
-        while (match({ TokenType::NOT_EQ, TokenType::EQ_EQ }))
+        if (match(Literals))
         {
-            Token& op{ previous() };
-            std::unique_ptr<Expr> right{ parseComparisonExpr() };
-            expression = std::make_unique<BinaryExpr>(BinaryExpr(expression.release(), op, right.release()));
+            return m_Context.create<LiteralExpr>(previous());
         }
-        return expression;
-    }
 
-    std::unique_ptr<Expr> Parser::parseComparisonExpr()
-    {
-        std::unique_ptr<Expr> expression{parseAdditiveExpr()};
-        while (match({ TokenType::GREATER, TokenType::LESS,TokenType::GREATER_EQ, TokenType::LESS_EQ }))
+        if (match(TokenType::IDENTIFIER))
         {
-            Token& op{ previous() };
-            std::unique_ptr<Expr> right{ parseAdditiveExpr() };
-            expression = std::make_unique<BinaryExpr>(BinaryExpr(expression.release(), op, right.release()));
+            return m_Context.create<VariableExpr>(previous());
         }
-        return expression;
-    }
 
-    std::unique_ptr<Expr> Parser::parseAdditiveExpr()
-    {
-        std::unique_ptr<Expr> expression{parseMultiplicativeExpr()};
-        while (match({ TokenType::MINUS, TokenType::PLUS }))
+        if (match(TokenType::LEFT_PAREN))
         {
-            Token& op{ previous() };
-            std::unique_ptr<Expr> right{ parseMultiplicativeExpr() };
-            expression = std::make_unique<BinaryExpr>(BinaryExpr(expression.release(), op, right.release()));
+            Expr* expr = parseExpression();
+            consume(TokenType::RIGHT_PAREN, "expected ')' after expression.");
+            return m_Context.create<GroupedExpr>(expr);
         }
-        return expression;
+
+        error(peek(), "expected expression.");
+        return m_Context.create<ErrorExpr>(peek());
     }
 
-    std::unique_ptr<Expr> Parser::parseMultiplicativeExpr()
+    Expr* Parser::finishCall(Expr* callee)
     {
-        std::unique_ptr<Expr> expression{parseUnaryExpr()};
-        while (match({ TokenType::SLASH, TokenType::STAR }))
+        ScratchScope<Expr*> args{ m_ExprScratch };
+        if(!check(TokenType::RIGHT_PAREN))
         {
-            Token& op{ previous() };
-            std::unique_ptr<Expr> right{ parseUnaryExpr() };
-            expression = std::make_unique<BinaryExpr>(BinaryExpr(expression.release(), op, right.release()));
+            do {
+                args.push(parseExpression());
+            } while (match(TokenType::COMMA));
         }
-        return expression;
+
+        Token paren = consume(TokenType::RIGHT_PAREN, "Expect '(' after arguments");
+        return m_Context.create<CallExpr>(callee, paren, args.copyTo(m_Context));
     }
 
-    std::unique_ptr<Expr> Parser::parseUnaryExpr()
+    void Parser::synchronize(DeclarationStart start)
     {
-        if(match({TokenType::NOT, TokenType::MINUS}))
+        // A declaration that failed on its first token skips it, so the
+        // caller always makes progress. Otherwise the token the error was
+        // reported on may already start the next statement.
+        if(m_Tokens.consumed() == start.consumed)
+            advance();
+        // Blocks opened by the declaration, before or while skipping, are
+        // skipped to their end. A '}' closing the enclosing block is left
+        // for parseBlock.
+        while(!isAtEnd())
         {
-            Token& op{ previous() };
-            std::unique_ptr<Expr> right{ parseUnaryExpr() };
-            return std::make_unique<UnaryExpr>(UnaryExpr(op, right.release()));
-        }
+            const bool outside{ m_OpenBraces <= start.openBraces };
+            const TokenType last{ previous().type };
+            if(outside && (last == TokenType::SEMICOLON || last == TokenType::RIGHT_BRACE))
+                return;
+
+            const TokenType type{ peek().type };
+            if(outside && (StatementStarts.contains(type) || type == TokenType::RIGHT_BRACE))
+                return;
 
-        return parseCallExpr();
+            advance();
+        }
     }
 
-    std::unique_ptr<Expr> Parser::parseCallExpr()
+    // Iterative parsing mirrors the recursive functions above. Statements
+    // that contain other statements are kept on m_PendingStmts until their
+    // last nested statement is complete, and expressions are parsed by
+    // operator precedence with explicit operator and operand stacks.
+    void Parser::parseIteratively()
     {
-        auto expr{ parsePrimaryExpr() };
-
+        using Kind = PendingStmt::Kind;
+        m_PendingStmts.push_back(PendingStmt{ Kind::PROGRAM });
+        // A statement waiting to be added to the pending statement on top
+        Stmt* completed{ nullptr };
         while(true)
         {
-            if(match(TokenType::LEFT_PAREN))
-                expr = finishCall(std::move(expr));
-            else
+            if(m_Panic)
+            {
+                completed = recover();
+                continue;
+            }
+            if(completed)
+            {
+                completed = completePending(completed);
+                continue;
+            }
+
+            PendingStmt& pending{ m_PendingStmts.back() };
+            if(pending.kind == Kind::PROGRAM && isAtEnd())
                 break;
+            if(pending.kind == Kind::BLOCK || pending.kind == Kind::FUNCTION)
+            {
+                if(check(TokenType::RIGHT_BRACE) || isAtEnd())
+                {
+                    completed = closeBlock();
+                    continue;
+                }
+            }
+            if(pending.kind == Kind::PROGRAM || pending.kind == Kind::BLOCK || pending.kind == Kind::FUNCTION)
+            {
+                pending.declarationStart = declarationStart();
+                completed = startDeclaration();
+            }
+            else
+            {
+                completed = startStatement();
+            }
         }
-        return expr;
+        m_PendingStmts.clear();
     }
 
-    std::unique_ptr<Expr> Parser::parsePrimaryExpr()
+    // Returns the declaration if it is complete, or nullptr once it is
+    // pending on its body
+    Stmt* Parser::startDeclaration()
     {
-        if (match({
-                TokenType::TRUE, TokenType::FALSE, TokenType::NIL, TokenType::INT_LITERAL,
-                TokenType::FLOAT_LITERAL, TokenType::STRING_LITERAL
-            }))
+        if(match(TokenType::FN))
         {
-            return std::make_unique<LiteralExpr>(LiteralExpr(previous()));
+            PendingStmt pending{ PendingStmt::Kind::FUNCTION };
+            pending.function = parseFunctionHeader("function");
+            pushPending(pending);
+            return nullptr;
         }
+        if(match(TokenType::LET))
+            return parseVariableDeclaration();
+        return startStatement();
+    }
 
-        if (match(TokenType::IDENTIFIER))
+    Stmt* Parser::startStatement()
+    {
+        using Kind = PendingStmt::Kind;
+        PendingStmt pending{ Kind::BLOCK };
+        if(match(TokenType::FOR))
         {
-            return std::make_unique<VariableExpr>(VariableExpr(previous()));
+            pending.kind = Kind::FOR;
+            pending.clauses = parseForClauses();
         }
-
-        if (match(TokenType::LEFT_PAREN))
+        else if(match(TokenType::IF))
         {
-            std::unique_ptr<Expr> expr = parseExpression();
-            consume(TokenType::RIGHT_PAREN, "expected ')' after expression.");
-            return std::make_unique<GroupedExpr>(GroupedExpr(expr.release()));
+            pending.kind = Kind::IF;
+            pending.condition = parseCondition("Expect '(' after 'if'.", "Expect ')' after if condition.");
         }
+        else if(match(TokenType::WHILE))
+        {
+            pending.kind = Kind::WHILE;
+            pending.condition = parseCondition("Expect '(' after 'while'.", "Expect ')' after condition.");
+        }
+        else if(match(TokenType::PRINT)) return parsePrintStatement();
+        else if(match(TokenType::RETURN)) return parseReturnStatement();
+        else if(!match(TokenType::LEFT_BRACE)) return parseExpressionStatement();
+        pushPending(pending);
+        return nullptr;
+    }
 
-        throw std::runtime_error(syntaxErrorMsg("file", peek(), "expected expression."));
+    bool Parser::pushPending(PendingStmt pending)
+    {
+        // The recursive parser enters a nesting level for the body at the
+        // same token, even when the header had an error
+        if(m_Panic || !checkNesting(m_Depth + 1))
+            return false;
+        pending.scratchBase = m_StmtScratch.size();
+        m_PendingStmts.push_back(pending);
+        ++m_Depth;
+        return true;
     }
 
-    std::unique_ptr<Expr> Parser::finishCall(std::unique_ptr<Expr> callee)
+    // Adds `statement` to the pending statement on top, returns that
+    // statement if it is now complete
+    Stmt* Parser::completePending(Stmt* statement)
     {
-        std::vector<std::unique_ptr<Expr>> args;
-        if(!check(TokenType::RIGHT_PAREN))
+        using Kind = PendingStmt::Kind;
+        PendingStmt& pending{ m_PendingStmts.back() };
+        switch(pending.kind)
         {
-            do {
-                args.push_back(parseExpression());
-            } while (match(TokenType::COMMA));
+        case Kind::PROGRAM:
+            m_Statements.push_back(statement);
+            return nullptr;
+        case Kind::BLOCK:
+        case Kind::FUNCTION:
+            m_StmtScratch.push_back(statement);
+            return nullptr;
+        case Kind::IF:
+            pending.thenBranch = statement;
+            if(match(TokenType::ELSE))
+            {
+                pending.kind = Kind::ELSE;
+                return nullptr;
+            }
+            statement = nullptr;
+            break;
+        case Kind::ELSE:
+        case Kind::WHILE:
+        case Kind::FOR:
+            break;
         }
 
-        Token paren = consume(TokenType::RIGHT_PAREN, "Expect '(' after arguments");
-        return std::make_unique<CallExpr>(CallExpr{ std::move(callee), paren, std::move(args) });
+        const PendingStmt completed{ pending };
+        m_PendingStmts.pop_back();
+        --m_Depth;
+        switch(completed.kind)
+        {
+        case Kind::WHILE:
+            return m_Context.create<WhileStmt>(completed.condition, statement);
+        case Kind::FOR:
+            return finishFor(completed.clauses, statement);
+        default:
+            return m_Context.create<IfStmt>(completed.condition, completed.thenBranch, statement);
+        }
     }
 
-    std::string Parser::syntaxErrorMsg(const std::string& filename, const Token& token, const std::string& msg)
+    Stmt* Parser::closeBlock()
     {
-        return "<"+filename+">:" +
-                std::to_string(token.position.line) + ":" + std::to_string(token.position.column) +
-                ": syntax error: " + msg;
+        consume(TokenType::RIGHT_BRACE, "Expect '}' after block.");
+        const PendingStmt block{ m_PendingStmts.back() };
+        m_PendingStmts.pop_back();
+        --m_Depth;
+        const auto body{ m_Context.copyArray(m_StmtScratch.data() + block.scratchBase, m_StmtScratch.size() - block.scratchBase) };
+        m_StmtScratch.resize(block.scratchBase);
+        if(m_Panic)
+            return nullptr;
+        if(block.kind == PendingStmt::Kind::FUNCTION)
+            return m_Context.create<FuncStmt>(block.function.name, block.function.returnType, block.function.params, body);
+        return m_Context.create<BlockStmt>(body);
+    }
+
+    // Drops the statements pending inside the declaration with the error,
+    // like returning up to parseDeclaration does
+    Stmt* Parser::recover()
+    {
+        using Kind = PendingStmt::Kind;
+        while(m_PendingStmts.back().kind != Kind::PROGRAM && m_PendingStmts.back().kind != Kind::BLOCK &&
+              m_PendingStmts.back().kind != Kind::FUNCTION)
+        {
+            m_PendingStmts.pop_back();
+            --m_Depth;
+        }
+        m_Panic = false;
+        synchronize(m_PendingStmts.back().declarationStart);
+        return m_Context.create<ErrorStmt>(m_Diagnostics.getDiagnostics().back().token);
+    }
+
+    Expr* Parser::parseExpressionIteratively()
+    {
+        using Kind = PendingOperator::Kind;
+        // Nesting is counted as in parsePrecedence, which is entered once for
+        // the expression and once more for every operator and parenthesis
+        // still waiting for its operand
+        if(!checkNesting(m_Depth + 1))
+            return m_Context.create<ErrorExpr>(peek());
+        const size_t operatorBase{ m_Operators.size() };
+        const size_t operandBase{ m_Operands.size() };
+        const auto push = [&](Kind kind, Precedence precedence) {
+            if(checkNesting(m_Depth + 2 + m_Operators.size() - operatorBase))
+                m_Operators.push_back(PendingOperator{ kind, previous(), precedence, m_Operands.size() });
+        };
+        const auto innermostParenthesis = [&]() -> PendingOperator* {
+            if(m_Operators.size() == operatorBase)
+                return nullptr;
+            PendingOperator& top{ m_Operators.back() };
+            return top.kind == Kind::GROUP || top.kind == Kind::CALL ? &top : nullptr;
+        };
+
+        bool expectOperand{ true };
+        while(!m_Panic)
+        {
+            if(expectOperand)
+            {
+                if(match(UnaryOperators))
+                {
+                    push(Kind::UNARY, Precedence::UNARY);
+                }
+                else if(match(TokenType::LEFT_PAREN))
+                {
+                    push(Kind::GROUP, Precedence::NONE);
+                }
+                else
+                {
+                    m_Operands.push_back(parsePrimaryExpr());
+                    expectOperand = false;
+                }
+                continue;
+            }
+
+            if(isAtEnd())
+                break;
+            const TokenType type{ peek().type };
+            if(type == TokenType::LEFT_PAREN)
+            {
+                advance();
+                if(check(TokenType::RIGHT_PAREN))
+                {
+                    const Token paren{ advance() };
+                    m_Operands.back() = m_Context.create<CallExpr>(m_Operands.back(), paren, AstSpan<Expr*>{});
+                    continue;
+                }
+                push(Kind::CALL, Precedence::NONE);
+                expectOperand = true;
+            }
+            else if(type == TokenType::RIGHT_PAREN || type == TokenType::COMMA)
+            {
+                reduceOperators(Precedence::NONE, false, operatorBase);
+                PendingOperator* parenthesis{ innermostParenthesis() };
+                // Without an open parenthesis the token ends the expression,
+                // and a ',' in a group is reported as a missing ')' below
+                if(m_Panic || !parenthesis || (type == TokenType::COMMA && parenthesis->kind != Kind::CALL))
+                    break;
+                if(type == TokenType::COMMA)
+                {
+                    advance();
+                    expectOperand = true;
+                    continue;
+                }
+                const Token paren{ advance() };
+                if(parenthesis->kind == Kind::GROUP)
+                {
+                    m_Operands.back() = m_Context.create<GroupedExpr>(m_Operands.back());
+                }
+                else
+                {
+                    const size_t argsBase{ parenthesis->operandBase };
+                    const auto args{ m_Context.copyArray(m_Operands.data() + argsBase, m_Operands.size() - argsBase) };
+                    m_Operands.resize(argsBase);
+                    m_Operands.back() = m_Context.create<CallExpr>(m_Operands.back(), paren, args);
+                }
+                m_Operators.pop_back();
+            }
+            else
+            {
+                const Precedence precedence{ infixPrecedence(type) };
+                if(precedence == Precedence::NONE)
+                    break;
+                reduceOperators(precedence, type == TokenType::EQ, operatorBase);
+                if(m_Panic)
+                    break;
+                advance();
+                push(Kind::BINARY, precedence);
+                expectOperand = true;
+            }
+        }
+
+        if(!m_Panic)
+        {
+            reduceOperators(Precedence::NONE, false, operatorBase);
+            if(const PendingOperator* parenthesis{ innermostParenthesis() })
+            {
+                if(parenthesis->kind == Kind::GROUP)
+                    error(peek(), "expected ')' after expression.");
+                else
+                    error(peek(), "Expect '(' after arguments");
+            }
+        }
+        // After an error the declaration is replaced by an ErrorStmt
+        Expr* expr{ m_Panic ? m_Context.create<ErrorExpr>(peek()) : m_Operands.back() };
+        m_Operators.resize(operatorBase);
+        m_Operands.resize(operandBase);
+        return expr;
     }
 
-    void Parser::synchronize()
+    // Builds the nodes of pending operators binding tighter than `precedence`,
+    // or as tight for left associative operators, down to the innermost
+    // open parenthesis
+    void Parser::reduceOperators(Precedence precedence, bool rightAssociative, size_t operatorBase)
     {
-        advance();
-        while(!isAtEnd())
+        while(m_Operators.size() > operatorBase && !m_Panic)
         {
-            if(previous().type == TokenType::SEMICOLON)
+            const PendingOperator op{ m_Operators.back() };
+            if(op.kind == PendingOperator::Kind::GROUP || op.kind == PendingOperator::Kind::CALL)
                 return;
-            
-            switch (peek().type)
-            {
-            case TokenType::IF:
-            case TokenType::WHILE:
-            case TokenType::FOR:
-            case TokenType::RETURN:
+            if(op.precedence < precedence || (op.precedence == precedence && rightAssociative))
                 return;
-            }
-
-            advance();
+            m_Operators.pop_back();
+            Expr* right{ m_Operands.back() };
+            m_Operands.pop_back();
+            if(op.kind == PendingOperator::Kind::UNARY)
+                m_Operands.push_back(m_Context.create<UnaryExpr>(op.token, right));
+            else if(op.token.type == TokenType::EQ)
+                m_Operands.back() = makeAssignment(m_Operands.back(), op.token, right);
+            else
+                m_Operands.back() = m_Context.create<BinaryExpr>(m_Operands.back(), op.token, right);
         }
     }
 }
\ No newline at end of file
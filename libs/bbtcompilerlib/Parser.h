@@ -1,62 +1,195 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include "Lexer.h"
 #include "Expression.h"
 #include "Statement.h"
-#include "SymbolTable.h"
+#include "TokenStream.h"
+#include "TokenSet.h"
+#include "Diagnostics.h"
 
 
 namespace BBTCompiler
 {
-    class SymbolTable;
+    // Expression precedence from loosest to tightest binding
+    enum class Precedence : uint8_t
+    {
+        NONE, ASSIGNMENT, OR, AND, EQUALITY, COMPARISON, TERM, FACTOR, UNARY, CALL
+    };
+
+    constexpr std::array<Precedence, TokenTypeCount> makeInfixPrecedenceTable()
+    {
+        std::array<Precedence, TokenTypeCount> table{};
+        for(auto& precedence : table)
+            precedence = Precedence::NONE;
+        table[static_cast<size_t>(TokenType::EQ)] = Precedence::ASSIGNMENT;
+        table[static_cast<size_t>(TokenType::OR)] = Precedence::OR;
+        table[static_cast<size_t>(TokenType::AND)] = Precedence::AND;
+        table[static_cast<size_t>(TokenType::EQ_EQ)] = Precedence::EQUALITY;
+        table[static_cast<size_t>(TokenType::NOT_EQ)] = Precedence::EQUALITY;
+        table[static_cast<size_t>(TokenType::GREATER)] = Precedence::COMPARISON;
+        table[static_cast<size_t>(TokenType::LESS)] = Precedence::COMPARISON;
+        table[static_cast<size_t>(TokenType::GREATER_EQ)] = Precedence::COMPARISON;
+        table[static_cast<size_t>(TokenType::LESS_EQ)] = Precedence::COMPARISON;
+        table[static_cast<size_t>(TokenType::PLUS)] = Precedence::TERM;
+        table[static_cast<size_t>(TokenType::MINUS)] = Precedence::TERM;
+        table[static_cast<size_t>(TokenType::STAR)] = Precedence::FACTOR;
+        table[static_cast<size_t>(TokenType::SLASH)] = Precedence::FACTOR;
+        table[static_cast<size_t>(TokenType::LEFT_PAREN)] = Precedence::CALL;
+        return table;
+    }
+
+    // Binding power of each token type following an operand, NONE if it
+    // does not continue the expression
+    constexpr std::array<Precedence, TokenTypeCount> InfixPrecedences{ makeInfixPrecedenceTable() };
+
+    constexpr Precedence infixPrecedence(TokenType type)
+    {
+        return InfixPrecedences[static_cast<size_t>(type)];
+    }
 
     class Parser
     {
     public:
         Parser(std::vector<Token>& tokens);
-        std::vector<std::unique_ptr<Stmt>>& parse();
+        // Pulls tokens from an opened Lexer while parsing instead of
+        // requiring the whole file to be lexed up front
+        Parser(Lexer& lexer);
+        Parser(const TokenBuffer& tokens);
+        std::vector<Stmt*>& parse();
+        // Owns every node of the parsed AST
+        AstContext& getContext() { return m_Context; }
+        // Syntax errors found by parse(). A statement with an error is
+        // skipped up to the next statement boundary and replaced by an
+        // ErrorStmt, parsing always continues with the following one.
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+
+        // Deepest nesting of blocks, statement bodies and subexpressions
+        // parse() accepts. Deeper input is reported as a syntax error instead
+        // of overflowing the call stack.
+        static constexpr size_t DefaultNestingLimit{ 1000 };
+        void setNestingLimit(size_t limit) { m_NestingLimit = limit; }
+        // Parse with explicit stacks instead of recursion. The AST and the
+        // diagnostics are the same, but the nesting limit may be raised as
+        // far as memory allows.
+        void setIterative(bool iterative) { m_Iterative = iterative; }
     private:
-        Token& advance();
-        Token& previous();
-        Token& peek();
-        Token& consume(TokenType type, const std::string& errorMsg);
+        // Where the declaration being parsed started, error recovery skips
+        // from there
+        struct DeclarationStart
+        {
+            size_t consumed{ 0 };
+            ptrdiff_t openBraces{ 0 };
+        };
+
+        struct FunctionHeader
+        {
+            Token name;
+            Token returnType;
+            AstSpan<std::pair<Token,Token>> params;
+        };
+
+        struct ForClauses
+        {
+            Stmt* initializer{ nullptr };
+            Expr* condition{ nullptr };
+            Expr* increment{ nullptr };
+        };
+
+        // A statement the iterative parser has started but not completed
+        struct PendingStmt
+        {
+            enum class Kind : uint8_t { PROGRAM, BLOCK, FUNCTION, IF, ELSE, WHILE, FOR };
+            Kind kind;
+            // PROGRAM, BLOCK and FUNCTION collect declarations, the statements
+            // so far are on m_StmtScratch from `scratchBase`
+            size_t scratchBase{ 0 };
+            DeclarationStart declarationStart{};
+            FunctionHeader function{};
+            Expr* condition{ nullptr };
+            Stmt* thenBranch{ nullptr };
+            ForClauses clauses{};
+        };
+
+        // An operator or parenthesis the iterative expression parser has not reduced yet
+        struct PendingOperator
+        {
+            enum class Kind : uint8_t { BINARY, UNARY, GROUP, CALL };
+            Kind kind;
+            Token token;
+            Precedence precedence;
+            // CALL: the arguments are on m_Operands from here
+            size_t operandBase;
+        };
+
+        const Token& advance();
+        const Token& previous();
+        const Token& peek();
+        const Token& consume(TokenType type, std::string_view errorMsg, std::string_view argument = {});
+        void error(const Token& token, std::string_view message, std::string_view argument = {});
         bool isAtEnd();
         bool check(TokenType type);
-        bool check(const std::vector<TokenType>& types);
-        bool match(const TokenType& type);
-        bool match(const std::vector<TokenType>& types);
-        std::vector<std::unique_ptr<Stmt>> parseBlock();
-        std::unique_ptr<Stmt> parseDeclaration();
+        bool check(TokenSet types);
+        bool match(TokenType type);
+        bool match(TokenSet types);
+        bool checkNesting(size_t depth);
+        bool enterNesting();
+        void leaveNesting() { --m_Depth; }
+        AstSpan<Stmt*> parseBlock();
+        Stmt* parseDeclaration();
         std::pair<Token, Token> parseNewVariable();
         Token parseType();
-        std::unique_ptr<Stmt> parseVariableDeclaration();
-        std::unique_ptr<Stmt> parseStatement();
-        std::unique_ptr<Stmt> parseExpressionStatement();
-        std::unique_ptr<Stmt> parseFunctionStatement(const std::string& kind);
-        std::unique_ptr<Stmt> parseReturnStatement();
-        std::unique_ptr<Stmt> parsePrintStatement();
-        std::unique_ptr<Stmt> parseForStatement();
-        std::unique_ptr<Stmt> parseWhileStatement();
-        std::unique_ptr<Stmt> parseIfStatement();
-        std::unique_ptr<Expr> parseExpression();
-        std::unique_ptr<Expr> parseAssignmentExpr();
-        std::unique_ptr<Expr> parseOrExpr();
-        std::unique_ptr<Expr> parseAndExpr();
-        std::unique_ptr<Expr> parseEqualityExpr();
-        std::unique_ptr<Expr> parseComparisonExpr();
-        std::unique_ptr<Expr> parseAdditiveExpr();
-        std::unique_ptr<Expr> parseMultiplicativeExpr();
-        std::unique_ptr<Expr> parseUnaryExpr();
-        std::unique_ptr<Expr> parseCallExpr();
-        std::unique_ptr<Expr> parsePrimaryExpr();
-        std::unique_ptr<Expr> finishCall(std::unique_ptr<Expr> callee);
-        std::string syntaxErrorMsg(const std::string& filename, const Token& token, const std::string& msg);
-        void synchronize();
+        Stmt* parseVariableDeclaration();
+        Stmt* parseStatement();
+        Stmt* parseNestedStatement();
+        Stmt* parseExpressionStatement();
+        Stmt* parseFunctionStatement(std::string_view kind);
+        FunctionHeader parseFunctionHeader(std::string_view kind);
+        Stmt* parseReturnStatement();
+        Stmt* parsePrintStatement();
+        Stmt* parseForStatement();
+        ForClauses parseForClauses();
+        Stmt* finishFor(const ForClauses& clauses, Stmt* body);
+        Stmt* parseWhileStatement();
+        Stmt* parseIfStatement();
+        Expr* parseCondition(std::string_view openMsg, std::string_view closeMsg);
+        Expr* parseExpression();
+        // Parses operators binding at least as tightly as `minPrecedence`
+        Expr* parsePrecedence(Precedence minPrecedence);
+        Expr* parseUnaryExpr();
+        Expr* parsePrimaryExpr();
+        Expr* makeAssignment(Expr* target, const Token& equals, Expr* value);
+        Expr* finishCall(Expr* callee);
+        DeclarationStart declarationStart() const { return { m_Tokens.consumed(), m_OpenBraces }; }
+        void synchronize(DeclarationStart start);
+        void parseIteratively();
+        Stmt* startDeclaration();
+        Stmt* startStatement();
+        bool pushPending(PendingStmt pending);
+        Stmt* completePending(Stmt* statement);
+        Stmt* closeBlock();
+        Stmt* recover();
+        Expr* parseExpressionIteratively();
+        void reduceOperators(Precedence precedence, bool rightAssociative, size_t operatorBase);
     private:
-        std::vector<Token>& m_Tokens;
-        SymbolTable m_SymbolTable;
-        std::vector<Token>::iterator m_Current;
-        std::vector<std::unique_ptr<Stmt>> m_Statements;
+        TokenStream m_Tokens;
+        AstContext m_Context;
+        std::vector<Stmt*> m_Statements;
+        Diagnostics m_Diagnostics;
+        // Set by the first error of a declaration until parseDeclaration recovers
+        bool m_Panic{ false };
+        // '{' minus '}' consumed so far
+        ptrdiff_t m_OpenBraces{ 0 };
+        std::vector<Stmt*> m_StmtScratch;
+        std::vector<Expr*> m_ExprScratch;
+        std::vector<std::pair<Token,Token>> m_ParamScratch;
+        size_t m_NestingLimit{ DefaultNestingLimit };
+        size_t m_Depth{ 0 };
+        bool m_Iterative{ false };
+        std::vector<PendingStmt> m_PendingStmts;
+        std::vector<PendingOperator> m_Operators;
+        std::vector<Expr*> m_Operands;
     };
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "Resolver.h"
+#include "ASTWalker.h"
+
+namespace BBTCompiler
+{
+    struct ResolverWalk
+    {
+        Resolver& resolver;
+
+        void operator()(AssignmentExpr& expr) const
+        {
+            resolver.resolve(expr.m_Value);
+            expr.m_Binding = resolver.bind(expr.m_Name);
+        }
+        void operator()(BinaryExpr& expr) const
+        {
+            resolver.resolve(expr.m_Left);
+            resolver.resolve(expr.m_Right);
+        }
+        void operator()(UnaryExpr& expr) const { resolver.resolve(expr.m_Right); }
+        void operator()(GroupedExpr& expr) const { resolver.resolve(expr.m_Expression); }
+        void operator()(LiteralExpr&) const {}
+        void operator()(VariableExpr& expr) const { expr.m_Binding = resolver.bind(expr.m_Name); }
+        void operator()(CallExpr& expr) const
+        {
+            resolver.resolve(expr.m_Callee);
+            for(Expr* argument : expr.m_Args)
+                resolver.resolve(argument);
+        }
+        void operator()(ErrorExpr&) const {}
+
+        void operator()(PrintStmt& stmt) const { resolver.resolve(stmt.m_Expression); }
+        void operator()(ExprStmt& stmt) const { resolver.resolve(stmt.m_Expression); }
+        void operator()(VariableStmt& stmt) const
+        {
+            // The initializer still sees an outer variable of the same name
+            resolver.resolve(stmt.m_Initializer);
+            stmt.m_Slot = resolver.declare(stmt.m_Name, SymbolType::VARIABLE);
+        }
+        void operator()(BlockStmt& stmt) const
+        {
+            resolver.m_Symbols.pushScope();
+            resolver.resolveBlock(stmt.m_Statements);
+            resolver.m_Symbols.popScope();
+        }
+        void operator()(IfStmt& stmt) const
+        {
+            resolver.resolve(stmt.m_Condition);
+            resolver.resolve(stmt.m_ThenBranch);
+            resolver.resolve(stmt.m_ElseBranch);
+        }
+        void operator()(WhileStmt& stmt) const
+        {
+            resolver.resolve(stmt.m_Condition);
+            resolver.resolve(stmt.m_Body);
+        }
+        void operator()(FuncStmt& stmt) const
+        {
+            // The name was declared by hoistFunctions, parameters and body
+            // share the function's scope
+            resolver.m_Symbols.pushScope();
+            resolver.m_FrameSizes.push_back(0);
+            for(const auto& parameter : stmt.m_Params)
+                resolver.declare(parameter.first, SymbolType::VARIABLE);
+            resolver.resolveBlock(stmt.m_Body);
+            stmt.m_FrameSize = resolver.m_FrameSizes.back();
+            resolver.m_FrameSizes.pop_back();
+            resolver.m_Symbols.popScope();
+        }
+        void operator()(ReturnStmt& stmt) const { resolver.resolve(stmt.m_Value); }
+        void operator()(ErrorStmt&) const {}
+    };
+
+    void Resolver::resolve(std::vector<Stmt*>& statements)
+    {
+        m_FrameSizes.assign(1, 0);
+        m_Symbols.pushScope();
+        resolveBlock(AstSpan<Stmt*>(statements.data(), statements.size()));
+        m_Symbols.popScope();
+        m_GlobalFrameSize = m_FrameSizes.back();
+        m_FrameSizes.clear();
+    }
+
+    void Resolver::resolveBlock(AstSpan<Stmt*> statements)
+    {
+        hoistFunctions(statements);
+        for(Stmt* statement : statements)
+            resolve(statement);
+    }
+
+    void Resolver::resolve(Stmt* stmt)
+    {
+        if(stmt)
+            visitAst(*stmt, ResolverWalk{ *this });
+    }
+
+    void Resolver::resolve(Expr* expr)
+    {
+        if(expr)
+            visitAst(*expr, ResolverWalk{ *this });
+    }
+
+    void Resolver::hoistFunctions(AstSpan<Stmt*> statements)
+    {
+        for(Stmt* statement : statements)
+        {
+            if(statement->getKind() != StmtKind::FUNCTION)
+                continue;
+            auto& function = static_cast<FuncStmt&>(*statement);
+            function.m_Slot = declare(function.m_Name, SymbolType::FUNCTION);
+        }
+    }
+
+    uint32_t Resolver::declare(const Token& name, SymbolType type)
+    {
+        // Names missing after a syntax error are not declared
+        if(name.symbol == NoSymbol)
+            return Binding::Unresolved;
+        if(m_Symbols.isDeclaredInScope(name.symbol))
+        {
+            m_Diagnostics.report(name, "'{}' is already declared in this scope.", name.value, DiagnosticKind::NAME);
+            return m_Symbols.find(name.symbol)->slot;
+        }
+        SymbolTable::Symbol& symbol{ m_Symbols.addSymbol(name.symbol, type) };
+        symbol.depth = functionDepth();
+        symbol.slot = m_FrameSizes.back()++;
+        return symbol.slot;
+    }
+
+    Binding Resolver::bind(const Token& name)
+    {
+        if(name.symbol == NoSymbol)
+            return Binding{};
+        const SymbolTable::Symbol* symbol{ m_Symbols.find(name.symbol) };
+        if(!symbol)
+        {
+            m_Diagnostics.report(name, "Undefined name '{}'.", name.value, DiagnosticKind::NAME);
+            return Binding{};
+        }
+        return Binding{ functionDepth() - symbol->depth, symbol->slot };
+    }
+}
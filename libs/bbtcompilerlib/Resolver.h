@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Diagnostics.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "SymbolTable.h"
+
+namespace BBTCompiler
+{
+    // Binds every name in a parsed program to its declaration, so later
+    // passes address variables by position instead of looking names up.
+    // The top level of the program and every function body get a frame:
+    // each declaration takes the next free slot of its function's frame,
+    // with parameters first, and each use of a name records how many
+    // functions out the declaring frame is and the slot in it. Slots are
+    // not reused when a block ends, so a frame has one slot per declaration.
+    //
+    // Within a block, and at the top level, functions are declared before
+    // the statements run, so they can call each other in any order. Other
+    // names are visible from their declaration to the end of their block.
+    // Undefined names and names declared twice in one scope are reported
+    // as diagnostics, resolution carries on after them.
+    class Resolver
+    {
+    public:
+        void resolve(std::vector<Stmt*>& statements);
+        // Slots the top level of the program needs
+        uint32_t getFrameSize() const { return m_GlobalFrameSize; }
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+    private:
+        friend struct ResolverWalk;
+        void resolveBlock(AstSpan<Stmt*> statements);
+        void resolve(Stmt* stmt);
+        void resolve(Expr* expr);
+        void hoistFunctions(AstSpan<Stmt*> statements);
+        uint32_t declare(const Token& name, SymbolType type);
+        Binding bind(const Token& name);
+        uint32_t functionDepth() const { return static_cast<uint32_t>(m_FrameSizes.size() - 1); }
+    private:
+        SymbolTable m_Symbols;
+        Diagnostics m_Diagnostics;
+        // Slots used so far by each function being resolved, outermost first
+        std::vector<uint32_t> m_FrameSizes;
+        uint32_t m_GlobalFrameSize{ 0 };
+    };
+}
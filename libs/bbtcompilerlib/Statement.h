@@ -1,108 +1,139 @@
 #pragma once
 
 #include "ASTVisitor.h"
-#include "JsonVisitor.h"
+#include "AstContext.h"
+#include "Expression.h"
 
 namespace BBTCompiler
 {
+    enum class StmtKind : uint8_t
+    {
+        PRINT, EXPRESSION, VARIABLE, BLOCK, IF, WHILE, FUNCTION, RETURN, ERROR
+    };
+
+    // Allocated in an AstContext alongside the expressions, see Expr
     class Stmt
     {
     public:
-        virtual ~Stmt() = default;
-        virtual void accept(ASTJSonVisitor& visitor) const = 0;
+        virtual void accept(ASTConstVisitor& visitor) const = 0;
+        StmtKind getKind() const { return m_Kind; }
+    protected:
+        explicit Stmt(StmtKind kind) : m_Kind{ kind } {}
+        ~Stmt() = default;
     private:
+        StmtKind m_Kind;
     };
 
     class PrintStmt : public Stmt
     {
     public:
-        PrintStmt(std::unique_ptr<Expr> expression)
-            : m_Expression{std::move(expression)}
+        PrintStmt(Expr* expression)
+            : Stmt{ StmtKind::PRINT }, m_Expression{expression}
         {}
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
-        std::unique_ptr<Expr> m_Expression;
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
+        Expr* m_Expression;
     };
 
     class ExprStmt : public Stmt
     {
     public:
         ExprStmt(Expr* expression)
-            : m_Expression{expression}
+            : Stmt{ StmtKind::EXPRESSION }, m_Expression{expression}
         {}
 
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
-        std::unique_ptr<Expr> m_Expression;
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
+        Expr* m_Expression;
     };
 
     class VariableStmt : public Stmt
     {
     public:
-        VariableStmt(Token name, Token type, std::unique_ptr<Expr> initializer)
-            : m_Name{name}, m_Type{type}, m_Initializer{std::move(initializer)}
+        VariableStmt(Token name, Token type, Expr* initializer)
+            : Stmt{ StmtKind::VARIABLE }, m_Name{name}, m_Type{type}, m_Initializer{initializer}
         {}
 
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
         Token m_Name, m_Type;
-        std::unique_ptr<Expr> m_Initializer;
+        Expr* m_Initializer;
+        // Slot in the frame of the enclosing function, set by the Resolver
+        uint32_t m_Slot{ Binding::Unresolved };
     };
 
     class BlockStmt : public Stmt
     {
     public:
-        BlockStmt(std::vector<std::unique_ptr<Stmt>> statements)
-            : m_Statements{std::move(statements)}
+        BlockStmt(AstSpan<Stmt*> statements)
+            : Stmt{ StmtKind::BLOCK }, m_Statements{statements}
         {}
 
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
-        std::vector<std::unique_ptr<Stmt>> m_Statements;
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
+        AstSpan<Stmt*> m_Statements;
     };
 
     class IfStmt : public Stmt
     {
     public:
-        IfStmt(std::unique_ptr<Expr> condition, std::unique_ptr<Stmt> thenBranch, std::unique_ptr<Stmt> elseBranch)
-            : m_Condition{std::move(condition)},m_ThenBranch{std::move(thenBranch)},m_ElseBranch{std::move(elseBranch)}
+        IfStmt(Expr* condition, Stmt* thenBranch, Stmt* elseBranch)
+            : Stmt{ StmtKind::IF }, m_Condition{condition},m_ThenBranch{thenBranch},m_ElseBranch{elseBranch}
         {}
 
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
-        std::unique_ptr<Expr> m_Condition;
-        std::unique_ptr<Stmt> m_ThenBranch, m_ElseBranch;
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
+        Expr* m_Condition;
+        Stmt* m_ThenBranch;
+        Stmt* m_ElseBranch;
     };
 
     class WhileStmt : public Stmt
     {
     public:
-        WhileStmt(std::unique_ptr<Expr> condition, std::unique_ptr<Stmt> body)
-            : m_Condition{std::move(condition)},m_Body{std::move(body)}
+        WhileStmt(Expr* condition, Stmt* body)
+            : Stmt{ StmtKind::WHILE }, m_Condition{condition},m_Body{body}
         {}
 
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
-        std::unique_ptr<Expr> m_Condition;
-        std::unique_ptr<Stmt> m_Body;
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
+        Expr* m_Condition;
+        Stmt* m_Body;
     };
 
     class FuncStmt : public Stmt
     {
     public:
-        FuncStmt(Token name, Token returnType, std::vector<std::pair<Token,Token>> params, std::vector<std::unique_ptr<Stmt>> body)
-            : m_Name{ name }, m_ReturnType{ returnType }, m_Params{ std::move(params) }, m_Body{ std::move(body) }
+        FuncStmt(Token name, Token returnType, AstSpan<std::pair<Token,Token>> params, AstSpan<Stmt*> body)
+            : Stmt{ StmtKind::FUNCTION }, m_Name{ name }, m_ReturnType{ returnType }, m_Params{ params }, m_Body{ body }
         {}
 
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
         Token m_Name, m_ReturnType;
-        std::vector<std::pair<Token,Token>> m_Params;
-        std::vector<std::unique_ptr<Stmt>> m_Body;
+        AstSpan<std::pair<Token,Token>> m_Params;
+        AstSpan<Stmt*> m_Body;
+        // Set by the Resolver: the slot of the function in the frame of the
+        // enclosing function, and the slots its own frame needs. Parameters
+        // take the first slots.
+        uint32_t m_Slot{ Binding::Unresolved };
+        uint32_t m_FrameSize{ 0 };
     };
 
     class ReturnStmt : public Stmt
     {
     public:
-        ReturnStmt(Token returnToken, std::unique_ptr<Expr> value)
-            : m_ReturnToken{returnToken}, m_Value{std::move(value)}
+        ReturnStmt(Token returnToken, Expr* value)
+            : Stmt{ StmtKind::RETURN }, m_ReturnToken{returnToken}, m_Value{value}
         {}
 
-        void accept(ASTJSonVisitor& visitor) const override { visitor.visit(*this); }
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
         Token m_ReturnToken;
-        std::unique_ptr<Expr> m_Value;
+        Expr* m_Value;
+    };
+
+    // Replaces a statement the Parser skipped after a syntax error
+    class ErrorStmt : public Stmt
+    {
+    public:
+        ErrorStmt(Token token)
+            : Stmt{ StmtKind::ERROR }, m_Token{token}
+        {}
+
+        void accept(ASTConstVisitor& visitor) const override { visitor.visit(*this); }
+        Token m_Token;
     };
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "StringInterner.h"
+#include <cstring>
+#include <utility>
+
+namespace BBTCompiler
+{
+    StringInterner::StringInterner()
+        : m_Slots(256, Slot{ 0, NoSymbol }), m_Strings{ std::string_view{} }
+    {
+    }
+
+    SymbolId StringInterner::intern(std::string_view text)
+    {
+        const uint32_t textHash{ hash(text) };
+        size_t slot{ findSlot(text, textHash) };
+        if(m_Slots[slot].symbol != NoSymbol)
+            return m_Slots[slot].symbol;
+
+        if((m_Strings.size() + 1) * 2 > m_Slots.size())
+        {
+            grow();
+            slot = findSlot(text, textHash);
+        }
+        char* copy{ static_cast<char*>(m_Storage.allocate(text.size(), 1)) };
+        if(!text.empty())
+            std::memcpy(copy, text.data(), text.size());
+        const SymbolId symbol{ static_cast<SymbolId>(m_Strings.size()) };
+        m_Strings.emplace_back(copy, text.size());
+        m_Slots[slot] = Slot{ textHash, symbol };
+        return symbol;
+    }
+
+    SymbolId StringInterner::find(std::string_view text) const
+    {
+        return m_Slots[findSlot(text, hash(text))].symbol;
+    }
+
+    uint32_t StringInterner::hash(std::string_view text)
+    {
+        // Eight bytes at a time, multiplied into the state and folded at the
+        // end. Most identifiers take one or two steps.
+        constexpr uint64_t Multiplier{ 0x9E3779B97F4A7C15ull };
+        uint64_t result{ text.size() * Multiplier };
+        const char* data{ text.data() };
+        size_t remaining{ text.size() };
+        for(; remaining >= 8; data += 8, remaining -= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, 8);
+            result = (result ^ word) * Multiplier;
+            result ^= result >> 29;
+        }
+        if(remaining)
+        {
+            uint64_t word{ 0 };
+            std::memcpy(&word, data, remaining);
+            result = (result ^ word) * Multiplier;
+            result ^= result >> 29;
+        }
+        return static_cast<uint32_t>(result ^ (result >> 32));
+    }
+
+    size_t StringInterner::findSlot(std::string_view text, uint32_t hash) const
+    {
+        const size_t mask{ m_Slots.size() - 1 };
+        for(size_t slot = hash & mask;; slot = (slot + 1) & mask)
+        {
+            const Slot& candidate{ m_Slots[slot] };
+            if(candidate.symbol == NoSymbol || (candidate.hash == hash && m_Strings[candidate.symbol] == text))
+                return slot;
+        }
+    }
+
+    void StringInterner::grow()
+    {
+        std::vector<Slot> slots(m_Slots.size() * 2, Slot{ 0, NoSymbol });
+        const size_t mask{ slots.size() - 1 };
+        for(const Slot& slot : m_Slots)
+        {
+            if(slot.symbol == NoSymbol)
+                continue;
+            size_t index{ slot.hash & mask };
+            while(slots[index].symbol != NoSymbol)
+                index = (index + 1) & mask;
+            slots[index] = slot;
+        }
+        m_Slots = std::move(slots);
+    }
+}
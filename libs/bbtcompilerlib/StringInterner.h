@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "AstContext.h"
+
+namespace BBTCompiler
+{
+    using SymbolId = uint32_t;
+    // The symbol of tokens that are not identifiers
+    constexpr SymbolId NoSymbol{ 0 };
+
+    // Gives every distinct string a dense 32-bit id, starting at 1 in the
+    // order strings are first seen, so names can be compared and looked up as
+    // integers. One interner is shared by everything in a compilation. It
+    // keeps its own copy of each string, views returned by view() stay valid
+    // as long as the interner, independently of the source.
+    class StringInterner
+    {
+    public:
+        StringInterner();
+        StringInterner(const StringInterner&) = delete;
+        StringInterner& operator=(const StringInterner&) = delete;
+        StringInterner(StringInterner&&) = default;
+        StringInterner& operator=(StringInterner&&) = default;
+
+        SymbolId intern(std::string_view text);
+        // NoSymbol if `text` was never interned
+        SymbolId find(std::string_view text) const;
+        std::string_view view(SymbolId symbol) const { return m_Strings[symbol]; }
+        // Number of symbols, ids run from 1 to size()
+        size_t size() const { return m_Strings.size() - 1; }
+    private:
+        struct Slot
+        {
+            uint32_t hash;
+            SymbolId symbol;
+        };
+        static uint32_t hash(std::string_view text);
+        // Slot holding `text`, or the empty slot it would be inserted in
+        size_t findSlot(std::string_view text, uint32_t hash) const;
+        void grow();
+    private:
+        // Open addressing with linear probing, a power of two in size and at
+        // most half full. Empty slots have the symbol NoSymbol.
+        std::vector<Slot> m_Slots;
+        std::vector<std::string_view> m_Strings;
+        AstContext m_Storage;
+    };
+}
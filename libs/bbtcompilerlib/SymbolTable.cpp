@@ -0,0 +1,89 @@
+#include "SymbolTable.h"
+#include <utility>
+
+namespace BBTCompiler
+{
+    SymbolTable::SymbolTable()
+        : m_Slots(64, Slot{ NoSymbol, NoDeclaration })
+    {
+    }
+
+    void SymbolTable::popScope()
+    {
+        const uint32_t start{ m_ScopeStarts.back() };
+        m_ScopeStarts.pop_back();
+        while(m_Declarations.size() > start)
+        {
+            const Declaration& declaration{ m_Declarations.back() };
+            m_Slots[declaration.slot].declaration = declaration.shadowed;
+            m_Declarations.pop_back();
+        }
+    }
+
+    const SymbolTable::Symbol* SymbolTable::find(SymbolId name) const
+    {
+        const uint32_t declaration{ m_Slots[findSlot(name)].declaration };
+        return declaration != NoDeclaration ? &m_Declarations[declaration].symbol : nullptr;
+    }
+
+    SymbolTable::Symbol* SymbolTable::find(SymbolId name)
+    {
+        return const_cast<Symbol*>(std::as_const(*this).find(name));
+    }
+
+    bool SymbolTable::isDeclaredInScope(SymbolId name) const
+    {
+        const uint32_t declaration{ m_Slots[findSlot(name)].declaration };
+        return declaration != NoDeclaration && declaration >= scopeStart();
+    }
+
+    SymbolTable::Symbol& SymbolTable::addSymbol(SymbolId name, SymbolType type)
+    {
+        size_t slot{ findSlot(name) };
+        if(m_Slots[slot].name == NoSymbol)
+        {
+            if((m_UsedSlots + 1) * 2 > m_Slots.size())
+            {
+                grow();
+                slot = findSlot(name);
+            }
+            m_Slots[slot].name = name;
+            ++m_UsedSlots;
+        }
+
+        Slot& entry{ m_Slots[slot] };
+        if(entry.declaration != NoDeclaration && entry.declaration >= scopeStart())
+        {
+            m_Declarations[entry.declaration].symbol = Symbol{ type };
+            return m_Declarations[entry.declaration].symbol;
+        }
+        m_Declarations.push_back(Declaration{ Symbol{ type }, static_cast<uint32_t>(slot), entry.declaration });
+        entry.declaration = static_cast<uint32_t>(m_Declarations.size() - 1);
+        return m_Declarations.back().symbol;
+    }
+
+    size_t SymbolTable::findSlot(SymbolId name) const
+    {
+        // Fibonacci hashing, the high bits of the product are the best mixed
+        const size_t mask{ m_Slots.size() - 1 };
+        size_t slot{ static_cast<size_t>((uint64_t{ name } * 0x9E3779B97F4A7C15ull) >> 32) & mask };
+        while(m_Slots[slot].name != name && m_Slots[slot].name != NoSymbol)
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void SymbolTable::grow()
+    {
+        std::vector<Slot> slots(std::exchange(m_Slots, std::vector<Slot>(m_Slots.size() * 2, Slot{ NoSymbol, NoDeclaration })));
+        for(const Slot& slot : slots)
+        {
+            if(slot.name == NoSymbol)
+                continue;
+            const size_t index{ findSlot(slot.name) };
+            m_Slots[index] = slot;
+            // Declarations refer to their slot, which moved
+            for(uint32_t declaration = slot.declaration; declaration != NoDeclaration; declaration = m_Declarations[declaration].shadowed)
+                m_Declarations[declaration].slot = static_cast<uint32_t>(index);
+        }
+    }
+}
@@ -1,37 +1,74 @@
 #pragma once
 
-#include<vector>
-#include<map>
-#include<optional>
+#include <cstdint>
+#include <vector>
+#include "StringInterner.h"
 
 namespace BBTCompiler
 {
     enum class SymbolType { VARIABLE, FUNCTION, TYPE, INVALID };
+
+    // Scoped symbol table keyed by the symbols the Lexer interned for
+    // identifiers. All scopes share one open addressing table holding, per
+    // name, the innermost declaration. A declaration that shadows another
+    // links to it, and the declarations are kept in order as an undo log:
+    // popScope() walks back the declarations of the scope and restores what
+    // they shadowed. Lookup is one probe however deep the scopes are, and
+    // pushScope() only records where the scope starts.
+    //
+    // The declarations live in a vector, so the Symbol references find() and
+    // addSymbol() return are only valid until the next addSymbol() or
+    // popScope(). Copy the symbol, or look it up again, to keep it longer.
     class SymbolTable
     {
     public:
         struct Symbol
         {
             SymbolType type{ SymbolType::INVALID };
-
+            // Function nesting level and frame slot of the declaration, see Resolver
+            uint32_t depth{ 0 };
+            uint32_t slot{ 0 };
         };
-        std::map<std::string, Symbol>& pushScope() { return m_symbols.emplace_back(); }
-        void popScope() { m_symbols.pop_back(); }
-        std::optional<Symbol> find(std::string_view symbol)
+
+        SymbolTable();
+
+        void pushScope() { m_ScopeStarts.push_back(static_cast<uint32_t>(m_Declarations.size())); }
+        void popScope();
+        // Number of open scopes
+        size_t depth() const { return m_ScopeStarts.size(); }
+        // Innermost declaration of `name`, nullptr if there is none
+        const Symbol* find(SymbolId name) const;
+        Symbol* find(SymbolId name);
+        // Declared in the innermost scope
+        bool isDeclaredInScope(SymbolId name) const;
+        // Declares `name` in the innermost scope, replacing a declaration of
+        // the same name in that scope. Declarations made while no scope is
+        // open belong to an outermost scope that is never popped.
+        Symbol& addSymbol(SymbolId name, SymbolType type);
+    private:
+        static constexpr uint32_t NoDeclaration{ UINT32_MAX };
+        struct Slot
         {
-            for(auto it{m_symbols.rbegin()}; it != m_symbols.rend(); ++it)
-            {
-                if(auto search{ it->find(symbol.data()) }; search != it->end())
-                    return { search->second };
-            }
-            return std::nullopt;
-        }
-        Symbol& addSymbol(std::string_view name, SymbolType type)
+            SymbolId name;
+            uint32_t declaration;
+        };
+        struct Declaration
         {
-            auto result = m_symbols.back().insert_or_assign(name.data(), Symbol{type}).first;
-            return result->second;
-        }
+            Symbol symbol;
+            uint32_t slot;
+            uint32_t shadowed;
+        };
+        uint32_t scopeStart() const { return m_ScopeStarts.empty() ? 0 : m_ScopeStarts.back(); }
+        // Slot holding `name`, or the empty slot it would be inserted in
+        size_t findSlot(SymbolId name) const;
+        void grow();
     private:
-        std::vector<std::map<std::string, Symbol>> m_symbols;
+        // A power of two in size and at most half full. Empty slots have the
+        // name NoSymbol. Slots stay assigned to their name once used, with
+        // NoDeclaration when no scope declares it.
+        std::vector<Slot> m_Slots;
+        size_t m_UsedSlots{ 0 };
+        std::vector<Declaration> m_Declarations;
+        std::vector<uint32_t> m_ScopeStarts;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,86 @@
+#include "TokenBuffer.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace BBTCompiler
+{
+    static_assert(static_cast<int>(TokenType::INVALID) < 0x80, "token types must fit below the escaped flag");
+
+    void TokenBuffer::scan(std::string_view source)
+    {
+        if(source.size() > std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error("TokenBuffer: sources larger than 4 GiB are not supported");
+        clear();
+        m_Source = source;
+        m_Lexer.reset();
+        m_Lexer.open(source);
+        Token token;
+        do
+        {
+            token = m_Lexer.next();
+            append(token, m_Lexer.tokenOffset(), m_Lexer.tokenEscaped());
+        } while(token.type != TokenType::END);
+    }
+
+    void TokenBuffer::clear()
+    {
+        m_Source = {};
+        m_Types.clear();
+        m_Offsets.clear();
+        m_Lengths.clear();
+        m_Lines.clear();
+        m_Escaped.clear();
+    }
+
+    std::string_view TokenBuffer::lexeme(size_t index) const
+    {
+        if(m_Types[index] & EscapedFlag)
+            return m_Escaped[m_Lengths[index]];
+        // Offsets are where tokens start, string values begin after the quote
+        const TokenType tokenType{ type(index) };
+        if(tokenType == TokenType::IDENTIFIER)
+            return m_Source.substr(m_Offsets[index], getInterner().view(m_Lengths[index]).size());
+        const size_t skip{ tokenType == TokenType::STRING_LITERAL ? 1u : 0u };
+        return m_Source.substr(m_Offsets[index] + skip, m_Lengths[index]);
+    }
+
+    TokenPosition TokenBuffer::position(size_t index) const
+    {
+        const auto entry = std::upper_bound(m_Lines.begin(), m_Lines.end(), index,
+            [](size_t value, const LineEntry& line) { return value < line.firstToken; }) - 1;
+        return TokenPosition{ entry->line, static_cast<size_t>(m_Offsets[index] - entry->start + 1) };
+    }
+
+    size_t TokenBuffer::memoryUsage() const
+    {
+        return m_Types.capacity() * sizeof(uint8_t)
+            + m_Offsets.capacity() * sizeof(uint32_t)
+            + m_Lengths.capacity() * sizeof(uint32_t)
+            + m_Lines.capacity() * sizeof(LineEntry)
+            + m_Escaped.capacity() * sizeof(std::string_view);
+    }
+
+    void TokenBuffer::append(const Token& token, size_t offset, bool isEscaped)
+    {
+        m_Types.push_back(static_cast<uint8_t>(token.type) | (isEscaped ? EscapedFlag : 0));
+        m_Offsets.push_back(static_cast<uint32_t>(offset));
+        if(isEscaped)
+        {
+            m_Lengths.push_back(static_cast<uint32_t>(m_Escaped.size()));
+            m_Escaped.push_back(token.value);
+        }
+        else if(token.type == TokenType::IDENTIFIER)
+        {
+            m_Lengths.push_back(token.symbol);
+        }
+        else
+        {
+            m_Lengths.push_back(static_cast<uint32_t>(token.value.size()));
+        }
+
+        const int64_t start{ static_cast<int64_t>(offset) + 1 - static_cast<int64_t>(token.position.column) };
+        if(m_Lines.empty() || m_Lines.back().line != token.position.line || m_Lines.back().start != start)
+            m_Lines.push_back(LineEntry{ static_cast<uint32_t>(m_Types.size() - 1), static_cast<uint32_t>(token.position.line), start });
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Lexer.h"
+
+namespace BBTCompiler
+{
+    // Structure-of-arrays token storage. A token costs 9 bytes: its type and
+    // the offset and length of its lexeme in the source. Positions are not
+    // stored per token, a line table entry is only recorded where a token does
+    // not continue the previous one's line, and line/column are recomputed
+    // from it on request. Escaped string literals, whose value is not a slice
+    // of the source, keep their value in a side table indexed by the length.
+    // Identifiers store their symbol in place of the length, the interner
+    // knows the length.
+    // Like Token, the buffer must not outlive the source it was scanned from.
+    class TokenBuffer
+    {
+    public:
+        void scan(std::string_view source);
+        void clear();
+
+        size_t size() const { return m_Types.size(); }
+        bool empty() const { return m_Types.empty(); }
+        TokenType type(size_t index) const { return static_cast<TokenType>(m_Types[index] & TypeMask); }
+        std::string_view lexeme(size_t index) const;
+        size_t offset(size_t index) const { return m_Offsets[index]; }
+        TokenPosition position(size_t index) const;
+        SymbolId symbol(size_t index) const { return type(index) == TokenType::IDENTIFIER ? m_Lengths[index] : NoSymbol; }
+        Token operator[](size_t index) const { return Token{ type(index), symbol(index), position(index), lexeme(index) }; }
+        StringInterner& getInterner() const { return m_Lexer.getInterner(); }
+        // Bytes held by the buffer including unused capacity, excluding the source
+        size_t memoryUsage() const;
+    private:
+        void append(const Token& token, size_t offset, bool isEscaped);
+    private:
+        static constexpr uint8_t EscapedFlag{ 0x80 };
+        static constexpr uint8_t TypeMask{ 0x7F };
+        struct LineEntry
+        {
+            uint32_t firstToken;
+            uint32_t line;
+            // Offset the column is counted from, negative when an unterminated
+            // string pushed the column past the bytes consumed
+            int64_t start;
+        };
+        std::string_view m_Source;
+        std::vector<uint8_t> m_Types;
+        std::vector<uint32_t> m_Offsets;
+        std::vector<uint32_t> m_Lengths;
+        std::vector<LineEntry> m_Lines;
+        std::vector<std::string_view> m_Escaped;
+        Lexer m_Lexer;
+    };
+}
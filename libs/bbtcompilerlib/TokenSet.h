@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include "Lexer.h"
+
+namespace BBTCompiler
+{
+    static_assert(TokenTypeCount <= 64, "TokenSet stores one bit per TokenType in 64 bits");
+
+    // Set of token types as a bit mask, so testing membership is one AND
+    // and sets can be built at compile time
+    class TokenSet
+    {
+    public:
+        constexpr TokenSet() = default;
+        constexpr TokenSet(std::initializer_list<TokenType> types)
+        {
+            for(const TokenType type : types)
+                m_Mask |= bit(type);
+        }
+
+        constexpr bool contains(TokenType type) const { return (m_Mask & bit(type)) != 0; }
+        constexpr bool empty() const { return m_Mask == 0; }
+        constexpr TokenSet operator|(TokenSet other) const { return TokenSet{ m_Mask | other.m_Mask }; }
+        constexpr bool operator==(TokenSet other) const { return m_Mask == other.m_Mask; }
+        constexpr bool operator!=(TokenSet other) const { return m_Mask != other.m_Mask; }
+    private:
+        explicit constexpr TokenSet(uint64_t mask) : m_Mask{ mask } {}
+        static constexpr uint64_t bit(TokenType type) { return uint64_t{ 1 } << static_cast<size_t>(type); }
+    private:
+        uint64_t m_Mask{ 0 };
+    };
+}
@@ -0,0 +1,63 @@
+#include "TokenStream.h"
+#include <algorithm>
+#include <cassert>
+
+namespace BBTCompiler
+{
+    static_assert((TokenStream::Capacity & (TokenStream::Capacity - 1)) == 0, "ring capacity must be a power of two");
+
+    TokenStream::TokenStream(const std::vector<Token>& tokens)
+        : m_Tokens{ &tokens }
+    {
+    }
+
+    TokenStream::TokenStream(Lexer& lexer)
+        : m_Lexer{ &lexer }
+    {
+    }
+
+    TokenStream::TokenStream(const TokenBuffer& buffer)
+        : m_Buffer{ &buffer }
+    {
+    }
+
+    const Token& TokenStream::peek(size_t ahead)
+    {
+        assert(ahead <= MaxLookahead && "peek() past the lookahead the ring buffer keeps");
+        while(m_Fetched <= m_Current + ahead)
+        {
+            slot(m_Fetched) = fetch();
+            ++m_Fetched;
+        }
+        return slot(m_Current + ahead);
+    }
+
+    const Token& TokenStream::previous()
+    {
+        return m_Current != 0 ? slot(m_Current - 1) : peek();
+    }
+
+    void TokenStream::advance()
+    {
+        if(!isAtEnd())
+            ++m_Current;
+    }
+
+    Token TokenStream::fetch()
+    {
+        if(m_Lexer)
+            return m_Lexer->next();
+        if(m_Buffer)
+        {
+            if(m_Buffer->empty())
+                return Token{ TokenType::END };
+            const size_t index{ std::min(m_NextIndex, m_Buffer->size() - 1) };
+            ++m_NextIndex;
+            return (*m_Buffer)[index];
+        }
+        if(m_NextIndex < m_Tokens->size())
+            return (*m_Tokens)[m_NextIndex++];
+        // Past the end, or a vector not produced by Lexer::scan
+        return m_Tokens->empty() ? Token{ TokenType::END } : m_Tokens->back();
+    }
+}
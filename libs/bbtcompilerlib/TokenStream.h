@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "Lexer.h"
+#include "TokenBuffer.h"
+
+namespace BBTCompiler
+{
+    // Token source for the Parser. It walks tokens materialized by Lexer::scan
+    // or a TokenBuffer, or pulls them from an opened Lexer on demand. Only a small
+    // ring buffer is kept in both cases, so a streamed file never has more
+    // than Capacity tokens in memory. References returned by peek() and
+    // previous() stay valid until the next advance(); peek() looks at most
+    // MaxLookahead tokens ahead, further would reuse the slots they are in.
+    class TokenStream
+    {
+    public:
+        explicit TokenStream(const std::vector<Token>& tokens);
+        explicit TokenStream(Lexer& lexer);
+        explicit TokenStream(const TokenBuffer& buffer);
+
+        static constexpr size_t Capacity{ 4 };
+        static constexpr size_t MaxLookahead{ Capacity - 2 };
+
+        const Token& peek(size_t ahead = 0);
+        const Token& previous();
+        void advance();
+        bool isAtEnd() { return peek().type == TokenType::END; }
+        // Number of tokens consumed so far
+        size_t consumed() const { return m_Current; }
+    private:
+        Token fetch();
+        Token& slot(size_t index) { return m_Ring[index & (Capacity - 1)]; }
+    private:
+        std::array<Token, Capacity> m_Ring{};
+        size_t m_Current{ 0 };
+        size_t m_Fetched{ 0 };
+        const std::vector<Token>* m_Tokens{ nullptr };
+        size_t m_NextIndex{ 0 };
+        Lexer* m_Lexer{ nullptr };
+        const TokenBuffer* m_Buffer{ nullptr };
+    };
+}
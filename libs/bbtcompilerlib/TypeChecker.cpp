@@ -0,0 +1,390 @@
+#include "TypeChecker.h"
+#include "ASTWalker.h"
+#include <algorithm>
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        constexpr std::string_view SyntaxErrorMessage{ "Cannot compile code with a syntax error." };
+
+        bool isNumber(ExprType type)
+        {
+            return type == ExprType::INT || type == ExprType::FLOAT;
+        }
+
+        // Whether a value of type `value` can be stored where `target` is
+        // expected. Unchecked types come from an error already reported.
+        bool fits(ExprType target, ExprType value)
+        {
+            return target == value || (target == ExprType::CHAR && value == ExprType::NIL) ||
+                   target == ExprType::UNCHECKED || value == ExprType::UNCHECKED;
+        }
+    }
+
+    struct TypeCheckerWalk
+    {
+        TypeChecker& checker;
+
+        ExprType operator()(AssignmentExpr& expr) const
+        {
+            const ExprType value{ checker.checkValue(*expr.m_Value) };
+            const TypeChecker::Slot* slot{ checker.slot(expr.m_Binding, expr.m_Name) };
+            if(!slot)
+                return ExprType::UNCHECKED;
+            if(slot->function)
+                return checker.error(expr.m_Name, "Cannot assign to the function '{}'.", expr.m_Name.value);
+            if(!fits(slot->type, value))
+                return checker.error(expr.m_Name, "Value does not match the type of '{}'.", expr.m_Name.value);
+            return slot->type;
+        }
+        ExprType operator()(BinaryExpr& expr) const { return checker.checkBinary(expr); }
+        ExprType operator()(UnaryExpr& expr) const
+        {
+            const ExprType operand{ checker.checkValue(*expr.m_Right) };
+            if(expr.m_Operator.type == TokenType::NOT)
+                return ExprType::BOOL;
+            if(operand == ExprType::UNCHECKED || isNumber(operand))
+                return operand;
+            return checker.error(expr.m_Operator, "Operand of '{}' must be a number.", expr.m_Operator.value);
+        }
+        ExprType operator()(GroupedExpr& expr) const { return checker.check(*expr.m_Expression); }
+        ExprType operator()(LiteralExpr& expr) const
+        {
+            switch(expr.m_Token.type)
+            {
+            case TokenType::TRUE:
+            case TokenType::FALSE: return ExprType::BOOL;
+            case TokenType::INT_LITERAL: return ExprType::INT;
+            case TokenType::FLOAT_LITERAL: return ExprType::FLOAT;
+            case TokenType::STRING_LITERAL: return ExprType::CHAR;
+            case TokenType::NIL: return ExprType::NIL;
+            default: return ExprType::UNCHECKED;
+            }
+        }
+        ExprType operator()(VariableExpr& expr) const
+        {
+            const TypeChecker::Slot* slot{ checker.slot(expr.m_Binding, expr.m_Name) };
+            if(!slot)
+                return ExprType::UNCHECKED;
+            if(slot->function)
+                return checker.error(expr.m_Name, "The function '{}' can only be called.", expr.m_Name.value);
+            return slot->type;
+        }
+        ExprType operator()(CallExpr& expr) const { return checker.checkCall(expr); }
+        ExprType operator()(ErrorExpr& expr) const
+        {
+            return checker.error(expr.m_Token, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+        }
+
+        void operator()(PrintStmt& stmt) const { checker.checkValue(*stmt.m_Expression); }
+        void operator()(ExprStmt& stmt) const { checker.check(*stmt.m_Expression); }
+        void operator()(VariableStmt& stmt) const
+        {
+            const ExprType type{ TypeChecker::declaredType(stmt.m_Type) };
+            if(type == ExprType::UNCHECKED)
+                checker.error(stmt.m_Type, "Unknown type '{}'.", stmt.m_Type.value);
+            if(stmt.m_Initializer && !fits(type, checker.checkValue(*stmt.m_Initializer)))
+                checker.error(stmt.m_Name, "Value does not match the type of '{}'.", stmt.m_Name.value);
+        }
+        void operator()(BlockStmt& stmt) const
+        {
+            for(Stmt* statement : stmt.m_Statements)
+                checker.check(*statement);
+        }
+        void operator()(IfStmt& stmt) const
+        {
+            checker.checkValue(*stmt.m_Condition);
+            if(stmt.m_ThenBranch)
+                checker.check(*stmt.m_ThenBranch);
+            if(stmt.m_ElseBranch)
+                checker.check(*stmt.m_ElseBranch);
+        }
+        void operator()(WhileStmt& stmt) const
+        {
+            checker.checkValue(*stmt.m_Condition);
+            if(stmt.m_Body)
+                checker.check(*stmt.m_Body);
+        }
+        void operator()(FuncStmt& stmt) const
+        {
+            checker.checkFunction(&stmt, AstSpan<Stmt* const>(stmt.m_Body.data(), stmt.m_Body.size()));
+        }
+        void operator()(ReturnStmt& stmt) const
+        {
+            const ExprType value{ stmt.m_Value ? checker.checkValue(*stmt.m_Value) : ExprType::VOID };
+            const FuncStmt* function{ checker.m_Functions.back().declaration };
+            // The top level may return anything, its value is dropped
+            if(!function)
+                return;
+            const ExprType expected{ function->m_ReturnType.type == TokenType::INVALID
+                                         ? ExprType::VOID : TypeChecker::declaredType(function->m_ReturnType) };
+            if(!fits(expected, value))
+                checker.error(stmt.m_ReturnToken, "Value does not match the return type of '{}'.", function->m_Name.value);
+        }
+        void operator()(ErrorStmt& stmt) const
+        {
+            checker.error(stmt.m_Token, SyntaxErrorMessage, {}, DiagnosticKind::SYNTAX);
+        }
+    };
+
+    bool TypeChecker::check(const std::vector<Stmt*>& statements)
+    {
+        m_Diagnostics.clear();
+        m_Functions.clear();
+        checkFunction(nullptr, AstSpan<Stmt* const>(statements.data(), statements.size()));
+        return !m_Diagnostics.hasErrors();
+    }
+
+    void TypeChecker::checkFunction(const FuncStmt* declaration, AstSpan<Stmt* const> body)
+    {
+        m_Functions.push_back(Function{ declaration });
+        if(declaration)
+        {
+            std::vector<Slot>& slots{ m_Functions.back().slots };
+            slots.resize(std::max<size_t>(declaration->m_FrameSize, declaration->m_Params.size()));
+            for(size_t i = 0; i < declaration->m_Params.size(); ++i)
+            {
+                const Token& type{ declaration->m_Params[i].second };
+                slots[i].type = declaredType(type);
+                if(slots[i].type == ExprType::UNCHECKED)
+                    error(type, "Unknown type '{}'.", type.value);
+            }
+        }
+        // Every slot gets its type before the body is checked, so uses in
+        // functions declared before a variable see it as well
+        declare(body);
+        for(Stmt* statement : body)
+            check(*statement);
+        if(declaration && declaration->m_ReturnType.type != TokenType::INVALID)
+        {
+            if(declaredType(declaration->m_ReturnType) == ExprType::UNCHECKED)
+                error(declaration->m_ReturnType, "Unknown type '{}'.", declaration->m_ReturnType.value);
+            else if(!returns(body))
+                error(declaration->m_Name, "'{}' does not return a value on every path.", declaration->m_Name.value);
+        }
+        m_Functions.pop_back();
+    }
+
+    void TypeChecker::declare(AstSpan<Stmt* const> statements)
+    {
+        for(const Stmt* statement : statements)
+            declare(statement);
+    }
+
+    void TypeChecker::declare(const Stmt* stmt)
+    {
+        if(!stmt)
+            return;
+        std::vector<Slot>& slots{ m_Functions.back().slots };
+        const auto slotAt = [&slots](uint32_t slot) -> Slot& {
+            if(slot >= slots.size())
+                slots.resize(slot + 1);
+            return slots[slot];
+        };
+        switch(stmt->getKind())
+        {
+        case StmtKind::VARIABLE:
+        {
+            const auto& variable = static_cast<const VariableStmt&>(*stmt);
+            if(variable.m_Slot != Binding::Unresolved)
+                slotAt(variable.m_Slot).type = declaredType(variable.m_Type);
+            break;
+        }
+        case StmtKind::FUNCTION:
+        {
+            const auto& function = static_cast<const FuncStmt&>(*stmt);
+            if(function.m_Slot != Binding::Unresolved)
+                slotAt(function.m_Slot) = Slot{ ExprType::FUNCTION, &function };
+            break;
+        }
+        case StmtKind::BLOCK:
+        {
+            const auto& block = static_cast<const BlockStmt&>(*stmt);
+            declare(AstSpan<Stmt* const>(block.m_Statements.data(), block.m_Statements.size()));
+            break;
+        }
+        case StmtKind::IF:
+        {
+            const auto& branch = static_cast<const IfStmt&>(*stmt);
+            declare(branch.m_ThenBranch);
+            declare(branch.m_ElseBranch);
+            break;
+        }
+        case StmtKind::WHILE:
+            declare(static_cast<const WhileStmt&>(*stmt).m_Body);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void TypeChecker::check(Stmt& stmt)
+    {
+        visitAst(stmt, TypeCheckerWalk{ *this });
+    }
+
+    ExprType TypeChecker::check(Expr& expr)
+    {
+        const ExprType type{ visitAst(expr, TypeCheckerWalk{ *this }) };
+        expr.setType(type);
+        return type;
+    }
+
+    ExprType TypeChecker::checkValue(Expr& expr)
+    {
+        const ExprType type{ check(expr) };
+        if(type != ExprType::VOID)
+            return type;
+        // Only calls have no value, possibly in parentheses
+        const Expr* inner{ &expr };
+        while(inner->getKind() == ExprKind::GROUPED)
+            inner = static_cast<const GroupedExpr&>(*inner).m_Expression;
+        if(inner->getKind() != ExprKind::CALL)
+            return error(Token{}, "Expression does not return a value.");
+        const auto& call = static_cast<const CallExpr&>(*inner);
+        if(call.m_Callee->getKind() != ExprKind::VARIABLE)
+            return error(call.m_Paren, "Expression does not return a value.");
+        const auto& callee = static_cast<const VariableExpr&>(*call.m_Callee);
+        return error(call.m_Paren, "'{}' does not return a value.", callee.m_Name.value);
+    }
+
+    ExprType TypeChecker::checkBinary(BinaryExpr& expr)
+    {
+        const Token& op{ expr.m_Operator };
+        const ExprType left{ checkValue(*expr.m_Left) };
+        const ExprType right{ checkValue(*expr.m_Right) };
+        if(op.type == TokenType::AND || op.type == TokenType::OR)
+            return ExprType::BOOL;
+        if(left == ExprType::UNCHECKED || right == ExprType::UNCHECKED)
+            return ExprType::UNCHECKED;
+        const bool numbers{ isNumber(left) && isNumber(right) };
+        const ExprType arithmetic{ left == ExprType::INT && right == ExprType::INT ? ExprType::INT : ExprType::FLOAT };
+        switch(op.type)
+        {
+        case TokenType::PLUS:
+            if(left == ExprType::CHAR && right == ExprType::CHAR)
+                return ExprType::CHAR;
+            if(!numbers)
+                return error(op, "Operands of '{}' must be two numbers or two strings.", op.value);
+            return arithmetic;
+        case TokenType::MINUS:
+        case TokenType::STAR:
+        case TokenType::SLASH:
+            if(!numbers)
+                return error(op, "Operands of '{}' must be numbers.", op.value);
+            return arithmetic;
+        case TokenType::LESS:
+        case TokenType::LESS_EQ:
+        case TokenType::GREATER:
+        case TokenType::GREATER_EQ:
+            if(!numbers)
+                return error(op, "Operands of '{}' must be numbers.", op.value);
+            return ExprType::BOOL;
+        case TokenType::EQ_EQ:
+        case TokenType::NOT_EQ:
+            if(!numbers && !fits(left, right) && !fits(right, left))
+                return error(op, "Operands of '{}' must have the same type.", op.value);
+            return ExprType::BOOL;
+        default:
+            return error(op, "Unsupported operator '{}'.", op.value);
+        }
+    }
+
+    ExprType TypeChecker::checkCall(CallExpr& expr)
+    {
+        std::vector<ExprType> arguments;
+        for(Expr* argument : expr.m_Args)
+            arguments.push_back(checkValue(*argument));
+        if(expr.m_Callee->getKind() != ExprKind::VARIABLE)
+        {
+            check(*expr.m_Callee);
+            return error(expr.m_Paren, "Only functions can be called, by their name.");
+        }
+        auto& callee = static_cast<VariableExpr&>(*expr.m_Callee);
+        const Slot* slot{ this->slot(callee.m_Binding, callee.m_Name) };
+        if(!slot)
+            return ExprType::UNCHECKED;
+        if(!slot->function)
+            return error(expr.m_Paren, "Can only call functions.");
+        callee.setType(ExprType::FUNCTION);
+        const FuncStmt& function{ *slot->function };
+        if(arguments.size() != function.m_Params.size())
+            return error(expr.m_Paren, "Wrong number of arguments to '{}'.", callee.m_Name.value);
+        for(size_t i = 0; i < arguments.size(); ++i)
+        {
+            if(!fits(declaredType(function.m_Params[i].second), arguments[i]))
+                error(expr.m_Paren, "Argument does not match the parameter type of '{}'.", callee.m_Name.value);
+        }
+        if(function.m_ReturnType.type == TokenType::INVALID)
+            return ExprType::VOID;
+        return declaredType(function.m_ReturnType);
+    }
+
+    const TypeChecker::Slot* TypeChecker::slot(const Binding& binding, const Token& name)
+    {
+        if(!binding.isResolved() || binding.depth >= m_Functions.size())
+        {
+            error(name, "Undefined name '{}'.", name.value, DiagnosticKind::NAME);
+            return nullptr;
+        }
+        const std::vector<Slot>& slots{ m_Functions[m_Functions.size() - 1 - binding.depth].slots };
+        // Only possible for a name whose declaration had an error
+        if(binding.slot >= slots.size())
+            return nullptr;
+        return &slots[binding.slot];
+    }
+
+    ExprType TypeChecker::declaredType(const Token& type)
+    {
+        switch(type.type)
+        {
+        case TokenType::INT: return ExprType::INT;
+        case TokenType::FLOAT: return ExprType::FLOAT;
+        case TokenType::BOOL: return ExprType::BOOL;
+        case TokenType::CHAR: return ExprType::CHAR;
+        default: return ExprType::UNCHECKED;
+        }
+    }
+
+    bool TypeChecker::returns(AstSpan<Stmt* const> statements)
+    {
+        return std::any_of(statements.begin(), statements.end(), [](const Stmt* statement) { return returns(statement); });
+    }
+
+    bool TypeChecker::returns(const Stmt* stmt)
+    {
+        if(!stmt)
+            return false;
+        switch(stmt->getKind())
+        {
+        case StmtKind::RETURN:
+            return true;
+        case StmtKind::BLOCK:
+        {
+            const auto& block = static_cast<const BlockStmt&>(*stmt);
+            return returns(AstSpan<Stmt* const>(block.m_Statements.data(), block.m_Statements.size()));
+        }
+        case StmtKind::IF:
+        {
+            const auto& branch = static_cast<const IfStmt&>(*stmt);
+            return returns(branch.m_ThenBranch) && returns(branch.m_ElseBranch);
+        }
+        case StmtKind::WHILE:
+        {
+            // There is no break, so `while(true)` is only left by returning
+            const Expr* condition{ static_cast<const WhileStmt&>(*stmt).m_Condition };
+            return condition->getKind() == ExprKind::LITERAL &&
+                   static_cast<const LiteralExpr&>(*condition).m_Token.type == TokenType::TRUE;
+        }
+        default:
+            return false;
+        }
+    }
+
+    ExprType TypeChecker::error(const Token& token, std::string_view message, std::string_view argument, DiagnosticKind kind)
+    {
+        m_Diagnostics.report(token, message, argument, kind);
+        return ExprType::UNCHECKED;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Diagnostics.h"
+#include "Expression.h"
+#include "Statement.h"
+
+namespace BBTCompiler
+{
+    // Checks a program the Resolver has resolved against the types of its
+    // declarations and stores the type of every expression in it, see
+    // Expr::getType. Variables and parameters have the type they are
+    // declared with, calls the return type of the function, and the
+    // operators follow the Interpreter: int and float operands mix in
+    // arithmetic and comparisons, computing in float, two chars concatenate
+    // with +, == and != take operands of the same type, and && and || as
+    // well as conditions take any value. `null` is a char without text, it
+    // fits wherever a char does. Functions can only be called, by their
+    // name, and a function with a return type must return a value on every
+    // path.
+    //
+    // In a program that checks, int, float and bool expressions always
+    // evaluate to values of that type, so backends may skip the checks of
+    // the type at runtime, like the BytecodeCompiler does for arithmetic and
+    // comparisons on two ints or two floats. For that a backend must give
+    // the variables of a block that are declared ahead of one of its
+    // functions their default value when the block starts, since a call to
+    // the function can read them before their declarations run.
+    class TypeChecker
+    {
+    public:
+        // Returns false if the program has type errors
+        bool check(const std::vector<Stmt*>& statements);
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+        // The type of a variable, parameter or return value declared with
+        // the type `type`, UNCHECKED for an unknown one
+        static ExprType declaredType(const Token& type);
+    private:
+        struct Slot
+        {
+            ExprType type{ ExprType::UNCHECKED };
+            // Set for function slots
+            const FuncStmt* function{ nullptr };
+        };
+        // State of the function being checked, null for the top level
+        struct Function
+        {
+            const FuncStmt* declaration;
+            std::vector<Slot> slots{};
+        };
+
+        friend struct TypeCheckerWalk;
+        void checkFunction(const FuncStmt* declaration, AstSpan<Stmt* const> body);
+        // Gives the variables and functions declared in `statements` their
+        // slot types, not looking into nested functions
+        void declare(AstSpan<Stmt* const> statements);
+        void declare(const Stmt* stmt);
+        void check(Stmt& stmt);
+        ExprType check(Expr& expr);
+        // Same, reporting a use of the result of a call to a function without
+        // a return type
+        ExprType checkValue(Expr& expr);
+        ExprType checkBinary(BinaryExpr& expr);
+        ExprType checkCall(CallExpr& expr);
+        // The slot a binding refers to, null after reporting an error
+        const Slot* slot(const Binding& binding, const Token& name);
+        // Whether control cannot reach the end of the statements
+        static bool returns(AstSpan<Stmt* const> statements);
+        static bool returns(const Stmt* stmt);
+        ExprType error(const Token& token, std::string_view message, std::string_view argument = {},
+                       DiagnosticKind kind = DiagnosticKind::TYPE);
+    private:
+        Diagnostics m_Diagnostics;
+        std::vector<Function> m_Functions;
+    };
+}
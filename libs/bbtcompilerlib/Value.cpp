@@ -0,0 +1,44 @@
+#include "Value.h"
+#include "Statement.h"
+#include <cstdio>
+
+namespace BBTCompiler
+{
+    bool operator==(const Value& left, const Value& right)
+    {
+        if(left.type != right.type)
+            return left.isNumber() && right.isNumber() && left.asFloat() == right.asFloat();
+        switch(left.type)
+        {
+        case ValueType::NIL: return true;
+        case ValueType::BOOL: return left.boolean == right.boolean;
+        case ValueType::INT: return left.integer == right.integer;
+        case ValueType::FLOAT: return left.number == right.number;
+        case ValueType::STRING: return left.asString() == right.asString();
+        case ValueType::FUNCTION:
+            return left.function.declaration == right.function.declaration &&
+                   left.function.frame == right.function.frame &&
+                   left.function.generation == right.function.generation;
+        }
+        return false;
+    }
+
+    std::ostream& operator<<(std::ostream& stream, const Value& value)
+    {
+        switch(value.type)
+        {
+        case ValueType::NIL: return stream << "null";
+        case ValueType::BOOL: return stream << (value.boolean ? "true" : "false");
+        case ValueType::INT: return stream << value.integer;
+        case ValueType::FLOAT:
+        {
+            char buffer[32];
+            const int length{ std::snprintf(buffer, sizeof(buffer), "%g", value.number) };
+            return stream.write(buffer, length);
+        }
+        case ValueType::STRING: return stream << value.asString();
+        case ValueType::FUNCTION: return stream << "<fn " << value.function.declaration->m_Name.value << '>';
+        }
+        return stream;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace BBTCompiler
+{
+    class FuncStmt;
+
+    enum class ValueType : uint8_t { NIL, BOOL, INT, FLOAT, STRING, FUNCTION };
+
+    // A function value: the declaration and the frame it was declared in,
+    // which the called function reaches its enclosing variables through.
+    // `generation` tells that frame apart from later calls reusing its index.
+    struct FunctionRef
+    {
+        const FuncStmt* declaration;
+        uint32_t frame;
+        uint32_t generation;
+    };
+
+    // A runtime value tagged with its type. Values are trivially copyable,
+    // strings are views of text owned by the tokens or by the engine that
+    // made them.
+    struct Value
+    {
+        ValueType type{ ValueType::NIL };
+        union
+        {
+            bool boolean;
+            int64_t integer;
+            double number;
+            struct
+            {
+                const char* data;
+                size_t size;
+            } string;
+            FunctionRef function;
+        };
+
+        Value() : integer{ 0 } {}
+
+        static Value makeBool(bool value) { Value result; result.type = ValueType::BOOL; result.boolean = value; return result; }
+        static Value makeInt(int64_t value) { Value result; result.type = ValueType::INT; result.integer = value; return result; }
+        static Value makeFloat(double value) { Value result; result.type = ValueType::FLOAT; result.number = value; return result; }
+        static Value makeString(std::string_view value)
+        {
+            Value result;
+            result.type = ValueType::STRING;
+            result.string = { value.data(), value.size() };
+            return result;
+        }
+        static Value makeFunction(FunctionRef value) { Value result; result.type = ValueType::FUNCTION; result.function = value; return result; }
+
+        bool isNumber() const { return type == ValueType::INT || type == ValueType::FLOAT; }
+        double asFloat() const { return type == ValueType::INT ? static_cast<double>(integer) : number; }
+        std::string_view asString() const { return std::string_view(string.data, string.size); }
+        // Only nil and false are false
+        bool isTruthy() const { return type == ValueType::BOOL ? boolean : type != ValueType::NIL; }
+    };
+
+    // Numbers compare by value across int and float, other values only
+    // equal values of the same type
+    bool operator==(const Value& left, const Value& right);
+    inline bool operator!=(const Value& left, const Value& right) { return !(left == right); }
+
+    // The text print writes: floats as the shortest of fixed and scientific
+    // notation with 6 significant digits, like printf's %g
+    std::ostream& operator<<(std::ostream& stream, const Value& value);
+}
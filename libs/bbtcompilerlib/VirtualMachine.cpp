@@ -0,0 +1,394 @@
+#include "VirtualMachine.h"
+#include "Statement.h"
+#include <algorithm>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BBTCOMPILER_COMPUTED_GOTO
+#endif
+
+namespace BBTCompiler
+{
+    namespace
+    {
+        // Integer arithmetic wraps around instead of overflowing
+        int64_t wrap(uint64_t value) { return static_cast<int64_t>(value); }
+    }
+
+    bool VirtualMachine::hasComputedGoto()
+    {
+#ifdef BBTCOMPILER_COMPUTED_GOTO
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool VirtualMachine::run(const BytecodeProgram& program)
+    {
+        m_Diagnostics.clear();
+        m_Program = &program;
+        m_CallCaches.assign(program.callSites, CallCache{});
+        const BytecodeFunction& script{ program.functions.front() };
+        m_Stack.assign(std::max<size_t>(script.maxStack, 1024), Value{});
+        // Reserved up front so a Frame pointer stays valid across calls
+        m_Frames.clear();
+        m_Frames.reserve(MaxCallDepth + 1);
+        m_Frames.push_back(Frame{ &script, script.code.data(), 0, 0, ++m_Generation });
+        const bool succeeded{ m_Dispatch == Dispatch::COMPUTED_GOTO ? execute<true>() : execute<false>() };
+        m_Frames.clear();
+        return succeeded;
+    }
+
+    template<bool Threaded>
+    bool VirtualMachine::execute()
+    {
+        Frame* frame{ &m_Frames.back() };
+        const uint8_t* ip{ frame->ip };
+        Value* slots{ m_Stack.data() };
+        Value* sp{ slots + frame->function->frameSize };
+        const Value* constants{ frame->function->constants.data() };
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, static_cast<uint32_t>(ip[-2] | (ip[-1] << 8)))
+#ifdef BBTCOMPILER_COMPUTED_GOTO
+#define BBTCOMPILER_OPCODE_LABEL(name) &&op_##name,
+        static const void* const Labels[]{ BBTCOMPILER_OPCODES(BBTCOMPILER_OPCODE_LABEL) };
+#undef BBTCOMPILER_OPCODE_LABEL
+#define DISPATCH() do { if constexpr(Threaded) goto *Labels[*ip++]; else goto dispatch; } while(false)
+#define CASE(name) case OpCode::name: op_##name
+#else
+#define DISPATCH() goto dispatch
+#define CASE(name) case OpCode::name
+#endif
+// Integer operands are handled inline, everything else by binary()
+#define BINARY(name, integerResult)                                 \
+        CASE(name):                                                 \
+        {                                                           \
+            Value& left{ sp[-2] };                                  \
+            const Value& right{ sp[-1] };                           \
+            --sp;                                                   \
+            if(left.type == ValueType::INT && right.type == ValueType::INT) \
+            {                                                       \
+                const int64_t a{ left.integer };                    \
+                const int64_t b{ right.integer };                   \
+                left = integerResult;                               \
+            }                                                       \
+            else if(!binary(OpCode::name, left, right, ip - 1))     \
+                return false;                                       \
+            DISPATCH();                                             \
+        }
+// Operands the TypeChecker typed, read without checking their type
+#define TYPED_BINARY(name, member, result)                          \
+        CASE(name):                                                 \
+        {                                                           \
+            const auto a = sp[-2].member;                           \
+            const auto b = sp[-1].member;                           \
+            --sp;                                                   \
+            sp[-1] = result;                                        \
+            DISPATCH();                                             \
+        }
+
+        DISPATCH();
+#ifdef BBTCOMPILER_COMPUTED_GOTO
+        // Only jumped to by the switch dispatch, not by the threaded one
+    dispatch: __attribute__((unused));
+#else
+    dispatch:
+#endif
+        switch(static_cast<OpCode>(READ_BYTE()))
+        {
+        CASE(CONSTANT):
+            *sp++ = constants[READ_SHORT()];
+            DISPATCH();
+        CASE(NIL):
+            *sp++ = Value{};
+            DISPATCH();
+        CASE(TRUE):
+            *sp++ = Value::makeBool(true);
+            DISPATCH();
+        CASE(FALSE):
+            *sp++ = Value::makeBool(false);
+            DISPATCH();
+        CASE(POP):
+            --sp;
+            DISPATCH();
+        CASE(GET_LOCAL):
+            *sp++ = slots[READ_SHORT()];
+            DISPATCH();
+        CASE(SET_LOCAL):
+            slots[READ_SHORT()] = sp[-1];
+            DISPATCH();
+        CASE(STORE_LOCAL):
+            slots[READ_SHORT()] = *--sp;
+            DISPATCH();
+        CASE(GET_OUTER):
+        {
+            uint32_t depth{ READ_BYTE() };
+            const uint32_t slot{ READ_SHORT() };
+            const Frame* outer{ frame };
+            for(; depth > 0; --depth)
+                outer = &m_Frames[outer->enclosing];
+            *sp++ = m_Stack[outer->base + slot];
+            DISPATCH();
+        }
+        CASE(SET_OUTER):
+        {
+            uint32_t depth{ READ_BYTE() };
+            const uint32_t slot{ READ_SHORT() };
+            const Frame* outer{ frame };
+            for(; depth > 0; --depth)
+                outer = &m_Frames[outer->enclosing];
+            m_Stack[outer->base + slot] = sp[-1];
+            DISPATCH();
+        }
+        CASE(FUNCTION):
+        {
+            const uint32_t function{ READ_SHORT() };
+            const uint32_t slot{ READ_SHORT() };
+            slots[slot] = Value::makeFunction(FunctionRef{ m_Program->functions[function].declaration,
+                static_cast<uint32_t>(frame - m_Frames.data()), frame->generation });
+            DISPATCH();
+        }
+        BINARY(ADD, Value::makeInt(wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b))))
+        BINARY(SUBTRACT, Value::makeInt(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b))))
+        BINARY(MULTIPLY, Value::makeInt(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b))))
+        CASE(DIVIDE):
+        {
+            Value& left{ sp[-2] };
+            const Value& right{ sp[-1] };
+            --sp;
+            if(left.type == ValueType::INT && right.type == ValueType::INT && right.integer > 0)
+                left = Value::makeInt(left.integer / right.integer);
+            else if(!binary(OpCode::DIVIDE, left, right, ip - 1))
+                return false;
+            DISPATCH();
+        }
+        BINARY(EQUAL, Value::makeBool(a == b))
+        BINARY(NOT_EQUAL, Value::makeBool(a != b))
+        BINARY(LESS, Value::makeBool(a < b))
+        BINARY(LESS_EQUAL, Value::makeBool(a <= b))
+        BINARY(GREATER, Value::makeBool(a > b))
+        BINARY(GREATER_EQUAL, Value::makeBool(a >= b))
+        TYPED_BINARY(ADD_INT, integer, Value::makeInt(wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b))))
+        TYPED_BINARY(SUBTRACT_INT, integer, Value::makeInt(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b))))
+        TYPED_BINARY(MULTIPLY_INT, integer, Value::makeInt(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b))))
+        CASE(DIVIDE_INT):
+        {
+            const int64_t b{ sp[-1].integer };
+            if(b == 0)
+                return error(ip - 1, "Division by zero.");
+            --sp;
+            sp[-1].integer = b == -1 ? wrap(0 - static_cast<uint64_t>(sp[-1].integer)) : sp[-1].integer / b;
+            DISPATCH();
+        }
+        TYPED_BINARY(EQUAL_INT, integer, Value::makeBool(a == b))
+        TYPED_BINARY(NOT_EQUAL_INT, integer, Value::makeBool(a != b))
+        TYPED_BINARY(LESS_INT, integer, Value::makeBool(a < b))
+        TYPED_BINARY(LESS_EQUAL_INT, integer, Value::makeBool(a <= b))
+        TYPED_BINARY(GREATER_INT, integer, Value::makeBool(a > b))
+        TYPED_BINARY(GREATER_EQUAL_INT, integer, Value::makeBool(a >= b))
+        TYPED_BINARY(ADD_FLOAT, number, Value::makeFloat(a + b))
+        TYPED_BINARY(SUBTRACT_FLOAT, number, Value::makeFloat(a - b))
+        TYPED_BINARY(MULTIPLY_FLOAT, number, Value::makeFloat(a * b))
+        TYPED_BINARY(DIVIDE_FLOAT, number, Value::makeFloat(a / b))
+        TYPED_BINARY(EQUAL_FLOAT, number, Value::makeBool(a == b))
+        TYPED_BINARY(NOT_EQUAL_FLOAT, number, Value::makeBool(a != b))
+        TYPED_BINARY(LESS_FLOAT, number, Value::makeBool(a < b))
+        TYPED_BINARY(LESS_EQUAL_FLOAT, number, Value::makeBool(a <= b))
+        TYPED_BINARY(GREATER_FLOAT, number, Value::makeBool(a > b))
+        TYPED_BINARY(GREATER_EQUAL_FLOAT, number, Value::makeBool(a >= b))
+        CASE(NEGATE):
+        {
+            Value& operand{ sp[-1] };
+            if(operand.type == ValueType::INT)
+                operand.integer = wrap(0 - static_cast<uint64_t>(operand.integer));
+            else if(operand.type == ValueType::FLOAT)
+                operand.number = -operand.number;
+            else
+                return error(ip - 1, "Operand of '{}' must be a number.", frame->function->tokenAt(
+                    static_cast<uint32_t>(ip - 1 - frame->function->code.data())).value);
+            DISPATCH();
+        }
+        CASE(NEGATE_INT):
+            sp[-1].integer = wrap(0 - static_cast<uint64_t>(sp[-1].integer));
+            DISPATCH();
+        CASE(NEGATE_FLOAT):
+            sp[-1].number = -sp[-1].number;
+            DISPATCH();
+        CASE(NOT):
+            sp[-1] = Value::makeBool(!sp[-1].isTruthy());
+            DISPATCH();
+        CASE(TRUTHY):
+            sp[-1] = Value::makeBool(sp[-1].isTruthy());
+            DISPATCH();
+        CASE(JUMP):
+        {
+            const uint32_t offset{ READ_SHORT() };
+            ip += offset;
+            DISPATCH();
+        }
+        CASE(JUMP_IF_FALSE):
+        {
+            const uint32_t offset{ READ_SHORT() };
+            if(!(--sp)->isTruthy())
+                ip += offset;
+            DISPATCH();
+        }
+        CASE(JUMP_IF_FALSE_OR_POP):
+        {
+            const uint32_t offset{ READ_SHORT() };
+            if(!sp[-1].isTruthy())
+                ip += offset;
+            else
+                --sp;
+            DISPATCH();
+        }
+        CASE(JUMP_IF_TRUE_OR_POP):
+        {
+            const uint32_t offset{ READ_SHORT() };
+            if(sp[-1].isTruthy())
+                ip += offset;
+            else
+                --sp;
+            DISPATCH();
+        }
+        CASE(LOOP):
+        {
+            const uint32_t offset{ READ_SHORT() };
+            ip -= offset;
+            DISPATCH();
+        }
+        CASE(CALL):
+        {
+            const uint32_t argumentCount{ READ_BYTE() };
+            const uint32_t site{ READ_SHORT() };
+            const uint8_t* instruction{ ip - 4 };
+            const Value& callee{ sp[-static_cast<ptrdiff_t>(argumentCount) - 1] };
+            if(callee.type != ValueType::FUNCTION)
+                return error(instruction, "Can only call functions.");
+            const FunctionRef reference{ callee.function };
+            CallCache& cache{ m_CallCaches[site] };
+            if(cache.declaration != reference.declaration)
+            {
+                cache.declaration = reference.declaration;
+                cache.function = &m_Program->functions[m_Program->findFunction(reference.declaration)];
+            }
+            const BytecodeFunction& function{ *cache.function };
+            if(argumentCount != function.arity)
+                return error(instruction, "Wrong number of arguments to '{}'.", function.name);
+            if(reference.frame >= m_Frames.size() || m_Frames[reference.frame].generation != reference.generation)
+                return error(instruction, "'{}' is called after the scope it was declared in ended.", function.name);
+            if(m_Frames.size() > MaxCallDepth)
+                return error(instruction, "Stack overflow.");
+
+            // The arguments already are the first slots of the new frame
+            const auto base{ static_cast<uint32_t>(sp - argumentCount - m_Stack.data()) };
+            if(base + function.maxStack > m_Stack.size())
+            {
+                m_Stack.resize(std::max<size_t>(m_Stack.size() * 2, base + function.maxStack));
+                sp = m_Stack.data() + base + argumentCount;
+            }
+            frame->ip = ip;
+            slots = m_Stack.data() + base;
+            std::fill(sp, slots + function.frameSize, Value{});
+            sp = slots + function.frameSize;
+            frame = &m_Frames.emplace_back(Frame{ &function, nullptr, base, reference.frame, ++m_Generation });
+            ip = function.code.data();
+            constants = function.constants.data();
+            DISPATCH();
+        }
+        CASE(RETURN):
+        {
+            const Value result{ sp[-1] };
+            const uint32_t base{ frame->base };
+            m_Frames.pop_back();
+            if(m_Frames.empty())
+                return true;
+            frame = &m_Frames.back();
+            // The result replaces the callee
+            sp = m_Stack.data() + base - 1;
+            *sp++ = result;
+            ip = frame->ip;
+            slots = m_Stack.data() + frame->base;
+            constants = frame->function->constants.data();
+            DISPATCH();
+        }
+        CASE(PRINT):
+            m_Output << *--sp << '\n';
+            DISPATCH();
+        }
+        return error(ip - 1, "Invalid instruction.");
+#undef READ_BYTE
+#undef READ_SHORT
+#undef DISPATCH
+#undef CASE
+#undef BINARY
+#undef TYPED_BINARY
+    }
+
+    bool VirtualMachine::binary(OpCode op, Value& left, const Value& right, const uint8_t* instruction)
+    {
+        switch(op)
+        {
+        case OpCode::EQUAL: left = Value::makeBool(left == right); return true;
+        case OpCode::NOT_EQUAL: left = Value::makeBool(left != right); return true;
+        case OpCode::ADD:
+            if(left.type == ValueType::STRING && right.type == ValueType::STRING)
+            {
+                left = concatenate(left.asString(), right.asString());
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+        const BytecodeFunction& function{ *m_Frames.back().function };
+        const std::string_view symbol{ function.tokenAt(static_cast<uint32_t>(instruction - function.code.data())).value };
+        if(!left.isNumber() || !right.isNumber())
+        {
+            if(op == OpCode::ADD)
+                return error(instruction, "Operands of '{}' must be two numbers or two strings.", symbol);
+            return error(instruction, "Operands of '{}' must be numbers.", symbol);
+        }
+        if(left.type == ValueType::INT && right.type == ValueType::INT)
+        {
+            // Only division reaches here with two integers
+            if(right.integer == 0)
+                return error(instruction, "Division by zero.");
+            left = Value::makeInt(right.integer == -1 ? wrap(0 - static_cast<uint64_t>(left.integer))
+                                                      : left.integer / right.integer);
+            return true;
+        }
+        const double a{ left.asFloat() };
+        const double b{ right.asFloat() };
+        switch(op)
+        {
+        case OpCode::ADD: left = Value::makeFloat(a + b); break;
+        case OpCode::SUBTRACT: left = Value::makeFloat(a - b); break;
+        case OpCode::MULTIPLY: left = Value::makeFloat(a * b); break;
+        case OpCode::DIVIDE: left = Value::makeFloat(a / b); break;
+        case OpCode::LESS: left = Value::makeBool(a < b); break;
+        case OpCode::LESS_EQUAL: left = Value::makeBool(a <= b); break;
+        case OpCode::GREATER: left = Value::makeBool(a > b); break;
+        case OpCode::GREATER_EQUAL: left = Value::makeBool(a >= b); break;
+        default: return error(instruction, "Unsupported operator '{}'.", symbol);
+        }
+        return true;
+    }
+
+    Value VirtualMachine::concatenate(std::string_view left, std::string_view right)
+    {
+        std::string& text = m_Strings.emplace_back();
+        text.reserve(left.size() + right.size());
+        text.append(left).append(right);
+        return Value::makeString(text);
+    }
+
+    bool VirtualMachine::error(const uint8_t* instruction, std::string_view message, std::string_view argument)
+    {
+        const BytecodeFunction& function{ *m_Frames.back().function };
+        const Token& token{ function.tokenAt(static_cast<uint32_t>(instruction - function.code.data())) };
+        m_Diagnostics.report(token, message, argument, DiagnosticKind::RUNTIME);
+        return false;
+    }
+}
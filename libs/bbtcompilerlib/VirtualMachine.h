@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Bytecode.h"
+#include "Diagnostics.h"
+#include "Value.h"
+
+namespace BBTCompiler
+{
+    // Runs a BytecodeProgram. Each call pushes a frame holding the callee's
+    // slots on the value stack, right where the caller pushed the arguments,
+    // and names of enclosing functions are reached through static links, as
+    // in the Interpreter. Programs behave the same in both engines, runtime
+    // errors included.
+    //
+    // Instructions are dispatched with computed goto where the compiler
+    // supports labels as values, each handler jumping straight to the next
+    // one, and with a switch in a loop otherwise.
+    class VirtualMachine
+    {
+    public:
+        enum class Dispatch : uint8_t { COMPUTED_GOTO, SWITCH };
+        // Calls nested deeper than this are a stack overflow
+        static constexpr size_t MaxCallDepth{ 1000 };
+
+        explicit VirtualMachine(std::ostream& output = std::cout) : m_Output{ output } {}
+
+        static bool hasComputedGoto();
+        // COMPUTED_GOTO falls back to SWITCH without compiler support
+        void setDispatch(Dispatch dispatch) { m_Dispatch = dispatch; }
+        // Returns false if the program stopped with a runtime error
+        bool run(const BytecodeProgram& program);
+        const Diagnostics& getDiagnostics() const { return m_Diagnostics; }
+    private:
+        struct Frame
+        {
+            const BytecodeFunction* function;
+            // Where the frame continues once its callee returns
+            const uint8_t* ip;
+            uint32_t base;
+            uint32_t enclosing;
+            uint32_t generation;
+        };
+        // The function a call site called last, calls from one site
+        // usually go to the same function
+        struct CallCache
+        {
+            const FuncStmt* declaration{ nullptr };
+            const BytecodeFunction* function{ nullptr };
+        };
+
+        template<bool Threaded>
+        bool execute();
+        // Operations on operands the fast paths in execute() do not handle,
+        // the result replaces `left`
+        bool binary(OpCode op, Value& left, const Value& right, const uint8_t* instruction);
+        Value concatenate(std::string_view left, std::string_view right);
+        bool error(const uint8_t* instruction, std::string_view message, std::string_view argument = {});
+    private:
+        std::ostream& m_Output;
+        Dispatch m_Dispatch{ Dispatch::COMPUTED_GOTO };
+        Diagnostics m_Diagnostics;
+        const BytecodeProgram* m_Program{ nullptr };
+        std::vector<Value> m_Stack;
+        std::vector<Frame> m_Frames;
+        std::vector<CallCache> m_CallCaches;
+        uint32_t m_Generation{ 0 };
+        // Text of strings made at runtime, kept until the VM is destroyed
+        std::list<std::string> m_Strings;
+    };
+}
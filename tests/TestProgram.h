@@ -0,0 +1,80 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "catch.hpp"
+#include "Interpreter.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+
+namespace BBTTests
+{
+    // What a program printed, and its exit code as the command line reports
+    // it: 0, or 70 after a runtime error
+    struct RunResult
+    {
+        int exitCode;
+        std::string output;
+        std::string diagnostics;
+    };
+
+    // Lexes, parses and resolves `source`, requiring that it has no syntax or
+    // name errors, then calls run(statements, frameSize), or
+    // run(statements, frameSize, parser) for tests that need the AstContext
+    // of the tree. The tree only lives during the call.
+    template<typename Run>
+    void withProgram(std::string_view source, Run&& run)
+    {
+        BBTCompiler::Lexer lexer;
+        lexer.scan(source);
+        auto parser = BBTCompiler::Parser(lexer.getTokens());
+        std::vector<BBTCompiler::Stmt*>& statements{ parser.parse() };
+        REQUIRE_FALSE(parser.getDiagnostics().hasErrors());
+        BBTCompiler::Resolver resolver;
+        resolver.resolve(statements);
+        REQUIRE_FALSE(resolver.getDiagnostics().hasErrors());
+        if constexpr(std::is_invocable_v<Run, std::vector<BBTCompiler::Stmt*>&, uint32_t>)
+            run(statements, resolver.getFrameSize());
+        else
+            run(statements, resolver.getFrameSize(), parser);
+    }
+
+    // Same, also requiring that the program type checks, for the backends
+    // that work from the types the TypeChecker stored
+    template<typename Run>
+    void withCheckedProgram(std::string_view source, Run&& run)
+    {
+        withProgram(source, [&](std::vector<BBTCompiler::Stmt*>& statements, uint32_t frameSize) {
+            BBTCompiler::TypeChecker checker;
+            const bool checked{ checker.check(statements) };
+            std::stringstream errors;
+            checker.getDiagnostics().print(errors);
+            INFO(errors.str());
+            REQUIRE(checked);
+            run(statements, frameSize);
+        });
+    }
+
+    inline RunResult interpret(const std::vector<BBTCompiler::Stmt*>& statements, uint32_t frameSize)
+    {
+        std::stringstream output;
+        BBTCompiler::Interpreter interpreter(output);
+        const bool succeeded{ interpreter.run(statements, frameSize) };
+        std::stringstream diagnostics;
+        interpreter.getDiagnostics().print(diagnostics);
+        return RunResult{ succeeded ? 0 : 70, output.str(), diagnostics.str() };
+    }
+
+    inline RunResult interpret(std::string_view source)
+    {
+        RunResult result{};
+        withProgram(source, [&](std::vector<BBTCompiler::Stmt*>& statements, uint32_t frameSize) {
+            result = interpret(statements, frameSize);
+        });
+        return result;
+    }
+}
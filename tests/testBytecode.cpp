@@ -0,0 +1,222 @@
+#include "catch.hpp"
+#include "BytecodeCompiler.h"
+#include "TestProgram.h"
+#include "VirtualMachine.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using BBTCompiler::BytecodeCompiler;
+using BBTCompiler::Stmt;
+using BBTCompiler::VirtualMachine;
+using BBTTests::interpret;
+using BBTTests::RunResult;
+using BBTTests::withProgram;
+
+namespace
+{
+    RunResult runVM(std::string_view source, VirtualMachine::Dispatch dispatch)
+    {
+        RunResult result{};
+        withProgram(source, [&](std::vector<Stmt*>& statements, uint32_t frameSize) {
+            BytecodeCompiler compiler;
+            REQUIRE(compiler.compile(statements, frameSize));
+            std::stringstream output;
+            VirtualMachine vm(output);
+            vm.setDispatch(dispatch);
+            const bool succeeded{ vm.run(compiler.getProgram()) };
+            std::stringstream diagnostics;
+            vm.getDiagnostics().print(diagnostics);
+            result = RunResult{ succeeded ? 0 : 70, output.str(), diagnostics.str() };
+        });
+        return result;
+    }
+
+    // The VM, with either dispatch, must behave like the Interpreter
+    void checkSameAsInterpreter(std::string_view source)
+    {
+        const RunResult expected{ interpret(source) };
+        for(const auto dispatch : { VirtualMachine::Dispatch::COMPUTED_GOTO, VirtualMachine::Dispatch::SWITCH })
+        {
+            const RunResult result{ runVM(source, dispatch) };
+            CHECK(result.exitCode == expected.exitCode);
+            CHECK(result.output == expected.output);
+            CHECK(result.diagnostics == expected.diagnostics);
+        }
+    }
+}
+
+TEST_CASE("BytecodeDisassembly", "[Bytecode]")
+{
+    withProgram(R"(
+        let total : int = 0;
+        for (let i : int = 0; i < 3; i = i + 1) total = total + i;
+        fn add(a: int, b: int) -> int { return a + b + total; }
+        print add(1, 2) > 5 && true;
+    )", [](std::vector<Stmt*>& statements, uint32_t frameSize) {
+        BytecodeCompiler compiler;
+        REQUIRE(compiler.compile(statements, frameSize));
+        std::stringstream stream;
+        compiler.getProgram().disassemble(stream);
+        // `total` starts with its default value, add could be called before
+        // its declaration. The for loop is a while loop whose body ends with
+        // the increment, constants are pooled per function.
+        CHECK(stream.str() ==
+            "== <script> ==\n"
+            "0000 FUNCTION 1 0\n"
+            "0005 CONSTANT 0 (0)\n"
+            "0008 STORE_LOCAL 1\n"
+            "0011 CONSTANT 0 (0)\n"
+            "0014 STORE_LOCAL 1\n"
+            "0017 CONSTANT 0 (0)\n"
+            "0020 STORE_LOCAL 2\n"
+            "0023 GET_LOCAL 2\n"
+            "0026 CONSTANT 1 (3)\n"
+            "0029 LESS\n"
+            "0030 JUMP_IF_FALSE -> 0056\n"
+            "0033 GET_LOCAL 1\n"
+            "0036 GET_LOCAL 2\n"
+            "0039 ADD\n"
+            "0040 STORE_LOCAL 1\n"
+            "0043 GET_LOCAL 2\n"
+            "0046 CONSTANT 2 (1)\n"
+            "0049 ADD\n"
+            "0050 STORE_LOCAL 2\n"
+            "0053 LOOP -> 0023\n"
+            "0056 GET_LOCAL 0\n"
+            "0059 CONSTANT 2 (1)\n"
+            "0062 CONSTANT 3 (2)\n"
+            "0065 CALL 2\n"
+            "0069 CONSTANT 4 (5)\n"
+            "0072 GREATER\n"
+            "0073 JUMP_IF_FALSE_OR_POP -> 0077\n"
+            "0076 TRUE\n"
+            "0077 TRUTHY\n"
+            "0078 PRINT\n"
+            "0079 NIL\n"
+            "0080 RETURN\n"
+            "== add ==\n"
+            "0000 GET_LOCAL 0\n"
+            "0003 GET_LOCAL 1\n"
+            "0006 ADD\n"
+            "0007 GET_OUTER 1 1\n"
+            "0011 ADD\n"
+            "0012 RETURN\n"
+            "0013 NIL\n"
+            "0014 RETURN\n");
+        const auto& functions = compiler.getProgram().functions;
+        CHECK(functions[0].frameSize == 3);
+        CHECK(functions[0].maxStack == 3 + 3);
+        CHECK(functions[1].arity == 2);
+        CHECK(functions[1].maxStack == 2 + 2);
+    });
+}
+
+TEST_CASE("BytecodeVM", "[Bytecode]")
+{
+    SECTION("expressions and values")
+    {
+        checkSameAsInterpreter(R"(
+            print 1 + 2 * 3;
+            print (1 + 2) * 3;
+            print 7 / 2;
+            print -7 / 2;
+            print 7 / -2;
+            print 7.0 / 2;
+            print 1 + 0.5;
+            print 10 >= 10;
+            print 1 == 1.0;
+            print 2 != 3;
+            print "a" == "a";
+            print "con" + "cat";
+            print !true;
+            print null;
+            print true && false || true;
+            print 0 && false;
+            print null || 3;
+            print -9223372036854775807 - 1;
+            print 9223372036854775807 + 1;
+        )");
+    }
+
+    SECTION("variables, blocks and loops")
+    {
+        checkSameAsInterpreter(R"(
+            let total : int = 0;
+            for (let i : int = 1; i <= 10; i = i + 1) total = total + i;
+            print total;
+            let x : int = 1;
+            {
+                let x : int = x + 1;
+                print x;
+            }
+            print x;
+            let n : int = 3;
+            while (n != 0) { print n; n = n - 1; }
+            if (n == 0) print "zero"; else print "not zero";
+            let f : float;
+            let b : bool;
+            let c : char;
+            print f;
+            print b;
+            print c;
+            print x = 5;
+        )");
+    }
+
+    SECTION("functions")
+    {
+        checkSameAsInterpreter(R"(
+            print fib(15);
+            fn fib(n: int) -> int {
+                if (n < 2) return n;
+                return fib(n - 1) + fib(n - 2);
+            }
+            fn isEven(n: int) -> bool { if (n == 0) return true; return isOdd(n - 1); }
+            fn isOdd(n: int) -> bool { if (n == 0) return false; return isEven(n - 1); }
+            print isEven(10);
+            let base : int = 100;
+            fn outer(x: int) -> int {
+                let local : int = x * 2;
+                fn inner(y: int) -> int { local = local + 1; return base + local + y; }
+                return inner(1) + inner(2) + local;
+            }
+            print outer(5);
+            fn nothing() -> int { print "side effect"; }
+            print nothing();
+            let g : int = 0;
+            fn count() -> int { g = g + 1; return g; }
+            count();
+            count();
+            print g;
+            print fib;
+            print fib == fib;
+            fn depth(n: int) -> int { if (n == 0) return 0; return depth(n - 1) + 1; }
+            print depth(900);
+            fn apply(f: int, value: int) -> int { return f(value); }
+            print apply(fib, 10);
+            print apply(isEven, 3);
+        )");
+    }
+
+    SECTION("runtime errors")
+    {
+        checkSameAsInterpreter("print 1;\nprint 1 / 0;\nprint 2;");
+        checkSameAsInterpreter("print 1 + true;");
+        checkSameAsInterpreter("print \"a\" < \"b\";");
+        checkSameAsInterpreter("print -\"a\";");
+        checkSameAsInterpreter("let x : int = 1;\nx();");
+        checkSameAsInterpreter("fn f(a: int) -> int { return a; }\nf(1, 2);");
+        checkSameAsInterpreter("fn f(n: int) -> int { return f(n + 1); }\nf(0);");
+        checkSameAsInterpreter(R"(
+            fn make() -> int {
+                fn inner() -> int { return 1; }
+                return inner;
+            }
+            let escaped : int = make();
+            print escaped();
+        )");
+        CHECK(runVM("print 1 / 0;", VirtualMachine::Dispatch::SWITCH).diagnostics ==
+              "<file>:1:9: runtime error: Division by zero.\n");
+    }
+}
@@ -0,0 +1,114 @@
+#include "catch.hpp"
+#include "CharScan.h"
+#include "Lexer.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace CharScan = BBTCompiler::CharScan;
+using BBTCompiler::Lexer;
+using CharScan::SimdLevel;
+
+namespace
+{
+    std::vector<SimdLevel> supportedLevels()
+    {
+        std::vector<SimdLevel> levels{ SimdLevel::SCALAR };
+        for(const SimdLevel level : { SimdLevel::SSE2, SimdLevel::AVX2 })
+            if(CharScan::setLevel(level))
+                levels.push_back(level);
+        CharScan::setLevel(CharScan::bestSupportedLevel());
+        return levels;
+    }
+
+    // Restores the best implementation when a test leaves its scope
+    struct LevelGuard
+    {
+        ~LevelGuard() { CharScan::setLevel(CharScan::bestSupportedLevel()); }
+    };
+}
+
+TEST_CASE("CharScanKernels", "[CharScan]")
+{
+    LevelGuard guard;
+    std::mt19937 random{ 1234 };
+    const std::string alphabet{ "abcXYZ_09 \t\r\n\"\\+;.\x80\xff" };
+    std::uniform_int_distribution<size_t> pick{ 0, alphabet.size() - 1 };
+    std::uniform_int_distribution<size_t> runLength{ 0, 70 };
+
+    // Long runs of one character class followed by a random tail, at every
+    // offset, so both the vector loops and the scalar tails are exercised
+    std::vector<std::string> inputs;
+    for(const std::string run : { "identifier_Run09", "0123456789", " \t\r\n\v\f", "plain string body" })
+    {
+        for(size_t i = 0; i < 40; ++i)
+        {
+            std::string input;
+            const size_t length = runLength(random);
+            while(input.size() < length)
+                input += run;
+            input.resize(length);
+            for(size_t tail = runLength(random); tail > 0; --tail)
+                input += alphabet[pick(random)];
+            inputs.push_back(input);
+        }
+    }
+
+    for(const SimdLevel level : supportedLevels())
+    {
+        INFO("simd level " << static_cast<int>(level));
+        for(const auto& input : inputs)
+        {
+            const char* begin = input.data();
+            const char* end = input.data() + input.size();
+            for(const char* start = begin; start <= end; ++start)
+            {
+                REQUIRE(CharScan::setLevel(SimdLevel::SCALAR));
+                const char* identifier = CharScan::skipIdentifierChars(start, end);
+                const char* digits = CharScan::skipDigits(start, end);
+                const char* whitespace = CharScan::skipWhitespace(start, end);
+                const char* special = CharScan::findQuoteOrBackslash(start, end);
+                const size_t newlines = CharScan::countNewlines(start, end);
+                REQUIRE(CharScan::setLevel(level));
+                REQUIRE(CharScan::skipIdentifierChars(start, end) == identifier);
+                REQUIRE(CharScan::skipDigits(start, end) == digits);
+                REQUIRE(CharScan::skipWhitespace(start, end) == whitespace);
+                REQUIRE(CharScan::findQuoteOrBackslash(start, end) == special);
+                REQUIRE(CharScan::countNewlines(start, end) == newlines);
+            }
+        }
+    }
+}
+
+TEST_CASE("CharScanLexerEquivalence", "[CharScan][Lexer]")
+{
+    LevelGuard guard;
+    std::string source;
+    for(int i = 0; i < 50; ++i)
+    {
+        source += "fn a_rather_long_function_name_number_" + std::to_string(i) + "(x: int) -> float\n{\n";
+        source += "        \t  let value : float = 1234567890123456789.25 * x;\r\n\n\n";
+        source += "    print \"a long string literal that spans more than thirty two bytes \\\"quoted\\\" \\\\x\";\n";
+        source += "    return value;          \n}\n";
+    }
+
+    Lexer reference;
+    REQUIRE(CharScan::setLevel(SimdLevel::SCALAR));
+    reference.scan(std::string_view(source));
+    for(const SimdLevel level : supportedLevels())
+    {
+        INFO("simd level " << static_cast<int>(level));
+        REQUIRE(CharScan::setLevel(level));
+        Lexer lexer;
+        lexer.scan(std::string_view(source));
+        CHECK(lexer.getTokens() == reference.getTokens());
+    }
+    const auto& tokens = reference.getTokens();
+    REQUIRE(tokens.size() > 20);
+    CHECK(tokens[11].value == "value");
+    CHECK(tokens[11].position.line == 3); CHECK(tokens[11].position.column == 16);
+    CHECK(tokens[20].value == "a long string literal that spans more than thirty two bytes \"quoted\" x");
+    CHECK(tokens[20].position.line == 6); CHECK(tokens[20].position.column == 11);
+    CHECK(tokens[21].type == BBTCompiler::TokenType::SEMICOLON);
+    CHECK(tokens[21].position.line == 6); CHECK(tokens[21].position.column == 87);
+}
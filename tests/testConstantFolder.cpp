@@ -0,0 +1,158 @@
+#include "catch.hpp"
+#include "ConstantFolder.h"
+#include "JsonVisitor.h"
+#include "TestProgram.h"
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+using BBTCompiler::ASTJSonVisitor;
+using BBTCompiler::ConstantFolder;
+using BBTCompiler::Parser;
+using BBTCompiler::Stmt;
+
+namespace
+{
+    struct FoldResult
+    {
+        // JSON of each top-level statement after folding
+        std::vector<nlohmann::json> statements;
+        size_t removedNodes;
+    };
+
+    // Parses and resolves `source`, runs the folder if `fold` and then `run`
+    template<typename Run>
+    void withFolded(std::string_view source, bool fold, Run&& run)
+    {
+        BBTTests::withProgram(source, [&](std::vector<Stmt*>& statements, uint32_t frameSize, Parser& parser) {
+            ConstantFolder folder(parser.getContext());
+            if(fold)
+                folder.fold(statements);
+            run(statements, frameSize, folder.getRemovedNodes());
+        });
+    }
+
+    FoldResult fold(std::string_view source)
+    {
+        FoldResult result{};
+        withFolded(source, true, [&](std::vector<Stmt*>& statements, uint32_t, size_t removedNodes) {
+            for(const Stmt* statement : statements)
+            {
+                ASTJSonVisitor visitor;
+                statement->accept(visitor);
+                result.statements.push_back(visitor.getJson());
+            }
+            result.removedNodes = removedNodes;
+        });
+        return result;
+    }
+
+    // The value an expression statement folds to, empty if it was not folded
+    // to a literal
+    std::string foldedValue(const std::string& expression)
+    {
+        const FoldResult result{ fold(expression + ";") };
+        REQUIRE(result.statements.size() == 1);
+        const nlohmann::json& folded{ result.statements[0]["expression"] };
+        if(folded["type"] != "PrimaryExpression")
+            return {};
+        return folded["value"];
+    }
+
+    std::string interpret(std::string_view source, bool fold)
+    {
+        std::string output;
+        withFolded(source, fold, [&](std::vector<Stmt*>& statements, uint32_t frameSize, size_t) {
+            const BBTTests::RunResult result{ BBTTests::interpret(statements, frameSize) };
+            output = result.output + result.diagnostics;
+        });
+        return output;
+    }
+}
+
+TEST_CASE("FoldConstants", "[ConstantFolder]")
+{
+    SECTION("literals")
+    {
+        // 1*2-3 is five nodes, one literal is left
+        const FoldResult result{ fold("1*2-3;") };
+        REQUIRE(result.statements.size() == 1);
+        CHECK(result.statements[0] == R"({
+            "type": "ExpressionStatement",
+            "expression": { "type": "PrimaryExpression", "value": "-1" }
+        })"_json);
+        CHECK(result.removedNodes == 4);
+
+        CHECK(foldedValue("7 / 2") == "3");
+        CHECK(foldedValue("-7 / 2") == "-3");
+        CHECK(foldedValue("7.0 / 2") == "3.5");
+        CHECK(foldedValue("(1 + 2) * 3") == "9");
+        CHECK(foldedValue("0.1 + 0.2") == "0.30000000000000004");
+        CHECK(foldedValue("9223372036854775807 + 1") == "-9223372036854775808");
+        CHECK(foldedValue("(-9223372036854775807 - 1) / -1") == "-9223372036854775808");
+        CHECK(foldedValue("1 == 1.0") == "true");
+        CHECK(foldedValue("2 >= 3 || 1 < 2") == "true");
+        CHECK(foldedValue("\"con\" + \"cat\"") == "concat");
+        CHECK(foldedValue("\"a\" != \"a\"") == "false");
+        CHECK(foldedValue("!null") == "true");
+        CHECK(foldedValue("null && 1") == "false");
+        CHECK(foldedValue("-(2.5)") == "-2.5");
+    }
+
+    SECTION("runtime errors are kept")
+    {
+        CHECK(foldedValue("1 / 0").empty());
+        CHECK(foldedValue("1 + true").empty());
+        CHECK(foldedValue("\"a\" < \"b\"").empty());
+        CHECK(foldedValue("-\"a\"").empty());
+        CHECK(foldedValue("99999999999999999999 + 1").empty());
+    }
+
+    SECTION("identities")
+    {
+        const FoldResult result{ fold("let x : int = 1;\nprint (x - 1) * 1;\nprint 1 * -x;\nprint x * 1;\nprint -x + 0.0;") };
+        REQUIRE(result.statements.size() == 5);
+        CHECK(result.statements[1]["expression"]["type"] == "GroupedExpression");
+        CHECK(result.statements[2]["expression"]["type"] == "UnaryExpression");
+        // x may not be a number, and -x + 0.0 would turn -0.0 into 0.0
+        CHECK(result.statements[3]["expression"]["type"] == "BinaryExpression");
+        CHECK(result.statements[4]["expression"]["type"] == "BinaryExpression");
+        CHECK(result.removedNodes == 2 + 2);
+    }
+
+    SECTION("control flow")
+    {
+        const FoldResult result{ fold(R"(
+            if (1 < 2) print "yes"; else print "no";
+            if (false) print "no";
+            while (1 > 2) print "never";
+            while (true) if (0 == 1) print "no";
+        )") };
+        // The else branch and the condition go with the first if, only the
+        // while (true) loop is left of the rest
+        REQUIRE(result.statements.size() == 2);
+        CHECK(result.statements[0]["type"] == "PrintStatement");
+        CHECK(result.statements[1]["type"] == "WhileStatement");
+        CHECK(result.statements[1]["condition"]["value"] == "true");
+        CHECK(result.statements[1]["body"]["type"] == "BlockStatement");
+        CHECK(result.removedNodes == (1 + 3 + 2) + (1 + 1 + 2) + (1 + 3 + 2) + (1 + 3 + 2 - 1));
+    }
+
+    SECTION("same output as without folding")
+    {
+        const std::string_view source{ R"(
+            let total : int = 0;
+            for (let i : int = 0; i < 2 * 5; i = i + 1 * 1) total = total + i * (3 - 2);
+            print total;
+            print total * 1.0;
+            print -0.0 - 0;
+            print 1.0 / 0 * 0;
+            fn f(n: int) -> int { if (2 > 1) return n * (4 / 2); print "dead"; }
+            print f(21);
+            print "a" + "b" == "ab";
+            print 1 && "x" || null;
+            print (10 - 4) / (3 - 3);
+        )" };
+        CHECK(interpret(source, true) == interpret(source, false));
+    }
+}
@@ -0,0 +1,336 @@
+#include "catch.hpp"
+#include "IRFolder.h"
+#include "IRGenerator.h"
+#include "TestProgram.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using BBTCompiler::BlockId;
+using BBTCompiler::IRFolder;
+using BBTCompiler::IRFunction;
+using BBTCompiler::IRGenerator;
+using BBTCompiler::IRInstruction;
+using BBTCompiler::IROp;
+using BBTCompiler::IRType;
+using BBTCompiler::Stmt;
+using BBTCompiler::ValueId;
+
+namespace
+{
+    template<typename Check>
+    void withIR(std::string_view source, Check&& check)
+    {
+        BBTTests::withCheckedProgram(source, [&](std::vector<Stmt*>& statements, uint32_t frameSize) {
+            IRGenerator generator;
+            const bool generated{ generator.generate(statements, frameSize) };
+            check(generator, generated);
+        });
+    }
+
+    std::string printIR(std::string_view source)
+    {
+        std::stringstream stream;
+        withIR(source, [&](IRGenerator& generator, bool generated) {
+            REQUIRE(generated);
+            generator.getModule().print(stream);
+        });
+        return stream.str();
+    }
+
+    std::string printFolded(std::string_view source)
+    {
+        std::stringstream stream;
+        withIR(source, [&](IRGenerator& generator, bool generated) {
+            REQUIRE(generated);
+            IRFolder folder;
+            folder.fold(generator.getModule());
+            generator.getModule().print(stream);
+        });
+        return stream.str();
+    }
+
+    std::string errors(std::string_view source)
+    {
+        std::stringstream stream;
+        withIR(source, [&](IRGenerator& generator, bool) {
+            generator.getDiagnostics().print(stream);
+        });
+        return stream.str();
+    }
+
+    // Properties every function of the IR must have
+    void checkWellFormed(const IRFunction& function)
+    {
+        for(ValueId id = 0; id < function.instructions.size(); ++id)
+            CHECK(function.instruction(id).id == id);
+        std::vector<std::vector<BlockId>> predecessors(function.blocks.size());
+        for(BlockId block = 0; block < function.blocks.size(); ++block)
+        {
+            const std::vector<ValueId>& code{ function.blocks[block].instructions };
+            REQUIRE_FALSE(code.empty());
+            bool phis{ true };
+            for(size_t i = 0; i < code.size(); ++i)
+            {
+                const IRInstruction& instruction{ function.instruction(code[i]) };
+                CHECK(instruction.block == block);
+                CHECK(instruction.isTerminator() == (i + 1 == code.size()));
+                CHECK((instruction.op != IROp::PHI || phis));
+                phis = phis && instruction.op == IROp::PHI;
+                if(instruction.op == IROp::PHI)
+                    CHECK(instruction.operands.size() == function.blocks[block].predecessors.size());
+                for(const ValueId operand : instruction.operands)
+                {
+                    REQUIRE(operand < function.instructions.size());
+                    CHECK(function.instruction(operand).type != IRType::VOID);
+                }
+            }
+            for(const BlockId successor : function.successors(block))
+                predecessors[successor].push_back(block);
+        }
+        for(BlockId block = 0; block < function.blocks.size(); ++block)
+        {
+            std::vector<BlockId> expected{ function.blocks[block].predecessors };
+            std::sort(expected.begin(), expected.end());
+            CHECK(predecessors[block] == expected);
+        }
+    }
+}
+
+TEST_CASE("IRLowering", "[IR]")
+{
+    SECTION("loops get phis at their header")
+    {
+        // `limit` does not change in the loop, so its phi is removed
+        CHECK(printIR(R"(
+            let total : int = 0;
+            let limit : int = 3;
+            while (total < limit) total = total + 1;
+            print total * 0.5;
+        )") ==
+            "fn <script>() {\n"
+            "block0:\n"
+            "    %0 = constant int 0\n"
+            "    %1 = constant int 3\n"
+            "    jump block1\n"
+            "block1: ; preds block0, block2\n"
+            "    %3 = phi int [%0, block0], [%7, block2]\n"
+            "    %4 = lt bool %3, %1\n"
+            "    branch %4, block2, block3\n"
+            "block2: ; preds block1\n"
+            "    %6 = constant int 1\n"
+            "    %7 = add int %3, %6\n"
+            "    jump block1\n"
+            "block3: ; preds block1\n"
+            "    %9 = constant float 0.5\n"
+            "    %10 = to_float float %3\n"
+            "    %11 = mul float %10, %9\n"
+            "    print %11\n"
+            "    return\n"
+            "}\n");
+    }
+
+    SECTION("branches merge in phis")
+    {
+        CHECK(printIR(R"(
+            fn pick(flag: bool, a: int) -> int {
+                let result : int = a;
+                if (flag && a > 0) result = 1; else result = 2;
+                return result;
+            }
+        )") ==
+            "fn <script>() {\n"
+            "block0:\n"
+            "    return\n"
+            "}\n"
+            "fn pick(bool, int) -> int {\n"
+            "block0:\n"
+            "    %0 = parameter bool 0\n"
+            "    %1 = parameter int 1\n"
+            "    branch %0, block1, block2\n"
+            "block1: ; preds block0\n"
+            "    %3 = constant int 0\n"
+            "    %4 = gt bool %1, %3\n"
+            "    jump block2\n"
+            "block2: ; preds block0, block1\n"
+            "    %6 = phi bool [%0, block0], [%4, block1]\n"
+            "    branch %6, block3, block4\n"
+            "block3: ; preds block2\n"
+            "    %8 = constant int 1\n"
+            "    jump block5\n"
+            "block4: ; preds block2\n"
+            "    %10 = constant int 2\n"
+            "    jump block5\n"
+            "block5: ; preds block3, block4\n"
+            "    %12 = phi int [%8, block3], [%10, block4]\n"
+            "    return %12\n"
+            "}\n");
+    }
+
+    SECTION("variables of nested functions stay in the frame")
+    {
+        // `local` starts with its default value, inner could be called
+        // before its declaration
+        CHECK(printIR(R"(
+            fn outer(x: int) -> int {
+                let local : int = x;
+                fn inner() { local = local + 1; }
+                inner();
+                return local;
+            }
+        )") ==
+            "fn <script>() {\n"
+            "block0:\n"
+            "    return\n"
+            "}\n"
+            "fn outer(int) -> int {\n"
+            "block0:\n"
+            "    %0 = parameter int 0\n"
+            "    %1 = constant int 0\n"
+            "    store slot 2, %1\n"
+            "    store slot 2, %0\n"
+            "    call inner()\n"
+            "    %5 = load int slot 2\n"
+            "    return %5\n"
+            "}\n"
+            "fn inner() {\n"
+            "block0:\n"
+            "    %0 = load int slot 2 depth 1\n"
+            "    %1 = constant int 1\n"
+            "    %2 = add int %0, %1\n"
+            "    store slot 2 depth 1, %2\n"
+            "    return\n"
+            "}\n");
+    }
+
+    SECTION("well formed")
+    {
+        withIR(R"(
+            let total : int = 0;
+            for (let i : int = 1; i <= 10; i = i + 1)
+            {
+                let j : int = 0;
+                while (j < i && total < 100) { if (j == 3) total = total + 1; else { j = j + 1; } j = j + 1; }
+                total = total + j;
+            }
+            print total;
+            fn fib(n: int) -> int {
+                if (n < 2) return n;
+                return fib(n - 1) + fib(n - 2);
+            }
+            fn isEven(n: int) -> bool { if (n == 0) return true; return isOdd(n - 1); }
+            fn isOdd(n: int) -> bool { if (n == 0) return false; return isEven(n - 1); }
+            print isEven(10) || fib(5) > 3.5;
+            let base : float = 1.5;
+            fn outer(x: int) -> float {
+                let local : int = x * 2;
+                fn inner(y: int) -> float { local = local + 1; return base + local + y; }
+                if (x > 0) return inner(1); else return inner(2);
+                print "unreachable";
+            }
+            print outer(5);
+            let name : char = "bbt";
+            let nothing : char;
+            print name == nothing;
+        )", [](IRGenerator& generator, bool generated) {
+            REQUIRE(generated);
+            for(const IRFunction& function : generator.getModule().functions)
+                checkWellFormed(function);
+            IRFolder folder;
+            folder.fold(generator.getModule());
+            for(const IRFunction& function : generator.getModule().functions)
+                checkWellFormed(function);
+            CHECK(generator.getModule().functions.size() == 6);
+            CHECK(generator.getModule().functions[4].name == "outer");
+            CHECK(generator.getModule().functions[4].returnType == IRType::FLOAT);
+        });
+    }
+}
+
+TEST_CASE("IRFolding", "[IR]")
+{
+    SECTION("constants fold through variables")
+    {
+        // The else branch is the only one left, and the division by zero
+        // still fails at runtime
+        CHECK(printFolded(R"(
+            let scale : int = 4;
+            let debug : bool = scale > 10;
+            let zero : int = 0;
+            if (debug) print "debug"; else print scale * 2 + 0.5;
+            print -scale / zero;
+        )") ==
+            "fn <script>() {\n"
+            "block0:\n"
+            "    %0 = constant int 0\n"
+            "    jump block1\n"
+            "block1: ; preds block0\n"
+            "    %2 = constant float 8.5\n"
+            "    print %2\n"
+            "    jump block2\n"
+            "block2: ; preds block1\n"
+            "    %5 = constant int -4\n"
+            "    %6 = div int %5, %0\n"
+            "    print %6\n"
+            "    return\n"
+            "}\n");
+    }
+
+    SECTION("phis merging one constant")
+    {
+        CHECK(printFolded(R"(
+            fn pick(flag: bool) -> int {
+                let result : int = 0;
+                if (flag) result = 1; else result = 1;
+                return result + 1;
+            }
+        )") ==
+            "fn <script>() {\n"
+            "block0:\n"
+            "    return\n"
+            "}\n"
+            "fn pick(bool) -> int {\n"
+            "block0:\n"
+            "    %0 = parameter bool 0\n"
+            "    branch %0, block1, block2\n"
+            "block1: ; preds block0\n"
+            "    jump block3\n"
+            "block2: ; preds block0\n"
+            "    jump block3\n"
+            "block3: ; preds block1, block2\n"
+            "    %4 = constant int 2\n"
+            "    return %4\n"
+            "}\n");
+    }
+
+    SECTION("loops that never run are removed")
+    {
+        // Loop phis are not folded, a value coming around the loop is not
+        // known to be constant
+        CHECK(printFolded(R"(
+            let limit : int = 0;
+            let total : int = 0;
+            while (limit > 0) total = total + 1;
+            print total;
+        )") ==
+            "fn <script>() {\n"
+            "block0:\n"
+            "    %0 = constant int 0\n"
+            "    jump block1\n"
+            "block1: ; preds block0\n"
+            "    jump block2\n"
+            "block2: ; preds block1\n"
+            "    print %0\n"
+            "    return\n"
+            "}\n");
+    }
+}
+
+TEST_CASE("IRUnsupported", "[IR]")
+{
+    // Type errors are left to the TypeChecker
+    CHECK(errors("print null;") == "<file>:1:7: type error: 'null' is not supported in the IR.\n");
+    CHECK(errors("let c : char = \"a\";\nprint c + \"b\";") ==
+          "<file>:2:9: type error: '+' on strings is not supported in the IR.\n");
+}
@@ -0,0 +1,138 @@
+#include "catch.hpp"
+#include "TestProgram.h"
+#include <string>
+
+using BBTTests::interpret;
+using BBTTests::RunResult;
+
+TEST_CASE("InterpreterStatements", "[Interpreter]")
+{
+    SECTION("expressions and values")
+    {
+        const RunResult result{ interpret(R"(
+            print 1 + 2 * 3;
+            print (1 + 2) * 3;
+            print 7 / 2;
+            print -7 / 2;
+            print 7.0 / 2;
+            print 1 + 0.5;
+            print 10 >= 10;
+            print 1 == 1.0;
+            print "a" == "a";
+            print "con" + "cat";
+            print !true;
+            print null;
+            print true && false || true;
+        )") };
+        CHECK(result.exitCode == 0);
+        CHECK(result.output == "7\n9\n3\n-3\n3.5\n1.5\ntrue\ntrue\ntrue\nconcat\nfalse\nnull\ntrue\n");
+    }
+
+    SECTION("variables, blocks and loops")
+    {
+        const RunResult result{ interpret(R"(
+            let total : int = 0;
+            for (let i : int = 1; i <= 10; i = i + 1) total = total + i;
+            print total;
+            let x : int = 1;
+            {
+                let x : int = x + 1;
+                print x;
+            }
+            print x;
+            let n : int = 3;
+            while (n != 0) { print n; n = n - 1; }
+            if (n == 0) print "zero"; else print "not zero";
+            let f : float;
+            let b : bool;
+            print f;
+            print b;
+        )") };
+        CHECK(result.exitCode == 0);
+        CHECK(result.output == "55\n2\n1\n3\n2\n1\nzero\n0\nfalse\n");
+    }
+
+    SECTION("functions")
+    {
+        const RunResult result{ interpret(R"(
+            print fib(15);
+            fn fib(n: int) -> int {
+                if (n < 2) return n;
+                return fib(n - 1) + fib(n - 2);
+            }
+            fn isEven(n: int) -> bool { if (n == 0) return true; return isOdd(n - 1); }
+            fn isOdd(n: int) -> bool { if (n == 0) return false; return isEven(n - 1); }
+            print isEven(10);
+            let base : int = 100;
+            fn outer(x: int) -> int {
+                let local : int = x * 2;
+                fn inner(y: int) -> int { return base + local + y; }
+                return inner(1) + inner(2);
+            }
+            print outer(5);
+            fn nothing() -> int { print "side effect"; }
+            print nothing();
+            let g : int = 0;
+            fn count() -> int { g = g + 1; return g; }
+            count();
+            count();
+            print g;
+            print fib;
+        )") };
+        CHECK(result.exitCode == 0);
+        CHECK(result.output == "610\ntrue\n223\nside effect\nnull\n2\n<fn fib>\n");
+    }
+}
+
+TEST_CASE("InterpreterErrors", "[Interpreter]")
+{
+    SECTION("the first runtime error stops the program")
+    {
+        const RunResult result{ interpret("print 1;\nprint 1 / 0;\nprint 2;") };
+        CHECK(result.exitCode == 70);
+        CHECK(result.output == "1\n");
+        CHECK(result.diagnostics == "<file>:2:9: runtime error: Division by zero.\n");
+    }
+
+    SECTION("type errors")
+    {
+        CHECK(interpret("print 1 + true;").diagnostics ==
+              "<file>:1:9: runtime error: Operands of '+' must be two numbers or two strings.\n");
+        CHECK(interpret("print \"a\" < \"b\";").diagnostics == "<file>:1:11: runtime error: Operands of '<' must be numbers.\n");
+        CHECK(interpret("print -\"a\";").diagnostics == "<file>:1:7: runtime error: Operand of '-' must be a number.\n");
+    }
+
+    SECTION("calls")
+    {
+        CHECK(interpret("let x : int = 1;\nx();").diagnostics == "<file>:2:3: runtime error: Can only call functions.\n");
+        CHECK(interpret("fn f(a: int) -> int { return a; }\nf(1, 2);").diagnostics ==
+              "<file>:2:7: runtime error: Wrong number of arguments to 'f'.\n");
+        CHECK(interpret("fn f(n: int) -> int { return f(n + 1); }\nf(0);").diagnostics ==
+              "<file>:1:37: runtime error: Stack overflow.\n");
+    }
+
+    SECTION("a function outliving its frame")
+    {
+        const RunResult result{ interpret(R"(
+            fn make() -> int {
+                fn inner() -> int { return 1; }
+                return inner;
+            }
+            let escaped : int = make();
+            print escaped();
+        )") };
+        CHECK(result.exitCode == 70);
+        CHECK(result.diagnostics ==
+              "<file>:7:27: runtime error: 'inner' is called after the scope it was declared in ended.\n");
+    }
+
+    SECTION("deep recursion within the limit")
+    {
+        const RunResult result{ interpret(R"(
+            fn depth(n: int) -> int { if (n == 0) return 0; return depth(n - 1) + 1; }
+            print depth(900);
+        )") };
+        CHECK(result.exitCode == 0);
+        CHECK(result.output == "900\n");
+    }
+}
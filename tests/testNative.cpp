@@ -0,0 +1,262 @@
+#include "catch.hpp"
+#include "NativeCodeGenerator.h"
+#include "TestProgram.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using BBTCompiler::NativeCodeGenerator;
+using BBTCompiler::Stmt;
+using BBTTests::interpret;
+using BBTTests::RunResult;
+using BBTTests::withCheckedProgram;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // The errors of `source`, which type checks, empty if it compiles
+    std::string compileErrors(std::string_view source)
+    {
+        std::stringstream diagnostics;
+        withCheckedProgram(source, [&](std::vector<Stmt*>& statements, uint32_t frameSize) {
+            NativeCodeGenerator generator;
+            generator.generate(statements, frameSize);
+            generator.getDiagnostics().print(diagnostics);
+        });
+        return diagnostics.str();
+    }
+
+    std::string readFile(const fs::path& path)
+    {
+        std::ifstream file(path);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // A directory of its own for every run, so test processes running in
+    // parallel do not overwrite each other's files. Removed with its files.
+    struct TemporaryDirectory
+    {
+        fs::path path;
+
+        TemporaryDirectory()
+        {
+            static unsigned runs{ 0 };
+            path = fs::temp_directory_path() /
+                   ("bbtcompiler-native-test-" + std::to_string(getpid()) + "-" + std::to_string(runs++));
+            fs::create_directories(path);
+        }
+        ~TemporaryDirectory()
+        {
+            std::error_code error;
+            fs::remove_all(path, error);
+        }
+    };
+
+    // Assembles and links `source` with the system's cc and runs it
+    RunResult runNative(std::string_view source)
+    {
+        const TemporaryDirectory temporary;
+        const fs::path& directory{ temporary.path };
+        const fs::path assembly{ directory / "program.s" };
+        const fs::path executable{ directory / "program" };
+        const fs::path output{ directory / "output.txt" };
+        const fs::path diagnostics{ directory / "diagnostics.txt" };
+        withCheckedProgram(source, [&](std::vector<Stmt*>& statements, uint32_t frameSize) {
+            NativeCodeGenerator generator;
+            REQUIRE(generator.generate(statements, frameSize));
+            std::ofstream(assembly) << generator.getAssembly();
+        });
+        const std::string build{ "cc \"" + assembly.string() + "\" -o \"" + executable.string() + "\"" };
+        REQUIRE(std::system(build.c_str()) == 0);
+        const std::string run{ "\"" + executable.string() + "\" > \"" + output.string() + "\" 2> \"" + diagnostics.string() + "\"" };
+        const int status{ std::system(run.c_str()) };
+        REQUIRE(WIFEXITED(status));
+        return RunResult{ WEXITSTATUS(status), readFile(output), readFile(diagnostics) };
+    }
+
+    // The executable must behave like the Interpreter, exit code included
+    void checkSameAsInterpreter(std::string_view source)
+    {
+        const RunResult expected{ interpret(source) };
+        const RunResult result{ runNative(source) };
+        CHECK(result.exitCode == expected.exitCode);
+        CHECK(result.output == expected.output);
+        CHECK(result.diagnostics == expected.diagnostics);
+    }
+
+    bool hasCompiler()
+    {
+        return std::system("cc --version > /dev/null 2>&1") == 0;
+    }
+}
+
+TEST_CASE("NativeAssembly", "[Native]")
+{
+    withCheckedProgram(R"(
+        fn add(a: int, b: float) -> float { return a + b; }
+        print add(1, 0.5);
+    )", [](std::vector<Stmt*>& statements, uint32_t frameSize) {
+        NativeCodeGenerator generator;
+        REQUIRE(generator.generate(statements, frameSize));
+        const std::string& assembly{ generator.getAssembly() };
+        // Arguments are passed in the System V registers, the int one
+        // converted when it meets the float
+        CHECK(assembly.find("    .intel_syntax noprefix\n") == 0);
+        CHECK(assembly.find("main:\n") != std::string::npos);
+        CHECK(assembly.find("    mov qword ptr [rbp - 16], rdi\n") != std::string::npos);
+        CHECK(assembly.find("    movsd qword ptr [rbp - 24], xmm0\n") != std::string::npos);
+        CHECK(assembly.find("    cvtsi2sd xmm1, rcx\n    addsd xmm1, xmm0\n") != std::string::npos);
+        CHECK(assembly.find("    call bbt_add_1\n") != std::string::npos);
+        CHECK(assembly.find("    call printf@PLT\n") != std::string::npos);
+        CHECK(assembly.find(".LF0:\n    .quad 4602678819172646912\n") != std::string::npos);
+    });
+}
+
+TEST_CASE("NativeUnsupported", "[Native]")
+{
+    // Type errors are left to the TypeChecker, native code only reports
+    // what it accepts but native code cannot do
+    CHECK(compileErrors("print null;") == "<file>:1:7: type error: 'null' is not supported in native code.\n");
+    CHECK(compileErrors("let c : char = \"a\";\nprint c + \"b\";") ==
+          "<file>:2:9: type error: '+' on strings is not supported in native code.\n");
+    CHECK(compileErrors("fn f(a: int, b: int, c: int, d: int, e: int, g: int, h: int) {}") ==
+          "<file>:1:4: type error: 'f' has more parameters than native code can pass in registers.\n");
+}
+
+TEST_CASE("NativeExecution", "[Native]")
+{
+    if(!hasCompiler())
+    {
+        WARN("cc is not available, native code is not run");
+        return;
+    }
+
+    SECTION("expressions and values")
+    {
+        checkSameAsInterpreter(R"(
+            print 1 + 2 * 3;
+            print (1 + 2) * 3;
+            print 7 / 2;
+            print -7 / 2;
+            print 7 / -2;
+            print 7.0 / 2;
+            print 1 + 0.5;
+            print -2.5;
+            print 10 >= 10;
+            print 1 == 1.0;
+            print 0.1 + 0.2 == 0.3;
+            print 1.5 < 2;
+            print 2 != 3;
+            print "a" == "a";
+            print "a" != "a";
+            print !true;
+            print true && false || true;
+            print 1 < 2 && 2.5 >= 2;
+            print -9223372036854775807 - 1;
+            print 9223372036854775807 + 1;
+            print (-9223372036854775807 - 1) / -1;
+        )");
+    }
+
+    SECTION("variables, blocks and loops")
+    {
+        checkSameAsInterpreter(R"(
+            let total : int = 0;
+            for (let i : int = 1; i <= 10; i = i + 1) total = total + i;
+            print total;
+            let x : int = 1;
+            {
+                let x : int = x + 1;
+                print x;
+            }
+            print x;
+            let n : int = 3;
+            while (n != 0) { print n; n = n - 1; }
+            if (n == 0) print "zero"; else print "not zero";
+            let f : float;
+            let b : bool;
+            let c : char;
+            print f;
+            print b;
+            print c;
+            print x = 5;
+        )");
+    }
+
+    SECTION("functions")
+    {
+        checkSameAsInterpreter(R"(
+            print fib(15);
+            fn fib(n: int) -> int {
+                if (n < 2) return n;
+                return fib(n - 1) + fib(n - 2);
+            }
+            fn isEven(n: int) -> bool { if (n == 0) return true; return isOdd(n - 1); }
+            fn isOdd(n: int) -> bool { if (n == 0) return false; return isEven(n - 1); }
+            print isEven(10);
+            let base : int = 100;
+            fn outer(x: int) -> int {
+                let local : int = x * 2;
+                fn inner(y: int) -> int { local = local + 1; return base + local + y; }
+                return inner(1) + inner(2) + local;
+            }
+            print outer(5);
+            fn noValue() { print "no value"; }
+            noValue();
+            let g : int = 0;
+            fn count() -> int { g = g + 1; return g; }
+            count();
+            count();
+            print g;
+            fn mix(a: int, b: float, c: int, d: float, e: bool) -> float {
+                if (e) return a + b + c + d;
+                return 0.0;
+            }
+            print mix(1, 0.5, 2, 0.25, true);
+            fn depth(n: int) -> int { if (n == 0) return 0; return depth(n - 1) + 1; }
+            print depth(900);
+        )");
+    }
+
+    SECTION("variables read before their declaration")
+    {
+        // A hoisted function can run before the declaration of a variable
+        // it reads, which then has its default value and not what was on
+        // the stack
+        constexpr std::string_view source{ R"(
+            let y : int = g();
+            print y;
+            let x : int = 5;
+            fn g() -> int { return x + 1; }
+            print h();
+            let later : float = 2.5;
+            fn h() -> float { return later * 2; }
+            print name();
+            let text : char = "text";
+            fn name() -> char { return text; }
+            fn outer() -> bool {
+                let b : bool = flag();
+                let set : bool = true;
+                fn flag() -> bool { return set; }
+                return b;
+            }
+            print outer();
+            print g();
+        )" };
+        checkSameAsInterpreter(source);
+        CHECK(runNative(source).output == "1\n0\nnull\nfalse\n6\n");
+    }
+
+    SECTION("runtime errors")
+    {
+        checkSameAsInterpreter("print 1;\nprint 1 / 0;\nprint 2;");
+        checkSameAsInterpreter("fn f(n: int) -> int { return f(n + 1); }\nprint f(0);");
+    }
+}
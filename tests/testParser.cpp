@@ -1,17 +1,25 @@
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <nlohmann/json.hpp>
 #include "catch.hpp"
 #include "Parser.h"
 #include "Statement.h"
 #include "JsonVisitor.h"
+#include "JsonWriter.h"
+#include "FlatAst.h"
+#include "ASTWalker.h"
 
 using BBTCompiler::Lexer;
 using BBTCompiler::Parser;
 using BBTCompiler::Expr;
 using BBTCompiler::BinaryExpr;
 using BBTCompiler::ASTJSonVisitor;
+using BBTCompiler::ASTJsonWriter;
 using BBTCompiler::Stmt;
+using BBTCompiler::Token;
 
 TEST_CASE("ParseExpression", "[Expression]")
 {
@@ -37,7 +45,7 @@ TEST_CASE("ParseExpression", "[Expression]")
         )"_json;
         lexer.scan(std::stringstream("1*2-3;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -55,7 +63,7 @@ TEST_CASE("ParseExpression", "[Expression]")
         )"_json;
         lexer.scan(std::stringstream("let a: int;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -76,7 +84,7 @@ TEST_CASE("ParseExpression", "[Expression]")
         )"_json;
         lexer.scan(std::stringstream("a = 5;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -94,7 +102,7 @@ TEST_CASE("ParseExpression", "[Expression]")
         )"_json;
         lexer.scan(std::stringstream("let a : int = b;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -116,7 +124,7 @@ TEST_CASE("ParseStatements", "[Stmt][Statements]")
         )"_json;
         lexer.scan(std::stringstream("print 5;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -147,7 +155,7 @@ TEST_CASE("ParseBlockStatements", "[Stmt][Block]")
         )"_json;
         lexer.scan(std::stringstream("{print 5;print 10;}"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -175,7 +183,7 @@ TEST_CASE("ParseIfStatement", "[Stmt][If]")
         )"_json;
         lexer.scan(std::stringstream("if(true) print 10;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -201,7 +209,7 @@ TEST_CASE("ParseIfStatement", "[Stmt][If]")
         )"_json;
         lexer.scan(std::stringstream("if(true) print 10; else print 5;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -234,7 +242,7 @@ TEST_CASE("ParseIfStatement", "[Stmt][If]")
         )"_json;
         lexer.scan(std::stringstream("if (true) if (false) print 5; else print 10;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -261,7 +269,7 @@ TEST_CASE("ParseLogicStatement", "[Stmt][And][Or]")
         )"_json;
         lexer.scan(std::stringstream("a && b;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -282,7 +290,7 @@ TEST_CASE("ParseLogicStatement", "[Stmt][And][Or]")
         )"_json;
         lexer.scan(std::stringstream("a || b;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -308,7 +316,7 @@ TEST_CASE("ParseLoopStatements", "[Stmt][Loop][While][For]")
         )"_json;
         lexer.scan(std::stringstream("while(true) print 10;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -361,7 +369,7 @@ TEST_CASE("ParseLoopStatements", "[Stmt][Loop][While][For]")
         )"_json;
         lexer.scan(std::stringstream("for (let i : int = 0; i < 10; i = i + 1) print i;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -387,7 +395,7 @@ TEST_CASE("CallExpression", "[Call][Functions]")
         )"_json;
         lexer.scan(std::stringstream("test();"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -412,7 +420,7 @@ TEST_CASE("CallExpression", "[Call][Functions]")
         )"_json;
         lexer.scan(std::stringstream("test(a, 1, b);"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -437,7 +445,7 @@ TEST_CASE("FunctionStatment", "[definition][Functions]")
         )"_json;
         lexer.scan(std::stringstream("fn test() -> int {}"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -456,7 +464,7 @@ TEST_CASE("FunctionStatment", "[definition][Functions]")
         )"_json;
         lexer.scan(std::stringstream("fn test(a: int) {}"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -479,7 +487,7 @@ TEST_CASE("FunctionStatment", "[definition][Functions]")
         )"_json;
         lexer.scan(std::stringstream("fn test(a: int, b: char,c:float) {}"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -501,7 +509,7 @@ TEST_CASE("ReturnStatment", "[return]")
         )"_json;
         lexer.scan(std::stringstream("return;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -520,7 +528,7 @@ TEST_CASE("ReturnStatment", "[return]")
         )"_json;
         lexer.scan(std::stringstream("return 4;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -547,7 +555,7 @@ TEST_CASE("ReturnStatment", "[return]")
         )"_json;
         lexer.scan(std::stringstream("return 2*2;"));
         auto parser = Parser(lexer.getTokens());
-        std::vector<std::unique_ptr<Stmt>>& statements{ parser.parse() };
+        std::vector<Stmt*>& statements{ parser.parse() };
         REQUIRE(statements.size() == 1);
         statements[0]->accept(jsonVisitor);
         INFO(jsonVisitor.toString());
@@ -555,3 +563,690 @@ TEST_CASE("ReturnStatment", "[return]")
     }
 }
 
+
+TEST_CASE("ParseTokenStream", "[Stream]")
+{
+    const std::string source{ R"(
+        fn add(a: int, b: int) -> int { return a + b; }
+        let total : int = 0;
+        for (let i : int = 0; i < 10; i = i + 1) {
+            if (i == 2 || !(i >= 7)) total = add(total, i * 2 - 1); else print "skip \"odd\"";
+        }
+        while (total > 0) total = total - 1;
+    )" };
+
+    Lexer vectorLexer;
+    vectorLexer.scan(std::string_view(source));
+    auto vectorParser = Parser(vectorLexer.getTokens());
+    std::vector<Stmt*>& expected{ vectorParser.parse() };
+
+    Lexer streamLexer;
+    streamLexer.open(source);
+    auto streamParser = Parser(streamLexer);
+    std::vector<Stmt*>& statements{ streamParser.parse() };
+
+    BBTCompiler::TokenBuffer buffer;
+    buffer.scan(source);
+    auto bufferParser = Parser(buffer);
+    std::vector<Stmt*>& bufferStatements{ bufferParser.parse() };
+    REQUIRE(bufferStatements.size() == expected.size());
+
+    // Tokens were pulled on demand, never materialized in the lexer
+    CHECK(streamLexer.getTokens().empty());
+    REQUIRE(statements.size() == 4);
+    REQUIRE(statements.size() == expected.size());
+    for(size_t i = 0; i < statements.size(); ++i)
+    {
+        ASTJSonVisitor expectedJson;
+        ASTJSonVisitor streamJson;
+        expected[i]->accept(expectedJson);
+        statements[i]->accept(streamJson);
+        INFO(streamJson.toString());
+        CHECK(expectedJson.getJson() == streamJson.getJson());
+        ASTJSonVisitor bufferJson;
+        bufferStatements[i]->accept(bufferJson);
+        CHECK(expectedJson.getJson() == bufferJson.getJson());
+    }
+}
+
+TEST_CASE("TokenStreamLookahead", "[Stream]")
+{
+    const std::string source{ "a b c d e f" };
+    Lexer lexer;
+    lexer.open(source);
+    BBTCompiler::TokenStream stream{ lexer };
+    stream.advance();
+
+    // Peeking as far as allowed keeps the tokens already handed out
+    const Token& previous{ stream.previous() };
+    const Token& current{ stream.peek() };
+    const Token& last{ stream.peek(BBTCompiler::TokenStream::MaxLookahead) };
+    CHECK(previous.value == "a");
+    CHECK(current.value == "b");
+    CHECK(last.value == "d");
+    CHECK(stream.peek(1).value == "c");
+    CHECK(&stream.previous() == &previous);
+    CHECK(previous.value == "a");
+    CHECK(current.value == "b");
+
+    stream.advance();
+    CHECK(stream.previous().value == "b");
+    CHECK(stream.peek(BBTCompiler::TokenStream::MaxLookahead).value == "e");
+}
+
+TEST_CASE("ParseAstContext", "[Arena]")
+{
+    SECTION("Allocation")
+    {
+        BBTCompiler::AstContext context;
+        auto* byte = static_cast<char*>(context.allocate(1, 1));
+        auto* value = context.create<double>(2.5);
+        CHECK(reinterpret_cast<std::uintptr_t>(value) % alignof(double) == 0);
+        CHECK(static_cast<void*>(byte) != static_cast<void*>(value));
+        CHECK(*value == 2.5);
+
+        const int items[]{ 1, 2, 3 };
+        const BBTCompiler::AstSpan<int> span{ context.copyArray(items, 3) };
+        REQUIRE(span.size() == 3);
+        CHECK(span[0] == 1);
+        CHECK(span[2] == 3);
+        CHECK(context.copyArray(items, 0).empty());
+
+        // Larger than a chunk, gets a chunk of its own
+        const size_t chunks{ context.chunkCount() };
+        context.allocate(BBTCompiler::AstContext::ChunkSize * 2, 8);
+        CHECK(context.chunkCount() == chunks + 1);
+        context.clear();
+        CHECK(context.chunkCount() == 0);
+        CHECK(context.bytesAllocated() == 0);
+    }
+
+    SECTION("Nodes are allocated in the parser's context")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("fn f(a: int, b: int) -> int { return a + b; } print f(1, 2);"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE(statements.size() == 2);
+        CHECK(parser.getContext().chunkCount() == 1);
+        CHECK(parser.getContext().bytesAllocated() > 0);
+
+        const auto* function = dynamic_cast<const BBTCompiler::FuncStmt*>(statements[0]);
+        REQUIRE(function);
+        CHECK(function->m_Params.size() == 2);
+        CHECK(function->m_Body.size() == 1);
+    }
+
+    SECTION("A syntax error does not leak into sibling lists")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("{ let a : int = 1; f(1, ; print g(2); }"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE(statements.size() == 1);
+        const auto* block = dynamic_cast<const BBTCompiler::BlockStmt*>(statements[0]);
+        REQUIRE(block);
+        REQUIRE(block->m_Statements.size() == 3);
+        CHECK(block->m_Statements[1]->getKind() == BBTCompiler::StmtKind::ERROR);
+        const auto* print = dynamic_cast<const BBTCompiler::PrintStmt*>(block->m_Statements[2]);
+        REQUIRE(print);
+        const auto* call = dynamic_cast<const BBTCompiler::CallExpr*>(print->m_Expression);
+        REQUIRE(call);
+        CHECK(call->m_Args.size() == 1);
+    }
+}
+
+TEST_CASE("ParseFlatAst", "[FlatAst]")
+{
+    using BBTCompiler::FlatAst;
+    using BBTCompiler::FlatNodeKind;
+
+    SECTION("Matches the tree")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream(R"(
+            fn add(a: int, b: int) -> int { return a + b; }
+            fn nothing() { return; }
+            let total : int = 0;
+            let unset : float;
+            for (let i : int = 0; i < 10; i = i + 1) {
+                if (i == 2 || !(i >= 7)) total = add(total, i * 2 - 1); else print "skip";
+                if (total > 100) { print total; }
+            }
+            while (total > 0) total = total - 1;
+            { let a : int = 1; f(1, ; print g(2); }
+            print h();
+        )"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        const FlatAst ast{ FlatAst::build(statements) };
+        REQUIRE(ast.getRoots().size() == statements.size());
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            INFO("statement " << i);
+            ASTJSonVisitor jsonVisitor;
+            statements[i]->accept(jsonVisitor);
+            CHECK(nlohmann::json::diff(jsonVisitor.getJson(), ast.toJson(ast.getRoots()[i])) == nlohmann::json::array({}));
+        }
+    }
+
+    SECTION("Traversal order")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("a = -b * (c + 1);"));
+        auto parser = Parser(lexer.getTokens());
+        const FlatAst ast{ FlatAst::build(parser.parse()) };
+        REQUIRE(ast.getRoots().size() == 1);
+
+        std::vector<FlatNodeKind> preOrder;
+        std::vector<BBTCompiler::NodeIndex> preOrderIndices;
+        ast.preOrder(ast.getRoots()[0], [&](BBTCompiler::NodeIndex node) {
+            preOrder.push_back(ast.kind(node));
+            preOrderIndices.push_back(node);
+        });
+        CHECK(preOrder == std::vector<FlatNodeKind>{
+            FlatNodeKind::EXPR_STMT, FlatNodeKind::ASSIGNMENT, FlatNodeKind::BINARY,
+            FlatNodeKind::UNARY, FlatNodeKind::VARIABLE, FlatNodeKind::GROUPED,
+            FlatNodeKind::BINARY, FlatNodeKind::VARIABLE, FlatNodeKind::LITERAL });
+        // Nodes are numbered in pre-order
+        for(size_t i = 0; i < preOrderIndices.size(); ++i)
+            CHECK(preOrderIndices[i] == i);
+
+        std::vector<std::string_view> postOrder;
+        ast.postOrder(ast.getRoots()[0], [&](BBTCompiler::NodeIndex node) {
+            if(ast.kind(node) == FlatNodeKind::VARIABLE || ast.kind(node) == FlatNodeKind::LITERAL
+                || ast.kind(node) == FlatNodeKind::BINARY || ast.kind(node) == FlatNodeKind::UNARY)
+                postOrder.push_back(ast.token(node).value);
+        });
+        CHECK(postOrder == std::vector<std::string_view>{ "b", "-", "c", "1", "+", "*" });
+    }
+}
+
+TEST_CASE("BinaryAst", "[FlatAst]")
+{
+    using BBTCompiler::FlatAst;
+
+    Lexer lexer;
+    lexer.scan(std::stringstream(R"(
+        fn add(a: int, b: int) -> int { return a + b; }
+        fn nothing() { return; }
+        let total : int = 0;
+        let unset : float;
+        for (let i : int = 0; i < 10; i = i + 1) {
+            if (i == 2 || !(i >= 7)) total = add(total, i * 2 - 1); else print "skip";
+            if (total > 100) { print f()(total, 1.5); }
+        }
+        while (total > 0) total = total - 1;
+        { let a : int = 1; f(1, ; print g(2); }
+        print h();
+    )"));
+    auto parser = Parser(lexer.getTokens());
+    std::vector<Stmt*>& statements{ parser.parse() };
+    const FlatAst built{ FlatAst::build(statements) };
+    std::stringstream stream;
+    built.write(stream);
+    const std::string bytes{ stream.str() };
+
+    // Same tree as the parser's, node for node
+    const auto checkRoundTrip = [&](const FlatAst& ast) {
+        REQUIRE(ast.size() == built.size());
+        REQUIRE(ast.getRoots().size() == statements.size());
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            INFO("statement " << i);
+            ASTJSonVisitor jsonVisitor;
+            statements[i]->accept(jsonVisitor);
+            CHECK(jsonVisitor.getJson() == ast.toJson(ast.getRoots()[i]));
+        }
+        for(BBTCompiler::NodeIndex node = 0; node < ast.size(); ++node)
+        {
+            CHECK(ast.kind(node) == built.kind(node));
+            CHECK(ast.data(node).lhs == built.data(node).lhs);
+            CHECK(ast.data(node).rhs == built.data(node).rhs);
+        }
+        const auto* function = static_cast<const BBTCompiler::FuncStmt*>(statements[0]);
+        // Symbols belong to the interner of the compilation, they are not stored
+        BBTCompiler::Token name{ function->m_Name };
+        name.symbol = BBTCompiler::NoSymbol;
+        CHECK(ast.token(ast.getRoots()[0]) == name);
+    };
+
+    SECTION("Loaded from memory")
+    {
+        // A vector of words keeps the bytes aligned
+        std::vector<uint32_t> buffer((bytes.size() + 3) / 4);
+        std::memcpy(buffer.data(), bytes.data(), bytes.size());
+        const FlatAst ast{ FlatAst::load(std::string_view(reinterpret_cast<const char*>(buffer.data()), bytes.size())) };
+        checkRoundTrip(ast);
+        // The arrays are views into the buffer
+        CHECK(ast.token(ast.getRoots()[0]).value.data() >= reinterpret_cast<const char*>(buffer.data()));
+        CHECK(ast.token(ast.getRoots()[0]).value.data() < reinterpret_cast<const char*>(buffer.data()) + bytes.size());
+    }
+
+    SECTION("Mapped from a file")
+    {
+        const auto path = std::filesystem::temp_directory_path() / "bbtcompiler_ast.bbta";
+        {
+            std::ofstream file(path, std::ios::binary);
+            built.write(file);
+        }
+        {
+            const FlatAst ast{ FlatAst::open(path) };
+            checkRoundTrip(ast);
+        }
+        std::filesystem::remove(path);
+    }
+
+    SECTION("Invalid input throws")
+    {
+        std::vector<uint32_t> buffer((bytes.size() + 3) / 4);
+        const auto load = [&](std::string corrupt) {
+            std::memcpy(buffer.data(), corrupt.data(), std::min(corrupt.size(), buffer.size() * 4));
+            return FlatAst::load(std::string_view(reinterpret_cast<const char*>(buffer.data()), corrupt.size()));
+        };
+        CHECK_NOTHROW(load(bytes));
+        CHECK_THROWS_AS(load(bytes.substr(0, 10)), std::runtime_error);
+        CHECK_THROWS_AS(load(bytes.substr(0, bytes.size() - 1)), std::runtime_error);
+        std::string wrongMagic{ bytes };
+        wrongMagic[0] = 'X';
+        CHECK_THROWS_AS(load(wrongMagic), std::runtime_error);
+        std::string wrongVersion{ bytes };
+        wrongVersion[4] = static_cast<char>(FlatAst::FileVersion + 1);
+        CHECK_THROWS_AS(load(wrongVersion), std::runtime_error);
+    }
+}
+
+namespace
+{
+    // Prefix notation printer dispatched through visitAst
+    struct ExprPrinter
+    {
+        std::string operator()(const BBTCompiler::AssignmentExpr& expr) const
+        {
+            return "(= " + std::string(expr.m_Name.value) + " " + visitAst(*expr.m_Value, *this) + ")";
+        }
+        std::string operator()(const BBTCompiler::BinaryExpr& expr) const
+        {
+            return "(" + std::string(expr.m_Operator.value) + " " + visitAst(*expr.m_Left, *this) + " " + visitAst(*expr.m_Right, *this) + ")";
+        }
+        std::string operator()(const BBTCompiler::UnaryExpr& expr) const
+        {
+            return "(" + std::string(expr.m_Operator.value) + " " + visitAst(*expr.m_Right, *this) + ")";
+        }
+        std::string operator()(const BBTCompiler::GroupedExpr& expr) const
+        {
+            return "(group " + visitAst(*expr.m_Expression, *this) + ")";
+        }
+        std::string operator()(const BBTCompiler::LiteralExpr& expr) const { return std::string(expr.m_Token.value); }
+        std::string operator()(const BBTCompiler::VariableExpr& expr) const { return std::string(expr.m_Name.value); }
+        std::string operator()(const BBTCompiler::CallExpr& expr) const
+        {
+            std::string result{ "(call " + visitAst(*expr.m_Callee, *this) };
+            for(const Expr* arg : expr.m_Args)
+                result += " " + visitAst(*arg, *this);
+            return result + ")";
+        }
+        std::string operator()(const BBTCompiler::ErrorExpr&) const { return "<error>"; }
+    };
+}
+
+TEST_CASE("ParseStaticDispatch", "[Walker]")
+{
+    SECTION("Expressions")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("a = -b * (c + f(1, x));"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE(statements.size() == 1);
+        REQUIRE(statements[0]->getKind() == BBTCompiler::StmtKind::EXPRESSION);
+        const auto& statement = static_cast<const BBTCompiler::ExprStmt&>(*statements[0]);
+        CHECK(visitAst(*statement.m_Expression, ExprPrinter{}) == "(= a (* (- b) (group (+ c (call f 1 x)))))");
+    }
+
+    SECTION("Statements")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream(R"(
+            fn f(a: int) -> int { return a; }
+            let b : int = 1;
+            print b;
+            b;
+            { b; }
+            if (b) b; else b;
+            while (b) b;
+        )"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE(statements.size() == 7);
+        for(const Stmt* statement : statements)
+        {
+            const bool matchesDynamicType = visitAst(*statement, [&](const auto& node) {
+                using NodeType = std::decay_t<decltype(node)>;
+                return dynamic_cast<const NodeType*>(statement) == &node;
+            });
+            CHECK(matchesDynamicType);
+        }
+    }
+}
+
+TEST_CASE("ParseDiagnostics", "[Diagnostics]")
+{
+    using BBTCompiler::StmtKind;
+
+    SECTION("Errors are collected and formatted on demand")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("fn (a: int) {}\nlet b : = 1;\nprint 1 +;"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        const auto& diagnostics = parser.getDiagnostics();
+        REQUIRE(diagnostics.size() == 3);
+        CHECK(diagnostics[0].message == "Expect {} name.");
+        CHECK(diagnostics[0].argument == "function");
+        CHECK(BBTCompiler::Diagnostics::format(diagnostics[0]) == "<file>:1:4: syntax error: Expect function name.");
+        CHECK(BBTCompiler::Diagnostics::format(diagnostics[1], "test") == "<test>:2:9: syntax error: Expect '<variable type>'.");
+        CHECK(diagnostics[2].token.value == ";");
+
+        std::stringstream printed;
+        diagnostics.print(printed);
+        CHECK(printed.str().find("<file>:3:10: syntax error: expected expression.\n") != std::string::npos);
+
+        REQUIRE(statements.size() == 3);
+        for(const Stmt* statement : statements)
+            CHECK(statement->getKind() == StmtKind::ERROR);
+    }
+
+    SECTION("Parsing continues after an error")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("let a : int = ;\nprint a;\nif (a print a;\nwhile (a) { a = ; print a; }"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        CHECK(parser.getDiagnostics().size() == 3);
+        // The statement after the unclosed condition is not skipped
+        REQUIRE(statements.size() == 5);
+        CHECK(statements[0]->getKind() == StmtKind::ERROR);
+        CHECK(statements[1]->getKind() == StmtKind::PRINT);
+        CHECK(statements[2]->getKind() == StmtKind::ERROR);
+        CHECK(statements[3]->getKind() == StmtKind::PRINT);
+        REQUIRE(statements[4]->getKind() == StmtKind::WHILE);
+        const auto* loop = static_cast<const BBTCompiler::WhileStmt*>(statements[4]);
+        REQUIRE(loop->m_Body->getKind() == StmtKind::BLOCK);
+        const auto* body = static_cast<const BBTCompiler::BlockStmt*>(loop->m_Body);
+        REQUIRE(body->m_Statements.size() == 2);
+        CHECK(body->m_Statements[0]->getKind() == StmtKind::ERROR);
+        CHECK(body->m_Statements[1]->getKind() == StmtKind::PRINT);
+    }
+
+    SECTION("A '}' after an error still closes the block")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("{ f(1 } print 2; fn g( { print 1; } let x : int = 1;"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        CHECK(parser.getDiagnostics().size() == 2);
+        REQUIRE(statements.size() == 4);
+        CHECK(statements[0]->getKind() == StmtKind::BLOCK);
+        CHECK(statements[1]->getKind() == StmtKind::PRINT);
+        CHECK(statements[2]->getKind() == StmtKind::ERROR);
+        CHECK(statements[3]->getKind() == StmtKind::VARIABLE);
+    }
+
+    SECTION("Invalid assignment target")
+    {
+        Lexer lexer;
+        lexer.scan(std::stringstream("1 = 2;"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE(parser.getDiagnostics().size() == 1);
+        CHECK(parser.getDiagnostics()[0].token.value == "=");
+        REQUIRE(statements.size() == 1);
+        CHECK(statements[0]->getKind() == StmtKind::ERROR);
+
+        ASTJSonVisitor jsonVisitor;
+        statements[0]->accept(jsonVisitor);
+        CHECK(jsonVisitor.getJson() == nlohmann::json::parse(R"({ "type": "ErrorStatement", "token": "=" })"));
+    }
+}
+
+TEST_CASE("ParsePrecedence", "[Expression][Precedence]")
+{
+    const std::pair<const char*, const char*> cases[]{
+        { "a = b = c || d;", "(= a (= b (|| c d)))" },
+        { "a || b && c || d;", "(|| (|| a (&& b c)) d)" },
+        { "a == b != c < d;", "(!= (== a b) (< c d))" },
+        { "a < b + c * d >= e;", "(>= (< a (+ b (* c d))) e)" },
+        { "a - b - c / d / e;", "(- (- a b) (/ (/ c d) e))" },
+        { "-a * !b - -f(c)(d);", "(- (* (- a) (! b)) (- (call (call f c) d)))" },
+        { "(a + b) * -(c - d);", "(* (group (+ a b)) (- (group (- c d))))" },
+        { "f(a = 1, b + 2)(g(3));", "(call (call f (= a 1) (+ b 2)) (call g 3))" },
+    };
+    for(const auto& [source, expected] : cases)
+    {
+        INFO(source);
+        Lexer lexer;
+        lexer.scan(std::stringstream(source));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        CHECK_FALSE(parser.getDiagnostics().hasErrors());
+        REQUIRE(statements.size() == 1);
+        REQUIRE(statements[0]->getKind() == BBTCompiler::StmtKind::EXPRESSION);
+        const auto& statement = static_cast<const BBTCompiler::ExprStmt&>(*statements[0]);
+        CHECK(visitAst(*statement.m_Expression, ExprPrinter{}) == expected);
+    }
+
+    SECTION("Only a variable can be assigned to")
+    {
+        for(const char* source : { "a + b = c;", "-a = b;", "a = b + c = d;", "f() = 1;" })
+        {
+            INFO(source);
+            Lexer lexer;
+            lexer.scan(std::stringstream(source));
+            auto parser = Parser(lexer.getTokens());
+            parser.parse();
+            REQUIRE(parser.getDiagnostics().size() == 1);
+            CHECK(parser.getDiagnostics()[0].message == "Invalid assignment target.");
+        }
+    }
+}
+
+TEST_CASE("TokenSet", "[TokenSet]")
+{
+    using BBTCompiler::TokenSet;
+    using BBTCompiler::TokenType;
+
+    constexpr TokenSet empty{};
+    constexpr TokenSet types{ TokenType::INT, TokenType::FLOAT };
+    static_assert(empty.empty());
+    static_assert(types.contains(TokenType::INT) && types.contains(TokenType::FLOAT));
+    static_assert(!types.contains(TokenType::CHAR));
+
+    const TokenSet bounds{ TokenType::IDENTIFIER, TokenType::INVALID };
+    CHECK(bounds.contains(TokenType::IDENTIFIER));
+    CHECK(bounds.contains(TokenType::INVALID));
+    CHECK_FALSE(bounds.contains(TokenType::END));
+    CHECK((types | bounds).contains(TokenType::INT));
+    CHECK((types | bounds).contains(TokenType::INVALID));
+    CHECK((types | TokenSet{ TokenType::INT }) == types);
+    CHECK(types != bounds);
+}
+
+TEST_CASE("ParseIterative", "[Iterative]")
+{
+    const auto parseBoth = [](const std::string& source, size_t nestingLimit) {
+        std::pair<std::string, std::string> results;
+        for(const bool iterative : { false, true })
+        {
+            Lexer lexer;
+            lexer.scan(std::string_view(source));
+            auto parser = Parser(lexer.getTokens());
+            parser.setIterative(iterative);
+            parser.setNestingLimit(nestingLimit);
+            std::stringstream result;
+            for(const Stmt* statement : parser.parse())
+            {
+                ASTJSonVisitor jsonVisitor;
+                if(iterative)
+                    jsonVisitor.visitIteratively(*statement);
+                else
+                    statement->accept(jsonVisitor);
+                result << jsonVisitor.getJson().dump() << '\n';
+            }
+            parser.getDiagnostics().print(result);
+            (iterative ? results.second : results.first) = result.str();
+        }
+        return results;
+    };
+
+    SECTION("Same AST and diagnostics as the recursive parser")
+    {
+        const char* const sources[]{
+            R"(
+                fn add(a: int, b: int) -> int { return a + b; }
+                fn nothing() { return; }
+                let total : int = 0;
+                for (let i : int = 0; i < 10; i = i + 1) {
+                    if (i == 2 || !(i >= 7)) total = add(total, -i * 2 - 1); else print "skip";
+                    if (total > 100) { print f()(total, (1)); }
+                }
+                while (total > 0) total = total - 1;
+                { { } }
+            )",
+            "{ let a : int = 1; f(1, ; print g(2); } print h();",
+            "if (a print a; while (a) { a = ; print a; } fn (a: int) {}",
+            "a = b + c = d; print ((1 + 2); f(1, 2; print (1, 2);",
+            "{ if (a) { print 1; } else { fn f() { x = ; } } print 2;",
+            "if (a) if (b) print 1; else print 2; else print 3; } print 4; {",
+        };
+        for(const char* source : sources)
+        {
+            INFO(source);
+            for(const size_t nestingLimit : { size_t{ 2 }, size_t{ 3 }, size_t{ 5 }, Parser::DefaultNestingLimit })
+            {
+                INFO("nesting limit " << nestingLimit);
+                const auto [recursive, iterative] = parseBoth(source, nestingLimit);
+                CHECK(recursive == iterative);
+            }
+        }
+    }
+
+    SECTION("Nesting deeper than the limit is a syntax error")
+    {
+        const std::string deepParentheses{ std::string(100000, '(') + "1" + std::string(100000, ')') };
+        const std::string deepBlocks{ std::string(100000, '{') + std::string(100000, '}') };
+        for(const std::string& nested : { "print " + deepParentheses + ";", deepBlocks })
+        {
+            for(const bool iterative : { false, true })
+            {
+                Lexer lexer;
+                lexer.scan(std::string_view(nested + " print 2;"));
+                auto parser = Parser(lexer.getTokens());
+                parser.setIterative(iterative);
+                std::vector<Stmt*>& statements{ parser.parse() };
+                REQUIRE(parser.getDiagnostics().size() == 1);
+                CHECK(parser.getDiagnostics()[0].message == "Too deeply nested.");
+                REQUIRE(statements.size() == 2);
+                CHECK(statements[1]->getKind() == BBTCompiler::StmtKind::PRINT);
+            }
+        }
+
+        const auto [recursive, iterative] = parseBoth("print ((1)); { { } } if (a) if (b) { print 1; }", 4);
+        CHECK(recursive == iterative);
+        CHECK(recursive.find("syntax error") == std::string::npos);
+        CHECK(parseBoth("print (((1)));", 3).first.find("<file>:1:10: syntax error: Too deeply nested.") != std::string::npos);
+        CHECK(parseBoth("{ { { } } }", 2).first.find("<file>:1:7: syntax error: Too deeply nested.") != std::string::npos);
+    }
+
+    SECTION("Iterative mode parses input nested deeper than the call stack")
+    {
+        const size_t depth{ 100000 };
+        Lexer lexer;
+        lexer.scan(std::string_view("print " + std::string(depth, '(') + "-x" + std::string(depth, ')') + ";" +
+                                    std::string(depth, '{') + "print 1;" + std::string(depth, '}')));
+        auto parser = Parser(lexer.getTokens());
+        parser.setIterative(true);
+        parser.setNestingLimit(depth + 3);
+        std::vector<Stmt*>& statements{ parser.parse() };
+        CHECK_FALSE(parser.getDiagnostics().hasErrors());
+        REQUIRE(statements.size() == 2);
+
+        const Expr* expr{ static_cast<const BBTCompiler::PrintStmt*>(statements[0])->m_Expression };
+        size_t groups{ 0 };
+        for(; expr->getKind() == BBTCompiler::ExprKind::GROUPED; ++groups)
+            expr = static_cast<const BBTCompiler::GroupedExpr*>(expr)->m_Expression;
+        CHECK(groups == depth);
+        CHECK(expr->getKind() == BBTCompiler::ExprKind::UNARY);
+
+        const Stmt* stmt{ statements[1] };
+        size_t blocks{ 0 };
+        for(; stmt->getKind() == BBTCompiler::StmtKind::BLOCK; ++blocks)
+            stmt = static_cast<const BBTCompiler::BlockStmt*>(stmt)->m_Statements[0];
+        CHECK(blocks == depth);
+        CHECK(stmt->getKind() == BBTCompiler::StmtKind::PRINT);
+
+        ASTJSonVisitor jsonVisitor;
+        jsonVisitor.visitIteratively(*statements[0]);
+        CHECK(jsonVisitor.getJson()["expression"]["type"] == "GroupedExpression");
+    }
+}
+
+TEST_CASE("JsonWriter", "[Parser][Json]")
+{
+    Lexer lexer;
+    lexer.scan(std::string_view(R"(
+        fn add(a: int, b: int) -> int { return a + b; }
+        fn nothing() { return; }
+        let total : int = 0;
+        let empty : string;
+        for (let i : int = 0; i < 10; i = i + 1) {
+            if (i == 2 || !(i >= 7)) total = add(total, -i * 2 - 1); else print "skip";
+            if (total > 100) { print f()(total, (1.5)); }
+        }
+        while (total > 0) total = total - 1;
+        print "quote \" backslash \\ tab 	 end";
+        { { } }
+        print (1 + ;
+    )"));
+    auto parser = Parser(lexer.getTokens());
+    std::vector<Stmt*>& statements{ parser.parse() };
+    REQUIRE(parser.getDiagnostics().size() == 1);
+
+    SECTION("Same JSON as the DOM visitor")
+    {
+        for(const Stmt* statement : statements)
+        {
+            ASTJSonVisitor jsonVisitor;
+            statement->accept(jsonVisitor);
+            ASTJsonWriter writer;
+            statement->accept(writer);
+            INFO(writer.getString());
+            CHECK(nlohmann::json::parse(writer.getString()) == jsonVisitor.getJson());
+            CHECK(writer.getString() == jsonVisitor.getJson().dump(4));
+
+            ASTJsonWriter compactWriter(-1);
+            statement->accept(compactWriter);
+            CHECK(compactWriter.getString() == jsonVisitor.getJson().dump());
+        }
+    }
+
+    SECTION("Streaming to an ostream")
+    {
+        std::stringstream expected;
+        std::stringstream stream;
+        {
+            ASTJsonWriter writer(stream, 2);
+            for(const Stmt* statement : statements)
+            {
+                ASTJSonVisitor jsonVisitor;
+                statement->accept(jsonVisitor);
+                expected << jsonVisitor.getJson().dump(2) << '\n';
+                statement->accept(writer);
+                writer.writeRaw("\n");
+            }
+            writer.flush();
+            CHECK(writer.getString().empty());
+        }
+        CHECK(stream.str() == expected.str());
+    }
+}
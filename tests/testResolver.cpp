@@ -0,0 +1,161 @@
+#include "catch.hpp"
+#include "Parser.h"
+#include "Resolver.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using BBTCompiler::Binding;
+using BBTCompiler::Lexer;
+using BBTCompiler::Parser;
+using BBTCompiler::Resolver;
+using BBTCompiler::Stmt;
+
+namespace
+{
+    template<typename Node>
+    Node& as(Stmt* stmt)
+    {
+        return static_cast<Node&>(*stmt);
+    }
+
+    template<typename Node>
+    Node& as(BBTCompiler::Expr* expr)
+    {
+        return static_cast<Node&>(*expr);
+    }
+
+    bool boundTo(const Binding& binding, uint32_t depth, uint32_t slot)
+    {
+        return binding.depth == depth && binding.slot == slot;
+    }
+
+    std::string printDiagnostics(const BBTCompiler::Diagnostics& diagnostics)
+    {
+        std::stringstream stream;
+        diagnostics.print(stream);
+        return stream.str();
+    }
+}
+
+TEST_CASE("ResolverSlots", "[Resolver]")
+{
+    Lexer lexer;
+    Resolver resolver;
+
+    SECTION("locals, parameters and frame sizes")
+    {
+        lexer.scan(std::string_view(R"(
+            let a : int = 1;
+            let b : int = a;
+            fn f(x: int, y: int) -> int {
+                let z : int = x + y;
+                { let w : int = z; }
+                return z + a;
+            }
+            print f(a, b);
+        )"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE_FALSE(parser.getDiagnostics().hasErrors());
+        resolver.resolve(statements);
+        CHECK_FALSE(resolver.getDiagnostics().hasErrors());
+
+        // f is declared before the statements run
+        auto& function = as<BBTCompiler::FuncStmt>(statements[2]);
+        CHECK(function.m_Slot == 0);
+        CHECK(as<BBTCompiler::VariableStmt>(statements[0]).m_Slot == 1);
+        auto& b = as<BBTCompiler::VariableStmt>(statements[1]);
+        CHECK(b.m_Slot == 2);
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(b.m_Initializer).m_Binding, 0, 1));
+        CHECK(resolver.getFrameSize() == 3);
+
+        // x, y, z and w, the block does not give its slot back
+        CHECK(function.m_FrameSize == 4);
+        auto& z = as<BBTCompiler::VariableStmt>(function.m_Body[0]);
+        CHECK(z.m_Slot == 2);
+        auto& sum = as<BBTCompiler::BinaryExpr>(z.m_Initializer);
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(sum.m_Left).m_Binding, 0, 0));
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(sum.m_Right).m_Binding, 0, 1));
+        auto& block = as<BBTCompiler::BlockStmt>(function.m_Body[1]);
+        CHECK(as<BBTCompiler::VariableStmt>(block.m_Statements[0]).m_Slot == 3);
+        auto& result = as<BBTCompiler::BinaryExpr>(as<BBTCompiler::ReturnStmt>(function.m_Body[2]).m_Value);
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(result.m_Left).m_Binding, 0, 2));
+        // a lives in the frame of the top level, one function out
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(result.m_Right).m_Binding, 1, 1));
+
+        auto& call = as<BBTCompiler::CallExpr>(as<BBTCompiler::PrintStmt>(statements[3]).m_Expression);
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(call.m_Callee).m_Binding, 0, 0));
+    }
+
+    SECTION("shadowing")
+    {
+        lexer.scan(std::string_view("let x : int = 1; { let x : int = x; x = 2; } print x;"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE_FALSE(parser.getDiagnostics().hasErrors());
+        resolver.resolve(statements);
+        CHECK_FALSE(resolver.getDiagnostics().hasErrors());
+        auto& block = as<BBTCompiler::BlockStmt>(statements[1]);
+        auto& inner = as<BBTCompiler::VariableStmt>(block.m_Statements[0]);
+        CHECK(inner.m_Slot == 1);
+        // The initializer still sees the outer x
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(inner.m_Initializer).m_Binding, 0, 0));
+        auto& assignment = as<BBTCompiler::AssignmentExpr>(as<BBTCompiler::ExprStmt>(block.m_Statements[1]).m_Expression);
+        CHECK(boundTo(assignment.m_Binding, 0, 1));
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(as<BBTCompiler::PrintStmt>(statements[2]).m_Expression).m_Binding, 0, 0));
+    }
+
+    SECTION("functions call each other in any order and see enclosing functions")
+    {
+        lexer.scan(std::string_view(R"(
+            fn even(n: int) -> bool { return odd(n); }
+            fn odd(n: int) -> bool {
+                fn inner() -> int { return n; }
+                return even(inner());
+            }
+        )"));
+        auto parser = Parser(lexer.getTokens());
+        std::vector<Stmt*>& statements{ parser.parse() };
+        REQUIRE_FALSE(parser.getDiagnostics().hasErrors());
+        resolver.resolve(statements);
+        CHECK_FALSE(resolver.getDiagnostics().hasErrors());
+        auto& even = as<BBTCompiler::FuncStmt>(statements[0]);
+        auto& call = as<BBTCompiler::CallExpr>(as<BBTCompiler::ReturnStmt>(even.m_Body[0]).m_Value);
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(call.m_Callee).m_Binding, 1, 1));
+
+        auto& odd = as<BBTCompiler::FuncStmt>(statements[1]);
+        CHECK(odd.m_FrameSize == 2);
+        auto& inner = as<BBTCompiler::FuncStmt>(odd.m_Body[0]);
+        CHECK(inner.m_Slot == 1);
+        CHECK(inner.m_FrameSize == 0);
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(as<BBTCompiler::ReturnStmt>(inner.m_Body[0]).m_Value).m_Binding, 1, 0));
+        auto& recursive = as<BBTCompiler::CallExpr>(as<BBTCompiler::ReturnStmt>(odd.m_Body[1]).m_Value);
+        CHECK(boundTo(as<BBTCompiler::VariableExpr>(recursive.m_Callee).m_Binding, 1, 0));
+    }
+}
+
+TEST_CASE("ResolverDiagnostics", "[Resolver]")
+{
+    Lexer lexer;
+    lexer.scan(std::string_view(
+        "print y;\n"
+        "let a : int = 1;\n"
+        "let a : int = a;\n"
+        "fn g(p: int, p: int) { q = p; }\n"
+        "{ let a : int = 2; }\n"));
+    auto parser = Parser(lexer.getTokens());
+    std::vector<Stmt*>& statements{ parser.parse() };
+    REQUIRE_FALSE(parser.getDiagnostics().hasErrors());
+
+    Resolver resolver;
+    resolver.resolve(statements);
+    CHECK(printDiagnostics(resolver.getDiagnostics()) ==
+        "<file>:1:7: name error: Undefined name 'y'.\n"
+        "<file>:3:5: name error: 'a' is already declared in this scope.\n"
+        "<file>:4:14: name error: 'p' is already declared in this scope.\n"
+        "<file>:4:24: name error: Undefined name 'q'.\n");
+    // The unresolved name is left unbound, the duplicate reuses the first slot
+    CHECK_FALSE(as<BBTCompiler::VariableExpr>(as<BBTCompiler::PrintStmt>(statements[0]).m_Expression).m_Binding.isResolved());
+    CHECK(as<BBTCompiler::VariableStmt>(statements[2]).m_Slot == as<BBTCompiler::VariableStmt>(statements[1]).m_Slot);
+}
@@ -0,0 +1,121 @@
+#include "catch.hpp"
+#include "SymbolTable.h"
+#include "StringInterner.h"
+#include <map>
+#include <random>
+#include <vector>
+
+using BBTCompiler::SymbolTable;
+using BBTCompiler::SymbolType;
+using BBTCompiler::StringInterner;
+
+TEST_CASE("SymbolTableScopes", "[SymbolTable]")
+{
+    StringInterner interner;
+    const auto x = interner.intern("x");
+    const auto y = interner.intern("y");
+    const auto f = interner.intern("f");
+    SymbolTable table;
+
+    SECTION("inner declarations shadow outer ones until their scope is popped")
+    {
+        table.pushScope();
+        table.addSymbol(x, SymbolType::VARIABLE);
+        table.addSymbol(f, SymbolType::FUNCTION);
+        CHECK(table.find(y) == nullptr);
+
+        table.pushScope();
+        CHECK(table.depth() == 2);
+        CHECK_FALSE(table.isDeclaredInScope(x));
+        table.addSymbol(x, SymbolType::TYPE);
+        table.addSymbol(y, SymbolType::VARIABLE);
+        CHECK(table.isDeclaredInScope(x));
+        REQUIRE(table.find(x));
+        CHECK(table.find(x)->type == SymbolType::TYPE);
+        CHECK(table.find(f)->type == SymbolType::FUNCTION);
+
+        table.popScope();
+        CHECK(table.depth() == 1);
+        REQUIRE(table.find(x));
+        CHECK(table.find(x)->type == SymbolType::VARIABLE);
+        CHECK(table.find(y) == nullptr);
+        CHECK(table.isDeclaredInScope(x));
+
+        table.popScope();
+        CHECK(table.find(x) == nullptr);
+        CHECK(table.find(f) == nullptr);
+    }
+
+    SECTION("redeclaring in the same scope replaces the declaration")
+    {
+        table.pushScope();
+        table.addSymbol(x, SymbolType::VARIABLE);
+        table.pushScope();
+        table.addSymbol(x, SymbolType::VARIABLE);
+        table.addSymbol(x, SymbolType::FUNCTION).type = SymbolType::TYPE;
+        CHECK(table.find(x)->type == SymbolType::TYPE);
+        table.popScope();
+        CHECK(table.find(x)->type == SymbolType::VARIABLE);
+    }
+
+    SECTION("declarations without an open scope are never popped")
+    {
+        table.addSymbol(x, SymbolType::FUNCTION);
+        CHECK(table.isDeclaredInScope(x));
+        table.pushScope();
+        table.addSymbol(x, SymbolType::VARIABLE);
+        table.popScope();
+        REQUIRE(table.find(x));
+        CHECK(table.find(x)->type == SymbolType::FUNCTION);
+    }
+}
+
+TEST_CASE("SymbolTableModel", "[SymbolTable]")
+{
+    // Random declarations and scope changes, checked against a stack of maps,
+    // with enough names to make the table grow while shadowing chains are live
+    std::mt19937 random{ 42 };
+    StringInterner interner;
+    std::vector<BBTCompiler::SymbolId> names;
+    for(int i = 0; i < 500; ++i)
+        names.push_back(interner.intern("name" + std::to_string(i)));
+
+    SymbolTable table;
+    std::vector<std::map<BBTCompiler::SymbolId, SymbolType>> model(1);
+    table.pushScope();
+    for(int step = 0; step < 20000; ++step)
+    {
+        const auto action = random() % 10;
+        if(action == 0 && model.size() < 50)
+        {
+            table.pushScope();
+            model.emplace_back();
+        }
+        else if(action == 1 && model.size() > 1)
+        {
+            table.popScope();
+            model.pop_back();
+        }
+        else
+        {
+            const auto name = names[random() % names.size()];
+            const auto type = static_cast<SymbolType>(random() % 3);
+            table.addSymbol(name, type);
+            model.back()[name] = type;
+        }
+
+        const auto name = names[random() % names.size()];
+        const SymbolTable::Symbol* found{ table.find(name) };
+        const SymbolType* expected{ nullptr };
+        for(auto scope = model.rbegin(); scope != model.rend() && !expected; ++scope)
+        {
+            if(auto it = scope->find(name); it != scope->end())
+                expected = &it->second;
+        }
+        REQUIRE((found == nullptr) == (expected == nullptr));
+        if(found)
+            REQUIRE(found->type == *expected);
+        REQUIRE(table.isDeclaredInScope(name) == (model.back().count(name) == 1));
+        REQUIRE(table.depth() == model.size());
+    }
+}
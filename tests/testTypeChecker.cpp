@@ -0,0 +1,264 @@
+#include "catch.hpp"
+#include "BytecodeCompiler.h"
+#include "ConstantFolder.h"
+#include "TestProgram.h"
+#include "TypeChecker.h"
+#include "VirtualMachine.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using BBTCompiler::BinaryExpr;
+using BBTCompiler::BytecodeCompiler;
+using BBTCompiler::ConstantFolder;
+using BBTCompiler::Expr;
+using BBTCompiler::ExprStmt;
+using BBTCompiler::ExprType;
+using BBTCompiler::Parser;
+using BBTCompiler::PrintStmt;
+using BBTCompiler::Stmt;
+using BBTCompiler::TypeChecker;
+using BBTCompiler::UnaryExpr;
+using BBTCompiler::VirtualMachine;
+
+namespace
+{
+    // Parses, resolves and type checks `source`, then hands the result to `check`
+    template<typename Check>
+    void withChecked(std::string_view source, Check&& check)
+    {
+        BBTTests::withProgram(source, [&](std::vector<Stmt*>& statements, uint32_t frameSize, Parser& parser) {
+            TypeChecker checker;
+            const bool checked{ checker.check(statements) };
+            check(parser, statements, frameSize, checker, checked);
+        });
+    }
+
+    std::string typeErrors(std::string_view source)
+    {
+        std::stringstream stream;
+        withChecked(source, [&](Parser&, std::vector<Stmt*>&, uint32_t, TypeChecker& checker, bool) {
+            checker.getDiagnostics().print(stream);
+        });
+        return stream.str();
+    }
+
+    const Expr& printed(const Stmt* stmt)
+    {
+        return *static_cast<const PrintStmt*>(stmt)->m_Expression;
+    }
+
+    std::string disassemble(std::string_view source)
+    {
+        std::stringstream stream;
+        withChecked(source, [&](Parser&, std::vector<Stmt*>& statements, uint32_t frameSize, TypeChecker&, bool checked) {
+            REQUIRE(checked);
+            BytecodeCompiler compiler;
+            REQUIRE(compiler.compile(statements, frameSize));
+            compiler.getProgram().disassemble(stream);
+        });
+        return stream.str();
+    }
+
+    // A checked program on the VM, with the typed opcodes, must behave like
+    // it does in the Interpreter
+    void checkSameAsInterpreter(std::string_view source)
+    {
+        withChecked(source, [&](Parser&, std::vector<Stmt*>& statements, uint32_t frameSize, TypeChecker& checker, bool checked) {
+            std::stringstream errors;
+            checker.getDiagnostics().print(errors);
+            INFO(errors.str());
+            REQUIRE(checked);
+            const BBTTests::RunResult expected{ BBTTests::interpret(statements, frameSize) };
+
+            BytecodeCompiler compiler;
+            REQUIRE(compiler.compile(statements, frameSize));
+            std::stringstream output, diagnostics;
+            VirtualMachine vm(output);
+            CHECK(vm.run(compiler.getProgram()) == (expected.exitCode == 0));
+            vm.getDiagnostics().print(diagnostics);
+            CHECK(output.str() == expected.output);
+            CHECK(diagnostics.str() == expected.diagnostics);
+        });
+    }
+}
+
+TEST_CASE("TypeAnnotations", "[TypeChecker]")
+{
+    withChecked(R"(
+        let i : int = 1;
+        let f : float = 2.0;
+        let c : char;
+        fn half(x: float) -> float { return x / 2; }
+        fn show(x: int) { print x; }
+        print i + f;
+        print -i;
+        print i < f && c == null;
+        print half(f) == f;
+        show(i);
+    )", [](Parser&, std::vector<Stmt*>& statements, uint32_t, TypeChecker&, bool checked) {
+        REQUIRE(checked);
+        const auto& mixed = static_cast<const BinaryExpr&>(printed(statements[5]));
+        CHECK(mixed.getType() == ExprType::FLOAT);
+        CHECK(mixed.m_Left->getType() == ExprType::INT);
+        CHECK(mixed.m_Right->getType() == ExprType::FLOAT);
+        const auto& negated = static_cast<const UnaryExpr&>(printed(statements[6]));
+        CHECK(negated.getType() == ExprType::INT);
+        const auto& logical = static_cast<const BinaryExpr&>(printed(statements[7]));
+        CHECK(logical.getType() == ExprType::BOOL);
+        CHECK(static_cast<const BinaryExpr&>(*logical.m_Right).m_Right->getType() == ExprType::NIL);
+        const auto& compared = static_cast<const BinaryExpr&>(printed(statements[8]));
+        CHECK(compared.getType() == ExprType::BOOL);
+        CHECK(compared.m_Left->getType() == ExprType::FLOAT);
+        const Expr& call{ *static_cast<const ExprStmt*>(statements[9])->m_Expression };
+        CHECK(call.getType() == ExprType::VOID);
+    });
+}
+
+TEST_CASE("TypeErrors", "[TypeChecker]")
+{
+    CHECK(typeErrors("print 1 + true;") ==
+          "<file>:1:9: type error: Operands of '+' must be two numbers or two strings.\n");
+    CHECK(typeErrors("print \"a\" - \"b\";") == "<file>:1:11: type error: Operands of '-' must be numbers.\n");
+    CHECK(typeErrors("print 1 == true;") == "<file>:1:9: type error: Operands of '==' must have the same type.\n");
+    CHECK(typeErrors("print -\"a\";") == "<file>:1:7: type error: Operand of '-' must be a number.\n");
+    CHECK(typeErrors("let x : int = 1.5;") == "<file>:1:5: type error: Value does not match the type of 'x'.\n");
+    CHECK(typeErrors("let x : float = 1.0;\nx = 1;") == "<file>:2:1: type error: Value does not match the type of 'x'.\n");
+    CHECK(typeErrors("let x : int = null;") == "<file>:1:5: type error: Value does not match the type of 'x'.\n");
+    CHECK(typeErrors("fn f(a: int) -> int { return a; }\nprint f(true);") ==
+          "<file>:2:13: type error: Argument does not match the parameter type of 'f'.\n");
+    CHECK(typeErrors("fn f(a: int) -> int { return a; }\nprint f();") ==
+          "<file>:2:9: type error: Wrong number of arguments to 'f'.\n");
+    CHECK(typeErrors("fn f() -> bool { return 1; }") ==
+          "<file>:1:18: type error: Value does not match the return type of 'f'.\n");
+    CHECK(typeErrors("fn f() { return 1; }") ==
+          "<file>:1:10: type error: Value does not match the return type of 'f'.\n");
+    CHECK(typeErrors("fn f(a: int) -> int { if (a > 0) return a; }") ==
+          "<file>:1:4: type error: 'f' does not return a value on every path.\n");
+    CHECK(typeErrors("fn f() { print 1; }\nprint f();") == "<file>:2:9: type error: 'f' does not return a value.\n");
+    CHECK(typeErrors("fn f() { print 1; }\nprint (f());") == "<file>:2:10: type error: 'f' does not return a value.\n");
+    CHECK(typeErrors("fn f() { print 1; }\nprint 1 + ((f()));") ==
+          "<file>:2:15: type error: 'f' does not return a value.\n");
+    CHECK(typeErrors("fn f() -> int { return 1; }\nprint f;") ==
+          "<file>:2:7: type error: The function 'f' can only be called.\n");
+    CHECK(typeErrors("fn apply(g: int) -> int { return g(1); }") ==
+          "<file>:1:37: type error: Can only call functions.\n");
+    // Errors do not cascade into the expressions around them
+    CHECK(typeErrors("print (1 + true) * 2 < 3;") ==
+          "<file>:1:10: type error: Operands of '+' must be two numbers or two strings.\n");
+    // Code a constant condition would remove is checked as well
+    CHECK(typeErrors("if (false) print 1 < true;") == "<file>:1:20: type error: Operands of '<' must be numbers.\n");
+}
+
+TEST_CASE("TypeCheckerAccepts", "[TypeChecker]")
+{
+    const auto accepted = [](std::string_view source) {
+        bool result{ false };
+        withChecked(source, [&](Parser&, std::vector<Stmt*>&, uint32_t, TypeChecker&, bool checked) { result = checked; });
+        return result;
+    };
+    CHECK(accepted("let c : char = null; c = \"a\" + \"b\"; print c == null;"));
+    CHECK(accepted("fn f(a: int) -> int { if (a > 0) return a; else return -a; }"));
+    CHECK(accepted("fn f() -> int { while (true) { return 1; } }"));
+    CHECK(accepted("fn f() -> int { return g(); } fn g() -> int { return 1; }"));
+    CHECK(accepted("fn outer() -> int { let x : int = 1; fn inner() -> int { return x + 1; } return inner(); }"));
+    CHECK(accepted("print 1 && \"a\" || null;"));
+    CHECK(accepted("return 1.5;"));
+}
+
+TEST_CASE("TypedBytecode", "[TypeChecker]")
+{
+    SECTION("ints and floats use the typed opcodes")
+    {
+        CHECK(disassemble("let i : int = 1; let f : float = 2.0; print i * i - -i < 2; print -f / f; print i + f;") ==
+            "== <script> ==\n"
+            "0000 CONSTANT 0 (1)\n"
+            "0003 STORE_LOCAL 0\n"
+            "0006 CONSTANT 1 (2)\n"
+            "0009 STORE_LOCAL 1\n"
+            "0012 GET_LOCAL 0\n"
+            "0015 GET_LOCAL 0\n"
+            "0018 MULTIPLY_INT\n"
+            "0019 GET_LOCAL 0\n"
+            "0022 NEGATE_INT\n"
+            "0023 SUBTRACT_INT\n"
+            "0024 CONSTANT 2 (2)\n"
+            "0027 LESS_INT\n"
+            "0028 PRINT\n"
+            "0029 GET_LOCAL 1\n"
+            "0032 NEGATE_FLOAT\n"
+            "0033 GET_LOCAL 1\n"
+            "0036 DIVIDE_FLOAT\n"
+            "0037 PRINT\n"
+            "0038 GET_LOCAL 0\n"
+            "0041 GET_LOCAL 1\n"
+            "0044 ADD\n"
+            "0045 PRINT\n"
+            "0046 NIL\n"
+            "0047 RETURN\n");
+    }
+    SECTION("folded literals keep their type")
+    {
+        withChecked("let i : int = 5; print i + 2 * 3;",
+                    [](Parser& parser, std::vector<Stmt*>& statements, uint32_t frameSize, TypeChecker&, bool checked) {
+            REQUIRE(checked);
+            ConstantFolder folder(parser.getContext());
+            folder.fold(statements);
+            CHECK(static_cast<const BinaryExpr&>(printed(statements[1])).m_Right->getType() == ExprType::INT);
+            BytecodeCompiler compiler;
+            REQUIRE(compiler.compile(statements, frameSize));
+            std::stringstream stream;
+            compiler.getProgram().disassemble(stream);
+            CHECK(stream.str().find("ADD_INT") != std::string::npos);
+        });
+    }
+    SECTION("same behaviour as the Interpreter")
+    {
+        checkSameAsInterpreter(R"(
+            fn fib(n: int) -> int { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }
+            print fib(15);
+            let big : int = 9223372036854775807;
+            print big + 1;
+            print -(big + 1);
+            print (big + 1) / -1;
+            print 7 / 2 == 3;
+            print 7 / -2 != -3;
+            let x : float = 1.5;
+            let y : float = 0.0;
+            print x * x - x / 0.5 >= 0.75;
+            print x / y;
+            print -x <= -1.5;
+            print 1 + x;
+            let s : char = "a";
+            print s + "b";
+        )");
+        checkSameAsInterpreter("let zero : int = 0; print 1; print 1 / zero; print 2;");
+    }
+    SECTION("variables read before their declaration have their default value")
+    {
+        // The typed opcodes find values of the declared type even when a
+        // hoisted function runs before the declaration
+        constexpr std::string_view source{ R"(
+            let y : int = g();
+            print y;
+            let x : int = 5;
+            fn g() -> int { return x + 1; }
+            print h();
+            let later : float = 2.5;
+            fn h() -> float { return later * 2; }
+            print name();
+            let text : char = "text";
+            fn name() -> char { return text; }
+            fn outer() -> bool {
+                let b : bool = flag();
+                let set : bool = true;
+                fn flag() -> bool { return set; }
+                return b;
+            }
+            print outer();
+            print g();
+        )" };
+        CHECK(BBTTests::interpret(source).output == "1\n0\nnull\nfalse\n6\n");
+        checkSameAsInterpreter(source);
+    }
+}
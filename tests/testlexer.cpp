@@ -1,9 +1,15 @@
 #include "catch.hpp"
 #include "Lexer.h"
+#include "MappedFile.h"
+#include "TokenBuffer.h"
 #include <sstream>
+#include <fstream>
 #include <iostream>
+#include <filesystem>
+#include <memory>
 
 using BBTCompiler::Lexer;
+using BBTCompiler::MappedFile;
 using BBTCompiler::TokenType;
 using BBTCompiler::TokenPosition;
 
@@ -235,6 +241,18 @@ TEST_CASE("LexerIdentifiers", "[Keywords][Identifiers]")
         CHECK(tokens[3].position.line == 1);
         CHECK(tokens[4].type == TokenType::END);
     }
+
+    SECTION("every keyword and near misses")
+    {
+        for(const auto& keyword : BBTCompiler::Keywords)
+            CHECK(BBTCompiler::keywordType(keyword.word) == keyword.type);
+        auto ss = std::stringstream("iff in floats whilst cons retur _if fn1 class");
+        lexer.scan(ss);
+        REQUIRE(tokens.size() == 10);
+        for(size_t i = 0; i < 8; ++i)
+            CHECK(tokens[i].type == TokenType::IDENTIFIER);
+        CHECK(tokens[8].type == TokenType::CLASS);
+    }
 }
 
 TEST_CASE("LexerFunctions", "[functions]")
@@ -296,6 +314,267 @@ const char* mainFunctionStr = R"(
     }
 }
 
+TEST_CASE("LexerBuffer", "[Buffer]")
+{
+    Lexer lexer;
+    const auto& tokens = lexer.getTokens();
+    const char* source = "let abc : float = 1.5;\nprint \"a\\\"b\" + abc;";
+
+    SECTION("string_view and stream scans produce the same tokens")
+    {
+        Lexer streamLexer;
+        auto ss = std::stringstream(source);
+        streamLexer.scan(ss);
+        lexer.scan(std::string_view(source));
+        REQUIRE(tokens.size() == 13);
+        CHECK(tokens == streamLexer.getTokens());
+        CHECK(tokens[7].value == "print");
+        CHECK(tokens[7].position.line == 2); CHECK(tokens[7].position.column == 1);
+        CHECK(tokens[8].value == "a\"b");
+        CHECK(tokens[8].position.line == 2); CHECK(tokens[8].position.column == 7);
+    }
+
+    SECTION("lexemes view into the source buffer")
+    {
+        const std::string buffer{ source };
+        lexer.scan(std::string_view(buffer));
+        REQUIRE(tokens.size() == 13);
+        const auto inBuffer = [&buffer](std::string_view value) {
+            return value.data() >= buffer.data() && value.data() + value.size() <= buffer.data() + buffer.size();
+        };
+        CHECK(inBuffer(tokens[1].value));
+        CHECK(inBuffer(tokens[4].value));
+        CHECK(inBuffer(tokens[5].value));
+        CHECK(inBuffer(tokens[10].value));
+        // Escaped string literals are materialized outside the source
+        CHECK_FALSE(inBuffer(tokens[8].value));
+        CHECK(tokens[8].value == "a\"b");
+    }
+
+    SECTION("unescaped string literal is not copied")
+    {
+        const std::string buffer{ R"(x = "plain text";)" };
+        lexer.scan(std::string_view(buffer));
+        REQUIRE(tokens.size() == 5);
+        CHECK(tokens[2].value == "plain text");
+        CHECK(tokens[2].value.data() == buffer.data() + 5);
+    }
+
+    SECTION("string literals with escapes are marked")
+    {
+        const std::string buffer{ R"("plain" "a\"b" x)" };
+        lexer.open(buffer);
+        CHECK(lexer.next().value == "plain");
+        CHECK_FALSE(lexer.tokenEscaped());
+        CHECK(lexer.next().value == "a\"b");
+        CHECK(lexer.tokenEscaped());
+        CHECK(lexer.next().value == "x");
+        CHECK_FALSE(lexer.tokenEscaped());
+    }
+
+    SECTION("memory mapped file")
+    {
+        const auto path = std::filesystem::temp_directory_path() / "bbtcompiler_lexer_buffer.bbt";
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << source;
+        }
+        {
+            const MappedFile file(path);
+            REQUIRE(file.isOpen());
+            CHECK(file.getView() == source);
+            lexer.scan(file.getView());
+            REQUIRE(tokens.size() == 13);
+            CHECK(tokens[1].value == "abc");
+            CHECK(tokens[12].type == TokenType::END);
+        }
+        std::filesystem::remove(path);
+    }
+
+    SECTION("empty mapped file")
+    {
+        const auto path = std::filesystem::temp_directory_path() / "bbtcompiler_lexer_empty.bbt";
+        std::ofstream(path, std::ios::binary).close();
+        {
+            const MappedFile file(path);
+            CHECK(file.isOpen());
+            CHECK(file.size() == 0);
+            lexer.scan(file.getView());
+        }
+        std::filesystem::remove(path);
+        REQUIRE(tokens.size() == 1);
+        CHECK(tokens[0].type == TokenType::END);
+    }
+
+    SECTION("missing file throws")
+    {
+        CHECK_THROWS_AS(MappedFile(std::filesystem::temp_directory_path() / "bbtcompiler_missing.bbt"), std::runtime_error);
+    }
+}
+
+TEST_CASE("LexerParallel", "[Parallel]")
+{
+    // The inputs of the sequential test cases above, plus sources where
+    // string literals span the newlines the parallel lexer splits at
+    std::vector<std::string> sources{
+        "54321", "54 321", "54.321", "5.4 3.21", "\"abcdef\"", R"("abc" "def" "gh\"i")",
+        "1+1.0", R"(15.2 /="string")", "+= -- ++", R"(str+="a"+"b")", "if _test char t_10",
+        "\n    int main(int argc, const char* argv[])\n    {\n        return 0;\n    }\n",
+        "let abc : float = 1.5;\nprint \"a\\\"b\" + abc;"
+    };
+    std::string multiline;
+    for(int i = 0; i < 40; ++i)
+    {
+        multiline += "let s" + std::to_string(i) + " : char = \"first\nsecond \\\"\n\\\\\nthird\n\";\n";
+        multiline += "print s" + std::to_string(i) + " + \"\n\" + \"x\"; \"\n\n\";\n\n";
+    }
+    sources.push_back(multiline);
+    sources.push_back(multiline + "\"unterminated\nstring\n");
+
+    for(const auto& source : sources)
+    {
+        Lexer sequential;
+        sequential.scan(std::string_view(source));
+        for(const size_t chunkSize : { 1, 7, 64 })
+        {
+            INFO("chunk size " << chunkSize << " source:\n" << source);
+            Lexer parallel;
+            parallel.scanParallel(source, 4, chunkSize);
+            CHECK(parallel.getTokens() == sequential.getTokens());
+        }
+    }
+}
+
+TEST_CASE("LexerPull", "[Stream]")
+{
+    const std::string source{ "fn f(a: int) -> int\n{\n    return a * 2.5 + \"x\\\"y\";\n}\n" };
+    Lexer scanned;
+    scanned.scan(std::string_view(source));
+
+    Lexer pulled;
+    pulled.open(source);
+    std::vector<BBTCompiler::Token> tokens;
+    do
+    {
+        tokens.push_back(pulled.next());
+    } while(tokens.back().type != TokenType::END);
+
+    CHECK(pulled.getTokens().empty());
+    CHECK(tokens == scanned.getTokens());
+    // The END token repeats once the source is exhausted
+    CHECK(pulled.next() == tokens.back());
+}
+
+TEST_CASE("LexerTokenBuffer", "[TokenBuffer]")
+{
+    const std::vector<std::string> sources{
+        "",
+        "fn f(a: int) -> int\n{\n    return a * 2.5 + \"x\\\"y\";\n}\n",
+        "let s : char = \"first\nsecond\"; let t = \"\\\\\";\n\n\t  x -+ y",
+        "print \"unterminated"
+    };
+    for(const std::string& source : sources)
+    {
+        INFO(source);
+        Lexer lexer;
+        lexer.scan(std::string_view(source));
+        const std::vector<BBTCompiler::Token>& expected{ lexer.getTokens() };
+
+        BBTCompiler::TokenBuffer buffer;
+        buffer.scan(source);
+        REQUIRE(buffer.size() == expected.size());
+        for(size_t i = 0; i < buffer.size(); ++i)
+        {
+            CHECK(buffer.type(i) == expected[i].type);
+            CHECK(buffer.lexeme(i) == expected[i].value);
+            CHECK(buffer[i] == expected[i]);
+        }
+        CHECK(buffer.type(buffer.size() - 1) == TokenType::END);
+    }
+}
+
+TEST_CASE("LexerSymbols", "[Identifiers]")
+{
+    using BBTCompiler::NoSymbol;
+    using BBTCompiler::StringInterner;
+
+    SECTION("interner gives dense ids in first seen order")
+    {
+        StringInterner interner;
+        CHECK(interner.size() == 0);
+        CHECK(interner.find("a") == NoSymbol);
+        const auto a = interner.intern("a");
+        const auto b = interner.intern("b");
+        CHECK(a == 1);
+        CHECK(b == 2);
+        CHECK(interner.intern(std::string("a")) == a);
+        CHECK(interner.find("b") == b);
+        CHECK(interner.view(b) == "b");
+
+        // Ids and views stay valid while the table grows
+        std::vector<std::string> names;
+        for(int i = 0; i < 10000; ++i)
+            names.push_back("name_" + std::to_string(i));
+        for(size_t i = 0; i < names.size(); ++i)
+            REQUIRE(interner.intern(names[i]) == i + 3);
+        CHECK(interner.size() == names.size() + 2);
+        for(size_t i = 0; i < names.size(); ++i)
+            REQUIRE(interner.find(names[i]) == i + 3);
+        CHECK(interner.view(a) == "a");
+        CHECK(interner.intern("") == names.size() + 3);
+    }
+
+    SECTION("identifiers are interned at lex time")
+    {
+        Lexer lexer;
+        {
+            const std::string source{ "let abc : int = abc + ab + \"abc\" + 1; abc();" };
+            lexer.scan(std::string_view(source));
+        }
+        const auto& tokens = lexer.getTokens();
+        REQUIRE(tokens.size() == 18);
+        CHECK(tokens[0].symbol == NoSymbol);
+        CHECK(tokens[1].symbol != NoSymbol);
+        CHECK(tokens[3].symbol == NoSymbol);
+        CHECK(tokens[5].symbol == tokens[1].symbol);
+        CHECK(tokens[7].symbol != tokens[1].symbol);
+        CHECK(tokens[9].symbol == NoSymbol);
+        CHECK(tokens[11].symbol == NoSymbol);
+        CHECK(tokens[13].symbol == tokens[1].symbol);
+        // The interner's copy outlives the source
+        CHECK(lexer.getInterner().view(tokens[1].symbol) == "abc");
+        CHECK(lexer.getInterner().view(tokens[7].symbol) == "ab");
+    }
+
+    SECTION("lexers of one compilation share an interner")
+    {
+        auto interner = std::make_shared<StringInterner>();
+        Lexer first;
+        Lexer second;
+        first.setInterner(interner);
+        second.setInterner(interner);
+        first.scan(std::string_view("x y"));
+        second.scan(std::string_view("y z x"));
+        CHECK(second.getTokens()[0].symbol == first.getTokens()[1].symbol);
+        CHECK(second.getTokens()[2].symbol == first.getTokens()[0].symbol);
+        CHECK(interner->size() == 3);
+    }
+
+    SECTION("token buffer")
+    {
+        const std::string source{ "a bb a ccc bb" };
+        BBTCompiler::TokenBuffer buffer;
+        buffer.scan(source);
+        REQUIRE(buffer.size() == 6);
+        CHECK(buffer.symbol(0) == buffer.symbol(2));
+        CHECK(buffer.symbol(1) == buffer.symbol(4));
+        CHECK(buffer.lexeme(3) == "ccc");
+        CHECK(buffer.lexeme(3).data() == source.data() + 7);
+        CHECK(buffer.getInterner().view(buffer.symbol(3)) == "ccc");
+        CHECK(buffer.symbol(5) == NoSymbol);
+    }
+}
+
 //TEST_CASE("LexerComments", "[Comments]")
 //{
 //    REQUIRE(false);